@@ -24,6 +24,11 @@ LOCAL_CFLAGS += -Wno-unused-parameter -Wno-int-to-pointer-cast
 LOCAL_CFLAGS += -Wno-maybe-uninitialized -Wno-parentheses -DNAN_2_0
 LOCAL_CPPFLAGS += -Wno-conversion-null
 
+# Keep debug and verbose HAL logging out of user builds
+ifneq ($(TARGET_BUILD_VARIANT),user)
+LOCAL_CFLAGS += -DWIFI_HAL_LOG_LEVEL=4
+endif
+
 LOCAL_C_INCLUDES += \
 	$(LOCAL_PATH) \
 	external/libnl/include \
@@ -36,6 +41,20 @@ LOCAL_SRC_FILES := \
 	wifi_hal.cpp \
 	common.cpp \
 	cpp_bindings.cpp \
+	nl_transport.cpp \
+	nl_msg_pool.cpp \
+	cmd_slab.cpp \
+	attr_schema.cpp \
+	cap_snapshot.cpp \
+	hal_log.cpp \
+	iface_cache.cpp \
+	event_loop.cpp \
+	event_filter.cpp \
+	event_ring.cpp \
+	cmd_sched.cpp \
+	hal_perf.cpp \
+	nl_trace.cpp \
+	fake_driver.cpp \
 	llstats.cpp \
 	gscan.cpp \
 	gscan_event_handler.cpp \
@@ -48,7 +67,7 @@ LOCAL_SRC_FILES := \
 	nan_rsp.cpp
 
 LOCAL_MODULE := libwifi-hal-qcom
-LOCAL_SHARED_LIBRARIES += libnetutils liblog
+LOCAL_SHARED_LIBRARIES += libnetutils liblog libcutils
 LOCAL_SHARED_LIBRARIES += libdl
 
 ifneq ($(wildcard external/libnl),)
@@ -69,6 +88,11 @@ LOCAL_CFLAGS += -Wno-unused-parameter -Wno-int-to-pointer-cast
 LOCAL_CFLAGS += -Wno-maybe-uninitialized -Wno-parentheses -DNAN_2_0
 LOCAL_CPPFLAGS += -Wno-conversion-null
 
+# Keep debug and verbose HAL logging out of user builds
+ifneq ($(TARGET_BUILD_VARIANT),user)
+LOCAL_CFLAGS += -DWIFI_HAL_LOG_LEVEL=4
+endif
+
 LOCAL_C_INCLUDES += \
 	$(LOCAL_PATH) \
 	external/libnl/include \
@@ -81,6 +105,20 @@ LOCAL_SRC_FILES := \
 	wifi_hal.cpp \
 	common.cpp \
 	cpp_bindings.cpp \
+	nl_transport.cpp \
+	nl_msg_pool.cpp \
+	cmd_slab.cpp \
+	attr_schema.cpp \
+	cap_snapshot.cpp \
+	hal_log.cpp \
+	iface_cache.cpp \
+	event_loop.cpp \
+	event_filter.cpp \
+	event_ring.cpp \
+	cmd_sched.cpp \
+	hal_perf.cpp \
+	nl_trace.cpp \
+	fake_driver.cpp \
 	llstats.cpp \
 	gscan.cpp \
 	gscan_event_handler.cpp \
@@ -93,7 +131,7 @@ LOCAL_SRC_FILES := \
 	nan_rsp.cpp
 
 LOCAL_MODULE := libwifi-hal-qcom
-LOCAL_SHARED_LIBRARIES += libnetutils liblog
+LOCAL_SHARED_LIBRARIES += libnetutils liblog libcutils
 LOCAL_SHARED_LIBRARIES += libdl libhardware_legacy
 
 ifneq ($(wildcard external/libnl),)
@@ -105,3 +143,56 @@ LOCAL_C_INCLUDES += external/libnl-headers
 endif
 
 include $(BUILD_SHARED_LIBRARY)
+
+# Host benchmark of the netlink encode, parse and dispatch paths, run on
+# the fake driver; see wifi_hal_bench.cpp
+# ============================================================
+include $(CLEAR_VARS)
+
+LOCAL_CFLAGS += -Wno-unused-parameter -Wno-int-to-pointer-cast
+LOCAL_CFLAGS += -Wno-maybe-uninitialized -Wno-parentheses -DNAN_2_0
+LOCAL_CPPFLAGS += -Wno-conversion-null
+
+LOCAL_C_INCLUDES += \
+	$(LOCAL_PATH) \
+	external/libnl/include \
+	$(call include-path-for, libhardware_legacy)/hardware_legacy \
+	external/wpa_supplicant_8/src/drivers
+
+LOCAL_SRC_FILES := \
+	wifi_hal_bench.cpp \
+	wifi_hal.cpp \
+	common.cpp \
+	cpp_bindings.cpp \
+	nl_transport.cpp \
+	nl_msg_pool.cpp \
+	cmd_slab.cpp \
+	attr_schema.cpp \
+	cap_snapshot.cpp \
+	hal_log.cpp \
+	iface_cache.cpp \
+	event_loop.cpp \
+	event_filter.cpp \
+	event_ring.cpp \
+	cmd_sched.cpp \
+	hal_perf.cpp \
+	nl_trace.cpp \
+	fake_driver.cpp \
+	llstats.cpp \
+	gscan.cpp \
+	gscan_event_handler.cpp \
+	rtt.cpp \
+	ifaceeventhandler.cpp \
+	tdls.cpp \
+	nan.cpp \
+	nan_ind.cpp \
+	nan_req.cpp \
+	nan_rsp.cpp
+
+LOCAL_MODULE := wifi_hal_bench
+LOCAL_MODULE_TAGS := optional
+LOCAL_STATIC_LIBRARIES += libnl
+LOCAL_SHARED_LIBRARIES += liblog libcutils
+LOCAL_LDLIBS += -lpthread -lrt
+
+include $(BUILD_HOST_EXECUTABLE)
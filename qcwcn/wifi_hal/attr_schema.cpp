@@ -0,0 +1,179 @@
+/*
+ * Copyright (C) 2014 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#define LOG_TAG  "WifiHAL"
+
+#include <utils/Log.h>
+#include <sched.h>
+#include <string.h>
+
+#include "attr_schema.h"
+
+/* Bytes each wire type needs before it may be read. */
+static const u8 attr_wire_len[] = {
+    1,  /* ATTR_U8 */
+    2,  /* ATTR_U16 */
+    4,  /* ATTR_U32 */
+    4,  /* ATTR_S32 */
+    8,  /* ATTR_U64 */
+    0,  /* ATTR_BINARY */
+    0,  /* ATTR_SET: attr_field.size */
+    0,  /* ATTR_NLA */
+};
+
+/* attr_schema.ready */
+#define SCHEMA_UNBUILT          (0)
+#define SCHEMA_READY            (1)
+#define SCHEMA_BUILDING         (2)
+
+/* The first caller builds the index into the zeroed static array that
+ * ATTR_SCHEMA() provides; any other caller waits the few hundred
+ * nanoseconds that takes rather than write to it as well. */
+static void attr_schema_build(attr_schema *schema)
+{
+    u64 required = 0;
+    int state = SCHEMA_UNBUILT;
+    u16 i;
+
+    if (!__atomic_compare_exchange_n(&schema->ready, &state, SCHEMA_BUILDING,
+                                     false, __ATOMIC_ACQUIRE, __ATOMIC_ACQUIRE)) {
+        while (__atomic_load_n(&schema->ready, __ATOMIC_ACQUIRE) != SCHEMA_READY)
+            sched_yield();
+        return;
+    }
+
+    if (schema->num_fields > ATTR_SCHEMA_MAX_FIELDS)
+        ALOGE("%s: %s has %u fields, only %d are tracked", __func__,
+              schema->name, schema->num_fields, ATTR_SCHEMA_MAX_FIELDS);
+
+    for (i = 0; i < schema->num_fields && i < ATTR_SCHEMA_MAX_FIELDS; i++) {
+        const attr_field *f = &schema->fields[i];
+
+        if (f->type > schema->max_type) {
+            ALOGE("%s: %s: %s is beyond the attribute range", __func__,
+                  schema->name, f->name);
+            continue;
+        }
+        schema->index[f->type] = i + 1;
+        if (f->flags & ATTR_REQUIRED)
+            required |= (u64)1 << i;
+    }
+    schema->required = required;
+    __atomic_store_n(&schema->ready, SCHEMA_READY, __ATOMIC_RELEASE);
+}
+
+static void attr_store(void *dst, u16 size, u64 val)
+{
+    switch (size) {
+    case 1: *(u8 *)dst = (u8)val; break;
+    case 2: *(u16 *)dst = (u16)val; break;
+    case 4: *(u32 *)dst = (u32)val; break;
+    case 8: *(u64 *)dst = val; break;
+    }
+}
+
+/*
+ * The walk reads the attribute headers directly rather than going through
+ * nla_ok()/nla_next()/nla_get_*(): those are out of line in libnl and cost
+ * more than the decode itself.
+ */
+wifi_error attr_decode(attr_schema *schema, void *out, struct nlattr **slot,
+                       struct nlattr *head, int len)
+{
+    struct nlattr *nla = head;
+    u64 seen = 0, missing;
+    u16 i;
+
+    if (__atomic_load_n(&schema->ready, __ATOMIC_ACQUIRE) != SCHEMA_READY)
+        attr_schema_build(schema);
+
+    if (slot) {
+        for (i = 0; i < schema->num_fields; i++)
+            if (schema->fields[i].kind == ATTR_NLA)
+                slot[schema->fields[i].offset] = NULL;
+    }
+
+    while (len >= (int)NLA_HDRLEN && nla->nla_len >= NLA_HDRLEN &&
+           nla->nla_len <= len) {
+        int type = nla->nla_type & NLA_TYPE_MASK;
+        int n = nla->nla_len - NLA_HDRLEN;
+        const u8 *data = (const u8 *)nla + NLA_HDRLEN;
+        const attr_field *f;
+        u8 *dst;
+        u64 v64;
+        u32 v32;
+        u16 v16;
+        int need;
+
+        if (type > schema->max_type || !schema->index[type])
+            goto next;
+        i = schema->index[type] - 1;
+        f = &schema->fields[i];
+        need = f->kind == ATTR_SET ? f->size : attr_wire_len[f->kind];
+
+        if (n < need) {
+            ALOGE("%s: %s is %d bytes, expected %d", schema->name, f->name,
+                  n, need);
+            return WIFI_ERROR_INVALID_ARGS;
+        }
+
+        dst = (u8 *)out + f->offset;
+        switch (f->kind) {
+        case ATTR_U8:
+            attr_store(dst, f->size, data[0]);
+            break;
+        case ATTR_U16:
+            memcpy(&v16, data, sizeof(v16));
+            attr_store(dst, f->size, v16);
+            break;
+        case ATTR_U32:
+            memcpy(&v32, data, sizeof(v32));
+            attr_store(dst, f->size, v32);
+            break;
+        case ATTR_S32:
+            memcpy(&v32, data, sizeof(v32));
+            attr_store(dst, f->size, (u64)(s64)(s32)v32);
+            break;
+        case ATTR_U64:
+            memcpy(&v64, data, sizeof(v64));
+            attr_store(dst, f->size, v64);
+            break;
+        case ATTR_BINARY:
+            memcpy(dst, data, n < f->size ? n : f->size);
+            break;
+        case ATTR_SET:
+            f->set(out, nla);
+            break;
+        case ATTR_NLA:
+            if (slot)
+                slot[f->offset] = nla;
+            break;
+        }
+        seen |= (u64)1 << i;
+next:
+        len -= NLA_ALIGN(nla->nla_len);
+        nla = (struct nlattr *)((u8 *)nla + NLA_ALIGN(nla->nla_len));
+    }
+
+    missing = schema->required & ~seen;
+    if (missing) {
+        for (i = 0; !(missing & ((u64)1 << i)); i++)
+            ;
+        ALOGE("%s: %s not found", schema->name, schema->fields[i].name);
+        return WIFI_ERROR_INVALID_ARGS;
+    }
+    return WIFI_SUCCESS;
+}
@@ -0,0 +1,108 @@
+/*
+ * Copyright (C) 2014 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef __WIFI_HAL_ATTR_SCHEMA_H__
+#define __WIFI_HAL_ATTR_SCHEMA_H__
+
+#include <stddef.h>
+#include "common.h"
+
+/*
+ * Declarative decoders for vendor attribute sets.
+ *
+ * A struct that is filled from a set of attributes lists its
+ * attribute-to-field mapping once, as a static table of ATTR_FIELD()
+ * entries, and wraps it with ATTR_SCHEMA(). attr_decode() then walks the
+ * attributes a single time: each one is looked up by type, its payload
+ * length is checked against the wire type and the value is stored
+ * straight into the struct. Required attributes that never showed up are
+ * reported by name once the walk is done.
+ *
+ * Nested lists (and attributes whose mere presence matters) are declared
+ * with ATTR_NLA(); the decoder hands the attribute back in the caller's
+ * slot array instead of storing anything.
+ */
+
+typedef enum {
+    ATTR_U8,
+    ATTR_U16,
+    ATTR_U32,
+    ATTR_S32,       /* sign extended into wider fields */
+    ATTR_U64,
+    ATTR_BINARY,    /* copied, truncated to the field size */
+    ATTR_SET,       /* converted by attr_field.set, size is the wire length */
+    ATTR_NLA        /* returned in slot[attr_field.offset] */
+} attr_kind;
+
+#define ATTR_REQUIRED           (1 << 0)
+#define ATTR_OPTIONAL           (0)
+
+/* attr_schema.required is a bit per table entry */
+#define ATTR_SCHEMA_MAX_FIELDS  (64)
+
+typedef struct attr_field {
+    u16 type;
+    u8 kind;
+    u8 flags;
+    u16 offset;
+    u16 size;
+    void (*set)(void *out, const struct nlattr *nla);
+    const char *name;
+} attr_field;
+
+typedef struct attr_schema {
+    const char *name;
+    const attr_field *fields;
+    u16 num_fields;
+    u16 max_type;
+    u8 *index;              /* type -> table entry + 1, built on first use */
+    u64 required;
+    int ready;              /* set once index and required are built */
+} attr_schema;
+
+#define ATTR_FIELD(st, attr, kind, member, flags)                           \
+    { (attr), ATTR_##kind, (flags), offsetof(st, member),                   \
+      sizeof(((st *)0)->member), NULL, #attr }
+
+#define ATTR_SETTER(attr, fn, wire_len, flags)                              \
+    { (attr), ATTR_SET, (flags), 0, (wire_len), (fn), #attr }
+
+#define ATTR_NLA(attr, slot, flags)                                         \
+    { (attr), ATTR_NLA, (flags), (slot), 0, NULL, #attr }
+
+#define ATTR_SCHEMA(var, fields, max_type)                                  \
+    static u8 var##_index[(max_type) + 1];                                  \
+    attr_schema var = { #var, fields, sizeof(fields) / sizeof(fields[0]),   \
+                        (max_type), var##_index, 0, 0 }
+
+/*
+ * Decode the attribute stream at head/len into out. slot receives the
+ * ATTR_NLA attributes (NULL when absent) and may be NULL if the schema has
+ * none. Returns WIFI_ERROR_INVALID_ARGS on a missing required attribute or
+ * a short payload, after logging which one.
+ */
+wifi_error attr_decode(attr_schema *schema, void *out, struct nlattr **slot,
+                       struct nlattr *head, int len);
+
+static inline wifi_error attr_decode_nested(attr_schema *schema, void *out,
+                                            struct nlattr **slot,
+                                            struct nlattr *nla)
+{
+    return attr_decode(schema, out, slot, (struct nlattr *)nla_data(nla),
+                       nla_len(nla));
+}
+
+#endif /* __WIFI_HAL_ATTR_SCHEMA_H__ */
@@ -0,0 +1,482 @@
+/*
+ * Copyright (C) 2014 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <cutils/properties.h>
+
+#include "wifi_hal.h"
+#include "common.h"
+#include "cap_snapshot.h"
+
+#define CAP_SNAPSHOT_MAGIC      (0x50414357)    /* "WCAP" */
+#define CAP_SNAPSHOT_VERSION    (2)
+
+typedef struct {
+    uint32_t magic;
+    uint16_t version;
+    uint16_t num_records;
+    uint32_t size;                                  // bytes of records that follow
+    uint32_t crc;                                   // CRC32 of those bytes
+    char key[CAP_SNAPSHOT_KEY_LEN];                 // build and driver version
+} cap_file_hdr;
+
+/* Followed by len bytes of payload, padded to 4 */
+typedef struct {
+    uint16_t type;
+    uint16_t reserved;
+    uint32_t arg;
+    uint32_t arg2;
+    uint32_t len;
+} cap_rec_hdr;
+
+#define CAP_REC_SIZE(len)       (sizeof(cap_rec_hdr) + (((len) + 3) & ~3U))
+
+typedef struct {
+    uint16_t type;
+    uint32_t arg;
+    uint32_t arg2;
+    uint32_t len;
+    uint8_t *data;
+} cap_entry;
+
+struct cap_snapshot {
+    char key[CAP_SNAPSHOT_KEY_LEN];
+    const uint8_t *map;                             // mapped file, NULL if none
+    size_t map_len;
+    bool stale;                                     // the driver disagreed with map
+    pthread_t thread;                               // revalidating map
+    bool running;                                   // ... is set, until joined
+    pthread_t self;                                 // thread, as it knows itself
+    bool revalidating;                              // ... is set
+    bool stop;                                      // no thread to run, or finish early
+    pthread_mutex_t lock;                           // protects entries, running, stop
+    cap_entry entries[CAP_SNAPSHOT_MAX_RECORDS];    // what the next file holds
+    int num_entries;
+};
+
+static uint32_t crc32(const uint8_t *p, size_t len)
+{
+    uint32_t crc = 0xffffffff;
+
+    while (len--) {
+        crc ^= *p++;
+        for (int i = 0; i < 8; i++)
+            crc = (crc >> 1) ^ (0xedb88320 & -(crc & 1));
+    }
+    return ~crc;
+}
+
+/* The build fingerprint covers the firmware shipped with the image; the
+ * driver version covers a module loaded from elsewhere. */
+static void cap_snapshot_key(char *key)
+{
+    char build[PROPERTY_VALUE_MAX] = "";
+    char driver[64] = "";
+
+    property_get("ro.build.fingerprint", build, "");
+
+    int fd = open(CAP_SNAPSHOT_DRIVER_VERSION, O_RDONLY | O_CLOEXEC);
+    if (fd >= 0) {
+        ssize_t n = read(fd, driver, sizeof(driver) - 1);
+        driver[n > 0 ? n : 0] = '\0';
+        driver[strcspn(driver, "\n")] = '\0';
+        close(fd);
+    }
+
+    memset(key, 0, CAP_SNAPSHOT_KEY_LEN);
+    snprintf(key, CAP_SNAPSHOT_KEY_LEN, "%s|%s", build, driver);
+}
+
+/* Calls fn on each record of a checked file; stops when fn returns false */
+static void cap_snapshot_walk(const uint8_t *map,
+        bool (*fn)(const cap_rec_hdr *rec, void *arg), void *arg)
+{
+    const cap_file_hdr *hdr = (const cap_file_hdr *)map;
+    const uint8_t *p = map + sizeof(*hdr);
+
+    for (int i = 0; i < hdr->num_records; i++) {
+        const cap_rec_hdr *rec = (const cap_rec_hdr *)p;
+        if (!fn(rec, arg))
+            return;
+        p += CAP_REC_SIZE(rec->len);
+    }
+}
+
+static bool cap_snapshot_check(const uint8_t *map, size_t len,
+        const char *key)
+{
+    const cap_file_hdr *hdr = (const cap_file_hdr *)map;
+
+    if (len < sizeof(*hdr) || hdr->magic != CAP_SNAPSHOT_MAGIC
+            || hdr->version != CAP_SNAPSHOT_VERSION
+            || hdr->num_records > CAP_SNAPSHOT_MAX_RECORDS
+            || hdr->size != len - sizeof(*hdr))
+        return false;
+    if (crc32(map + sizeof(*hdr), hdr->size) != hdr->crc)
+        return false;
+    if (memcmp(hdr->key, key, CAP_SNAPSHOT_KEY_LEN) != 0) {
+        ALOGI("Capability snapshot is for %.*s", CAP_SNAPSHOT_KEY_LEN,
+                hdr->key);
+        return false;
+    }
+
+    /* every record must lie within the file */
+    size_t off = sizeof(*hdr);
+    for (int i = 0; i < hdr->num_records; i++) {
+        const cap_rec_hdr *rec = (const cap_rec_hdr *)(map + off);
+        if (len - off < sizeof(*rec) || rec->len > len
+                || len - off < CAP_REC_SIZE(rec->len))
+            return false;
+        off += CAP_REC_SIZE(rec->len);
+    }
+    return off == len;
+}
+
+static cap_entry *cap_entry_find(cap_snapshot *snap, int type, u32 arg,
+        u32 arg2)
+{
+    for (int i = 0; i < snap->num_entries; i++) {
+        cap_entry *e = &snap->entries[i];
+        if (e->type == type && e->arg == arg && e->arg2 == arg2)
+            return e;
+    }
+    return NULL;
+}
+
+/* Replaces the entry for type/arg/arg2; returns whether anything changed */
+static bool cap_entry_set(cap_snapshot *snap, int type, u32 arg, u32 arg2,
+        const void *data, int len)
+{
+    cap_entry *e = cap_entry_find(snap, type, arg, arg2);
+
+    if (e != NULL && e->len == (uint32_t)len && !memcmp(e->data, data, len))
+        return false;
+
+    uint8_t *copy = (uint8_t *)malloc(len > 0 ? len : 1);
+    if (copy == NULL)
+        return false;
+    memcpy(copy, data, len);
+
+    if (e == NULL) {
+        if (snap->num_entries == CAP_SNAPSHOT_MAX_RECORDS) {
+            free(copy);
+            return false;
+        }
+        e = &snap->entries[snap->num_entries++];
+        e->type = type;
+        e->arg = arg;
+        e->arg2 = arg2;
+    } else {
+        free(e->data);
+    }
+    e->len = len;
+    e->data = copy;
+    return true;
+}
+
+static bool cap_entry_load(const cap_rec_hdr *rec, void *arg)
+{
+    cap_entry_set((cap_snapshot *)arg, rec->type, rec->arg, rec->arg2,
+            rec + 1, rec->len);
+    return true;
+}
+
+/* Writes the entries out; called with snap->lock held. The file is
+ * replaced by a rename so that a reader never maps a partial one. */
+static void cap_snapshot_write(cap_snapshot *snap)
+{
+    size_t size = 0;
+    for (int i = 0; i < snap->num_entries; i++)
+        size += CAP_REC_SIZE(snap->entries[i].len);
+    if (sizeof(cap_file_hdr) + size > CAP_SNAPSHOT_MAX_SIZE)
+        return;
+
+    uint8_t *buf = (uint8_t *)calloc(1, sizeof(cap_file_hdr) + size);
+    if (buf == NULL)
+        return;
+
+    cap_file_hdr *hdr = (cap_file_hdr *)buf;
+    uint8_t *p = buf + sizeof(*hdr);
+    for (int i = 0; i < snap->num_entries; i++) {
+        const cap_entry *e = &snap->entries[i];
+        cap_rec_hdr *rec = (cap_rec_hdr *)p;
+        rec->type = e->type;
+        rec->arg = e->arg;
+        rec->arg2 = e->arg2;
+        rec->len = e->len;
+        memcpy(rec + 1, e->data, e->len);
+        p += CAP_REC_SIZE(e->len);
+    }
+    hdr->magic = CAP_SNAPSHOT_MAGIC;
+    hdr->version = CAP_SNAPSHOT_VERSION;
+    hdr->num_records = snap->num_entries;
+    hdr->size = size;
+    hdr->crc = crc32(buf + sizeof(*hdr), size);
+    memcpy(hdr->key, snap->key, CAP_SNAPSHOT_KEY_LEN);
+
+    const char *tmp = CAP_SNAPSHOT_PATH ".tmp";
+    int fd = open(tmp, O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0600);
+    if (fd < 0) {
+        ALOGE("Could not write capability snapshot: %s", strerror(errno));
+        free(buf);
+        return;
+    }
+
+    size_t len = sizeof(*hdr) + size, off = 0;
+    while (off < len) {
+        ssize_t n = write(fd, buf + off, len - off);
+        if (n < 0 && errno == EINTR)
+            continue;
+        if (n <= 0)
+            break;
+        off += n;
+    }
+    close(fd);
+    free(buf);
+
+    if (off != len || rename(tmp, CAP_SNAPSHOT_PATH) < 0) {
+        ALOGE("Could not write capability snapshot: %s", strerror(errno));
+        unlink(tmp);
+    }
+}
+
+wifi_error cap_snapshot_init(hal_info *info)
+{
+    if (info->transport != NULL)
+        return WIFI_SUCCESS;
+
+    cap_snapshot *snap = (cap_snapshot *)calloc(1, sizeof(*snap));
+    if (snap == NULL)
+        return WIFI_ERROR_OUT_OF_MEMORY;
+    pthread_mutex_init(&snap->lock, NULL);
+    cap_snapshot_key(snap->key);
+
+    int fd = open(CAP_SNAPSHOT_PATH, O_RDONLY | O_CLOEXEC);
+    if (fd >= 0) {
+        struct stat st;
+        if (fstat(fd, &st) == 0 && st.st_size > 0
+                && st.st_size <= CAP_SNAPSHOT_MAX_SIZE) {
+            void *map = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+            if (map == MAP_FAILED) {
+                ALOGE("Could not map capability snapshot: %s",
+                        strerror(errno));
+            } else if (!cap_snapshot_check((const uint8_t *)map, st.st_size,
+                        snap->key)) {
+                ALOGI("Ignoring capability snapshot, it does not check out");
+                munmap(map, st.st_size);
+            } else {
+                snap->map = (const uint8_t *)map;
+                snap->map_len = st.st_size;
+                cap_snapshot_walk(snap->map, cap_entry_load, snap);
+                ALOGI("Serving %d capability records from the snapshot",
+                        snap->num_entries);
+            }
+        }
+        close(fd);
+    }
+
+    info->caps = snap;
+    return WIFI_SUCCESS;
+}
+
+typedef struct {
+    int type;
+    u32 arg;
+    u32 arg2;
+    const cap_rec_hdr *rec;
+} cap_lookup;
+
+static bool cap_lookup_match(const cap_rec_hdr *rec, void *arg)
+{
+    cap_lookup *l = (cap_lookup *)arg;
+
+    if (rec->type != l->type || rec->arg != l->arg || rec->arg2 != l->arg2)
+        return true;
+    l->rec = rec;
+    return false;
+}
+
+int cap_snapshot_get(hal_info *info, int type, u32 arg, u32 arg2,
+        void *buf, int len)
+{
+    cap_snapshot *snap = info->caps;
+
+    if (snap == NULL || snap->map == NULL
+            || __atomic_load_n(&snap->stale, __ATOMIC_RELAXED))
+        return -1;
+    /* revalidation wants what the driver says now */
+    if (__atomic_load_n(&snap->revalidating, __ATOMIC_ACQUIRE)
+            && pthread_equal(snap->self, pthread_self()))
+        return -1;
+
+    cap_lookup l = { type, arg, arg2, NULL };
+    cap_snapshot_walk(snap->map, cap_lookup_match, &l);
+    if (l.rec == NULL)
+        return -1;
+
+    memcpy(buf, l.rec + 1, min((int)l.rec->len, len));
+    return l.rec->len;
+}
+
+void cap_snapshot_put(hal_info *info, int type, u32 arg, u32 arg2,
+        const void *data, int len)
+{
+    cap_snapshot *snap = info->caps;
+
+    if (snap == NULL)
+        return;
+
+    if (snap->map != NULL && !__atomic_load_n(&snap->stale, __ATOMIC_RELAXED)) {
+        cap_lookup l = { type, arg, arg2, NULL };
+        cap_snapshot_walk(snap->map, cap_lookup_match, &l);
+        if (l.rec != NULL && (l.rec->len != (uint32_t)len
+                    || memcmp(l.rec + 1, data, len) != 0)) {
+            ALOGI("Capability record %d/%u/%u changed, snapshot is stale",
+                    type, arg, arg2);
+            __atomic_store_n(&snap->stale, true, __ATOMIC_RELAXED);
+        }
+    }
+
+    pthread_mutex_lock(&snap->lock);
+    if (cap_entry_set(snap, type, arg, arg2, data, len))
+        cap_snapshot_write(snap);
+    pthread_mutex_unlock(&snap->lock);
+}
+
+typedef struct {
+    hal_info *info;
+    wifi_interface_handle iface;
+    int count;
+} cap_refresh;
+
+static bool cap_refresh_record(const cap_rec_hdr *rec, void *arg)
+{
+    cap_refresh *r = (cap_refresh *)arg;
+    cap_snapshot *snap = r->info->caps;
+
+    if (__atomic_load_n(&snap->stop, __ATOMIC_RELAXED))
+        return false;
+
+    switch (rec->type) {
+    case CAP_FEATURES: {
+        feature_set set;
+        wifi_get_supported_feature_set(r->iface, &set);
+        break;
+    }
+    case CAP_GSCAN: {
+        wifi_gscan_capabilities capa;
+        wifi_get_gscan_capabilities(r->iface, &capa);
+        break;
+    }
+    case CAP_CONCURRENCY: {
+        feature_set *set = (feature_set *)calloc(rec->arg + 1, sizeof(*set));
+        int num = 0;
+        if (set != NULL)
+            wifi_get_concurrency_matrix(r->iface, rec->arg, set, &num);
+        free(set);
+        break;
+    }
+    default:
+        return true;
+    }
+    r->count++;
+    return true;
+}
+
+static void *cap_snapshot_thread(void *arg)
+{
+    hal_info *info = (hal_info *)arg;
+    cap_snapshot *snap = info->caps;
+    cap_refresh r = { info, NULL, 0 };
+
+    /* pthread_create() may not have stored snap->thread yet */
+    snap->self = pthread_self();
+    __atomic_store_n(&snap->revalidating, true, __ATOMIC_RELEASE);
+
+    if (info->num_interfaces > 0) {
+        r.iface = getIfaceHandle(info->interfaces[0]);
+        cap_snapshot_walk(snap->map, cap_refresh_record, &r);
+    }
+
+    __atomic_store_n(&snap->revalidating, false, __ATOMIC_RELEASE);
+    ALOGI("Revalidated %d capability records, snapshot is %s", r.count,
+            __atomic_load_n(&snap->stale, __ATOMIC_RELAXED) ?
+            "stale" : "current");
+    return NULL;
+}
+
+void cap_snapshot_revalidate(hal_info *info)
+{
+    cap_snapshot *snap = info->caps;
+
+    if (snap == NULL || snap->map == NULL)
+        return;
+
+    /* wifi_cleanup() may have stopped us before the loop got here */
+    pthread_mutex_lock(&snap->lock);
+    if (!snap->running && !snap->stop) {
+        if (pthread_create(&snap->thread, NULL, cap_snapshot_thread, info) == 0)
+            snap->running = true;
+        else
+            ALOGE("Could not start capability revalidation");
+    }
+    pthread_mutex_unlock(&snap->lock);
+}
+
+void cap_snapshot_stop(hal_info *info)
+{
+    cap_snapshot *snap = info->caps;
+
+    if (snap == NULL)
+        return;
+
+    /* Also keeps a revalidation from starting later on; the caller that
+     * finds the thread running is the one that joins it */
+    pthread_mutex_lock(&snap->lock);
+    __atomic_store_n(&snap->stop, true, __ATOMIC_RELAXED);
+    bool running = snap->running;
+    snap->running = false;
+    pthread_mutex_unlock(&snap->lock);
+
+    if (running)
+        pthread_join(snap->thread, NULL);
+}
+
+void cap_snapshot_cleanup(hal_info *info)
+{
+    cap_snapshot *snap = info->caps;
+
+    if (snap == NULL)
+        return;
+
+    cap_snapshot_stop(info);
+    if (snap->map != NULL)
+        munmap((void *)snap->map, snap->map_len);
+    for (int i = 0; i < snap->num_entries; i++)
+        free(snap->entries[i].data);
+    pthread_mutex_destroy(&snap->lock);
+    free(snap);
+    info->caps = NULL;
+}
@@ -0,0 +1,73 @@
+/*
+ * Copyright (C) 2014 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef __WIFI_HAL_CAP_SNAPSHOT_H__
+#define __WIFI_HAL_CAP_SNAPSHOT_H__
+
+#include "common.h"
+
+/*
+ * Capability answers of the driver that survive a HAL restart.
+ *
+ * Supported features, gscan capabilities and the concurrency matrix do not
+ * change while the same driver and firmware are running, yet every
+ * wifi_initialize() used to ask for them again. The valid channels are
+ * not kept: they follow the regulatory domain, which changes at run time. Each
+ * answer the driver gives is kept as a record and written out to
+ * CAP_SNAPSHOT_PATH, under a header carrying a format version, a CRC32 of
+ * the records and a key naming the build and driver version.
+ *
+ * The next wifi_initialize() maps the file read-only and, when it checks
+ * out and the key still matches, serves the records from the mapping
+ * without a round trip. Once the event loop runs, a background thread
+ * asks the driver for every served record again; the first answer that
+ * differs marks the mapping stale, so that nothing more is served from
+ * it, and the file is rewritten with what the driver said.
+ *
+ * Nothing is kept or served when a transport stands in for the driver.
+ */
+
+#define CAP_SNAPSHOT_PATH           "/data/misc/wifi/wifi_hal_caps.bin"
+#define CAP_SNAPSHOT_DRIVER_VERSION "/sys/module/wlan/version"
+#define CAP_SNAPSHOT_KEY_LEN        (128)
+#define CAP_SNAPSHOT_MAX_RECORDS    (32)
+#define CAP_SNAPSHOT_MAX_SIZE       (64 * 1024)
+
+enum {
+    CAP_FEATURES,                                   // feature_set
+    CAP_GSCAN,                                      // wifi_gscan_capabilities
+    CAP_CONCURRENCY,                                // arg: set_size_max
+    CAP_TYPES
+};
+
+/* Maps the snapshot of an earlier run, if there is a usable one */
+wifi_error cap_snapshot_init(hal_info *info);
+/* Starts asking the driver again for what is being served */
+void cap_snapshot_revalidate(hal_info *info);
+/* Waits for the revalidation, or keeps it from starting; the event loop
+ * must still be running */
+void cap_snapshot_stop(hal_info *info);
+void cap_snapshot_cleanup(hal_info *info);
+
+/* Copies a record into buf, of len bytes at most. Returns the length of
+ * the record, or -1 if there is none to serve. */
+int cap_snapshot_get(hal_info *info, int type, u32 arg, u32 arg2,
+        void *buf, int len);
+/* Keeps an answer of the driver and writes the file if it changed */
+void cap_snapshot_put(hal_info *info, int type, u32 arg, u32 arg2,
+        const void *data, int len);
+
+#endif /* __WIFI_HAL_CAP_SNAPSHOT_H__ */
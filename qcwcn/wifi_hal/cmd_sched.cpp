@@ -0,0 +1,209 @@
+/*
+ * Copyright (C) 2014 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <pthread.h>
+
+#include "wifi_hal.h"
+#include "common.h"
+#include "cmd_sched.h"
+
+typedef struct cmd_waiter {
+    int prio;
+    uint64_t since;                                 // CLOCK_MONOTONIC ms
+    struct cmd_waiter *next;
+} cmd_waiter;
+
+struct cmd_sched {
+    pthread_mutex_t lock;
+    pthread_cond_t cond;                            // broadcast when a slot frees
+    int inflight;
+    int inflight_bulk;                              // of those, bulk and background
+    int waiting;
+    cmd_waiter *head[CMD_PRIO_MAX];                 // FIFO per class
+    cmd_waiter *next;                               // waiter the next slot is for
+    wifi_cmd_sched_stats stats;
+};
+
+static uint64_t now_ms()
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000 + ts.tv_nsec / 1000000;
+}
+
+static inline int sched_class(int prio)
+{
+    return prio < 0 || prio >= CMD_PRIO_MAX ? CMD_PRIO_INTERACTIVE : prio;
+}
+
+/* Whether a request of the given class may be sent now. Must be called
+ * with the lock held. */
+static inline bool may_send(struct cmd_sched *s, int prio)
+{
+    if (s->inflight >= CMD_SCHED_MAX_INFLIGHT)
+        return false;
+    return prio < CMD_PRIO_BULK || s->inflight_bulk < 1;
+}
+
+/* Picks the waiter the next slot is for, or NULL if none may have one
+ * right now. Waiters of a class that may not send yet, i.e. bulk and
+ * background while one of them is in flight, are passed over; they only
+ * wait for that one, which does not need slots to drain. Must be called
+ * with the lock held. */
+static cmd_waiter *pick_next(struct cmd_sched *s)
+{
+    uint64_t now = now_ms();
+    cmd_waiter *best = NULL;
+    long best_prio = 0;
+
+    for (int prio = 0; prio < CMD_PRIO_MAX; prio++) {
+        cmd_waiter *w = s->head[prio];
+        if (w == NULL || !may_send(s, prio))
+            continue;
+        long eff = prio - (long)((now - w->since) / CMD_SCHED_AGING_MS);
+        if (best == NULL || eff < best_prio
+                || (eff == best_prio && w->since < best->since)) {
+            best = w;
+            best_prio = eff;
+        }
+    }
+
+    return best;
+}
+
+static inline void take_slot(struct cmd_sched *s, int prio)
+{
+    s->inflight++;
+    if (prio >= CMD_PRIO_BULK)
+        s->inflight_bulk++;
+}
+
+static void dequeue(struct cmd_sched *s, cmd_waiter *w)
+{
+    cmd_waiter **pp = &s->head[w->prio];
+    while (*pp != w)
+        pp = &(*pp)->next;
+    *pp = w->next;
+}
+
+wifi_error cmd_sched_init(hal_info *info)
+{
+    struct cmd_sched *s = (struct cmd_sched *)malloc(sizeof(*s));
+    if (s == NULL)
+        return WIFI_ERROR_OUT_OF_MEMORY;
+
+    memset(s, 0, sizeof(*s));
+    pthread_mutex_init(&s->lock, NULL);
+    pthread_cond_init(&s->cond, NULL);
+    info->sched = s;
+    return WIFI_SUCCESS;
+}
+
+void cmd_sched_cleanup(hal_info *info)
+{
+    struct cmd_sched *s = info->sched;
+    if (s == NULL)
+        return;
+
+    pthread_cond_destroy(&s->cond);
+    pthread_mutex_destroy(&s->lock);
+    free(s);
+    info->sched = NULL;
+}
+
+void cmd_sched_acquire(hal_info *info, int prio, bool urgent)
+{
+    struct cmd_sched *s = info->sched;
+    wifi_cmd_class_stats *st;
+
+    prio = sched_class(prio);
+    st = &s->stats.cls[prio];
+
+    pthread_mutex_lock(&s->lock);
+    st->requests++;
+
+    if (urgent || (s->waiting == 0 && may_send(s, prio))) {
+        take_slot(s, prio);
+        pthread_mutex_unlock(&s->lock);
+        return;
+    }
+
+    cmd_waiter w;
+    w.prio = prio;
+    w.since = now_ms();
+    w.next = NULL;
+
+    cmd_waiter **pp = &s->head[prio];
+    while (*pp != NULL)
+        pp = &(*pp)->next;
+    *pp = &w;
+    s->waiting++;
+    st->queued++;
+    st->depth++;
+
+    if (s->next == NULL) {
+        s->next = pick_next(s);
+        if (s->next != NULL && s->next != &w)
+            pthread_cond_broadcast(&s->cond);
+    }
+    while (s->next != &w)
+        pthread_cond_wait(&s->cond, &s->lock);
+
+    dequeue(s, &w);
+    s->waiting--;
+    take_slot(s, prio);
+    s->next = pick_next(s);
+    if (s->next != NULL)
+        pthread_cond_broadcast(&s->cond);
+
+    uint32_t waited = (uint32_t)(now_ms() - w.since);
+    st->depth--;
+    st->wait_total_ms += waited;
+    if (waited > st->wait_max_ms)
+        st->wait_max_ms = waited;
+    pthread_mutex_unlock(&s->lock);
+}
+
+void cmd_sched_release(hal_info *info, int prio)
+{
+    struct cmd_sched *s = info->sched;
+
+    pthread_mutex_lock(&s->lock);
+    s->inflight--;
+    if (sched_class(prio) >= CMD_PRIO_BULK)
+        s->inflight_bulk--;
+    if (s->next == NULL) {
+        s->next = pick_next(s);
+        if (s->next != NULL)
+            pthread_cond_broadcast(&s->cond);
+    }
+    pthread_mutex_unlock(&s->lock);
+}
+
+wifi_error wifi_get_cmd_sched_stats(wifi_handle handle,
+        wifi_cmd_sched_stats *stats)
+{
+    struct cmd_sched *s = ((hal_info *)handle)->sched;
+
+    pthread_mutex_lock(&s->lock);
+    *stats = s->stats;
+    pthread_mutex_unlock(&s->lock);
+    return WIFI_SUCCESS;
+}
@@ -0,0 +1,48 @@
+/*
+ * Copyright (C) 2014 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef __WIFI_HAL_CMD_SCHED_H__
+#define __WIFI_HAL_CMD_SCHED_H__
+
+#include "common.h"
+
+/*
+ * Orders requests on cmd_sock by priority class.
+ *
+ * At most CMD_SCHED_MAX_INFLIGHT requests are outstanding with the driver
+ * at a time, and of those at most one is bulk or background, so an
+ * interactive request never queues behind more than one big transfer.
+ * Waiting requests sit in a FIFO per class; whenever a slot frees up it
+ * goes to the head with the best class that may send, where every
+ * CMD_SCHED_AGING_MS spent waiting counts as one class better, so that
+ * nothing starves under a steady stream of urgent work.
+ */
+
+#define CMD_SCHED_MAX_INFLIGHT  (2)
+#define CMD_SCHED_AGING_MS      (100)
+
+wifi_error cmd_sched_init(hal_info *info);
+void cmd_sched_cleanup(hal_info *info);
+
+/* Waits for a slot to send a request of the given class. With urgent set
+ * the slot is taken at once; for callers that must not wait, e.g. because
+ * they are the ones reading the replies that free slots. */
+void cmd_sched_acquire(hal_info *info, int prio, bool urgent);
+
+/* Gives back the slot once the request of the given class has completed */
+void cmd_sched_release(hal_info *info, int prio);
+
+#endif /* __WIFI_HAL_CMD_SCHED_H__ */
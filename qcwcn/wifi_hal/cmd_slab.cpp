@@ -0,0 +1,135 @@
+/*
+ * Copyright (C) 2014 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <pthread.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <time.h>
+
+#include "cmd_slab.h"
+#include "sync.h"
+
+#define CMD_SLAB_CLASSES        (CMD_SLAB_MAX_SIZE / CMD_SLAB_ALIGN)
+
+typedef struct cmd_slab_block {
+    struct cmd_slab_block *next;
+} cmd_slab_block;
+
+typedef struct {
+    cmd_slab_block *head;
+    unsigned count;
+} cmd_slab_class;
+
+/* The HAL has a single hal_info, and commands are allocated before it is
+ * known which one they belong to, so the free lists are global */
+static pthread_mutex_t slab_lock = PTHREAD_MUTEX_INITIALIZER;
+static cmd_slab_class slab[CMD_SLAB_CLASSES];
+static completion_slot *idle_slots;
+static unsigned num_idle_slots;
+
+static inline int size_class(size_t size)
+{
+    if (size == 0 || size > CMD_SLAB_MAX_SIZE)
+        return -1;
+    return (size - 1) / CMD_SLAB_ALIGN;
+}
+
+void *cmd_slab_alloc(size_t size)
+{
+    int c = size_class(size);
+    if (c < 0)
+        return malloc(size);
+
+    pthread_mutex_lock(&slab_lock);
+    cmd_slab_block *block = slab[c].head;
+    if (block != NULL) {
+        slab[c].head = block->next;
+        slab[c].count--;
+    }
+    pthread_mutex_unlock(&slab_lock);
+
+    if (block == NULL)
+        block = (cmd_slab_block *)malloc((c + 1) * CMD_SLAB_ALIGN);
+    return block;
+}
+
+void cmd_slab_free(void *ptr, size_t size)
+{
+    int c = size_class(size);
+    if (ptr == NULL)
+        return;
+    if (c < 0) {
+        free(ptr);
+        return;
+    }
+
+    cmd_slab_block *block = (cmd_slab_block *)ptr;
+    pthread_mutex_lock(&slab_lock);
+    if (slab[c].count < CMD_SLAB_DEPTH) {
+        block->next = slab[c].head;
+        slab[c].head = block;
+        slab[c].count++;
+        block = NULL;
+    }
+    pthread_mutex_unlock(&slab_lock);
+
+    free(block);
+}
+
+completion_slot *completion_slot_get()
+{
+    pthread_mutex_lock(&slab_lock);
+    completion_slot *s = idle_slots;
+    if (s != NULL) {
+        idle_slots = s->next;
+        num_idle_slots--;
+    }
+    pthread_mutex_unlock(&slab_lock);
+
+    if (s == NULL) {
+        s = (completion_slot *)malloc(sizeof(*s));
+        if (s == NULL)
+            return NULL;
+
+        pthread_condattr_t attr;
+        pthread_condattr_init(&attr);
+        pthread_condattr_setclock(&attr, CLOCK_MONOTONIC);
+        pthread_mutex_init(&s->lock, NULL);
+        pthread_cond_init(&s->cond, &attr);
+        pthread_condattr_destroy(&attr);
+    }
+    s->done = false;
+    s->next = NULL;
+    return s;
+}
+
+void completion_slot_put(completion_slot *s)
+{
+    pthread_mutex_lock(&slab_lock);
+    if (num_idle_slots < CMD_SLAB_DEPTH) {
+        s->next = idle_slots;
+        idle_slots = s;
+        num_idle_slots++;
+        s = NULL;
+    }
+    pthread_mutex_unlock(&slab_lock);
+
+    if (s != NULL) {
+        pthread_cond_destroy(&s->cond);
+        pthread_mutex_destroy(&s->lock);
+        free(s);
+    }
+}
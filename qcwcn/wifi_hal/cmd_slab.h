@@ -0,0 +1,39 @@
+/*
+ * Copyright (C) 2014 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef __WIFI_HAL_CMD_SLAB_H__
+#define __WIFI_HAL_CMD_SLAB_H__
+
+#include <stddef.h>
+
+/*
+ * Process wide free lists for the objects every HAL call creates and
+ * drops again: WifiCommand objects (see WifiCommand::operator new), the
+ * gscan response parameter blocks and the mutex/condition pairs behind
+ * Completion. Blocks are kept per size class of CMD_SLAB_ALIGN bytes, up
+ * to CMD_SLAB_DEPTH of each; larger ones go straight to malloc().
+ */
+
+#define CMD_SLAB_ALIGN          (64)
+#define CMD_SLAB_MAX_SIZE       (1024)
+#define CMD_SLAB_DEPTH          (8)     /* idle blocks kept per size class */
+
+/* size bytes, uninitialized; NULL on failure */
+void *cmd_slab_alloc(size_t size);
+/* size must be what the block was allocated with; ptr may be NULL */
+void cmd_slab_free(void *ptr, size_t size);
+
+#endif /* __WIFI_HAL_CMD_SLAB_H__ */
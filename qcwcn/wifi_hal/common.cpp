@@ -15,12 +15,14 @@
  */
 
 #include <stdlib.h>
+#include <unistd.h>
 #include <linux/pkt_sched.h>
 #include <netlink/object-api.h>
 #include <netlink-types.h>
 
 #include "wifi_hal.h"
 #include "common.h"
+#include "event_filter.h"
 #include <netlink-types.h>
 
 interface_info *getIfaceInfo(wifi_interface_handle handle)
@@ -53,67 +55,308 @@ wifi_interface_handle getIfaceHandle(interface_info *info)
     return (wifi_interface_handle)info;
 }
 
-wifi_error wifi_register_handler(wifi_handle handle, int cmd, nl_recvmsg_msg_cb_t func, void *arg)
+/* Event handlers are kept in a hash table keyed on (nl_cmd, vendor_id,
+ * vendor_subcmd) so that dispatching an event only walks the subscribers of
+ * that very event. Each bucket is a singly linked list kept in registration
+ * order; several subscribers may share a key as long as their cb_arg differs.
+ *
+ * The table is never modified in place. Writers serialize on cb_lock, build
+ * a copy of the affected bucket, and publish a new snapshot with an atomic
+ * pointer store. The event loop announces itself in event_cb_readers before
+ * loading the snapshot, so a replaced snapshot is only freed once no
+ * dispatcher is inside any table.
+ *
+ * Removing a handler never waits for dispatchers. Whoever owns the cb_arg of
+ * a handler that may be running hands it to wifi_release_handler_arg(),
+ * which frees it the same way once the dispatchers are gone.
+ */
+struct event_cb_release {
+    void (*release)(void *arg);
+    void *arg;
+    struct event_cb_release *next;
+};
+
+static inline unsigned int event_cb_hash(int cmd, uint32_t id, int subcmd)
 {
-    hal_info *info = (hal_info *)handle;
+    uint32_t h = (uint32_t)cmd * 0x9E3779B1u;
+    h ^= id + 0x7F4A7C15u + (h << 6) + (h >> 2);
+    h ^= (uint32_t)subcmd + 0x7F4A7C15u + (h << 6) + (h >> 2);
+    return h & (EVENT_CB_HASH_SIZE - 1);
+}
+
+static inline bool event_cb_match(const cb_info *cbi, int cmd, uint32_t id,
+        int subcmd)
+{
+    return cbi->nl_cmd == cmd && cbi->vendor_id == id
+        && cbi->vendor_subcmd == subcmd;
+}
+
+static void event_cb_free_chain(cb_info *cbi)
+{
+    while (cbi != NULL) {
+        cb_info *next = cbi->next;
+        free(cbi);
+        cbi = next;
+    }
+}
+
+/* Frees retired snapshots once no dispatcher can still be walking them.
+ * Must be called with cb_lock held. */
+static void event_cb_reclaim(hal_info *info)
+{
+    if (__atomic_load_n(&info->event_cb_readers, __ATOMIC_SEQ_CST) != 0)
+        return;
+
+    event_cb_table *tab = info->event_cb_retired;
+    __atomic_store_n(&info->event_cb_retired, (event_cb_table *)NULL,
+            __ATOMIC_RELAXED);
+    while (tab != NULL) {
+        event_cb_table *next = tab->retired_next;
+        event_cb_free_chain(tab->bucket[tab->retired_bucket]);
+        free(tab);
+        tab = next;
+    }
+}
+
+/* Detaches the pending releases once no dispatcher can still be calling a
+ * handler with their arg. Must be called with cb_lock held; the caller runs
+ * them after dropping it, as they typically unregister handlers. */
+static struct event_cb_release *event_cb_take_releases(hal_info *info)
+{
+    if (__atomic_load_n(&info->event_cb_readers, __ATOMIC_SEQ_CST) != 0)
+        return NULL;
+
+    struct event_cb_release *rel = info->event_cb_releases;
+    __atomic_store_n(&info->event_cb_releases,
+            (struct event_cb_release *)NULL, __ATOMIC_SEQ_CST);
+    return rel;
+}
+
+static void event_cb_run_releases(struct event_cb_release *rel)
+{
+    while (rel != NULL) {
+        struct event_cb_release *next = rel->next;
+        (*(rel->release))(rel->arg);
+        free(rel);
+        rel = next;
+    }
+}
+
+static void event_cb_leave(hal_info *info)
+{
+    int left = __atomic_sub_fetch(&info->event_cb_readers, 1,
+            __ATOMIC_SEQ_CST);
+    if (left != 0)
+        return;
+
+    /* Releases are not left to a later dispatch, which may never come */
+    if (__atomic_load_n(&info->event_cb_releases, __ATOMIC_SEQ_CST) != NULL) {
+        pthread_mutex_lock(&info->cb_lock);
+        event_cb_reclaim(info);
+        struct event_cb_release *rel = event_cb_take_releases(info);
+        pthread_mutex_unlock(&info->cb_lock);
+        event_cb_run_releases(rel);
+    } else if (__atomic_load_n(&info->event_cb_retired, __ATOMIC_RELAXED)
+            && pthread_mutex_trylock(&info->cb_lock) == 0) {
+        event_cb_reclaim(info);
+        pthread_mutex_unlock(&info->cb_lock);
+    }
+}
+
+static void event_cb_enter(hal_info *info)
+{
+    __atomic_add_fetch(&info->event_cb_readers, 1, __ATOMIC_SEQ_CST);
+}
+
+/* Publishes a snapshot in which bucket b is replaced by chain. On failure
+ * the caller still owns chain. Must be called with cb_lock held. */
+static wifi_error event_cb_publish(hal_info *info, unsigned int b,
+        cb_info *chain, int delta)
+{
+    event_cb_table *old = info->event_cb;
+    event_cb_table *tab = (event_cb_table *)malloc(sizeof(event_cb_table));
+    if (tab == NULL) {
+        ALOGE("Failed to allocate event handler table");
+        return WIFI_ERROR_OUT_OF_MEMORY;
+    }
+
+    memcpy(tab->bucket, old->bucket, sizeof(tab->bucket));
+    tab->bucket[b] = chain;
+    tab->num_event_cb = old->num_event_cb + delta;
+    tab->retired_bucket = 0;
+    tab->retired_next = NULL;
+
+    __atomic_store_n(&info->event_cb, tab, __ATOMIC_SEQ_CST);
+
+    old->retired_bucket = b;
+    old->retired_next = info->event_cb_retired;
+    __atomic_store_n(&info->event_cb_retired, old, __ATOMIC_RELAXED);
 
-    for (int i = 0; i < info->num_event_cb; i++) {
-        if(info->event_cb[i].nl_cmd == cmd &&
-           info->event_cb[i].cb_arg == arg) {
-            info->event_cb[i].cb_func = func;
-            ALOGI("Updated event handler %p for nl_cmd 0x%0x"
-                    " and arg %p", func, cmd, arg);
-            return WIFI_SUCCESS;
+    event_cb_reclaim(info);
+    event_filter_update(info);
+    return WIFI_SUCCESS;
+}
+
+/* Copies bucket b, leaving out 'skip' and replacing the handler of 'update'
+ * by func. Returns false if memory ran out. */
+static bool event_cb_copy_chain(const cb_info *src, const cb_info *skip,
+        const cb_info *update, nl_recvmsg_msg_cb_t func, cb_info **head,
+        cb_info ***tail)
+{
+    cb_info **pp = head;
+
+    *head = NULL;
+    for (; src != NULL; src = src->next) {
+        if (src == skip)
+            continue;
+        cb_info *cbi = (cb_info *)malloc(sizeof(cb_info));
+        if (cbi == NULL) {
+            event_cb_free_chain(*head);
+            *head = NULL;
+            return false;
         }
+        *cbi = *src;
+        if (src == update)
+            cbi->cb_func = func;
+        cbi->next = NULL;
+        *pp = cbi;
+        pp = &cbi->next;
     }
 
-    if (info->num_event_cb < info->alloc_event_cb) {
-        info->event_cb[info->num_event_cb].nl_cmd  = cmd;
-        info->event_cb[info->num_event_cb].vendor_id  = 0;
-        info->event_cb[info->num_event_cb].vendor_subcmd  = 0;
-        info->event_cb[info->num_event_cb].cb_func = func;
-        info->event_cb[info->num_event_cb].cb_arg  = arg;
-        info->num_event_cb++;
-        ALOGI("Successfully added event handler %p for command %d", func, cmd);
+    *tail = pp;
+    return true;
+}
+
+static wifi_error event_cb_add(hal_info *info, int cmd, uint32_t id,
+        int subcmd, nl_recvmsg_msg_cb_t func, void *arg)
+{
+    unsigned int b = event_cb_hash(cmd, id, subcmd);
+    const cb_info *found = NULL;
+    cb_info *chain, **tail;
+    wifi_error ret;
+
+    pthread_mutex_lock(&info->cb_lock);
+
+    for (const cb_info *cbi = info->event_cb->bucket[b]; cbi; cbi = cbi->next) {
+        if (event_cb_match(cbi, cmd, id, subcmd) && cbi->cb_arg == arg) {
+            found = cbi;
+            break;
+        }
+    }
+
+    if (found != NULL && found->cb_func == func) {
+        pthread_mutex_unlock(&info->cb_lock);
         return WIFI_SUCCESS;
-    } else {
+    }
+
+    if (!event_cb_copy_chain(info->event_cb->bucket[b], NULL, found, func,
+                &chain, &tail)) {
+        pthread_mutex_unlock(&info->cb_lock);
+        ALOGE("Failed to allocate event handler for nl_cmd 0x%0x", cmd);
         return WIFI_ERROR_OUT_OF_MEMORY;
     }
+
+    if (found == NULL) {
+        cb_info *cbi = (cb_info *)malloc(sizeof(cb_info));
+        if (cbi == NULL) {
+            pthread_mutex_unlock(&info->cb_lock);
+            event_cb_free_chain(chain);
+            ALOGE("Failed to allocate event handler for nl_cmd 0x%0x", cmd);
+            return WIFI_ERROR_OUT_OF_MEMORY;
+        }
+        cbi->nl_cmd = cmd;
+        cbi->vendor_id = id;
+        cbi->vendor_subcmd = subcmd;
+        cbi->cb_func = func;
+        cbi->cb_arg = arg;
+        cbi->next = NULL;
+        *tail = cbi;
+    } else {
+        ALOGI("Updated event handler %p for nl_cmd 0x%0x, vendor 0x%0x,"
+            " subcmd 0x%0x and arg %p", func, cmd, id, subcmd, arg);
+    }
+
+    ret = event_cb_publish(info, b, chain, found == NULL ? 1 : 0);
+    pthread_mutex_unlock(&info->cb_lock);
+
+    if (ret != WIFI_SUCCESS)
+        event_cb_free_chain(chain);
+    return ret;
 }
 
-wifi_error wifi_register_vendor_handler(wifi_handle handle,
-        uint32_t id, int subcmd, nl_recvmsg_msg_cb_t func, void *arg)
+static bool event_cb_remove(hal_info *info, int cmd, uint32_t id,
+        int subcmd, void *arg)
 {
-    hal_info *info = (hal_info *)handle;
+    unsigned int b = event_cb_hash(cmd, id, subcmd);
+    const cb_info *found = NULL;
+    cb_info *chain, **tail;
 
-    for (int i = 0; i < info->num_event_cb; i++) {
-        if(info->event_cb[i].vendor_id  == id &&
-           info->event_cb[i].vendor_subcmd == subcmd)
-        {
-            info->event_cb[i].cb_func = func;
-            info->event_cb[i].cb_arg  = arg;
-            ALOGI("Updated event handler %p for vendor 0x%0x, subcmd 0x%0x"
-                " and arg %p", func, id, subcmd, arg);
-            return WIFI_SUCCESS;
+    pthread_mutex_lock(&info->cb_lock);
+
+    for (const cb_info *cbi = info->event_cb->bucket[b]; cbi; cbi = cbi->next) {
+        if (event_cb_match(cbi, cmd, id, subcmd) && cbi->cb_arg == arg) {
+            found = cbi;
+            break;
         }
     }
 
-    if (info->num_event_cb < info->alloc_event_cb) {
-        info->event_cb[info->num_event_cb].nl_cmd  = NL80211_CMD_VENDOR;
-        info->event_cb[info->num_event_cb].vendor_id  = id;
-        info->event_cb[info->num_event_cb].vendor_subcmd  = subcmd;
-        info->event_cb[info->num_event_cb].cb_func = func;
-        info->event_cb[info->num_event_cb].cb_arg  = arg;
-        info->num_event_cb++;
+    if (found == NULL) {
+        pthread_mutex_unlock(&info->cb_lock);
+        return false;
+    }
+
+    if (!event_cb_copy_chain(info->event_cb->bucket[b], found, NULL, NULL,
+                &chain, &tail)
+            || event_cb_publish(info, b, chain, -1) != WIFI_SUCCESS) {
+        pthread_mutex_unlock(&info->cb_lock);
+        event_cb_free_chain(chain);
+        ALOGE("Failed to remove event handler for nl_cmd 0x%0x", cmd);
+        return false;
+    }
+
+    pthread_mutex_unlock(&info->cb_lock);
+    return true;
+}
+
+wifi_error wifi_init_event_handlers(wifi_handle handle)
+{
+    hal_info *info = (hal_info *)handle;
+
+    info->event_cb = (event_cb_table *)malloc(sizeof(event_cb_table));
+    if (info->event_cb == NULL)
+        return WIFI_ERROR_OUT_OF_MEMORY;
+    memset(info->event_cb, 0, sizeof(event_cb_table));
+    info->event_cb_retired = NULL;
+    info->event_cb_releases = NULL;
+    info->event_cb_readers = 0;
+    pthread_mutex_init(&info->cb_lock, NULL);
+    return WIFI_SUCCESS;
+}
+
+wifi_error wifi_register_handler(wifi_handle handle, int cmd, nl_recvmsg_msg_cb_t func, void *arg)
+{
+    hal_info *info = (hal_info *)handle;
+
+    wifi_error ret = event_cb_add(info, cmd, 0, 0, func, arg);
+    if (ret == WIFI_SUCCESS)
+        ALOGI("Successfully added event handler %p for command %d", func, cmd);
+    return ret;
+}
+
+wifi_error wifi_register_vendor_handler(wifi_handle handle,
+        uint32_t id, int subcmd, nl_recvmsg_msg_cb_t func, void *arg)
+{
+    hal_info *info = (hal_info *)handle;
+
+    wifi_error ret = event_cb_add(info, NL80211_CMD_VENDOR, id, subcmd,
+            func, arg);
+    if (ret == WIFI_SUCCESS)
         ALOGI("Added event handler %p for vendor 0x%0x, subcmd 0x%0x and arg"
             " %p", func, id, subcmd, arg);
-        return WIFI_SUCCESS;
-    } else {
-        return WIFI_ERROR_OUT_OF_MEMORY;
-    }
+    return ret;
 }
 
-void wifi_unregister_handler(wifi_handle handle, int cmd)
+void wifi_unregister_handler(wifi_handle handle, int cmd, void *arg)
 {
     hal_info *info = (hal_info *)handle;
 
@@ -121,61 +364,181 @@ void wifi_unregister_handler(wifi_handle handle, int cmd)
         ALOGE("Must use wifi_unregister_vendor_handler to remove vendor handlers");
     }
 
-    for (int i = 0; i < info->num_event_cb; i++) {
-        if (info->event_cb[i].nl_cmd == cmd) {
-            if(i < info->num_event_cb-1) {
-                /* No need to memmove if only one entry exist and deleting
-                 * the same, as the num_event_cb will become 0 in this case.
-                 */
-                memmove(&info->event_cb[i], &info->event_cb[i+1],
-                        (info->num_event_cb - i) * sizeof(cb_info));
+    if (event_cb_remove(info, cmd, 0, 0, arg))
+        ALOGI("Successfully removed event handler for command %d", cmd);
+}
+
+void wifi_unregister_vendor_handler(wifi_handle handle,
+        uint32_t id, int subcmd, void *arg)
+{
+    hal_info *info = (hal_info *)handle;
+
+    if (event_cb_remove(info, NL80211_CMD_VENDOR, id, subcmd, arg))
+        ALOGI("Successfully removed event handler for vendor 0x%0x", id);
+}
+
+/* Removes every handler registered with arg and calls release(arg) once no
+ * dispatcher can still be running one of them: right away, or when the last
+ * dispatcher leaves, on its thread. Never waits, so it may be called from a
+ * handler, which has arg released after it returns. */
+void wifi_release_handler_arg(wifi_handle handle, void *arg,
+        void (*release)(void *arg))
+{
+    hal_info *info = (hal_info *)handle;
+
+    struct event_cb_release *rel =
+        (struct event_cb_release *)malloc(sizeof(struct event_cb_release));
+    if (rel == NULL) {
+        ALOGE("Failed to defer releasing %p; leaking it", arg);
+        return;
+    }
+    rel->release = release;
+    rel->arg = arg;
+
+    pthread_mutex_lock(&info->cb_lock);
+    for (int b = 0; b < EVENT_CB_HASH_SIZE; b++) {
+        const cb_info *found;
+        cb_info *chain, **tail;
+
+        do {
+            found = NULL;
+            for (const cb_info *cbi = info->event_cb->bucket[b]; cbi;
+                    cbi = cbi->next) {
+                if (cbi->cb_arg == arg) {
+                    found = cbi;
+                    break;
+                }
             }
-            info->num_event_cb--;
-            ALOGI("Successfully removed event handler for command %d", cmd);
-            return;
-        }
+            if (found == NULL)
+                break;
+            if (!event_cb_copy_chain(info->event_cb->bucket[b], found, NULL,
+                        NULL, &chain, &tail)
+                    || event_cb_publish(info, b, chain, -1) != WIFI_SUCCESS) {
+                /* a handler stays behind, so arg must too */
+                pthread_mutex_unlock(&info->cb_lock);
+                event_cb_free_chain(chain);
+                free(rel);
+                ALOGE("Failed to remove event handlers of %p; leaking it", arg);
+                return;
+            }
+        } while (found != NULL);
     }
+
+    rel->next = info->event_cb_releases;
+    __atomic_store_n(&info->event_cb_releases, rel, __ATOMIC_SEQ_CST);
+    rel = event_cb_take_releases(info);
+    pthread_mutex_unlock(&info->cb_lock);
+
+    event_cb_run_releases(rel);
 }
 
-void wifi_unregister_vendor_handler(wifi_handle handle, uint32_t id, int subcmd)
+/* Invokes every handler subscribed to the given event, in registration
+ * order, without taking any lock. Returns the number of handlers called.
+ * Handlers may register or unregister handlers; such changes take effect
+ * from the next event on.
+ */
+int wifi_dispatch_event(wifi_handle handle, int cmd, uint32_t id, int subcmd,
+        struct nl_msg *msg)
 {
     hal_info *info = (hal_info *)handle;
+    int dispatched = 0;
 
-    for (int i = 0; i < info->num_event_cb; i++) {
-
-        if (info->event_cb[i].nl_cmd == NL80211_CMD_VENDOR
-                && info->event_cb[i].vendor_id == id
-                && info->event_cb[i].vendor_subcmd == subcmd) {
-            if(i < info->num_event_cb-1) {
-                /* No need to memmove if only one entry exist and deleting
-                 * the same, as the num_event_cb will become 0 in this case.
-                 */
-                memmove(&info->event_cb[i], &info->event_cb[i+1],
-                        (info->num_event_cb - i) * sizeof(cb_info));
-            }
-            info->num_event_cb--;
-            ALOGI("Successfully removed event handler for vendor 0x%0x", id);
-            return;
+    if (cmd != NL80211_CMD_VENDOR) {
+        id = 0;
+        subcmd = 0;
+    }
+
+    event_cb_enter(info);
+
+    event_cb_table *tab = __atomic_load_n(&info->event_cb, __ATOMIC_SEQ_CST);
+    for (cb_info *cbi = tab->bucket[event_cb_hash(cmd, id, subcmd)]; cbi;
+            cbi = cbi->next) {
+        if (event_cb_match(cbi, cmd, id, subcmd)) {
+            (*(cbi->cb_func))(msg, cbi->cb_arg);
+            dispatched++;
         }
     }
+
+    event_cb_leave(info);
+    return dispatched;
+}
+
+void wifi_for_each_event_handler(wifi_handle handle,
+        void (*fn)(cb_info *cbi, void *ctx), void *ctx)
+{
+    hal_info *info = (hal_info *)handle;
+
+    event_cb_enter(info);
+
+    event_cb_table *tab = __atomic_load_n(&info->event_cb, __ATOMIC_SEQ_CST);
+    for (int i = 0; i < EVENT_CB_HASH_SIZE; i++) {
+        for (cb_info *cbi = tab->bucket[i]; cbi; cbi = cbi->next)
+            (*fn)(cbi, ctx);
+    }
+
+    event_cb_leave(info);
 }
 
+void wifi_update_event_filter(wifi_handle handle)
+{
+    hal_info *info = (hal_info *)handle;
+
+    pthread_mutex_lock(&info->cb_lock);
+    event_filter_update(info);
+    pthread_mutex_unlock(&info->cb_lock);
+}
+
+void wifi_free_event_handlers(wifi_handle handle)
+{
+    hal_info *info = (hal_info *)handle;
 
+    if (info->event_cb == NULL)
+        return;
+
+    /* the event loop is gone; run what it still had to release */
+    pthread_mutex_lock(&info->cb_lock);
+    struct event_cb_release *rel = event_cb_take_releases(info);
+    pthread_mutex_unlock(&info->cb_lock);
+    event_cb_run_releases(rel);
+
+    pthread_mutex_lock(&info->cb_lock);
+    event_cb_reclaim(info);
+    for (int i = 0; i < EVENT_CB_HASH_SIZE; i++)
+        event_cb_free_chain(info->event_cb->bucket[i]);
+    free(info->event_cb);
+    info->event_cb = NULL;
+    pthread_mutex_unlock(&info->cb_lock);
+    pthread_mutex_destroy(&info->cb_lock);
+}
+
+/* The command array is only touched by framework threads; it grows on
+ * demand under cmd_lock. */
 wifi_error wifi_register_cmd(wifi_handle handle, int id, WifiCommand *cmd)
 {
     hal_info *info = (hal_info *)handle;
 
     ALOGD("registering command %d", id);
 
-    if (info->num_cmd < info->alloc_cmd) {
-        info->cmd[info->num_cmd].id   = id;
-        info->cmd[info->num_cmd].cmd  = cmd;
-        info->num_cmd++;
-        ALOGI("Successfully added command %d: %p", id, cmd);
-        return WIFI_SUCCESS;
-    } else {
-        return WIFI_ERROR_OUT_OF_MEMORY;
+    pthread_mutex_lock(&info->cmd_lock);
+    if (info->num_cmd == info->alloc_cmd) {
+        int alloc = info->alloc_cmd ? info->alloc_cmd * 2 : DEFAULT_CMD_SIZE;
+        cmd_info *cmds = (cmd_info *)realloc(info->cmd, alloc * sizeof(cmd_info));
+        if (cmds == NULL) {
+            pthread_mutex_unlock(&info->cmd_lock);
+            ALOGE("Failed to grow command table to %d entries", alloc);
+            return WIFI_ERROR_OUT_OF_MEMORY;
+        }
+        info->cmd = cmds;
+        info->alloc_cmd = alloc;
     }
+
+    info->cmd[info->num_cmd].id   = id;
+    info->cmd[info->num_cmd].cmd  = cmd;
+    info->num_cmd++;
+    pthread_mutex_unlock(&info->cmd_lock);
+
+    ALOGI("Successfully added command %d: %p", id, cmd);
+    return WIFI_SUCCESS;
 }
 
 WifiCommand *wifi_unregister_cmd(wifi_handle handle, int id)
@@ -184,15 +547,19 @@ WifiCommand *wifi_unregister_cmd(wifi_handle handle, int id)
 
     ALOGD("un-registering command %d", id);
 
+    pthread_mutex_lock(&info->cmd_lock);
     for (int i = 0; i < info->num_cmd; i++) {
         if (info->cmd[i].id == id) {
             WifiCommand *cmd = info->cmd[i].cmd;
-            memmove(&info->cmd[i], &info->cmd[i+1], (info->num_cmd - i) * sizeof(cmd_info));
+            memmove(&info->cmd[i], &info->cmd[i+1],
+                    (info->num_cmd - i - 1) * sizeof(cmd_info));
             info->num_cmd--;
+            pthread_mutex_unlock(&info->cmd_lock);
             ALOGI("Successfully removed command %d: %p", id, cmd);
             return cmd;
         }
     }
+    pthread_mutex_unlock(&info->cmd_lock);
 
     return NULL;
 }
@@ -201,15 +568,19 @@ void wifi_unregister_cmd(wifi_handle handle, WifiCommand *cmd)
 {
     hal_info *info = (hal_info *)handle;
 
+    pthread_mutex_lock(&info->cmd_lock);
     for (int i = 0; i < info->num_cmd; i++) {
         if (info->cmd[i].cmd == cmd) {
             int id = info->cmd[i].id;
-            memmove(&info->cmd[i], &info->cmd[i+1], (info->num_cmd - i) * sizeof(cmd_info));
+            memmove(&info->cmd[i], &info->cmd[i+1],
+                    (info->num_cmd - i - 1) * sizeof(cmd_info));
             info->num_cmd--;
+            pthread_mutex_unlock(&info->cmd_lock);
             ALOGI("Successfully removed command %d: %p", id, cmd);
             return;
         }
     }
+    pthread_mutex_unlock(&info->cmd_lock);
 }
 
 #ifdef __cplusplus
@@ -219,25 +590,7 @@ extern "C"
 
 void hexdump(char *bytes, u16 len)
 {
-    int i=0;
-    ALOGI("******HexDump len:%d*********", len);
-    for (i = 0; ((i + 7) < len); i+=8) {
-        ALOGI("%02x %02x %02x %02x   %02x %02x %02x %02x",
-              bytes[i], bytes[i+1],
-              bytes[i+2], bytes[i+3],
-              bytes[i+4], bytes[i+5],
-              bytes[i+6], bytes[i+7]);
-    }
-    if ((len - i) >= 4) {
-        ALOGI("%02x %02x %02x %02x",
-              bytes[i], bytes[i+1],
-              bytes[i+2], bytes[i+3]);
-        i+=4;
-    }
-    for (;i < len;i++) {
-        ALOGI("%02x", bytes[i]);
-    }
-    ALOGI("******HexDump End***********");
+    HAL_LOG_DUMP(HAL_LOG_CORE, "hexdump", bytes, len);
 }
 
 #ifdef __cplusplus
@@ -25,6 +25,7 @@
 
 #include <stdint.h>
 #include <fcntl.h>
+#include <pthread.h>
 #include <sys/socket.h>
 #include <netlink/genl/genl.h>
 #include <netlink/genl/family.h>
@@ -43,11 +44,38 @@
 #include "nl80211_copy.h"
 
 #include <utils/Log.h>
+#include "hal_log.h"
 
-#define SOCKET_BUFFER_SIZE      (32768U)
+#define SOCKET_BUFFER_SIZE      (32768U)  /* initial event_sock receive buffer */
+#define SOCKET_BUFFER_SIZE_MAX  (1048576U) /* grown up to this on overruns */
 #define RECV_BUF_SIZE           (4096)
-#define DEFAULT_EVENT_CB_SIZE   (64)
-#define DEFAULT_CMD_SIZE        (64)
+#define DEFAULT_CMD_SIZE        (64)    /* initial size, grows on demand */
+#define EVENT_CB_HASH_SIZE      (64)    /* must be a power of two */
+#define MAX_INTERFACES          (16)    /* wifi interfaces tracked at once */
+#define NL_MSG_POOL_SIZE        (8)     /* cached request buffers */
+#define HAL_PERF_KEYS           (256)   /* vendor subcmds with latency stats */
+
+/* nl80211 multicast groups event_sock may be a member of */
+enum {
+    HAL_MCGRP_CONFIG,
+    HAL_MCGRP_SCAN,
+    HAL_MCGRP_REGULATORY,
+    HAL_MCGRP_MLME,
+    HAL_MCGRP_VENDOR,
+    HAL_MCGRP_MAX
+};
+
+/* Phases of wifi_initialize(), reported by wifi_get_startup_timeline() */
+enum {
+    WIFI_STARTUP_SOCKETS,                           // cmd_sock and event_sock
+    WIFI_STARTUP_SUBSYSTEMS,                        // event loop, ring, trace, transport
+    WIFI_STARTUP_FAMILY,                            // nl80211 and its multicast groups
+    WIFI_STARTUP_DRIVER,                            // loading the driver, if it was not
+    WIFI_STARTUP_INTERFACES,                        // interface table and link monitor
+    WIFI_STARTUP_SNAPSHOT,                          // mapping the capability snapshot
+    WIFI_STARTUP_FEATURES,                          // supported features, on first use
+    WIFI_STARTUP_PHASES
+};
 
 #define MAC_ADDR_ARRAY(a) (a)[0], (a)[1], (a)[2], (a)[3], (a)[4], (a)[5]
 #define MAC_ADDR_STR "%02x:%02x:%02x:%02x:%02x:%02x"
@@ -59,15 +87,36 @@ typedef int64_t s64;
 typedef void (*wifi_internal_event_handler) (wifi_handle handle, int events);
 
 class WifiCommand;
-
-typedef struct {
+struct nl_pending_request;
+struct event_loop;
+struct event_ring;
+struct cmd_sched;
+struct hal_perf_entry;
+struct nl_trace;
+struct hal_transport_ops;
+struct cap_snapshot;
+class WifiEvent;
+
+typedef struct cb_info {
     int nl_cmd;
     uint32_t vendor_id;
     int vendor_subcmd;
     nl_recvmsg_msg_cb_t cb_func;
     void *cb_arg;
+    struct cb_info *next;                           // next subscriber in the hash bucket
 } cb_info;
 
+/* Immutable snapshot of the event handler registry. Writers publish a new
+ * table on every change; the event loop reads the current one without
+ * taking any lock. Unchanged buckets are shared between snapshots.
+ */
+typedef struct event_cb_table {
+    cb_info *bucket[EVENT_CB_HASH_SIZE];            // hashed on (nl_cmd, vendor_id, subcmd)
+    int num_event_cb;                               // number of event callbacks
+    int retired_bucket;                             // bucket replaced by the successor
+    struct event_cb_table *retired_next;            // next snapshot awaiting reclaim
+} event_cb_table;
+
 typedef struct {
     wifi_request_id id;
     WifiCommand *cmd;
@@ -81,9 +130,30 @@ typedef struct {
 
 typedef struct {
 
+    const struct hal_transport_ops *transport;      // stands in for the driver, or NULL
     struct nl_sock *cmd_sock;                       // command socket object
     struct nl_sock *event_sock;                     // event socket object
+    struct nl_cb *cmd_sock_cb;                      // callbacks for cmd_sock replies
+    struct nl_cb *event_sock_cb;                    // callbacks for event_sock
+    unsigned event_sock_rcvbuf;                     // receive buffer asked for event_sock
+    uint32_t event_overruns;                        // times the kernel dropped events
+    struct nl_pending_request *pending_req;         // requests awaiting an ACK
+    struct cmd_sched *sched;                        // orders requests by class
+    pthread_mutex_t xport_lock;                     // protects pending_req, nl_seq
+    pthread_cond_t xport_cond;                      // signalled on request completion
+    bool xport_reading;                             // a thread is reading cmd_sock
+    pthread_t xport_reader;                         // ... and which one
+    bool xport_parked;                              // event loop not watching cmd_sock
+    uint32_t xport_cb_seq;                          // request whose reply is being handled
+    uint32_t nl_seq;                                // last sequence number issued
+    struct nl_pending_request *completed_req;       // async requests to report
+    pthread_cond_t completion_cond;                 // signalled when completed_req grows
+    pthread_t completion_thread;
+    bool completion_running;                        // completion_thread was started
+    bool completion_exit;                           // completion_thread should exit
     int nl80211_family_id;                          // family id for 80211 driver
+    int mcast_id[HAL_MCGRP_MAX];                    // nl80211 group ids, -1 if unknown
+    uint32_t mcast_joined;                          // bit per group event_sock is in
 
     bool in_event_loop;                             // Indicates that event loop is active
     bool clean_up;                                  // Indication to clean up the socket
@@ -91,18 +161,43 @@ typedef struct {
     wifi_internal_event_handler event_handler;      // default event handler
     wifi_cleaned_up_handler cleaned_up_handler;     // socket cleaned up handler
 
-    cb_info *event_cb;                              // event callbacks
-    int num_event_cb;                               // number of event callbacks
-    int alloc_event_cb;                             // number of allocated callback objects
+    pthread_t event_thread;                         // thread running wifi_event_loop
+    struct event_loop *loop;                        // epoll set and timers of the loop
+    struct event_ring *ring;                        // events waiting for callback_thread
+    pthread_t callback_thread;                      // thread running the event handlers
+    WifiEvent *current_event;                       // event being dispatched by callback_thread
+
+    event_cb_table *event_cb;                       // current event callback snapshot
+    event_cb_table *event_cb_retired;               // snapshots waiting for readers
+    struct event_cb_release *event_cb_releases;     // handler args waiting for readers
+    int event_cb_readers;                           // dispatchers inside a snapshot
+    pthread_mutex_t cb_lock;                        // serializes handler updates
+
+    struct nl_msg *msg_pool[NL_MSG_POOL_SIZE];      // idle request buffers
+    int num_msg_pool;                               // number of idle buffers
+    pthread_mutex_t msg_pool_lock;                  // protects msg_pool
 
+    pthread_mutex_t cmd_lock;                       // protects the command array
     cmd_info *cmd;                                  // Outstanding commands
     int num_cmd;                                    // number of commands
     int alloc_cmd;                                  // number of commands allocated
 
-    interface_info **interfaces;                    // array of interfaces
+    interface_info **interfaces;                    // array of MAX_INTERFACES interfaces
     int num_interfaces;                             // number of interfaces
+    pthread_mutex_t iface_lock;                     // serializes interface table updates
+    int link_sock;                                  // rtnetlink socket for link changes
 
-    feature_set supported_feature_set;
+    struct hal_perf_entry *perf[HAL_PERF_KEYS];     // latency histograms by vendor subcmd
+    struct nl_trace *trace;                         // recent netlink traffic
+
+    uint32_t startup_us[WIFI_STARTUP_PHASES];       // time spent in each phase
+    uint32_t startup_total_us;                      // wifi_initialize() as a whole
+
+    struct cap_snapshot *caps;                      // capabilities kept across runs
+
+    feature_set supported_feature_set;              // valid once features_known
+    bool features_known;                            // the driver has been asked
+    pthread_mutex_t feature_lock;                   // serializes asking it
     // add other details
 } hal_info;
 
@@ -110,8 +205,107 @@ wifi_error wifi_register_handler(wifi_handle handle, int cmd, nl_recvmsg_msg_cb_
 wifi_error wifi_register_vendor_handler(wifi_handle handle,
             uint32_t id, int subcmd, nl_recvmsg_msg_cb_t func, void *arg);
 
-void wifi_unregister_handler(wifi_handle handle, int cmd);
-void wifi_unregister_vendor_handler(wifi_handle handle, uint32_t id, int subcmd);
+void wifi_unregister_handler(wifi_handle handle, int cmd, void *arg);
+void wifi_unregister_vendor_handler(wifi_handle handle,
+            uint32_t id, int subcmd, void *arg);
+/* Unregisters the handlers of arg and releases it once none is running */
+void wifi_release_handler_arg(wifi_handle handle, void *arg,
+            void (*release)(void *arg));
+int wifi_dispatch_event(wifi_handle handle, int cmd, uint32_t id, int subcmd,
+            struct nl_msg *msg);
+wifi_error wifi_init_event_handlers(wifi_handle handle);
+void wifi_free_event_handlers(wifi_handle handle);
+/* Matches group membership and the event_sock filter to the handlers */
+void wifi_update_event_filter(wifi_handle handle);
+/* Calls fn for every registered event handler, from a consistent snapshot */
+void wifi_for_each_event_handler(wifi_handle handle,
+            void (*fn)(cb_info *cbi, void *ctx), void *ctx);
+
+typedef struct {
+    uint32_t overruns;                              // event_sock overflows so far
+    uint32_t rcvbuf;                                // current receive buffer size
+} wifi_event_sock_stats;
+
+wifi_error wifi_get_event_sock_stats(wifi_handle handle, wifi_event_sock_stats *stats);
+
+/* What the event thread does with an event when the callback thread is
+ * EVENT_RING_SIZE events behind */
+typedef enum {
+    EVENT_RING_BLOCK,                               // wait for the callback thread
+    EVENT_RING_DROP_OLDEST,                         // drop the oldest queued event
+    EVENT_RING_COALESCE,                            // drop it if the same event is queued (default)
+} wifi_event_ring_policy;
+
+typedef struct {
+    uint32_t depth;                                 // events waiting right now
+    uint32_t max_depth;                             // most events ever waiting
+    uint32_t stalls;                                // times the event thread waited
+    uint32_t dropped;                               // events dropped when full
+    uint32_t coalesced;                             // events merged into a queued one
+    uint32_t delivered;                             // events handed to the handlers
+} wifi_event_ring_stats;
+
+wifi_error wifi_set_event_ring_policy(wifi_handle handle, wifi_event_ring_policy policy);
+wifi_error wifi_get_event_ring_stats(wifi_handle handle, wifi_event_ring_stats *stats);
+
+/* Priority classes of requests on cmd_sock, most urgent first */
+typedef enum {
+    CMD_PRIO_INTERACTIVE,                           // everything not listed below
+    CMD_PRIO_RANGING,                               // RTT and NAN
+    CMD_PRIO_BULK,                                  // statistics and cached results
+    CMD_PRIO_BACKGROUND,                            // background scan setup
+    CMD_PRIO_MAX
+} wifi_cmd_priority;
+
+typedef struct {
+    uint32_t requests;                              // requests sent
+    uint32_t queued;                                // ... that had to wait for a slot
+    uint32_t depth;                                 // requests waiting right now
+    uint32_t wait_max_ms;                           // longest wait for a slot
+    uint64_t wait_total_ms;                         // sum of all waits
+} wifi_cmd_class_stats;
+
+typedef struct {
+    wifi_cmd_class_stats cls[CMD_PRIO_MAX];
+} wifi_cmd_sched_stats;
+
+wifi_error wifi_get_cmd_sched_stats(wifi_handle handle, wifi_cmd_sched_stats *stats);
+
+typedef struct {
+    uint32_t count;                                 // samples recorded
+    uint32_t p50_us;                                // median, in microseconds
+    uint32_t p99_us;                                // 99th percentile
+    uint32_t max_us;                                // slowest sample
+} wifi_perf_summary;
+
+typedef struct {
+    int subcmd;                                     // vendor subcommand
+    wifi_perf_summary build;                        // request create() to send
+    wifi_perf_summary ack;                          // send to ACK from the driver
+    wifi_perf_summary event;                        // ACK to the event answering it
+    wifi_perf_summary dispatch;                     // running the handlers of an event
+} wifi_cmd_perf_stats;
+
+/* Fills stats with up to max_stats subcommands that have samples */
+wifi_error wifi_get_hal_perf_stats(wifi_handle handle,
+        wifi_cmd_perf_stats *stats, int max_stats, int *num);
+
+typedef struct {
+    uint32_t phase_us[WIFI_STARTUP_PHASES];         // duration of each phase, 0 if not run
+    uint32_t total_us;                              // wifi_initialize() from entry to return
+} wifi_startup_timeline;
+
+wifi_error wifi_get_startup_timeline(wifi_handle handle,
+        wifi_startup_timeline *timeline);
+
+/* Supported features, asked of the driver the first time they are needed */
+feature_set hal_feature_set(hal_info *info);
+
+/* Writes the recent netlink traffic to fd as a pcap file */
+wifi_error wifi_dump_nl_trace(wifi_handle handle, int fd);
+/* Feeds the events in a pcap file from wifi_dump_nl_trace() to the event
+ * handlers, spaced as recorded if realtime is set, else back to back */
+wifi_error wifi_replay_nl_trace(wifi_handle handle, const char *path, bool realtime);
 
 wifi_error wifi_register_cmd(wifi_handle handle, int id, WifiCommand *cmd);
 WifiCommand *wifi_unregister_cmd(wifi_handle handle, int id);
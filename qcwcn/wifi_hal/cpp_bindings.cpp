@@ -34,10 +34,14 @@
 
 #include "nl80211_copy.h"
 #include <ctype.h>
+#include <errno.h>
 
 #include "wifi_hal.h"
 #include "common.h"
 #include "cpp_bindings.h"
+#include "nl_transport.h"
+#include "iface_cache.h"
+#include "hal_perf.h"
 
 void appendFmt(char *buf, size_t buf_len, int &offset, const char *fmt, ...)
 {
@@ -493,43 +497,19 @@ const char *attributeToString(int attribute)
 }
 
 void WifiEvent::log() {
-    parse();
+    if (parse() < 0)
+        return;
 
     byte *data = (byte *)genlmsg_attrdata(mHeader, 0);
     int len = genlmsg_attrlen(mHeader, 0);
     ALOGD("cmd = %s, len = %d", get_cmdString(), len);
     ALOGD("vendor_id = %04x, vendor_subcmd = %d", get_vendor_id(), get_vendor_subcmd());
 
-    for (int i = 0; i < len; i += 16) {
-        char line[81];
-        int linelen = min(16, len - i);
-        int offset = 0;
-        appendFmt(line, sizeof(line), offset, "%02x", data[i]);
-        for (int j = 1; j < linelen; j++) {
-            appendFmt(line, sizeof(line), offset, " %02x", data[i+j]);
-        }
-
-        for (int j = linelen; j < 16; j++) {
-            appendFmt(line, sizeof(line), offset, "   ");
-        }
-
-        line[23] = '-';
-
-        appendFmt(line, sizeof(line), offset, "  ");
-
-        for (int j = 0; j < linelen; j++) {
-            if (isprint(data[i+j])) {
-                appendFmt(line, sizeof(line), offset, "%c", data[i+j]);
-            } else {
-                appendFmt(line, sizeof(line), offset, "-");
-            }
-        }
-
-        ALOGD("%s", line);
-    }
+    hal_log_dump(HAL_LOG_CORE, get_cmdString(), data, len);
 
+    nlattr **tb = attributes();
     for (unsigned i = 0; i < NL80211_ATTR_MAX_INTERNAL; i++) {
-        if (mAttributes[i] != NULL) {
+        if (tb[i] != NULL) {
             ALOGD("found attribute %s", attributeToString(i));
         }
     }
@@ -546,16 +526,68 @@ int WifiEvent::parse() {
     if (mHeader != NULL) {
         return WIFI_SUCCESS;
     }
-    mHeader = (genlmsghdr *)nlmsg_data(nlmsg_hdr(mMsg));
-    int result = nla_parse(mAttributes, NL80211_ATTR_MAX_INTERNAL, genlmsg_attrdata(mHeader, 0),
-          genlmsg_attrlen(mHeader, 0), NULL);
+    struct nlmsghdr *nlh = nlmsg_hdr(mMsg);
+    if (!genlmsg_valid_hdr(nlh, 0)) {
+        return -NLE_MSG_TOOSHORT;
+    }
+    /* attributes are located on demand, see get_attribute()/attributes() */
+    mHeader = (genlmsghdr *)nlmsg_data(nlh);
 
     // ALOGD("event len = %d", nlmsg_hdr(mMsg)->nlmsg_len);
-    return result;
+    return WIFI_SUCCESS;
+}
+
+nlattr *WifiEvent::find_attribute(int attribute) {
+    for (unsigned i = 0; i < mNumCached; i++) {
+        if (mCachedType[i] == attribute)
+            return mCachedAttr[i];
+    }
+
+    if (parse() < 0)
+        return NULL;
+
+    /* nla_parse() keeps the last instance of a repeated attribute */
+    struct nlattr *found = NULL, *pos;
+    int rem;
+    nla_for_each_attr(pos, genlmsg_attrdata(mHeader, 0),
+            genlmsg_attrlen(mHeader, 0), rem) {
+        if (nla_type(pos) == attribute)
+            found = pos;
+    }
+
+    if (mNumCached < ATTR_CACHE_SIZE) {
+        mCachedType[mNumCached] = attribute;
+        mCachedAttr[mNumCached] = found;
+        mNumCached++;
+    }
+    return found;
+}
+
+nlattr **WifiEvent::attributes() {
+    /* handed out when the index cannot be allocated; never written */
+    static struct nlattr *no_attributes[NL80211_ATTR_MAX_INTERNAL + 1];
+
+    if (mAttributes != NULL)
+        return mAttributes;
+    if (parse() < 0)
+        return no_attributes;
+
+    mAttributes = (struct nlattr **)calloc(NL80211_ATTR_MAX_INTERNAL + 1,
+            sizeof(struct nlattr *));
+    if (mAttributes == NULL) {
+        ALOGE("Failed to allocate attribute index");
+        return no_attributes;
+    }
+    nla_parse(mAttributes, NL80211_ATTR_MAX_INTERNAL, genlmsg_attrdata(mHeader, 0),
+          genlmsg_attrlen(mHeader, 0), NULL);
+    return mAttributes;
 }
 
 int WifiRequest::create(int family, uint8_t cmd, int flags, int hdrlen) {
-    mMsg = nlmsg_alloc();
+    destroy();
+    mCreated = hal_perf_now_us();
+    mMsg = nl_msg_pool_get(mInfo, mSizeHint);
+    mSizeHint = 0;
     if (mMsg != NULL) {
         genlmsg_put(mMsg, /* pid = */ 0, /* seq = */ 0, family,
                 hdrlen, flags, cmd, /* version = */ 0);
@@ -589,11 +621,6 @@ int WifiRequest::create(uint32_t id, int subcmd) {
 }
 
 
-static int no_seq_check(struct nl_msg *msg, void *arg)
-{
-    return NL_OK;
-}
-
 int WifiCommand::requestResponse() {
     int err = create();                 /* create the message */
     if (err < 0) {
@@ -603,39 +630,123 @@ int WifiCommand::requestResponse() {
     return requestResponse(mMsg);
 }
 
-int WifiCommand::requestResponse(WifiRequest& request) {
-    int err = 0;
+int WifiCommand::requestResponse(WifiRequest& request, bool awaitEvent) {
+    /* Replies are matched to this request by sequence number, so several
+     * commands may be in flight on cmd_sock at the same time. */
+    return transact(request, response_handler, this, awaitEvent);
+}
 
-    struct nl_cb *cb = nl_cb_alloc(NL_CB_DEFAULT);
-    if (!cb)
-        goto out;
+/* mPerfEventMark hands the ACK time to event_handler(): 0 when no event is
+ * awaited, 1 while the request is in flight and the ACK time after that.
+ * Whichever side takes the mark away records the sample, so an event that
+ * overtakes its ACK counts once, as zero. */
+int WifiCommand::transact(WifiRequest& request, nl_recvmsg_msg_cb_t valid_cb,
+        void *valid_arg, bool awaitEvent) {
+    if (cancelled())
+        return -ECANCELED;
+
+    uint64_t sent = hal_perf_now_us();
+    mPerfKey = hal_perf_msg_key(request.getMessage());
+    hal_perf_record(mInfo, mPerfKey, HAL_PERF_BUILD, sent - request.created());
+
+    __atomic_store_n(&mPerfEventMark, awaitEvent ? 1 : 0, __ATOMIC_RELEASE);
+    int err = nl_transport_request(mInfo, request.getMessage(), mPriority,
+            valid_cb, valid_arg, &mPendingSeq);
+    __atomic_store_n(&mPendingSeq, 0, __ATOMIC_SEQ_CST);
+
+    uint64_t acked = hal_perf_now_us();
+    hal_perf_record(mInfo, mPerfKey, HAL_PERF_ACK, acked - sent);
+
+    if (awaitEvent)
+        ackBeforeEvent(err, acked);
+    return err;
+}
 
-    err = nl_send_auto_complete(mInfo->cmd_sock, request.getMessage());    /* send message */
-    if (err < 0)
-        goto out;
+void WifiCommand::ackBeforeEvent(int err, uint64_t acked) {
+    uint64_t mark = 1;
+    if (err < 0) {
+        __atomic_store_n(&mPerfEventMark, 0, __ATOMIC_RELEASE);
+    } else if (!__atomic_compare_exchange_n(&mPerfEventMark, &mark, acked,
+                false, __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE)) {
+        hal_perf_record(mInfo, mPerfKey, HAL_PERF_EVENT, 0);
+    }
+}
+
+int WifiCommand::requestResponseAsync(wifi_command_callback cb, void *ctx) {
+    int err = create();                 /* create the message */
+    if (err < 0) {
+        return err;
+    }
 
-    err = 1;
+    return requestResponseAsync(mMsg, cb, ctx);
+}
 
-    nl_cb_set(cb, NL_CB_SEQ_CHECK, NL_CB_CUSTOM, no_seq_check, NULL);
-    nl_cb_err(cb, NL_CB_CUSTOM, error_handler, &err);
-    nl_cb_set(cb, NL_CB_FINISH, NL_CB_CUSTOM, finish_handler, &err);
-    nl_cb_set(cb, NL_CB_ACK, NL_CB_CUSTOM, ack_handler, &err);
-    nl_cb_set(cb, NL_CB_VALID, NL_CB_CUSTOM, response_handler, this);
+int WifiCommand::requestResponseAsync(WifiRequest& request,
+        wifi_command_callback cb, void *ctx) {
+    /* cancelled since create(); cb is not called */
+    if (cancelled())
+        return -ECANCELED;
+
+    mCallback = cb;
+    mCallbackCtx = ctx;
+    mPerfSent = hal_perf_now_us();
+    mPerfKey = hal_perf_msg_key(request.getMessage());
+    hal_perf_record(mInfo, mPerfKey, HAL_PERF_BUILD,
+            mPerfSent - request.created());
+    return nl_transport_request_async(mInfo, request.getMessage(), mPriority,
+            response_handler, this, async_done_handler, this, &mPendingSeq);
+}
 
-    while (err > 0) {                   /* wait for reply */
-        int res = nl_recvmsgs(mInfo->cmd_sock, cb);
-        if (res) {
-            ALOGE("nl80211: %s->nl_recvmsgs failed: %d", __func__, res);
-        }
+int WifiCommand::sendRequest(WifiRequest& request, bool awaitEvent) {
+    mAckCompletion.reset();
+
+    if (!nl_transport_may_wait(mInfo)) {
+        /* Nobody else would read the answer; fall back to reading it here */
+        int res = requestResponse(request, awaitEvent);
+        if (res < 0)
+            return res;
+        mAckResult = 0;
+        mAckCompletion.signal();
+        return 0;
     }
-out:
-    nl_cb_put(cb);
-    return err;
+
+    __atomic_store_n(&mPerfEventMark, awaitEvent ? 1 : 0, __ATOMIC_RELEASE);
+    return requestResponseAsync(request, ack_wait_handler,
+            awaitEvent ? &mCompletion : NULL);
+}
+
+int WifiCommand::awaitResponse() {
+    /* the transport completes every request it accepted, within
+     * NL_TRANSPORT_ASYNC_TIMEOUT_MS at the latest */
+    mAckCompletion.wait();
+    return mAckResult;
+}
+
+int WifiCommand::cancel() {
+    __atomic_store_n(&mCancelled, true, __ATOMIC_RELEASE);
+
+    uint32_t seq = __atomic_load_n(&mPendingSeq, __ATOMIC_SEQ_CST);
+    if (seq != 0) {
+        ALOGI("WifiCommand %p cancelling request %u", this, seq);
+        nl_transport_cancel(mInfo, seq);
+    }
+
+    /* Wake up a requestEvent() caller waiting for its event */
+    mCompletion.signal();
+    return WIFI_SUCCESS;
+}
+
+void WifiCommand::release_handler(void *arg) {
+    delete (WifiCommand *)arg;
+}
+
+void WifiCommand::release() {
+    wifi_release_handler_arg(wifiHandle(), this, release_handler);
 }
 
 int WifiCommand::requestEvent(int cmd) {
 
-    ALOGD("requesting event %d", cmd);
+    HAL_LOGD(HAL_LOG_CORE, "requesting event %d", cmd);
 
     int res = wifi_register_handler(wifiHandle(), cmd, event_handler, this);
     if (res < 0) {
@@ -646,19 +757,22 @@ int WifiCommand::requestEvent(int cmd) {
     if (res < 0)
         goto out;
 
-    ALOGD("waiting for response %d", cmd);
+    HAL_LOGD(HAL_LOG_CORE, "waiting for response %d", cmd);
 
-    res = nl_send_auto_complete(mInfo->cmd_sock, mMsg.getMessage());    /* send message */
+    mCompletion.reset();
+    res = transact(mMsg, NULL, NULL, true);                         /* send message */
     if (res < 0)
         goto out;
 
-    ALOGD("waiting for event %d", cmd);
-    res = mCondition.wait();
+    HAL_LOGD(HAL_LOG_CORE, "waiting for event %d", cmd);
+    res = mCompletion.wait();
     if (res < 0)
         goto out;
+    if (cancelled())
+        res = -ECANCELED;
 
 out:
-    wifi_unregister_handler(wifiHandle(), cmd);
+    wifi_unregister_handler(wifiHandle(), cmd, this);
     return res;
 }
 
@@ -673,16 +787,19 @@ int WifiCommand::requestVendorEvent(uint32_t id, int subcmd) {
     if (res < 0)
         goto out;
 
-    res = nl_send_auto_complete(mInfo->cmd_sock, mMsg.getMessage());    /* send message */
+    mCompletion.reset();
+    res = transact(mMsg, NULL, NULL, true);                         /* send message */
     if (res < 0)
         goto out;
 
-    res = mCondition.wait();
+    res = mCompletion.wait();
     if (res < 0)
         goto out;
+    if (cancelled())
+        res = -ECANCELED;
 
 out:
-    wifi_unregister_vendor_handler(wifiHandle(), id, subcmd);
+    wifi_unregister_vendor_handler(wifiHandle(), id, subcmd, this);
     return res;
 }
 
@@ -696,57 +813,89 @@ int WifiCommand::response_handler(struct nl_msg *msg, void *arg) {
         ALOGE("Failed to parse reply message = %d", res);
         return NL_SKIP;
     } else {
-        reply.log();
+        if (HAL_LOG_ON(HAL_LOG_CORE, HAL_LOG_LEVEL_VERBOSE))
+            reply.log();
         return cmd->handleResponse(reply);
     }
 }
 
+void WifiCommand::async_done_handler(void *arg, int result) {
+    WifiCommand *cmd = (WifiCommand *)arg;
+    __atomic_store_n(&cmd->mPendingSeq, 0, __ATOMIC_SEQ_CST);
+    hal_perf_record(cmd->mInfo, cmd->mPerfKey, HAL_PERF_ACK,
+            hal_perf_now_us() - cmd->mPerfSent);
+    if (cmd->mCallback != NULL)
+        (*cmd->mCallback)(cmd, result, cmd->mCallbackCtx);
+}
+
+/* Completion callback of sendRequest(); ctx is the Completion of the
+ * awaited event, if any */
+void WifiCommand::ack_wait_handler(WifiCommand *cmd, int result, void *ctx) {
+    Completion *event = (Completion *)ctx;
+
+    if (event != NULL) {
+        cmd->ackBeforeEvent(result, hal_perf_now_us());
+        if (result < 0)
+            event->signal();
+    }
+    cmd->mAckResult = result;
+    /* the command may be deleted as soon as this is signalled */
+    cmd->mAckCompletion.signal();
+}
+
 int WifiCommand::event_handler(struct nl_msg *msg, void *arg) {
     WifiCommand *cmd = (WifiCommand *)arg;
-    WifiEvent event(msg);
-    int res = event.parse();
-    if (res < 0) {
-        ALOGE("Failed to parse event = %d", res);
-        res = NL_SKIP;
+    WifiEvent *current = cmd->mInfo->current_event;
+    int res;
+
+    uint64_t mark = __atomic_load_n(&cmd->mPerfEventMark, __ATOMIC_ACQUIRE);
+    while (mark != 0 && !__atomic_compare_exchange_n(&cmd->mPerfEventMark,
+                &mark, 0, true, __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE))
+        ;
+    if (mark > 1)
+        hal_perf_record(cmd->mInfo, cmd->mPerfKey, HAL_PERF_EVENT,
+                hal_perf_now_us() - mark);
+
+    if (current != NULL && current->msg() == msg
+            && pthread_equal(pthread_self(), cmd->mInfo->callback_thread)) {
+        /* already parsed by internal_deliver_event */
+        res = cmd->handleEvent(*current);
     } else {
-        res = cmd->handleEvent(event);
+        WifiEvent event(msg);
+        res = event.parse();
+        if (res < 0) {
+            ALOGE("Failed to parse event = %d", res);
+            res = NL_SKIP;
+        } else {
+            res = cmd->handleEvent(event);
+        }
     }
 
-    cmd->mCondition.signal();
+    cmd->mCompletion.signal();
     return res;
 }
 
-/* Other event handlers */
-int WifiCommand::valid_handler(struct nl_msg *msg, void *arg) {
-    // ALOGD("valid_handler called");
-     int *err = (int *)arg;
-    *err = 0;
-    return NL_SKIP;
-}
+void WifiCommand::overrun_visitor(cb_info *cbi, void *ctx) {
+    uint32_t overrun = *(uint32_t *)ctx;
 
-int WifiCommand::ack_handler(struct nl_msg *msg, void *arg) {
-    // ALOGD("ack_handler called");
-    int *err = (int *)arg;
-    *err = 0;
-    return NL_STOP;
-}
+    if (cbi->cb_func != &event_handler)
+        return;
 
-int WifiCommand::finish_handler(struct nl_msg *msg, void *arg) {
-    // ALOGD("finish_handler called");
-    int *ret = (int *)arg;
-    *ret = 0;
-    return NL_SKIP;
+    /* a command usually registers for several events; tell it once */
+    WifiCommand *cmd = (WifiCommand *)cbi->cb_arg;
+    if (cmd->mOverrunSeen == overrun)
+        return;
+    cmd->mOverrunSeen = overrun;
+    cmd->handleOverrun();
 }
 
-int WifiCommand::error_handler(struct sockaddr_nl *nla, struct nlmsgerr *err, void *arg) {
-    int *ret = (int *)arg;
-    *ret = err->error;
-
-    // ALOGD("error_handler received : %d", err->error);
-    return NL_SKIP;
+void WifiCommand::notifyEventOverrun(hal_info *info) {
+    /* one per notification, as the event ring drops events too */
+    static uint32_t generation;
+    uint32_t overrun = __atomic_add_fetch(&generation, 1, __ATOMIC_RELAXED);
+    wifi_for_each_event_handler(getWifiHandle(info), overrun_visitor, &overrun);
 }
 
-
 WifiVendorCommand::WifiVendorCommand(wifi_handle handle,
                                      wifi_request_id id,
                                      u32 vendor_id,
@@ -770,7 +919,7 @@ WifiVendorCommand::~WifiVendorCommand()
 // in the corresponding object
 int WifiVendorCommand::handleResponse(WifiEvent &reply)
 {
-    ALOGI("WifiVendorCommand::handleResponse");
+    HAL_LOGD(HAL_LOG_CORE, "WifiVendorCommand::handleResponse");
     struct nlattr **tb = reply.attributes();
     struct nlattr *attr = NULL;
     struct genlmsghdr *gnlh = reply.header();
@@ -779,7 +928,7 @@ int WifiVendorCommand::handleResponse(WifiEvent &reply)
         if (tb[NL80211_ATTR_VENDOR_DATA]) {
             mVendorData = (char *)nla_data(tb[NL80211_ATTR_VENDOR_DATA]);
             mDataLen = nla_len(tb[NL80211_ATTR_VENDOR_DATA]);
-            ALOGD("%s: Vendor data len received:%d", __func__, mDataLen);
+            HAL_LOGD(HAL_LOG_CORE, "%s: Vendor data len received:%d", __func__, mDataLen);
         }
     }
     return NL_SKIP;
@@ -789,7 +938,7 @@ int WifiVendorCommand::handleResponse(WifiEvent &reply)
 // save it in the object
 int WifiVendorCommand::handleEvent(WifiEvent &event)
 {
-    ALOGI("WifiVendorCommand::handleEvent");
+    HAL_LOGD(HAL_LOG_CORE, "WifiVendorCommand::handleEvent");
     struct nlattr **tb = event.attributes();
     struct nlattr *attr = NULL;
     struct genlmsghdr *gnlh = event.header();
@@ -803,14 +952,15 @@ int WifiVendorCommand::handleEvent(WifiEvent &event)
         mVendor_id = nla_get_u32(tb[NL80211_ATTR_VENDOR_ID]);
         mSubcmd = nla_get_u32(tb[NL80211_ATTR_VENDOR_SUBCMD]);
 
-        ALOGD("%s: Vendor event: vendor_id=0x%x subcmd=%u",
+        HAL_LOGD(HAL_LOG_CORE, "%s: Vendor event: vendor_id=0x%x subcmd=%u",
               __func__, mVendor_id, mSubcmd);
 
         if (tb[NL80211_ATTR_VENDOR_DATA]) {
             mVendorData = (char *)nla_data(tb[NL80211_ATTR_VENDOR_DATA]);
             mDataLen = nla_len(tb[NL80211_ATTR_VENDOR_DATA]);
-            ALOGD("%s: Vendor data len received:%d", __func__, mDataLen);
-            hexdump(mVendorData, mDataLen);
+            HAL_LOGD(HAL_LOG_CORE, "%s: Vendor data len received:%d",
+                    __func__, mDataLen);
+            HAL_LOG_DUMP(HAL_LOG_CORE, "vendor event", mVendorData, mDataLen);
         }
     }
     return NL_SKIP;
@@ -818,6 +968,13 @@ int WifiVendorCommand::handleEvent(WifiEvent &event)
 
 int WifiVendorCommand::create() {
     int ifindex;
+
+    resetCancelled();
+    if (mDataLen > 0) {
+        /* Vendor data built by the caller may exceed the default buffer */
+        mMsg.set_size_hint(WifiRequestSize().vendor_cmd()
+                .put_bytes(mDataLen).size());
+    }
     int ret = mMsg.create(NL80211_CMD_VENDOR, 0, 0);
     if (ret < 0) {
         return ret;
@@ -834,11 +991,14 @@ int WifiVendorCommand::create() {
 
     //Insert the vendor specific data
     ret = mMsg.put_bytes(NL80211_ATTR_VENDOR_DATA, mVendorData, mDataLen);
-    hexdump(mVendorData, mDataLen);
-
-    //insert the iface id to be "wlan0"
-    ifindex = if_nametoindex("wlan0");
-    ALOGE("%s ifindex obtained:%d",__func__,ifindex);
+    HAL_LOG_DUMP(HAL_LOG_CORE, "vendor command", mVendorData, mDataLen);
+
+    /* target the command's interface; "wlan0" if it has none yet */
+    if (mIfaceInfo != NULL)
+        ifindex = __atomic_load_n(&mIfaceInfo->id, __ATOMIC_RELAXED);
+    else
+        ifindex = iface_cache_get_ifindex(mInfo, "wlan0");
+    HAL_LOGD(HAL_LOG_CORE, "%s ifindex obtained:%d", __func__, ifindex);
     mMsg.set_iface_id(ifindex);
 out:
     return ret;
@@ -847,7 +1007,7 @@ out:
 
 int WifiVendorCommand::requestResponse()
 {
-    ALOGD("%s: request a response", __func__);
+    HAL_LOGD(HAL_LOG_CORE, "%s: request a response", __func__);
     return WifiCommand::requestResponse(mMsg);
 }
 
@@ -959,8 +1119,13 @@ void WifiVendorCommand::attr_end(struct nlattr *attribute)
 
 int WifiVendorCommand::set_iface_id(const char* name)
 {
-    unsigned ifindex = if_nametoindex(name);
-    ALOGE("%s ifindex obtained:%d",__func__,ifindex);
+    /* later create() calls of a reused command target it as well */
+    interface_info *ifinfo = iface_cache_find(mInfo, name);
+    if (ifinfo != NULL)
+        mIfaceInfo = ifinfo;
+
+    int ifindex = ifinfo ? __atomic_load_n(&ifinfo->id, __ATOMIC_RELAXED) : 0;
+    HAL_LOGD(HAL_LOG_CORE, "%s ifindex obtained:%d", __func__, ifindex);
     return mMsg.set_iface_id(ifindex);
 }
 
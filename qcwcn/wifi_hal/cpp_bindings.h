@@ -19,30 +19,46 @@
 #include "wifi_hal.h"
 #include "common.h"
 #include "sync.h"
+#include "nl_msg_pool.h"
+#include "cmd_slab.h"
 
 class WifiEvent
 {
     /* TODO: remove this when nl headers are updated */
     static const unsigned NL80211_ATTR_MAX_INTERNAL = 256;
+    /* number of individually looked up attributes remembered per event */
+    static const unsigned ATTR_CACHE_SIZE = 4;
 private:
     struct nl_msg *mMsg;
     struct genlmsghdr *mHeader;
-    struct nlattr *mAttributes[NL80211_ATTR_MAX_INTERNAL + 1];
+    /* full attribute index; only built if a handler asks for attributes() */
+    struct nlattr **mAttributes;
+    int mCachedType[ATTR_CACHE_SIZE];
+    struct nlattr *mCachedAttr[ATTR_CACHE_SIZE];
+    unsigned mNumCached;
+
+    nlattr *find_attribute(int attribute);
 
 public:
     WifiEvent(nl_msg *msg) {
         mMsg = msg;
         mHeader = NULL;
-        memset(mAttributes, 0, sizeof(mAttributes));
+        mAttributes = NULL;
+        mNumCached = 0;
     }
     ~WifiEvent() {
         /* don't destroy mMsg; it doesn't belong to us */
+        free(mAttributes);
     }
 
     void log();
 
     int parse();
 
+    nl_msg *msg() {
+        return mMsg;
+    }
+
     genlmsghdr *header() {
         return mHeader;
     }
@@ -69,36 +85,44 @@ public:
 
     const char *get_cmdString();
 
-    nlattr ** attributes() {
-        return mAttributes;
-    }
+    /* Indexes every top-level attribute on first use; prefer get_attribute()
+     * and friends when only a few attributes are needed. */
+    nlattr ** attributes();
 
     nlattr *get_attribute(int attribute) {
-        return mAttributes[attribute];
+        if (mAttributes != NULL)
+            return mAttributes[attribute];
+        return find_attribute(attribute);
     }
 
     uint8_t get_u8(int attribute) {
-        return mAttributes[attribute] ? nla_get_u8(mAttributes[attribute]) : 0;
+        nlattr *attr = get_attribute(attribute);
+        return attr ? nla_get_u8(attr) : 0;
     }
 
     uint16_t get_u16(int attribute) {
-        return mAttributes[attribute] ? nla_get_u16(mAttributes[attribute]) : 0;
+        nlattr *attr = get_attribute(attribute);
+        return attr ? nla_get_u16(attr) : 0;
     }
 
     uint32_t get_u32(int attribute) {
-        return mAttributes[attribute] ? nla_get_u32(mAttributes[attribute]) : 0;
+        nlattr *attr = get_attribute(attribute);
+        return attr ? nla_get_u32(attr) : 0;
     }
 
     uint64_t get_u64(int attribute) {
-        return mAttributes[attribute] ? nla_get_u64(mAttributes[attribute]) : 0;
+        nlattr *attr = get_attribute(attribute);
+        return attr ? nla_get_u64(attr) : 0;
     }
 
     int get_len(int attribute) {
-        return mAttributes[attribute] ? nla_len(mAttributes[attribute]) : 0;
+        nlattr *attr = get_attribute(attribute);
+        return attr ? nla_len(attr) : 0;
     }
 
     void *get_data(int attribute) {
-        return mAttributes[attribute] ? nla_data(mAttributes[attribute]) : NULL;
+        nlattr *attr = get_attribute(attribute);
+        return attr ? nla_data(attr) : NULL;
     }
 
 private:
@@ -147,24 +171,81 @@ private:
     nl_iterator(const nl_iterator&);    // hide copy constructor to prevent copies
 };
 
+/* Computes the encoded length of a request before it is built, so that
+ * WifiRequest can check out a buffer large enough for all of it. Mirror
+ * every put_*() and attr_start() of the request being sized. */
+class WifiRequestSize
+{
+private:
+    size_t mLen;
+
+public:
+    WifiRequestSize() : mLen(nlmsg_total_size(GENL_HDRLEN)) {
+    }
+
+    /* NL80211_CMD_VENDOR header: vendor id, subcmd and ifindex */
+    WifiRequestSize& vendor_cmd() {
+        return put_u32().put_u32().put_u32();
+    }
+
+    WifiRequestSize& put_bytes(int len) {
+        mLen += nla_total_size(len);
+        return *this;
+    }
+    WifiRequestSize& put_u8() {
+        return put_bytes(sizeof(uint8_t));
+    }
+    WifiRequestSize& put_u16() {
+        return put_bytes(sizeof(uint16_t));
+    }
+    WifiRequestSize& put_u32() {
+        return put_bytes(sizeof(uint32_t));
+    }
+    WifiRequestSize& put_u64() {
+        return put_bytes(sizeof(uint64_t));
+    }
+    WifiRequestSize& put_string(const char *value) {
+        return put_bytes(strlen(value) + 1);
+    }
+    WifiRequestSize& put_addr() {
+        return put_bytes(sizeof(mac_addr));
+    }
+    WifiRequestSize& attr_start() {
+        return put_bytes(0);
+    }
+
+    size_t size() {
+        return mLen;
+    }
+};
+
 class WifiRequest
 {
 private:
+    hal_info *mInfo;
     int mFamily;
     int mIface;
+    size_t mSizeHint;
     struct nl_msg *mMsg;
+    uint64_t mCreated;                      /* hal_perf_now_us() at create() */
 
 public:
-    WifiRequest(int family) {
+    WifiRequest(hal_info *info, int family) {
+        mInfo = info;
         mMsg = NULL;
         mFamily = family;
         mIface = -1;
+        mSizeHint = 0;
+        mCreated = 0;
     }
 
-    WifiRequest(int family, int iface) {
+    WifiRequest(hal_info *info, int family, int iface) {
+        mInfo = info;
         mMsg = NULL;
         mFamily = family;
         mIface = iface;
+        mSizeHint = 0;
+        mCreated = 0;
     }
 
     ~WifiRequest() {
@@ -173,15 +254,25 @@ public:
 
     void destroy() {
         if (mMsg) {
-            nlmsg_free(mMsg);
+            nl_msg_pool_put(mInfo, mMsg);
             mMsg = NULL;
         }
     }
 
+    /* Room the next create() should reserve, from WifiRequestSize; the
+     * default buffer is used when this is 0 or too small. */
+    void set_size_hint(size_t size) {
+        mSizeHint = size;
+    }
+
     nl_msg *getMessage() {
         return mMsg;
     }
 
+    uint64_t created() {
+        return mCreated;
+    }
+
     /* Command assembly helpers */
     int create(int family, uint8_t cmd, int flags, int hdrlen);
     int create(uint8_t cmd, int flags, int hdrlen) {
@@ -281,17 +372,146 @@ private:
 
 };
 
+/* Non-virtual attribute writer for a request built with create(). Each
+ * put is typed at compile time and appended straight into the buffer that
+ * create() checked out (size it with WifiRequestSize), so a large nested
+ * spec costs no virtual calls and no calls into libnl. The first attribute
+ * that does not fit latches failed(); check it once after the last put. */
+class WifiAttrBuilder
+{
+private:
+    struct nl_msg *mMsg;
+    bool mFailed;
+
+    struct nlattr *reserve(int attribute, int len) {
+        struct nlmsghdr *nlh;
+        struct nlattr *nla;
+        size_t tail, total;
+
+        if (mFailed)
+            return NULL;
+        nlh = mMsg->nm_nlh;
+        tail = NLMSG_ALIGN(nlh->nlmsg_len);
+        total = tail + NLA_ALIGN(NLA_HDRLEN + len);
+        if (total > mMsg->nm_size) {
+            mFailed = true;
+            return NULL;
+        }
+        nla = (struct nlattr *)((char *)nlh + tail);
+        nla->nla_type = attribute;
+        nla->nla_len = NLA_HDRLEN + len;
+        if (NLA_ALIGN(len) != len)
+            memset((char *)nla + NLA_HDRLEN + len, 0, NLA_ALIGN(len) - len);
+        nlh->nlmsg_len = total;
+        return nla;
+    }
+
+public:
+    explicit WifiAttrBuilder(struct nl_msg *msg)
+        : mMsg(msg), mFailed(msg == NULL) {
+    }
+
+    template <typename T>
+    WifiAttrBuilder& put(int attribute, T value) {
+        struct nlattr *nla = reserve(attribute, sizeof(T));
+        if (nla)
+            memcpy((char *)nla + NLA_HDRLEN, &value, sizeof(T));
+        return *this;
+    }
+
+    WifiAttrBuilder& put_u8(int attribute, u8 value) {
+        return put<u8>(attribute, value);
+    }
+    WifiAttrBuilder& put_u16(int attribute, u16 value) {
+        return put<u16>(attribute, value);
+    }
+    WifiAttrBuilder& put_u32(int attribute, u32 value) {
+        return put<u32>(attribute, value);
+    }
+    WifiAttrBuilder& put_u64(int attribute, u64 value) {
+        return put<u64>(attribute, value);
+    }
+    WifiAttrBuilder& put_s8(int attribute, s8 value) {
+        return put<s8>(attribute, value);
+    }
+    WifiAttrBuilder& put_s16(int attribute, s16 value) {
+        return put<s16>(attribute, value);
+    }
+    WifiAttrBuilder& put_s32(int attribute, s32 value) {
+        return put<s32>(attribute, value);
+    }
+    WifiAttrBuilder& put_s64(int attribute, s64 value) {
+        return put<s64>(attribute, value);
+    }
+
+    WifiAttrBuilder& put_bytes(int attribute, const void *data, int len) {
+        struct nlattr *nla = reserve(attribute, len);
+        if (nla && len)
+            memcpy((char *)nla + NLA_HDRLEN, data, len);
+        return *this;
+    }
+    WifiAttrBuilder& put_addr(int attribute, const mac_addr value) {
+        return put_bytes(attribute, value, sizeof(mac_addr));
+    }
+    WifiAttrBuilder& put_string(int attribute, const char *value) {
+        return put_bytes(attribute, value, strlen(value) + 1);
+    }
+
+    /* NULL once failed(); attr_end() ignores it */
+    struct nlattr *attr_start(int attribute) {
+        return reserve(attribute, 0);
+    }
+    void attr_end(struct nlattr *nest) {
+        size_t len;
+
+        if (!nest || mFailed)
+            return;
+        len = (char *)mMsg->nm_nlh + NLMSG_ALIGN(mMsg->nm_nlh->nlmsg_len)
+            - (char *)nest;
+        if (len > 0xffff) {
+            mFailed = true;
+            return;
+        }
+        nest->nla_len = len;
+    }
+
+    bool failed() {
+        return mFailed;
+    }
+};
+
+class WifiCommand;
+
+/* Completion callback for asynchronous requests; runs on the HAL
+ * completion thread. result is 0, a negative errno from the driver, or
+ * -ECANCELED. The command may be deleted from within the callback. */
+typedef void (*wifi_command_callback)(WifiCommand *cmd, int result, void *ctx);
+
 class WifiCommand
 {
 protected:
     hal_info *mInfo;
     WifiRequest mMsg;
-    Condition mCondition;
+    Completion mCompletion;
     wifi_request_id mId;
     interface_info *mIfaceInfo;
+    uint32_t mPendingSeq;                   /* request in flight on cmd_sock */
+    bool mCancelled;                        /* set by cancel(); __atomic */
+    wifi_command_callback mCallback;
+    void *mCallbackCtx;
+    uint32_t mOverrunSeen;                  /* last overrun handleOverrun() saw */
+    int mPriority;                          /* wifi_cmd_priority of requests */
+    int mPerfKey;                           /* vendor subcmd of the last request */
+    uint64_t mPerfSent;                     /* when the async request was sent */
+    uint64_t mPerfEventMark;                /* see transact() */
+    Completion mAckCompletion;              /* see sendRequest() */
+    int mAckResult;
 public:
     WifiCommand(wifi_handle handle, wifi_request_id id)
-            : mMsg(getHalInfo(handle)->nl80211_family_id), mId(id)
+            : mMsg(getHalInfo(handle), getHalInfo(handle)->nl80211_family_id), mId(id),
+            mPendingSeq(0), mCancelled(false), mCallback(NULL),
+            mCallbackCtx(NULL), mOverrunSeen(0), mPriority(CMD_PRIO_INTERACTIVE),
+            mPerfKey(-1), mPerfSent(0), mPerfEventMark(0), mAckResult(0)
     {
         mIfaceInfo = NULL;
         mInfo = getHalInfo(handle);
@@ -299,7 +519,11 @@ public:
     }
 
     WifiCommand(wifi_interface_handle iface, wifi_request_id id)
-            : mMsg(getHalInfo(iface)->nl80211_family_id, getIfaceInfo(iface)->id), mId(id)
+            : mMsg(getHalInfo(iface), getHalInfo(iface)->nl80211_family_id,
+                    getIfaceInfo(iface)->id), mId(id),
+            mPendingSeq(0), mCancelled(false), mCallback(NULL),
+            mCallbackCtx(NULL), mOverrunSeen(0), mPriority(CMD_PRIO_INTERACTIVE),
+            mPerfKey(-1), mPerfSent(0), mPerfEventMark(0), mAckResult(0)
     {
         mIfaceInfo = getIfaceInfo(iface);
         mInfo = getHalInfo(iface);
@@ -310,25 +534,57 @@ public:
         // ALOGD("WifiCommand %p destroyed", this);
     }
 
+    /* Commands live for one HAL call; recycle their memory. The sized
+     * delete gets the size of the most derived class. */
+    static void *operator new(size_t size) throw() {
+        return cmd_slab_alloc(size);
+    }
+    static void operator delete(void *ptr, size_t size) {
+        cmd_slab_free(ptr, size);
+    }
+
     wifi_request_id id() {
         return mId;
     }
 
+    /* Sizes the buffer of the next create(); see WifiRequestSize */
+    void set_size_hint(size_t size) {
+        mMsg.set_size_hint(size);
+    }
+
+    /* Scheduling class of the requests this command sends */
+    void set_priority(wifi_cmd_priority prio) {
+        mPriority = prio;
+    }
+
     virtual int create() {
         /* by default there is no way to cancel */
         ALOGD("WifiCommand %p can't be created", this);
         return WIFI_ERROR_NOT_SUPPORTED;
     }
 
-    virtual int cancel() {
-        /* by default there is no way to cancel */
-        return WIFI_ERROR_NOT_SUPPORTED;
-    }
+    /* Abandons the request in flight, if any, and wakes a thread blocked
+     * waiting for its event. Safe to call from any thread. */
+    virtual int cancel();
+
+    /* Deletes the command once none of its event handlers can still be
+     * running. Use instead of delete for commands that registered event
+     * handlers; it never waits, so handlers may call it too. */
+    virtual void release();
 
     int requestResponse();
     int requestEvent(int cmd);
     int requestVendorEvent(uint32_t id, int subcmd);
-    int requestResponse(WifiRequest& request);
+    /* awaitEvent: the driver answers with an event after the ACK, which
+     * the command's own handler gets; only used for timing it */
+    int requestResponse(WifiRequest& request, bool awaitEvent = false);
+
+    /* Same as requestResponse(), but returns as soon as the request is
+     * sent. Replies reach handleResponse() on the thread reading cmd_sock
+     * and cb is invoked once the driver has acknowledged the request. */
+    int requestResponseAsync(wifi_command_callback cb, void *ctx);
+    int requestResponseAsync(WifiRequest& request,
+            wifi_command_callback cb, void *ctx);
 
 protected:
     wifi_handle wifiHandle() {
@@ -347,6 +603,33 @@ protected:
         return mIfaceInfo->id;
     }
 
+    /* Sends request and waits for the driver to acknowledge it, recording
+     * build and round trip times for wifi_get_hal_perf_stats(). With
+     * awaitEvent the time from the ACK to the next event this command
+     * handles is recorded as well. */
+    int transact(WifiRequest& request, nl_recvmsg_msg_cb_t valid_cb,
+            void *valid_arg, bool awaitEvent);
+
+    /* Blocking requests of commands that wait for the driver: the request
+     * goes out through the asynchronous transport and the event loop reads
+     * the ACK and replies while the caller sleeps in awaitResponse(),
+     * instead of taking over cmd_sock itself. With awaitEvent a request
+     * that fails also wakes the thread waiting on mCompletion for its
+     * event. Unless sendRequest() fails, awaitResponse() must be called
+     * before the command is deleted. */
+    int sendRequest(WifiRequest& request, bool awaitEvent = false);
+    int awaitResponse();
+
+    bool cancelled() {
+        return __atomic_load_n(&mCancelled, __ATOMIC_ACQUIRE);
+    }
+
+    /* Forgets a cancel() of an earlier request. Called by create(), so a
+     * cancel() between building and sending a request is not lost. */
+    void resetCancelled() {
+        __atomic_store_n(&mCancelled, false, __ATOMIC_RELEASE);
+    }
+
     /* Override this method to parse reply and dig out data; save it in the object */
     virtual int handleResponse(WifiEvent& reply) {
         ALOGI("skipping a response");
@@ -359,12 +642,18 @@ protected:
         return NL_SKIP;
     }
 
+    /* Override this method to recover from events the kernel dropped
+     * because event_sock overflowed, e.g. by asking for a fresh copy of
+     * whatever state the events carry. */
+    virtual void handleOverrun() {
+    }
+
     int registerHandler(int cmd) {
         return wifi_register_handler(wifiHandle(), cmd, &event_handler, this);
     }
 
     void unregisterHandler(int cmd) {
-        wifi_unregister_handler(wifiHandle(), cmd);
+        wifi_unregister_handler(wifiHandle(), cmd, this);
     }
 
     int registerVendorHandler(uint32_t id, int subcmd) {
@@ -372,7 +661,7 @@ protected:
     }
 
     void unregisterVendorHandler(uint32_t id, int subcmd) {
-        wifi_unregister_vendor_handler(wifiHandle(), id, subcmd);
+        wifi_unregister_vendor_handler(wifiHandle(), id, subcmd, this);
     }
 
 private:
@@ -383,14 +672,23 @@ private:
 
     static int event_handler(struct nl_msg *msg, void *arg);
 
-    /* Other event handlers */
-    static int valid_handler(struct nl_msg *msg, void *arg);
+    static void async_done_handler(void *arg, int result);
 
-    static int ack_handler(struct nl_msg *msg, void *arg);
+    static void ack_wait_handler(WifiCommand *cmd, int result, void *ctx);
 
-    static int finish_handler(struct nl_msg *msg, void *arg);
+    static void release_handler(void *arg);
 
-    static int error_handler(struct sockaddr_nl *nla, struct nlmsgerr *err, void *arg);
+    /* Hands the ACK time of a request that awaits an event to
+     * event_handler(); see transact() */
+    void ackBeforeEvent(int err, uint64_t acked);
+
+    static void overrun_visitor(cb_info *cbi, void *ctx);
+
+public:
+    /* Tells every command with a registered event handler that events were
+     * dropped; called on the callback thread after an event_sock overrun
+     * or after the event ring dropped events. */
+    static void notifyEventOverrun(hal_info *info);
 };
 
 //WifiVendorCommand class
@@ -452,6 +750,11 @@ public:
 
     virtual int put_bytes(int attribute, const char *data, int len);
 
+    /* Typed writer for the message create() built; see WifiAttrBuilder */
+    WifiAttrBuilder builder() {
+        return WifiAttrBuilder(mMsg.getMessage());
+    }
+
 protected:
 
     /* Override this method to parse reply and dig out data; save it in the corresponding
@@ -0,0 +1,278 @@
+/*
+ * Copyright (C) 2014 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <errno.h>
+#include <stddef.h>
+#include <stdlib.h>
+#include <string.h>
+#include <arpa/inet.h>
+
+#include "common.h"
+#include "event_filter.h"
+
+/* Above this many distinct commands or vendor subcommands the filter gives
+ * up on matching them one by one and lets the whole class through; this
+ * also keeps every jump within the 8 bit offsets of classic BPF. */
+#define EVENT_FILTER_MAX_KEYS   (64)
+#define EVENT_FILTER_MAX_INSNS  (2 * EVENT_FILTER_MAX_KEYS + 16)
+
+/* Offset of the genlmsghdr and of the first attribute in a message */
+#define GENL_CMD_OFFSET         (NLMSG_HDRLEN)
+#define GENL_ATTR_OFFSET        (NLMSG_HDRLEN + GENL_HDRLEN)
+
+static const char *const group_names[HAL_MCGRP_MAX] = {
+    "config",
+    "scan",
+    "regulatory",
+    "mlme",
+    "vendor",
+};
+
+const char *event_filter_group_name(int group)
+{
+    return group >= 0 && group < HAL_MCGRP_MAX ? group_names[group] : NULL;
+}
+
+/* Group on which the kernel multicasts the given nl80211 command */
+static int event_filter_group(int cmd)
+{
+    switch (cmd) {
+    case NL80211_CMD_VENDOR:
+        return HAL_MCGRP_VENDOR;
+    case NL80211_CMD_TRIGGER_SCAN:
+    case NL80211_CMD_NEW_SCAN_RESULTS:
+    case NL80211_CMD_SCAN_ABORTED:
+    case NL80211_CMD_START_SCHED_SCAN:
+    case NL80211_CMD_SCHED_SCAN_RESULTS:
+    case NL80211_CMD_SCHED_SCAN_STOPPED:
+        return HAL_MCGRP_SCAN;
+    case NL80211_CMD_REG_CHANGE:
+    case NL80211_CMD_REG_BEACON_HINT:
+    case NL80211_CMD_WIPHY_REG_CHANGE:
+        return HAL_MCGRP_REGULATORY;
+    case NL80211_CMD_NEW_WIPHY:
+    case NL80211_CMD_DEL_WIPHY:
+    case NL80211_CMD_NEW_INTERFACE:
+    case NL80211_CMD_DEL_INTERFACE:
+        return HAL_MCGRP_CONFIG;
+    default:
+        return HAL_MCGRP_MLME;
+    }
+}
+
+typedef struct {
+    uint32_t groups;                                // bit per HAL_MCGRP_*
+    bool cmd_seen[256];                             // genl cmd is a u8
+    int num_cmds;
+    uint8_t cmds[EVENT_FILTER_MAX_KEYS];
+    bool any_vendor;                                // vendor handlers exist
+    int num_subcmds;                                // -1 once there are too many
+    uint32_t subcmds[EVENT_FILTER_MAX_KEYS];
+} event_filter_keys;
+
+static void event_filter_add_key(event_filter_keys *keys, const cb_info *cbi)
+{
+    keys->groups |= 1U << event_filter_group(cbi->nl_cmd);
+
+    if (cbi->nl_cmd == NL80211_CMD_VENDOR) {
+        keys->any_vendor = true;
+        if (keys->num_subcmds < 0)
+            return;
+        for (int i = 0; i < keys->num_subcmds; i++) {
+            if (keys->subcmds[i] == (uint32_t)cbi->vendor_subcmd)
+                return;
+        }
+        if (keys->num_subcmds == EVENT_FILTER_MAX_KEYS) {
+            keys->num_subcmds = -1;
+            return;
+        }
+        keys->subcmds[keys->num_subcmds++] = cbi->vendor_subcmd;
+        return;
+    }
+
+    uint8_t cmd = (uint8_t)cbi->nl_cmd;
+    if (keys->cmd_seen[cmd])
+        return;
+    keys->cmd_seen[cmd] = true;
+    if (keys->num_cmds < EVENT_FILTER_MAX_KEYS)
+        keys->cmds[keys->num_cmds] = cmd;
+    keys->num_cmds++;
+}
+
+enum { LBL_NEXT, LBL_ACCEPT, LBL_DROP };
+
+typedef struct {
+    struct sock_filter insn[EVENT_FILTER_MAX_INSNS];
+    uint8_t jt[EVENT_FILTER_MAX_INSNS];             // LBL_* of each jump
+    uint8_t jf[EVENT_FILTER_MAX_INSNS];
+    int len;
+} event_filter_prog;
+
+static void emit(event_filter_prog *p, uint16_t code, uint32_t k,
+        uint8_t jt, uint8_t jf)
+{
+    struct sock_filter insn = BPF_STMT(code, k);
+    p->insn[p->len] = insn;
+    p->jt[p->len] = jt;
+    p->jf[p->len] = jf;
+    p->len++;
+}
+
+/* Appends the two return statements and turns labels into offsets */
+static void resolve(event_filter_prog *p)
+{
+    int drop = p->len;
+    int accept = p->len + 1;
+
+    emit(p, BPF_RET | BPF_K, 0, LBL_NEXT, LBL_NEXT);
+    emit(p, BPF_RET | BPF_K, 0xffffffff, LBL_NEXT, LBL_NEXT);
+
+    for (int i = 0; i < p->len; i++) {
+        int jt = p->jt[i] == LBL_ACCEPT ? accept : p->jt[i] == LBL_DROP ? drop : i + 1;
+        int jf = p->jf[i] == LBL_ACCEPT ? accept : p->jf[i] == LBL_DROP ? drop : i + 1;
+        if (p->insn[i].code == (BPF_JMP | BPF_JA)) {
+            /* unconditional jumps take their offset from k */
+            p->insn[i].k = jt - i - 1;
+            continue;
+        }
+        p->insn[i].jt = jt - i - 1;
+        p->insn[i].jf = jf - i - 1;
+    }
+}
+
+/* BPF loads are big endian while netlink fields are in host order, hence
+ * the htons()/htonl() on every constant compared against a loaded field. */
+static void event_filter_build(hal_info *info, const event_filter_keys *keys,
+        event_filter_prog *p)
+{
+    p->len = 0;
+
+    /* Anything that is not from nl80211 is none of our business */
+    emit(p, BPF_LD | BPF_H | BPF_ABS, offsetof(struct nlmsghdr, nlmsg_type),
+            LBL_NEXT, LBL_NEXT);
+    emit(p, BPF_JMP | BPF_JEQ | BPF_K, htons(info->nl80211_family_id),
+            LBL_NEXT, LBL_ACCEPT);
+
+    emit(p, BPF_LD | BPF_B | BPF_ABS, GENL_CMD_OFFSET, LBL_NEXT, LBL_NEXT);
+    if (keys->num_cmds > EVENT_FILTER_MAX_KEYS) {
+        emit(p, BPF_JMP | BPF_JEQ | BPF_K, NL80211_CMD_VENDOR,
+                LBL_NEXT, LBL_ACCEPT);
+    } else {
+        for (int i = 0; i < keys->num_cmds; i++)
+            emit(p, BPF_JMP | BPF_JEQ | BPF_K, keys->cmds[i],
+                    LBL_ACCEPT, LBL_NEXT);
+        emit(p, BPF_JMP | BPF_JEQ | BPF_K, NL80211_CMD_VENDOR,
+                LBL_NEXT, LBL_DROP);
+    }
+
+    if (!keys->any_vendor) {
+        emit(p, BPF_JMP | BPF_JA, 0, LBL_DROP, LBL_DROP);
+    } else if (keys->num_subcmds >= 0) {
+        /* A = offset of the attribute of type X, searched from A on;
+         * let malformed events through for the handler to complain. */
+        emit(p, BPF_LDX | BPF_W | BPF_IMM, NL80211_ATTR_VENDOR_SUBCMD,
+                LBL_NEXT, LBL_NEXT);
+        emit(p, BPF_LD | BPF_W | BPF_IMM, GENL_ATTR_OFFSET, LBL_NEXT, LBL_NEXT);
+        emit(p, BPF_LD | BPF_W | BPF_ABS, SKF_AD_OFF + SKF_AD_NLATTR,
+                LBL_NEXT, LBL_NEXT);
+        emit(p, BPF_JMP | BPF_JEQ | BPF_K, 0, LBL_ACCEPT, LBL_NEXT);
+        emit(p, BPF_MISC | BPF_TAX, 0, LBL_NEXT, LBL_NEXT);
+        emit(p, BPF_LD | BPF_W | BPF_IND, NLA_HDRLEN, LBL_NEXT, LBL_NEXT);
+        for (int i = 0; i < keys->num_subcmds; i++)
+            emit(p, BPF_JMP | BPF_JEQ | BPF_K, htonl(keys->subcmds[i]),
+                    LBL_ACCEPT, LBL_NEXT);
+        emit(p, BPF_JMP | BPF_JA, 0, LBL_DROP, LBL_DROP);
+    } else {
+        emit(p, BPF_JMP | BPF_JA, 0, LBL_ACCEPT, LBL_ACCEPT);
+    }
+
+    resolve(p);
+}
+
+static void event_filter_membership(hal_info *info, uint32_t groups)
+{
+    /* A transport feeds event_sock itself; its group ids mean nothing to
+     * the kernel */
+    if (info->transport != NULL)
+        return;
+
+    for (int g = 0; g < HAL_MCGRP_MAX; g++) {
+        uint32_t bit = 1U << g;
+        bool want = (groups & bit) != 0;
+        bool joined = (info->mcast_joined & bit) != 0;
+        int ret;
+
+        if (want == joined || info->mcast_id[g] < 0)
+            continue;
+
+        if (want)
+            ret = nl_socket_add_membership(info->event_sock, info->mcast_id[g]);
+        else
+            ret = nl_socket_drop_membership(info->event_sock, info->mcast_id[g]);
+
+        if (ret < 0) {
+            ALOGE("Could not %s multicast group %s: %d",
+                    want ? "join" : "leave", group_names[g], ret);
+            continue;
+        }
+
+        info->mcast_joined ^= bit;
+        HAL_LOGD(HAL_LOG_CORE, "%s multicast group %s",
+                want ? "Joined" : "Left", group_names[g]);
+    }
+}
+
+void event_filter_update(hal_info *info)
+{
+    if (info->event_sock == NULL || info->nl80211_family_id <= 0)
+        return;
+
+    event_filter_keys *keys = (event_filter_keys *)malloc(sizeof(*keys));
+    event_filter_prog *prog = (event_filter_prog *)malloc(sizeof(*prog));
+    if (keys == NULL || prog == NULL) {
+        ALOGE("Failed to allocate event filter, leaving it as it is");
+        free(keys);
+        free(prog);
+        return;
+    }
+
+    memset(keys, 0, sizeof(*keys));
+    for (int i = 0; i < EVENT_CB_HASH_SIZE; i++) {
+        for (const cb_info *cbi = info->event_cb->bucket[i]; cbi;
+                cbi = cbi->next)
+            event_filter_add_key(keys, cbi);
+    }
+
+    /* Filter before joining so that nothing unwanted is let in meanwhile */
+    event_filter_build(info, keys, prog);
+
+    struct sock_fprog fprog;
+    fprog.len = prog->len;
+    fprog.filter = prog->insn;
+    if (setsockopt(nl_socket_get_fd(info->event_sock), SOL_SOCKET,
+                SO_ATTACH_FILTER, &fprog, sizeof(fprog)) < 0) {
+        ALOGE("Could not attach event filter: %s", strerror(errno));
+    } else {
+        HAL_LOGV(HAL_LOG_CORE, "Attached event filter of %d insns, %d cmds,"
+                " %d vendor subcmds", prog->len, keys->num_cmds,
+                keys->num_subcmds);
+    }
+
+    event_filter_membership(info, keys->groups);
+
+    free(keys);
+    free(prog);
+}
@@ -0,0 +1,41 @@
+/*
+ * Copyright (C) 2014 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef __WIFI_HAL_EVENT_FILTER_H__
+#define __WIFI_HAL_EVENT_FILTER_H__
+
+#include "common.h"
+
+/*
+ * Keeps event_sock subscribed to exactly what the registered handlers want.
+ *
+ * Each nl80211 multicast group is joined while at least one handler is
+ * registered for a command carried by that group, and left again when the
+ * last one goes away. On top of that a classic BPF program is attached to
+ * event_sock that accepts only the registered commands and, for
+ * NL80211_CMD_VENDOR, only the registered vendor subcommands, so that
+ * events nobody listens to are dropped in the kernel instead of waking
+ * the event thread.
+ */
+
+/* Name of the nl80211 multicast group, as reported by the nlctrl family */
+const char *event_filter_group_name(int group);
+
+/* Joins and leaves groups and reattaches the socket filter to match the
+ * current handler snapshot. Must be called with cb_lock held. */
+void event_filter_update(hal_info *info);
+
+#endif /* __WIFI_HAL_EVENT_FILTER_H__ */
@@ -0,0 +1,392 @@
+/*
+ * Copyright (C) 2014 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <sys/timerfd.h>
+
+#include "wifi_hal.h"
+#include "common.h"
+#include "event_loop.h"
+
+#define MAX_EVENT_FDS           (8)
+#define TIMER_TICK_MS           (10)
+#define TIMER_WHEEL_SLOTS       (256)   /* one turn of the wheel is 2.56s */
+
+typedef struct {
+    int fd;                                         // -1 if the slot is free
+    uint32_t gen;                                   // bumped on every reuse
+    event_loop_fd_handler handler;
+    void *arg;
+} event_fd_reg;
+
+struct event_loop {
+    int epoll_fd;
+    int wake_fd;                                    // eventfd
+    int timer_fd;                                   // timerfd for the wheel
+    pthread_mutex_t lock;                           // guards everything below
+    event_fd_reg fds[MAX_EVENT_FDS];
+    hal_timer *wheel[TIMER_WHEEL_SLOTS];
+    unsigned num_timers;
+    uint64_t last_tick;                             // last tick run
+    uint64_t armed_tick;                            // timer_fd deadline, 0 if none
+};
+
+static uint64_t now_ms()
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000 + ts.tv_nsec / 1000000;
+}
+
+/* Must be called with the loop lock held */
+static void wheel_insert(struct event_loop *loop, hal_timer *timer)
+{
+    hal_timer **slot = &loop->wheel[timer->expires % TIMER_WHEEL_SLOTS];
+    timer->next = *slot;
+    *slot = timer;
+    timer->armed = true;
+    loop->num_timers++;
+}
+
+/* Must be called with the loop lock held */
+static bool wheel_remove(struct event_loop *loop, hal_timer *timer)
+{
+    if (!timer->armed)
+        return false;
+
+    hal_timer **pp = &loop->wheel[timer->expires % TIMER_WHEEL_SLOTS];
+    while (*pp != timer)
+        pp = &(*pp)->next;
+    *pp = timer->next;
+    timer->next = NULL;
+    timer->armed = false;
+    loop->num_timers--;
+    return true;
+}
+
+/* Returns the earliest tick any timer expires at, 0 if there are none.
+ * Must be called with the loop lock held. */
+static uint64_t wheel_next_expiry(struct event_loop *loop)
+{
+    uint64_t earliest = 0;
+
+    if (loop->num_timers == 0)
+        return 0;
+
+    /* Slots are visited in expiry order for the current turn of the wheel;
+     * the first timer due within this turn is the earliest one. */
+    for (unsigned i = 1; i <= TIMER_WHEEL_SLOTS; i++) {
+        uint64_t tick = loop->last_tick + i;
+        for (hal_timer *t = loop->wheel[tick % TIMER_WHEEL_SLOTS]; t; t = t->next) {
+            if (t->expires <= tick)
+                return t->expires;
+            if (earliest == 0 || t->expires < earliest)
+                earliest = t->expires;
+        }
+    }
+    return earliest;
+}
+
+/* Points timer_fd at the earliest timer. Must be called with the loop
+ * lock held. */
+static void rearm_timer_fd(struct event_loop *loop)
+{
+    uint64_t tick = wheel_next_expiry(loop);
+    if (tick == loop->armed_tick)
+        return;
+
+    struct itimerspec its;
+    memset(&its, 0, sizeof(its));
+    if (tick != 0) {
+        uint64_t ms = tick * TIMER_TICK_MS;
+        its.it_value.tv_sec = ms / 1000;
+        its.it_value.tv_nsec = (ms % 1000) * 1000000;
+    }
+    if (timerfd_settime(loop->timer_fd, TFD_TIMER_ABSTIME, &its, NULL) < 0) {
+        ALOGE("%s: timerfd_settime failed: %d", __func__, -errno);
+        return;
+    }
+    loop->armed_tick = tick;
+}
+
+/* Runs every timer that is due */
+static void run_timers(hal_info *info)
+{
+    struct event_loop *loop = info->loop;
+    uint64_t now = now_ms() / TIMER_TICK_MS;
+
+    pthread_mutex_lock(&loop->lock);
+    /* a tick may have passed unseen if the loop was busy; never scan a
+     * slot more than once per call */
+    uint64_t first = loop->last_tick + 1;
+    if (now >= first + TIMER_WHEEL_SLOTS)
+        first = now - TIMER_WHEEL_SLOTS + 1;
+    /* timers started by the handlers below expire after now, so one that
+     * keeps re-arming itself with no delay runs once per call */
+    loop->last_tick = now;
+
+    for (uint64_t tick = first; tick <= now; tick++) {
+        hal_timer **slot = &loop->wheel[tick % TIMER_WHEEL_SLOTS];
+        hal_timer *t = *slot;
+        while (t != NULL) {
+            if (t->expires > now) {
+                t = t->next;
+                continue;
+            }
+
+            hal_timer_handler handler = t->handler;
+            void *arg = t->arg;
+            wheel_remove(loop, t);
+            if (t->period != 0) {
+                t->expires = now + (t->period + TIMER_TICK_MS - 1) / TIMER_TICK_MS;
+                wheel_insert(loop, t);
+            }
+
+            pthread_mutex_unlock(&loop->lock);
+            (*handler)(info, arg);
+            pthread_mutex_lock(&loop->lock);
+
+            /* the handler may have changed the slot; start over */
+            t = *slot;
+        }
+    }
+    loop->armed_tick = 0;   /* timer_fd has fired and is disarmed */
+    rearm_timer_fd(loop);
+    pthread_mutex_unlock(&loop->lock);
+}
+
+static void timer_fd_handler(hal_info *info, int fd, uint32_t events, void *arg)
+{
+    uint64_t expirations;
+    if (read(fd, &expirations, sizeof(expirations)) < 0 && errno != EAGAIN)
+        ALOGE("%s: read failed: %d", __func__, -errno);
+    run_timers(info);
+}
+
+static void wake_fd_handler(hal_info *info, int fd, uint32_t events, void *arg)
+{
+    uint64_t count;
+    if (read(fd, &count, sizeof(count)) < 0 && errno != EAGAIN)
+        ALOGE("%s: read failed: %d", __func__, -errno);
+}
+
+wifi_error event_loop_init(hal_info *info)
+{
+    struct event_loop *loop = (struct event_loop *)malloc(sizeof(*loop));
+    if (loop == NULL)
+        return WIFI_ERROR_OUT_OF_MEMORY;
+
+    memset(loop, 0, sizeof(*loop));
+    for (int i = 0; i < MAX_EVENT_FDS; i++)
+        loop->fds[i].fd = -1;
+    loop->last_tick = now_ms() / TIMER_TICK_MS;
+    pthread_mutex_init(&loop->lock, NULL);
+    loop->epoll_fd = epoll_create1(EPOLL_CLOEXEC);
+    loop->wake_fd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    loop->timer_fd = timerfd_create(CLOCK_MONOTONIC, TFD_NONBLOCK | TFD_CLOEXEC);
+    info->loop = loop;
+
+    if (loop->epoll_fd < 0 || loop->wake_fd < 0 || loop->timer_fd < 0) {
+        ALOGE("%s: failed to create event loop descriptors", __func__);
+        event_loop_cleanup(info);
+        return WIFI_ERROR_UNKNOWN;
+    }
+
+    if (event_loop_add_fd(info, loop->wake_fd, EPOLLIN, wake_fd_handler, NULL)
+            != WIFI_SUCCESS
+            || event_loop_add_fd(info, loop->timer_fd, EPOLLIN, timer_fd_handler,
+                NULL) != WIFI_SUCCESS) {
+        event_loop_cleanup(info);
+        return WIFI_ERROR_UNKNOWN;
+    }
+    return WIFI_SUCCESS;
+}
+
+void event_loop_cleanup(hal_info *info)
+{
+    struct event_loop *loop = info->loop;
+    if (loop == NULL)
+        return;
+
+    if (loop->num_timers != 0)
+        ALOGW("%s: %u timers still pending", __func__, loop->num_timers);
+    if (loop->timer_fd >= 0)
+        close(loop->timer_fd);
+    if (loop->wake_fd >= 0)
+        close(loop->wake_fd);
+    if (loop->epoll_fd >= 0)
+        close(loop->epoll_fd);
+    pthread_mutex_destroy(&loop->lock);
+    free(loop);
+    info->loop = NULL;
+}
+
+void event_loop_run(hal_info *info)
+{
+    struct event_loop *loop = info->loop;
+    struct epoll_event events[MAX_EVENT_FDS];
+
+    while (!info->clean_up) {
+        int n = epoll_wait(loop->epoll_fd, events, MAX_EVENT_FDS, -1);
+        if (n < 0) {
+            if (errno != EINTR)
+                ALOGE("Error polling: %d", -errno);
+            continue;
+        }
+
+        for (int i = 0; i < n; i++) {
+            unsigned idx = (uint32_t)events[i].data.u64;
+            uint32_t gen = (uint32_t)(events[i].data.u64 >> 32);
+
+            pthread_mutex_lock(&loop->lock);
+            event_fd_reg reg = loop->fds[idx];
+            pthread_mutex_unlock(&loop->lock);
+
+            /* skip descriptors removed by an earlier handler in this batch */
+            if (reg.fd < 0 || reg.gen != gen)
+                continue;
+            (*reg.handler)(info, reg.fd, events[i].events, reg.arg);
+        }
+    }
+}
+
+void event_loop_wakeup(hal_info *info)
+{
+    uint64_t one = 1;
+    if (info->loop == NULL)
+        return;
+    if (write(info->loop->wake_fd, &one, sizeof(one)) < 0 && errno != EAGAIN)
+        ALOGE("%s: write failed: %d", __func__, -errno);
+}
+
+wifi_error event_loop_add_fd(hal_info *info, int fd, uint32_t events,
+        event_loop_fd_handler handler, void *arg)
+{
+    struct event_loop *loop = info->loop;
+    wifi_error ret = WIFI_ERROR_TOO_MANY_REQUESTS;
+
+    pthread_mutex_lock(&loop->lock);
+    for (int i = 0; i < MAX_EVENT_FDS; i++) {
+        event_fd_reg *reg = &loop->fds[i];
+        if (reg->fd >= 0)
+            continue;
+
+        struct epoll_event ev;
+        memset(&ev, 0, sizeof(ev));
+        ev.events = events;
+        ev.data.u64 = ((uint64_t)(reg->gen + 1) << 32) | (uint32_t)i;
+        if (epoll_ctl(loop->epoll_fd, EPOLL_CTL_ADD, fd, &ev) < 0) {
+            ALOGE("%s: failed to add fd %d: %d", __func__, fd, -errno);
+            ret = WIFI_ERROR_UNKNOWN;
+            break;
+        }
+        reg->gen++;
+        reg->fd = fd;
+        reg->handler = handler;
+        reg->arg = arg;
+        ret = WIFI_SUCCESS;
+        break;
+    }
+    pthread_mutex_unlock(&loop->lock);
+
+    if (ret == WIFI_ERROR_TOO_MANY_REQUESTS)
+        ALOGE("%s: no room for fd %d", __func__, fd);
+    return ret;
+}
+
+wifi_error event_loop_mod_fd(hal_info *info, int fd, uint32_t events)
+{
+    struct event_loop *loop = info->loop;
+    wifi_error ret = WIFI_ERROR_INVALID_ARGS;
+
+    pthread_mutex_lock(&loop->lock);
+    for (int i = 0; i < MAX_EVENT_FDS; i++) {
+        event_fd_reg *reg = &loop->fds[i];
+        if (reg->fd != fd)
+            continue;
+
+        struct epoll_event ev;
+        memset(&ev, 0, sizeof(ev));
+        ev.events = events;
+        ev.data.u64 = ((uint64_t)reg->gen << 32) | (uint32_t)i;
+        if (epoll_ctl(loop->epoll_fd, EPOLL_CTL_MOD, fd, &ev) < 0) {
+            ALOGE("%s: failed to modify fd %d: %d", __func__, fd, -errno);
+            ret = WIFI_ERROR_UNKNOWN;
+        } else {
+            ret = WIFI_SUCCESS;
+        }
+        break;
+    }
+    pthread_mutex_unlock(&loop->lock);
+    return ret;
+}
+
+void event_loop_del_fd(hal_info *info, int fd)
+{
+    struct event_loop *loop = info->loop;
+
+    pthread_mutex_lock(&loop->lock);
+    for (int i = 0; i < MAX_EVENT_FDS; i++) {
+        if (loop->fds[i].fd == fd) {
+            epoll_ctl(loop->epoll_fd, EPOLL_CTL_DEL, fd, NULL);
+            loop->fds[i].fd = -1;
+            break;
+        }
+    }
+    pthread_mutex_unlock(&loop->lock);
+}
+
+void hal_timer_init(hal_timer *timer, hal_timer_handler handler, void *arg)
+{
+    memset(timer, 0, sizeof(*timer));
+    timer->handler = handler;
+    timer->arg = arg;
+}
+
+void hal_timer_start(hal_info *info, hal_timer *timer, uint32_t delay_ms,
+        uint32_t period_ms)
+{
+    struct event_loop *loop = info->loop;
+    /* round up so that a timer never fires early */
+    uint64_t expires = (now_ms() + delay_ms + TIMER_TICK_MS - 1) / TIMER_TICK_MS;
+
+    pthread_mutex_lock(&loop->lock);
+    wheel_remove(loop, timer);
+    /* ticks up to last_tick have been run already */
+    timer->expires = expires > loop->last_tick ? expires : loop->last_tick + 1;
+    timer->period = period_ms;
+    wheel_insert(loop, timer);
+    rearm_timer_fd(loop);
+    pthread_mutex_unlock(&loop->lock);
+}
+
+bool hal_timer_cancel(hal_info *info, hal_timer *timer)
+{
+    struct event_loop *loop = info->loop;
+
+    pthread_mutex_lock(&loop->lock);
+    bool pending = wheel_remove(loop, timer);
+    rearm_timer_fd(loop);
+    pthread_mutex_unlock(&loop->lock);
+    return pending;
+}
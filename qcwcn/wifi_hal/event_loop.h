@@ -0,0 +1,80 @@
+/*
+ * Copyright (C) 2014 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef __WIFI_HAL_EVENT_LOOP_H__
+#define __WIFI_HAL_EVENT_LOOP_H__
+
+#include <sys/epoll.h>
+
+#include "common.h"
+
+/*
+ * epoll based loop run by wifi_event_loop().
+ *
+ * File descriptors are added with event_loop_add_fd() and their handler is
+ * called on the event thread whenever epoll reports them. An eventfd wakes
+ * the loop at once, e.g. on wifi_cleanup(). Timers live on a hashed wheel
+ * of TIMER_WHEEL_SLOTS slots of TIMER_TICK_MS each; a timerfd is armed for
+ * the earliest one, so an idle loop never wakes up just to check them.
+ * A timer with no delay is the way to hand work to the event thread; one
+ * started from a timer handler runs on the next tick at the earliest.
+ */
+
+typedef void (*event_loop_fd_handler)(hal_info *info, int fd, uint32_t events,
+        void *arg);
+typedef void (*hal_timer_handler)(hal_info *info, void *arg);
+
+typedef struct hal_timer {
+    hal_timer_handler handler;
+    void *arg;
+    uint64_t expires;                               // CLOCK_MONOTONIC tick
+    uint32_t period;                                // ms, 0 for one shot
+    bool armed;
+    struct hal_timer *next;                         // wheel slot chain
+} hal_timer;
+
+wifi_error event_loop_init(hal_info *info);
+void event_loop_cleanup(hal_info *info);
+
+/* Dispatches events on the calling thread until hal_info::clean_up is set */
+void event_loop_run(hal_info *info);
+
+/* Makes event_loop_run() look at hal_info::clean_up right away */
+void event_loop_wakeup(hal_info *info);
+
+/* events is a mask of EPOLLIN, EPOLLOUT, ... */
+wifi_error event_loop_add_fd(hal_info *info, int fd, uint32_t events,
+        event_loop_fd_handler handler, void *arg);
+/* Changes the events fd is watched for; with 0 its handler is not called
+ * until they are changed again */
+wifi_error event_loop_mod_fd(hal_info *info, int fd, uint32_t events);
+/* Once this returns the handler of fd is not called again, unless this is
+ * called from another thread while it is running. */
+void event_loop_del_fd(hal_info *info, int fd);
+
+void hal_timer_init(hal_timer *timer, hal_timer_handler handler, void *arg);
+
+/* (Re)arms timer to fire delay_ms from now on the event thread, then every
+ * period_ms if that is not 0. */
+void hal_timer_start(hal_info *info, hal_timer *timer, uint32_t delay_ms,
+        uint32_t period_ms);
+
+/* Disarms timer. Returns true if it was pending. A handler that is already
+ * running is not waited for; the loop does not touch the timer once its
+ * handler has been called, so the handler is what must not outlive it. */
+bool hal_timer_cancel(hal_info *info, hal_timer *timer);
+
+#endif /* __WIFI_HAL_EVENT_LOOP_H__ */
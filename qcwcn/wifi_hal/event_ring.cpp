@@ -0,0 +1,332 @@
+/*
+ * Copyright (C) 2014 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+
+#include "wifi_hal.h"
+#include "common.h"
+#include "event_ring.h"
+
+#define CACHE_LINE              (64)
+
+typedef struct {
+    struct nl_msg *msg;
+    int cmd;
+    uint32_t vendor_id;
+    int subcmd;
+} event_slot;
+
+/*
+ * head and tail are free running. The producer owns tail and the slots in
+ * [head, tail); the consumer claims the slot at head by moving head on
+ * with a CAS. Dropping the oldest event is the producer claiming it the
+ * same way, so a consumer whose CAS fails simply discards the copy it
+ * made and never touches the message. Slot fields are accessed atomically
+ * since a losing consumer may read a slot while it is being refilled.
+ */
+struct event_ring {
+    uint32_t head __attribute__((aligned(CACHE_LINE)));
+    uint32_t tail __attribute__((aligned(CACHE_LINE)));
+    event_slot slot[EVENT_RING_SIZE] __attribute__((aligned(CACHE_LINE)));
+
+    int policy;                                     // wifi_event_ring_policy
+    bool overrun_pending;
+    bool exit;
+    bool consumer_waiting;                          // callback thread asleep
+    bool producer_waiting;                          // event thread asleep
+    pthread_mutex_t lock;                           // only taken to sleep or wake
+    pthread_cond_t cond;
+
+    pthread_t thread;
+    bool running;
+    event_ring_deliver_fn deliver;
+    event_ring_overrun_fn overrun;
+
+    uint32_t max_depth;
+    uint32_t stalls;
+    uint32_t dropped;
+    uint32_t coalesced;
+    uint32_t delivered;
+};
+
+static inline void slot_store(event_slot *s, struct nl_msg *msg, int cmd,
+        uint32_t vendor_id, int subcmd)
+{
+    __atomic_store_n(&s->msg, msg, __ATOMIC_RELAXED);
+    __atomic_store_n(&s->cmd, cmd, __ATOMIC_RELAXED);
+    __atomic_store_n(&s->vendor_id, vendor_id, __ATOMIC_RELAXED);
+    __atomic_store_n(&s->subcmd, subcmd, __ATOMIC_RELAXED);
+}
+
+static inline void slot_load(event_slot *s, event_slot *copy)
+{
+    copy->msg = __atomic_load_n(&s->msg, __ATOMIC_RELAXED);
+    copy->cmd = __atomic_load_n(&s->cmd, __ATOMIC_RELAXED);
+    copy->vendor_id = __atomic_load_n(&s->vendor_id, __ATOMIC_RELAXED);
+    copy->subcmd = __atomic_load_n(&s->subcmd, __ATOMIC_RELAXED);
+}
+
+static inline void stat_inc(uint32_t *counter)
+{
+    __atomic_add_fetch(counter, 1, __ATOMIC_RELAXED);
+}
+
+static void ring_wake(struct event_ring *ring)
+{
+    pthread_mutex_lock(&ring->lock);
+    pthread_cond_broadcast(&ring->cond);
+    pthread_mutex_unlock(&ring->lock);
+}
+
+/* Claims the event at head for the caller. Returns false if the other
+ * side got there first. */
+static bool ring_claim(struct event_ring *ring, uint32_t head)
+{
+    return __atomic_compare_exchange_n(&ring->head, &head, head + 1, false,
+            __ATOMIC_SEQ_CST, __ATOMIC_SEQ_CST);
+}
+
+/* True if an event with the same key is queued and not yet claimed */
+static bool ring_coalesce(struct event_ring *ring, uint32_t tail, int cmd,
+        uint32_t vendor_id, int subcmd)
+{
+    uint32_t head = __atomic_load_n(&ring->head, __ATOMIC_SEQ_CST);
+
+    for (uint32_t i = tail; i-- != head; ) {
+        event_slot *s = &ring->slot[i & (EVENT_RING_SIZE - 1)];
+        if (__atomic_load_n(&s->cmd, __ATOMIC_RELAXED) != cmd
+                || __atomic_load_n(&s->vendor_id, __ATOMIC_RELAXED) != vendor_id
+                || __atomic_load_n(&s->subcmd, __ATOMIC_RELAXED) != subcmd)
+            continue;
+        /* only if it will still be delivered after the new one came in */
+        return (int32_t)(i - __atomic_load_n(&ring->head, __ATOMIC_SEQ_CST)) >= 0;
+    }
+    return false;
+}
+
+static void *callback_thread(void *arg)
+{
+    hal_info *info = (hal_info *)arg;
+    struct event_ring *ring = info->ring;
+    event_slot ev;
+
+    for (;;) {
+        if (__atomic_load_n(&ring->exit, __ATOMIC_SEQ_CST))
+            break;
+        if (__atomic_exchange_n(&ring->overrun_pending, false, __ATOMIC_SEQ_CST))
+            (*ring->overrun)(info);
+
+        uint32_t head = __atomic_load_n(&ring->head, __ATOMIC_SEQ_CST);
+        uint32_t tail = __atomic_load_n(&ring->tail, __ATOMIC_SEQ_CST);
+
+        if (head == tail) {
+            pthread_mutex_lock(&ring->lock);
+            __atomic_store_n(&ring->consumer_waiting, true, __ATOMIC_SEQ_CST);
+            if (__atomic_load_n(&ring->head, __ATOMIC_SEQ_CST)
+                        == __atomic_load_n(&ring->tail, __ATOMIC_SEQ_CST)
+                    && !__atomic_load_n(&ring->overrun_pending, __ATOMIC_SEQ_CST)
+                    && !__atomic_load_n(&ring->exit, __ATOMIC_SEQ_CST))
+                pthread_cond_wait(&ring->cond, &ring->lock);
+            __atomic_store_n(&ring->consumer_waiting, false, __ATOMIC_SEQ_CST);
+            pthread_mutex_unlock(&ring->lock);
+            continue;
+        }
+
+        slot_load(&ring->slot[head & (EVENT_RING_SIZE - 1)], &ev);
+        if (!ring_claim(ring, head))
+            continue;
+
+        if (__atomic_load_n(&ring->producer_waiting, __ATOMIC_SEQ_CST))
+            ring_wake(ring);
+
+        (*ring->deliver)(info, ev.msg, ev.cmd, ev.vendor_id, ev.subcmd);
+        nlmsg_free(ev.msg);
+        stat_inc(&ring->delivered);
+    }
+
+    return NULL;
+}
+
+wifi_error event_ring_init(hal_info *info)
+{
+    struct event_ring *ring = (struct event_ring *)malloc(sizeof(*ring));
+    if (ring == NULL)
+        return WIFI_ERROR_OUT_OF_MEMORY;
+
+    memset(ring, 0, sizeof(*ring));
+    ring->policy = EVENT_RING_COALESCE;
+    pthread_mutex_init(&ring->lock, NULL);
+    pthread_cond_init(&ring->cond, NULL);
+    info->ring = ring;
+    return WIFI_SUCCESS;
+}
+
+void event_ring_cleanup(hal_info *info)
+{
+    struct event_ring *ring = info->ring;
+    if (ring == NULL)
+        return;
+
+    event_ring_stop(info);
+    pthread_mutex_destroy(&ring->lock);
+    pthread_cond_destroy(&ring->cond);
+    free(ring);
+    info->ring = NULL;
+}
+
+wifi_error event_ring_start(hal_info *info, event_ring_deliver_fn deliver,
+        event_ring_overrun_fn overrun)
+{
+    struct event_ring *ring = info->ring;
+
+    ring->deliver = deliver;
+    ring->overrun = overrun;
+    ring->exit = false;
+    int res = pthread_create(&ring->thread, NULL, callback_thread, info);
+    if (res != 0) {
+        ALOGE("Failed to start callback thread: %d; delivering events on"
+                " the event thread", res);
+        return WIFI_ERROR_UNKNOWN;
+    }
+    info->callback_thread = ring->thread;
+    ring->running = true;
+    return WIFI_SUCCESS;
+}
+
+void event_ring_stop(hal_info *info)
+{
+    struct event_ring *ring = info->ring;
+
+    if (ring->running) {
+        __atomic_store_n(&ring->exit, true, __ATOMIC_SEQ_CST);
+        ring_wake(ring);
+        pthread_join(ring->thread, NULL);
+        ring->running = false;
+    }
+
+    while (ring->head != ring->tail) {
+        nlmsg_free(ring->slot[ring->head & (EVENT_RING_SIZE - 1)].msg);
+        ring->head++;
+    }
+}
+
+void event_ring_post(hal_info *info, struct nl_msg *msg, int cmd,
+        uint32_t vendor_id, int subcmd)
+{
+    struct event_ring *ring = info->ring;
+    uint32_t tail = ring->tail;
+
+    if (!ring->running) {
+        /* no callback thread; deliver on the event thread as before */
+        (*ring->deliver)(info, msg, cmd, vendor_id, subcmd);
+        return;
+    }
+
+    for (;;) {
+        uint32_t head = __atomic_load_n(&ring->head, __ATOMIC_SEQ_CST);
+        if (tail - head < EVENT_RING_SIZE)
+            break;
+
+        int policy = __atomic_load_n(&ring->policy, __ATOMIC_RELAXED);
+        if (policy == EVENT_RING_COALESCE
+                && ring_coalesce(ring, tail, cmd, vendor_id, subcmd)) {
+            stat_inc(&ring->coalesced);
+            return;
+        }
+
+        if (policy == EVENT_RING_BLOCK) {
+            stat_inc(&ring->stalls);
+            pthread_mutex_lock(&ring->lock);
+            __atomic_store_n(&ring->producer_waiting, true, __ATOMIC_SEQ_CST);
+            if (tail - __atomic_load_n(&ring->head, __ATOMIC_SEQ_CST)
+                        >= EVENT_RING_SIZE
+                    && !__atomic_load_n(&ring->exit, __ATOMIC_SEQ_CST))
+                pthread_cond_wait(&ring->cond, &ring->lock);
+            __atomic_store_n(&ring->producer_waiting, false, __ATOMIC_SEQ_CST);
+            pthread_mutex_unlock(&ring->lock);
+            if (__atomic_load_n(&ring->exit, __ATOMIC_SEQ_CST))
+                return;
+            continue;
+        }
+
+        /* drop the oldest, unless the consumer just took it, and have
+         * the handlers catch up as after an event_sock overrun */
+        if (ring_claim(ring, head)) {
+            nlmsg_free(ring->slot[head & (EVENT_RING_SIZE - 1)].msg);
+            stat_inc(&ring->dropped);
+            __atomic_store_n(&ring->overrun_pending, true, __ATOMIC_SEQ_CST);
+        }
+    }
+
+    nlmsg_get(msg);
+    slot_store(&ring->slot[tail & (EVENT_RING_SIZE - 1)], msg, cmd, vendor_id,
+            subcmd);
+    __atomic_store_n(&ring->tail, tail + 1, __ATOMIC_SEQ_CST);
+
+    uint32_t depth = tail + 1 - __atomic_load_n(&ring->head, __ATOMIC_SEQ_CST);
+    if (depth > __atomic_load_n(&ring->max_depth, __ATOMIC_RELAXED))
+        __atomic_store_n(&ring->max_depth, depth, __ATOMIC_RELAXED);
+
+    if (__atomic_load_n(&ring->consumer_waiting, __ATOMIC_SEQ_CST))
+        ring_wake(ring);
+}
+
+void event_ring_post_overrun(hal_info *info)
+{
+    struct event_ring *ring = info->ring;
+
+    if (!ring->running) {
+        (*ring->overrun)(info);
+        return;
+    }
+
+    __atomic_store_n(&ring->overrun_pending, true, __ATOMIC_SEQ_CST);
+    if (__atomic_load_n(&ring->consumer_waiting, __ATOMIC_SEQ_CST))
+        ring_wake(ring);
+}
+
+wifi_error wifi_set_event_ring_policy(wifi_handle handle,
+        wifi_event_ring_policy policy)
+{
+    hal_info *info = (hal_info *)handle;
+
+    if (policy != EVENT_RING_BLOCK && policy != EVENT_RING_DROP_OLDEST
+            && policy != EVENT_RING_COALESCE)
+        return WIFI_ERROR_INVALID_ARGS;
+
+    __atomic_store_n(&info->ring->policy, (int)policy, __ATOMIC_RELAXED);
+    if (policy != EVENT_RING_BLOCK)
+        ring_wake(info->ring);
+    return WIFI_SUCCESS;
+}
+
+wifi_error wifi_get_event_ring_stats(wifi_handle handle,
+        wifi_event_ring_stats *stats)
+{
+    struct event_ring *ring = ((hal_info *)handle)->ring;
+
+    stats->depth = __atomic_load_n(&ring->tail, __ATOMIC_SEQ_CST)
+        - __atomic_load_n(&ring->head, __ATOMIC_SEQ_CST);
+    stats->max_depth = __atomic_load_n(&ring->max_depth, __ATOMIC_RELAXED);
+    stats->stalls = __atomic_load_n(&ring->stalls, __ATOMIC_RELAXED);
+    stats->dropped = __atomic_load_n(&ring->dropped, __ATOMIC_RELAXED);
+    stats->coalesced = __atomic_load_n(&ring->coalesced, __ATOMIC_RELAXED);
+    stats->delivered = __atomic_load_n(&ring->delivered, __ATOMIC_RELAXED);
+    return WIFI_SUCCESS;
+}
@@ -0,0 +1,64 @@
+/*
+ * Copyright (C) 2014 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef __WIFI_HAL_EVENT_RING_H__
+#define __WIFI_HAL_EVENT_RING_H__
+
+#include "common.h"
+
+/*
+ * Hands events from the event thread to the callback thread.
+ *
+ * The event thread only reads event_sock and classifies each event; the
+ * event handlers, and the framework callbacks they invoke, run on a
+ * dedicated callback thread. Between the two sits a bounded ring with a
+ * single producer and a single consumer that neither side locks; a mutex
+ * and condition are only touched by a side that has to sleep.
+ *
+ * When the ring is full the producer applies the configured
+ * wifi_event_ring_policy: it waits for room, drops the oldest queued
+ * event or, for coalescing, drops the new event if one with the same
+ * command and vendor subcommand is still waiting to be delivered and the
+ * oldest one otherwise. Coalescing is the default: a handler that sends a
+ * request waits for the event thread to read the answer, so the event
+ * thread must never wait for a handler. Dropping the oldest event calls
+ * overrun just like an event_sock overrun does.
+ */
+
+#define EVENT_RING_SIZE         (256)   /* must be a power of two */
+
+/* Called on the callback thread for each event; msg is freed afterwards */
+typedef void (*event_ring_deliver_fn)(hal_info *info, struct nl_msg *msg,
+        int cmd, uint32_t vendor_id, int subcmd);
+/* Called on the callback thread after event_ring_post_overrun() */
+typedef void (*event_ring_overrun_fn)(hal_info *info);
+
+wifi_error event_ring_init(hal_info *info);
+void event_ring_cleanup(hal_info *info);
+
+/* Starts the callback thread */
+wifi_error event_ring_start(hal_info *info, event_ring_deliver_fn deliver,
+        event_ring_overrun_fn overrun);
+/* Stops the callback thread; events still queued are dropped */
+void event_ring_stop(hal_info *info);
+
+/* Queues msg, taking a reference on it. Event thread only. */
+void event_ring_post(hal_info *info, struct nl_msg *msg, int cmd,
+        uint32_t vendor_id, int subcmd);
+/* Has overrun called on the callback thread, once however often posted */
+void event_ring_post_overrun(hal_info *info);
+
+#endif /* __WIFI_HAL_EVENT_RING_H__ */
@@ -0,0 +1,875 @@
+/*
+ * Copyright (C) 2014 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <time.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <net/if.h>
+#include <sys/eventfd.h>
+
+#include "wifi_hal.h"
+#include "common.h"
+#include "qca-vendor.h"
+#include "vendor_definitions.h"
+#include "event_filter.h"
+#include "nan_i.h"
+#include "fake_driver.h"
+
+#define FAKE_DRIVER_MCGRP_BASE  (0x7f00)    /* ids handed out for the groups */
+#define FAKE_DRIVER_SUBCMDS     (256)
+
+typedef struct fake_msg {
+    struct nl_msg *msg;
+    struct fake_msg *next;
+} fake_msg;
+
+/* Messages waiting to be read from one socket; fd is an eventfd that is
+ * readable for as long as the queue is not empty */
+typedef struct {
+    fake_msg *head;
+    fake_msg *tail;
+    unsigned len;
+    int fd;
+} fake_queue;
+
+typedef struct {
+    int subcmd;
+    uint64_t period_ns;
+    uint64_t next;                                  // CLOCK_MONOTONIC ns
+    uint32_t sent;
+    uint32_t count;                                 // 0 for no limit
+    fake_event_fill fill;
+    void *arg;
+} fake_stream;
+
+static pthread_mutex_t fake_lock = PTHREAD_MUTEX_INITIALIZER;   // queues and streams
+static pthread_cond_t fake_cond = PTHREAD_COND_INITIALIZER;     // streams changed
+
+static struct {
+    hal_info *info;
+    fake_driver_config config;
+    fake_queue replies;                             // for cmd_sock
+    fake_queue events;                              // for event_sock
+    bool overrun;                                   // events were dropped
+    fake_vendor_handler handler[FAKE_DRIVER_SUBCMDS];
+    void *handler_arg[FAKE_DRIVER_SUBCMDS];
+    fake_stream streams[FAKE_DRIVER_MAX_STREAMS];
+    int num_streams;
+    pthread_t thread;
+    bool running;                                   // thread was started
+    bool exit;                                      // thread should exit
+} fake;
+
+static uint64_t now_ns()
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+/* Must be called with the lock held */
+static void queue_push(fake_queue *q, struct nl_msg *msg)
+{
+    fake_msg *m = (fake_msg *)malloc(sizeof(*m));
+    if (m == NULL) {
+        nlmsg_free(msg);
+        return;
+    }
+
+    m->msg = msg;
+    m->next = NULL;
+    if (q->tail != NULL)
+        q->tail->next = m;
+    else
+        q->head = m;
+    q->tail = m;
+
+    if (q->len++ == 0) {
+        uint64_t one = 1;
+        write(q->fd, &one, sizeof(one));
+    }
+}
+
+/* Must be called with the lock held */
+static struct nl_msg *queue_pop(fake_queue *q)
+{
+    fake_msg *m = q->head;
+    if (m == NULL)
+        return NULL;
+
+    q->head = m->next;
+    if (q->head == NULL)
+        q->tail = NULL;
+    if (--q->len == 0) {
+        uint64_t val;
+        read(q->fd, &val, sizeof(val));
+    }
+
+    struct nl_msg *msg = m->msg;
+    free(m);
+    return msg;
+}
+
+static void queue_flush(fake_queue *q)
+{
+    struct nl_msg *msg;
+    while ((msg = queue_pop(q)) != NULL)
+        nlmsg_free(msg);
+}
+
+static void queue_reply(struct nl_msg *msg)
+{
+    pthread_mutex_lock(&fake_lock);
+    queue_push(&fake.replies, msg);
+    pthread_mutex_unlock(&fake_lock);
+}
+
+/* Must be called with the lock held */
+static void queue_event(struct nl_msg *msg)
+{
+    unsigned limit = fake.config.event_queue ? fake.config.event_queue
+        : FAKE_DRIVER_EVENT_QUEUE;
+
+    if (fake.events.len >= limit) {
+        fake.overrun = true;
+        nlmsg_free(msg);
+        return;
+    }
+    queue_push(&fake.events, msg);
+}
+
+static void ack(struct nlmsghdr *req, int err)
+{
+    struct nl_msg *msg = nlmsg_alloc_simple(NLMSG_ERROR, 0);
+    if (msg == NULL)
+        return;
+
+    nlmsg_hdr(msg)->nlmsg_seq = req->nlmsg_seq;
+    nlmsg_hdr(msg)->nlmsg_pid = req->nlmsg_pid;
+
+    struct nlmsgerr e;
+    e.error = err;
+    e.msg = *req;
+    nlmsg_append(msg, &e, sizeof(e), NLMSG_ALIGNTO);
+    queue_reply(msg);
+}
+
+struct nl_msg *fake_driver_msg(int subcmd, int ifindex, struct nlattr **data)
+{
+    struct nl_msg *msg = nlmsg_alloc();
+    if (msg == NULL)
+        return NULL;
+
+    genlmsg_put(msg, 0, 0, FAKE_DRIVER_NL80211_ID, 0, 0, NL80211_CMD_VENDOR, 0);
+    nla_put_u32(msg, NL80211_ATTR_IFINDEX, ifindex ? ifindex : FAKE_DRIVER_IFINDEX);
+    nla_put_u32(msg, NL80211_ATTR_VENDOR_ID, OUI_QCA);
+    nla_put_u32(msg, NL80211_ATTR_VENDOR_SUBCMD, subcmd);
+    *data = nla_nest_start(msg, NL80211_ATTR_VENDOR_DATA);
+    return msg;
+}
+
+void fake_driver_reply(const fake_request *req, struct nl_msg *msg,
+        struct nlattr *data)
+{
+    nla_nest_end(msg, data);
+    nlmsg_hdr(msg)->nlmsg_seq = req->seq;
+    nlmsg_hdr(msg)->nlmsg_pid = req->port;
+    queue_reply(msg);
+}
+
+void fake_driver_event(struct nl_msg *msg, struct nlattr *data)
+{
+    nla_nest_end(msg, data);
+    pthread_mutex_lock(&fake_lock);
+    queue_event(msg);
+    pthread_mutex_unlock(&fake_lock);
+}
+
+/* Built in answers to the QCA vendor subcommands */
+
+static void reply_u32(const fake_request *req, int attr, uint32_t val)
+{
+    struct nlattr *data;
+    struct nl_msg *msg = fake_driver_msg(req->subcmd, req->ifindex, &data);
+    if (msg == NULL)
+        return;
+    nla_put_u32(msg, attr, val);
+    fake_driver_reply(req, msg, data);
+}
+
+static int tdls_answer(const fake_request *req)
+{
+    struct nlattr *tb[QCA_WLAN_VENDOR_ATTR_TDLS_ENABLE_MAX + 1];
+    struct nlattr *data;
+    struct nl_msg *msg;
+
+    if (req->subcmd == QCA_NL80211_VENDOR_SUBCMD_TDLS_GET_STATUS) {
+        msg = fake_driver_msg(req->subcmd, req->ifindex, &data);
+        if (msg == NULL)
+            return -ENOMEM;
+        nla_put_u32(msg, QCA_WLAN_VENDOR_ATTR_TDLS_GET_STATUS_STATE,
+                WIFI_TDLS_DISABLED);
+        nla_put_u32(msg, QCA_WLAN_VENDOR_ATTR_TDLS_GET_STATUS_REASON, 0);
+        nla_put_u32(msg, QCA_WLAN_VENDOR_ATTR_TDLS_GET_STATUS_CHANNEL, 0);
+        nla_put_u32(msg,
+                QCA_WLAN_VENDOR_ATTR_TDLS_GET_STATUS_GLOBAL_OPERATING_CLASS, 0);
+        fake_driver_reply(req, msg, data);
+        return 0;
+    }
+
+    /* enable and disable are followed by a state change */
+    bool enable = req->subcmd == QCA_NL80211_VENDOR_SUBCMD_TDLS_ENABLE;
+    int mac_attr = enable ? (int)QCA_WLAN_VENDOR_ATTR_TDLS_ENABLE_MAC_ADDR
+        : (int)QCA_WLAN_VENDOR_ATTR_TDLS_DISABLE_MAC_ADDR;
+    uint8_t mac[6];
+
+    memset(mac, 0, sizeof(mac));
+    nla_parse(tb, QCA_WLAN_VENDOR_ATTR_TDLS_ENABLE_MAX, req->data, req->len, NULL);
+    if (tb[mac_attr] != NULL)
+        nla_memcpy(mac, tb[mac_attr], sizeof(mac));
+
+    msg = fake_driver_msg(QCA_NL80211_VENDOR_SUBCMD_TDLS_STATE, req->ifindex,
+            &data);
+    if (msg == NULL)
+        return -ENOMEM;
+    nla_put(msg, QCA_WLAN_VENDOR_ATTR_TDLS_MAC_ADDR, sizeof(mac), mac);
+    nla_put_u32(msg, QCA_WLAN_VENDOR_ATTR_TDLS_STATE,
+            enable ? WIFI_TDLS_ENABLED : WIFI_TDLS_DISABLED);
+    nla_put_u32(msg, QCA_WLAN_VENDOR_ATTR_TDLS_REASON, 0);
+    nla_put_u32(msg, QCA_WLAN_VENDOR_ATTR_TDLS_CHANNEL, 0);
+    nla_put_u32(msg, QCA_WLAN_VENDOR_ATTR_TDLS_GLOBAL_OPERATING_CLASS, 0);
+    fake_driver_event(msg, data);
+    return 0;
+}
+
+static int gscan_answer(const fake_request *req)
+{
+    struct nlattr *data;
+    struct nl_msg *msg = fake_driver_msg(req->subcmd, req->ifindex, &data);
+    if (msg == NULL)
+        return -ENOMEM;
+
+    if (req->subcmd == QCA_NL80211_VENDOR_SUBCMD_GSCAN_GET_VALID_CHANNELS) {
+        uint32_t channels[11];
+        for (int i = 0; i < 11; i++)
+            channels[i] = 2412 + 5 * i;
+        nla_put_u32(msg, QCA_WLAN_VENDOR_ATTR_GSCAN_RESULTS_NUM_CHANNELS, 11);
+        nla_put(msg, QCA_WLAN_VENDOR_ATTR_GSCAN_RESULTS_CHANNELS,
+                sizeof(channels), channels);
+        fake_driver_reply(req, msg, data);
+        return 0;
+    }
+
+    /* the rest report back with an event of their own subcommand */
+    nla_put_u32(msg, QCA_WLAN_VENDOR_ATTR_GSCAN_STATUS, 0);
+    if (req->subcmd == QCA_NL80211_VENDOR_SUBCMD_GSCAN_GET_CAPABILITIES) {
+        nla_put_u32(msg,
+            QCA_WLAN_VENDOR_ATTR_GSCAN_RESULTS_CAPABILITIES_MAX_SCAN_CACHE_SIZE,
+            8192);
+        nla_put_u32(msg,
+            QCA_WLAN_VENDOR_ATTR_GSCAN_RESULTS_CAPABILITIES_MAX_SCAN_BUCKETS, 8);
+        nla_put_u32(msg,
+            QCA_WLAN_VENDOR_ATTR_GSCAN_RESULTS_CAPABILITIES_MAX_AP_CACHE_PER_SCAN,
+            64);
+        nla_put_u32(msg,
+            QCA_WLAN_VENDOR_ATTR_GSCAN_RESULTS_CAPABILITIES_MAX_RSSI_SAMPLE_SIZE,
+            8);
+        nla_put_u32(msg,
+            QCA_WLAN_VENDOR_ATTR_GSCAN_RESULTS_CAPABILITIES_MAX_SCAN_REPORTING_THRESHOLD,
+            100);
+        nla_put_u32(msg,
+            QCA_WLAN_VENDOR_ATTR_GSCAN_RESULTS_CAPABILITIES_MAX_HOTLIST_APS, 64);
+        nla_put_u32(msg,
+            QCA_WLAN_VENDOR_ATTR_GSCAN_RESULTS_CAPABILITIES_MAX_SIGNIFICANT_WIFI_CHANGE_APS,
+            64);
+        nla_put_u32(msg,
+            QCA_WLAN_VENDOR_ATTR_GSCAN_RESULTS_CAPABILITIES_MAX_BSSID_HISTORY_ENTRIES,
+            16);
+    }
+    fake_driver_event(msg, data);
+    return 0;
+}
+
+typedef struct {
+    int attr;
+    uint32_t val;
+} fake_u32_attr;
+
+static void put_u32s(struct nl_msg *msg, const fake_u32_attr *attrs, int n)
+{
+    for (int i = 0; i < n; i++)
+        nla_put_u32(msg, attrs[i].attr, attrs[i].val);
+}
+
+#define LL(attr) QCA_WLAN_VENDOR_ATTR_LL_STATS_##attr
+
+static const fake_u32_attr ll_radio[] = {
+    { LL(RADIO_ID), 0 },
+    { LL(RADIO_ON_TIME), 1000 },
+    { LL(RADIO_TX_TIME), 100 },
+    { LL(RADIO_RX_TIME), 200 },
+    { LL(RADIO_ON_TIME_SCAN), 50 },
+    { LL(RADIO_ON_TIME_NBD), 0 },
+    { LL(RADIO_ON_TIME_GSCAN), 20 },
+    { LL(RADIO_ON_TIME_ROAM_SCAN), 0 },
+    { LL(RADIO_ON_TIME_PNO_SCAN), 0 },
+    { LL(RADIO_ON_TIME_HS20), 0 },
+    { LL(RADIO_NUM_CHANNELS), 1 },
+};
+
+static const fake_u32_attr ll_channel[] = {
+    { LL(CHANNEL_INFO_WIDTH), WIFI_CHAN_WIDTH_20 },
+    { LL(CHANNEL_INFO_CENTER_FREQ), 2412 },
+    { LL(CHANNEL_INFO_CENTER_FREQ0), 2412 },
+    { LL(CHANNEL_INFO_CENTER_FREQ1), 0 },
+    { LL(CHANNEL_ON_TIME), 1000 },
+    { LL(CHANNEL_CCA_BUSY_TIME), 300 },
+};
+
+static const fake_u32_attr ll_iface[] = {
+    { LL(IFACE_INFO_MODE), WIFI_INTERFACE_STA },
+    { LL(IFACE_INFO_STATE), WIFI_ASSOCIATED },
+    { LL(IFACE_INFO_ROAMING), WIFI_ROAMING_IDLE },
+    { LL(IFACE_INFO_CAPABILITIES), 0 },
+    { LL(IFACE_BEACON_RX), 100 },
+    { LL(IFACE_MGMT_RX), 10 },
+    { LL(IFACE_MGMT_ACTION_RX), 0 },
+    { LL(IFACE_MGMT_ACTION_TX), 0 },
+    { LL(IFACE_RSSI_MGMT), (uint32_t)-50 },
+    { LL(IFACE_RSSI_DATA), (uint32_t)-52 },
+    { LL(IFACE_RSSI_ACK), (uint32_t)-51 },
+};
+
+static const fake_u32_attr ll_wmm_ac[] = {
+    { LL(WMM_AC_TX_MPDU), 40 },
+    { LL(WMM_AC_RX_MPDU), 60 },
+    { LL(WMM_AC_TX_MCAST), 0 },
+    { LL(WMM_AC_RX_MCAST), 2 },
+    { LL(WMM_AC_RX_AMPDU), 30 },
+    { LL(WMM_AC_TX_AMPDU), 20 },
+    { LL(WMM_AC_MPDU_LOST), 1 },
+    { LL(WMM_AC_RETRIES), 3 },
+    { LL(WMM_AC_RETRIES_SHORT), 2 },
+    { LL(WMM_AC_RETRIES_LONG), 1 },
+    { LL(WMM_AC_CONTENTION_TIME_MIN), 10 },
+    { LL(WMM_AC_CONTENTION_TIME_MAX), 500 },
+    { LL(WMM_AC_CONTENTION_TIME_AVG), 50 },
+    { LL(WMM_AC_CONTENTION_NUM_SAMPLES), 40 },
+};
+
+static const fake_u32_attr ll_peer[] = {
+    { LL(PEER_INFO_TYPE), WIFI_PEER_AP },
+    { LL(PEER_INFO_CAPABILITIES), 0 },
+    { LL(PEER_INFO_NUM_RATES), 1 },
+};
+
+static const fake_u32_attr ll_rate[] = {
+    { LL(RATE_BIT_RATE), 720 },
+    { LL(RATE_TX_MPDU), 40 },
+    { LL(RATE_RX_MPDU), 60 },
+    { LL(RATE_MPDU_LOST), 1 },
+    { LL(RATE_RETRIES), 3 },
+    { LL(RATE_RETRIES_SHORT), 2 },
+    { LL(RATE_RETRIES_LONG), 1 },
+};
+
+#define N(a) ((int)(sizeof(a) / sizeof((a)[0])))
+
+/* A GET is answered with the radio, iface and peers results, one event
+ * each, the way the driver reports them after its acknowledgement */
+static int ll_stats_answer(const fake_request *req)
+{
+    static const uint8_t ap[6] = { 0x02, 0, 0, 0, 0, 0x01 };
+    struct nlattr *data, *list, *entry, *rates, *rate;
+    struct nl_msg *msg;
+
+    if (req->subcmd == QCA_NL80211_VENDOR_SUBCMD_LL_STATS_CLR) {
+        struct nlattr *tb[QCA_WLAN_VENDOR_ATTR_LL_STATS_CLR_MAX + 1];
+        uint32_t mask = 0, stop = 0;
+
+        nla_parse(tb, QCA_WLAN_VENDOR_ATTR_LL_STATS_CLR_MAX, req->data,
+                req->len, NULL);
+        if (tb[LL(CLR_CONFIG_REQ_MASK)] != NULL)
+            mask = nla_get_u32(tb[LL(CLR_CONFIG_REQ_MASK)]);
+        if (tb[LL(CLR_CONFIG_STOP_REQ)] != NULL)
+            stop = nla_get_u8(tb[LL(CLR_CONFIG_STOP_REQ)]);
+        msg = fake_driver_msg(req->subcmd, req->ifindex, &data);
+        if (msg == NULL)
+            return -ENOMEM;
+        nla_put_u32(msg, LL(CLR_CONFIG_RSP_MASK), mask);
+        nla_put_u32(msg, LL(CLR_CONFIG_STOP_RSP), stop);
+        fake_driver_reply(req, msg, data);
+        return 0;
+    }
+    if (req->subcmd != QCA_NL80211_VENDOR_SUBCMD_LL_STATS_GET)
+        return 0;
+
+    msg = fake_driver_msg(QCA_NL80211_VENDOR_SUBCMD_LL_STATS_RADIO_RESULTS,
+            req->ifindex, &data);
+    if (msg == NULL)
+        return -ENOMEM;
+    put_u32s(msg, ll_radio, N(ll_radio));
+    list = nla_nest_start(msg, LL(CH_INFO));
+    entry = nla_nest_start(msg, 0);
+    put_u32s(msg, ll_channel, N(ll_channel));
+    nla_nest_end(msg, entry);
+    nla_nest_end(msg, list);
+    fake_driver_event(msg, data);
+
+    uint8_t mac[6], ssid[33];
+    char country[3] = { 'U', 'S', ' ' };
+
+    memset(mac, 0, sizeof(mac));
+    memset(ssid, 0, sizeof(ssid));
+    memcpy(ssid, "fake", 4);
+    msg = fake_driver_msg(QCA_NL80211_VENDOR_SUBCMD_LL_STATS_IFACE_RESULTS,
+            req->ifindex, &data);
+    if (msg == NULL)
+        return -ENOMEM;
+    put_u32s(msg, ll_iface, N(ll_iface));
+    nla_put(msg, LL(IFACE_INFO_MAC_ADDR), sizeof(mac), mac);
+    nla_put(msg, LL(IFACE_INFO_SSID), sizeof(ssid), ssid);
+    nla_put(msg, LL(IFACE_INFO_BSSID), sizeof(ap), ap);
+    nla_put(msg, LL(IFACE_INFO_AP_COUNTRY_STR), sizeof(country), country);
+    nla_put(msg, LL(IFACE_INFO_COUNTRY_STR), sizeof(country), country);
+    list = nla_nest_start(msg, LL(WMM_INFO));
+    for (int ac = 0; ac < WIFI_AC_MAX; ac++) {
+        entry = nla_nest_start(msg, ac);
+        nla_put_u32(msg, LL(WMM_AC_AC), ac);
+        put_u32s(msg, ll_wmm_ac, N(ll_wmm_ac));
+        nla_nest_end(msg, entry);
+    }
+    nla_nest_end(msg, list);
+    nla_put_u32(msg, LL(IFACE_NUM_PEERS), 1);
+    fake_driver_event(msg, data);
+
+    msg = fake_driver_msg(QCA_NL80211_VENDOR_SUBCMD_LL_STATS_PEERS_RESULTS,
+            req->ifindex, &data);
+    if (msg == NULL)
+        return -ENOMEM;
+    nla_put_u32(msg, LL(IFACE_NUM_PEERS), 1);
+    list = nla_nest_start(msg, LL(PEER_INFO));
+    entry = nla_nest_start(msg, 0);
+    put_u32s(msg, ll_peer, N(ll_peer));
+    nla_put(msg, LL(PEER_INFO_MAC_ADDRESS), sizeof(ap), ap);
+    rates = nla_nest_start(msg, LL(PEER_INFO_RATE_INFO));
+    rate = nla_nest_start(msg, 0);
+    nla_put_u8(msg, LL(RATE_PREAMBLE), 2);          /* HT */
+    nla_put_u8(msg, LL(RATE_NSS), 0);
+    nla_put_u8(msg, LL(RATE_BW), WIFI_CHAN_WIDTH_20);
+    nla_put_u8(msg, LL(RATE_MCS_INDEX), 7);
+    put_u32s(msg, ll_rate, N(ll_rate));
+    nla_nest_end(msg, rate);
+    nla_nest_end(msg, rates);
+    nla_nest_end(msg, entry);
+    nla_nest_end(msg, list);
+    fake_driver_event(msg, data);
+    return 0;
+}
+
+#undef LL
+
+/* Every NAN request is answered by its response message, which follows
+ * the request in the message id space, with a success status */
+static int nan_answer(const fake_request *req)
+{
+    NanStatsRspMsg rsp;
+    const NanMsgHeader *hdr = (const NanMsgHeader *)req->data;
+    struct nlattr *data;
+    int len = sizeof(NanErrorRspMsg);
+
+    if (req->len < (int)sizeof(NanMsgHeader))
+        return -EINVAL;
+
+    memset(&rsp, 0, sizeof(rsp));
+    rsp.fwHeader.msgVersion = NAN_MSG_VERSION1;
+    rsp.fwHeader.msgId = hdr->msgId + 1;
+    rsp.fwHeader.handle = hdr->handle;
+    rsp.fwHeader.transactionId = hdr->transactionId;
+    if (hdr->msgId == NAN_MSG_ID_STATS_REQ) {
+        if (req->len >= (int)sizeof(NanStatsReqMsg))
+            rsp.statsRspParams.statsId =
+                ((const NanStatsReqMsg *)req->data)->statsReqParams.statsId;
+        len = sizeof(NanStatsRspMsg);
+    }
+    rsp.fwHeader.msgLen = len;
+
+    struct nl_msg *msg = fake_driver_msg(req->subcmd, req->ifindex, &data);
+    if (msg == NULL)
+        return -ENOMEM;
+    nla_put(msg, QCA_WLAN_VENDOR_ATTR_NAN, len, &rsp);
+    fake_driver_event(msg, data);
+    return 0;
+}
+
+static int builtin_answer(const fake_request *req)
+{
+    switch (req->subcmd) {
+    case QCA_NL80211_VENDOR_SUBCMD_GET_SUPPORTED_FEATURES:
+        reply_u32(req, QCA_WLAN_VENDOR_ATTR_FEATURE_SET, fake.config.features);
+        return 0;
+
+    case QCA_NL80211_VENDOR_SUBCMD_GET_CONCURRENCY_MATRIX:
+        reply_u32(req,
+                QCA_WLAN_VENDOR_ATTR_GET_CONCURRENCY_MATRIX_RESULTS_SET_SIZE, 0);
+        return 0;
+
+    case QCA_NL80211_VENDOR_SUBCMD_TDLS_ENABLE:
+    case QCA_NL80211_VENDOR_SUBCMD_TDLS_DISABLE:
+    case QCA_NL80211_VENDOR_SUBCMD_TDLS_GET_STATUS:
+        return tdls_answer(req);
+
+    case QCA_NL80211_VENDOR_SUBCMD_GSCAN_START:
+    case QCA_NL80211_VENDOR_SUBCMD_GSCAN_STOP:
+    case QCA_NL80211_VENDOR_SUBCMD_GSCAN_GET_VALID_CHANNELS:
+    case QCA_NL80211_VENDOR_SUBCMD_GSCAN_GET_CAPABILITIES:
+    case QCA_NL80211_VENDOR_SUBCMD_GSCAN_SET_BSSID_HOTLIST:
+    case QCA_NL80211_VENDOR_SUBCMD_GSCAN_RESET_BSSID_HOTLIST:
+    case QCA_NL80211_VENDOR_SUBCMD_GSCAN_SET_SIGNIFICANT_CHANGE:
+    case QCA_NL80211_VENDOR_SUBCMD_GSCAN_RESET_SIGNIFICANT_CHANGE:
+        return gscan_answer(req);
+
+    case QCA_NL80211_VENDOR_SUBCMD_LL_STATS_GET:
+    case QCA_NL80211_VENDOR_SUBCMD_LL_STATS_CLR:
+        return ll_stats_answer(req);
+
+    case QCA_NL80211_VENDOR_SUBCMD_NAN:
+        return nan_answer(req);
+
+    default:
+        /* the rest are only acknowledged */
+        return 0;
+    }
+}
+
+static int vendor_request(struct nlmsghdr *nlh, struct nlattr **tb)
+{
+    fake_request req;
+
+    if (!tb[NL80211_ATTR_VENDOR_ID] || !tb[NL80211_ATTR_VENDOR_SUBCMD]
+            || nla_get_u32(tb[NL80211_ATTR_VENDOR_ID]) != OUI_QCA)
+        return -EOPNOTSUPP;
+
+    memset(&req, 0, sizeof(req));
+    req.subcmd = nla_get_u32(tb[NL80211_ATTR_VENDOR_SUBCMD]);
+    if (tb[NL80211_ATTR_IFINDEX])
+        req.ifindex = nla_get_u32(tb[NL80211_ATTR_IFINDEX]);
+    if (tb[NL80211_ATTR_VENDOR_DATA]) {
+        req.data = (struct nlattr *)nla_data(tb[NL80211_ATTR_VENDOR_DATA]);
+        req.len = nla_len(tb[NL80211_ATTR_VENDOR_DATA]);
+    }
+    req.seq = nlh->nlmsg_seq;
+    req.port = nlh->nlmsg_pid;
+
+    fake_vendor_handler fn = NULL;
+    void *arg = NULL;
+    if (req.subcmd >= 0 && req.subcmd < FAKE_DRIVER_SUBCMDS) {
+        pthread_mutex_lock(&fake_lock);
+        fn = fake.handler[req.subcmd];
+        arg = fake.handler_arg[req.subcmd];
+        pthread_mutex_unlock(&fake_lock);
+    }
+    return fn != NULL ? fn(&req, arg) : builtin_answer(&req);
+}
+
+static int ctrl_request(struct nlmsghdr *nlh, struct nlattr **tb)
+{
+    struct genlmsghdr *gnlh = (struct genlmsghdr *)nlmsg_data(nlh);
+    if (gnlh->cmd != CTRL_CMD_GETFAMILY || !tb[CTRL_ATTR_FAMILY_NAME])
+        return -EOPNOTSUPP;
+
+    const char *name = nla_get_string(tb[CTRL_ATTR_FAMILY_NAME]);
+    int id;
+    if (!strcmp(name, "nl80211"))
+        id = FAKE_DRIVER_NL80211_ID;
+    else if (!strcmp(name, "nlctrl"))
+        id = GENL_ID_CTRL;
+    else
+        return -ENOENT;
+
+    struct nl_msg *msg = nlmsg_alloc();
+    if (msg == NULL)
+        return -ENOMEM;
+    genlmsg_put(msg, nlh->nlmsg_pid, nlh->nlmsg_seq, GENL_ID_CTRL, 0, 0,
+            CTRL_CMD_NEWFAMILY, 1);
+    nla_put_string(msg, CTRL_ATTR_FAMILY_NAME, name);
+    nla_put_u16(msg, CTRL_ATTR_FAMILY_ID, id);
+
+    if (id == FAKE_DRIVER_NL80211_ID) {
+        struct nlattr *groups = nla_nest_start(msg, CTRL_ATTR_MCAST_GROUPS);
+        for (int g = 0; g < HAL_MCGRP_MAX; g++) {
+            struct nlattr *grp = nla_nest_start(msg, g + 1);
+            nla_put_string(msg, CTRL_ATTR_MCAST_GRP_NAME,
+                    event_filter_group_name(g));
+            nla_put_u32(msg, CTRL_ATTR_MCAST_GRP_ID, FAKE_DRIVER_MCGRP_BASE + g);
+            nla_nest_end(msg, grp);
+        }
+        nla_nest_end(msg, groups);
+    }
+
+    queue_reply(msg);
+    return 0;
+}
+
+/* Replaces nl_send() on cmd_sock; the request is answered right away */
+static int fake_send(struct nl_sock *sk, struct nl_msg *msg)
+{
+    struct nlmsghdr *nlh = nlmsg_hdr(msg);
+    struct nlattr *tb[NL80211_ATTR_MAX + 1];
+    int err;
+
+    if (genlmsg_parse(nlh, 0, tb, NL80211_ATTR_MAX, NULL) < 0) {
+        err = -EINVAL;
+    } else if (nlh->nlmsg_type == GENL_ID_CTRL) {
+        err = ctrl_request(nlh, tb);
+    } else if (nlh->nlmsg_type == FAKE_DRIVER_NL80211_ID) {
+        struct genlmsghdr *gnlh = (struct genlmsghdr *)nlmsg_data(nlh);
+        err = gnlh->cmd == NL80211_CMD_VENDOR ? vendor_request(nlh, tb) : 0;
+    } else {
+        err = -EOPNOTSUPP;
+    }
+
+    if (err < 0 || (nlh->nlmsg_flags & NLM_F_ACK))
+        ack(nlh, err);
+    return nlh->nlmsg_len;
+}
+
+/* Replaces the recvmsg() of nl_recvmsgs(); one message per call, like a
+ * netlink socket, and 0 when there is nothing, as if non blocking */
+static int fake_recv(struct nl_sock *sk, struct sockaddr_nl *nla,
+        unsigned char **buf, struct ucred **creds)
+{
+    bool events = sk == fake.info->event_sock;
+    struct nl_msg *msg;
+
+    pthread_mutex_lock(&fake_lock);
+    if (events && fake.overrun) {
+        fake.overrun = false;
+        pthread_mutex_unlock(&fake_lock);
+        /* what libnl makes of recvmsg() failing with ENOBUFS */
+        errno = ENOBUFS;
+        return -NLE_NOMEM;
+    }
+    msg = queue_pop(events ? &fake.events : &fake.replies);
+    pthread_mutex_unlock(&fake_lock);
+
+    if (msg == NULL)
+        return 0;
+
+    struct nlmsghdr *nlh = nlmsg_hdr(msg);
+    int len = nlh->nlmsg_len;
+    *buf = (unsigned char *)malloc(len);
+    if (*buf == NULL) {
+        nlmsg_free(msg);
+        return -NLE_NOMEM;
+    }
+    memcpy(*buf, nlh, len);
+    nlmsg_free(msg);
+
+    memset(nla, 0, sizeof(*nla));
+    nla->nl_family = AF_NETLINK;
+    return len;
+}
+
+static void *stream_thread(void *arg)
+{
+    pthread_mutex_lock(&fake_lock);
+    while (!fake.exit) {
+        uint64_t now = now_ns();
+        uint64_t next = 0;
+
+        for (int i = 0; i < fake.num_streams; i++) {
+            fake_stream *s = &fake.streams[i];
+            if (s->count != 0 && s->sent >= s->count)
+                continue;
+
+            /* catch up on events that fell due while we slept */
+            while (s->next <= now && (s->count == 0 || s->sent < s->count)) {
+                struct nlattr *data;
+                struct nl_msg *msg = fake_driver_msg(s->subcmd, 0, &data);
+                if (msg != NULL) {
+                    if (s->fill != NULL)
+                        s->fill(msg, s->sent, s->arg);
+                    nla_nest_end(msg, data);
+                    queue_event(msg);
+                }
+                s->sent++;
+                s->next += s->period_ns;
+            }
+            if ((s->count == 0 || s->sent < s->count)
+                    && (next == 0 || s->next < next))
+                next = s->next;
+        }
+
+        if (next == 0) {
+            pthread_cond_wait(&fake_cond, &fake_lock);
+        } else {
+            /* the condition waits on CLOCK_REALTIME */
+            struct timespec ts;
+            clock_gettime(CLOCK_REALTIME, &ts);
+            uint64_t wait = next > now_ns() ? next - now_ns() : 0;
+            ts.tv_sec += wait / 1000000000ULL;
+            ts.tv_nsec += wait % 1000000000ULL;
+            if (ts.tv_nsec >= 1000000000L) {
+                ts.tv_sec++;
+                ts.tv_nsec -= 1000000000L;
+            }
+            pthread_cond_timedwait(&fake_cond, &fake_lock, &ts);
+        }
+    }
+    pthread_mutex_unlock(&fake_lock);
+    return NULL;
+}
+
+void fake_driver_configure(const fake_driver_config *config)
+{
+    pthread_mutex_lock(&fake_lock);
+    if (config != NULL)
+        fake.config = *config;
+    else
+        memset(&fake.config, 0, sizeof(fake.config));
+    pthread_mutex_unlock(&fake_lock);
+}
+
+void fake_driver_set_handler(int subcmd, fake_vendor_handler fn, void *arg)
+{
+    if (subcmd < 0 || subcmd >= FAKE_DRIVER_SUBCMDS)
+        return;
+
+    pthread_mutex_lock(&fake_lock);
+    fake.handler[subcmd] = fn;
+    fake.handler_arg[subcmd] = arg;
+    pthread_mutex_unlock(&fake_lock);
+}
+
+wifi_error fake_driver_add_stream(int subcmd, unsigned rate_hz, unsigned count,
+        fake_event_fill fill, void *arg)
+{
+    if (rate_hz == 0)
+        return WIFI_ERROR_INVALID_ARGS;
+
+    pthread_mutex_lock(&fake_lock);
+    if (fake.num_streams == FAKE_DRIVER_MAX_STREAMS) {
+        pthread_mutex_unlock(&fake_lock);
+        return WIFI_ERROR_TOO_MANY_REQUESTS;
+    }
+
+    fake_stream *s = &fake.streams[fake.num_streams++];
+    s->subcmd = subcmd;
+    s->period_ns = 1000000000ULL / rate_hz;
+    s->next = now_ns();
+    s->sent = 0;
+    s->count = count;
+    s->fill = fill;
+    s->arg = arg;
+    pthread_cond_signal(&fake_cond);
+    pthread_mutex_unlock(&fake_lock);
+    return WIFI_SUCCESS;
+}
+
+void fake_driver_stop_streams()
+{
+    pthread_mutex_lock(&fake_lock);
+    fake.num_streams = 0;
+    pthread_mutex_unlock(&fake_lock);
+}
+
+static void override_sock(struct nl_sock *sock, struct nl_cb *cb)
+{
+    struct nl_cb *s_cb = nl_socket_get_cb(sock);
+    nl_cb_overwrite_send(s_cb, fake_send);
+    nl_cb_overwrite_recv(s_cb, fake_recv);
+    nl_cb_put(s_cb);
+
+    if (cb != NULL)
+        nl_cb_overwrite_recv(cb, fake_recv);
+}
+
+static wifi_error fake_attach(hal_info *info)
+{
+    fake.replies.fd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    fake.events.fd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    if (fake.replies.fd < 0 || fake.events.fd < 0) {
+        ALOGE("Could not create fake driver queues: %s", strerror(errno));
+        if (fake.replies.fd >= 0)
+            close(fake.replies.fd);
+        if (fake.events.fd >= 0)
+            close(fake.events.fd);
+        return WIFI_ERROR_UNKNOWN;
+    }
+
+    fake.info = info;
+    fake.overrun = false;
+    fake.exit = false;
+    override_sock(info->cmd_sock, info->cmd_sock_cb);
+    override_sock(info->event_sock, info->event_sock_cb);
+
+    if (pthread_create(&fake.thread, NULL, stream_thread, NULL) != 0) {
+        ALOGE("Could not start fake driver thread");
+    } else {
+        fake.running = true;
+    }
+
+    ALOGI("Using fake driver, interface %s",
+            fake.config.iface ? fake.config.iface : "wlan0");
+    return WIFI_SUCCESS;
+}
+
+static void fake_detach(hal_info *info)
+{
+    if (fake.running) {
+        pthread_mutex_lock(&fake_lock);
+        fake.exit = true;
+        pthread_cond_signal(&fake_cond);
+        pthread_mutex_unlock(&fake_lock);
+        pthread_join(fake.thread, NULL);
+        fake.running = false;
+    }
+
+    pthread_mutex_lock(&fake_lock);
+    queue_flush(&fake.replies);
+    queue_flush(&fake.events);
+    fake.num_streams = 0;
+    pthread_mutex_unlock(&fake_lock);
+
+    close(fake.replies.fd);
+    close(fake.events.fd);
+    fake.info = NULL;
+}
+
+static int fake_get_fd(hal_info *info, struct nl_sock *sock)
+{
+    return sock == info->event_sock ? fake.events.fd : fake.replies.fd;
+}
+
+static void fake_scan_ifaces(hal_info *info,
+        void (*add)(hal_info *info, const char *name, int ifindex))
+{
+    add(info, fake.config.iface ? fake.config.iface : "wlan0",
+            FAKE_DRIVER_IFINDEX);
+}
+
+const hal_transport_ops fake_driver_transport = {
+    "fake",
+    fake_attach,
+    fake_detach,
+    fake_get_fd,
+    fake_scan_ifaces,
+};
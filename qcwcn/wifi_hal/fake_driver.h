@@ -0,0 +1,94 @@
+/*
+ * Copyright (C) 2014 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef __WIFI_HAL_FAKE_DRIVER_H__
+#define __WIFI_HAL_FAKE_DRIVER_H__
+
+#include "common.h"
+#include "hal_transport.h"
+
+/*
+ * In-process stand-in for nl80211 and the QCA vendor commands, so that the
+ * whole HAL runs on a Linux host without wifi hardware:
+ *
+ *     fake_driver_configure(&config);
+ *     wifi_set_transport(&fake_driver_transport);
+ *     wifi_initialize(&handle);
+ *
+ * It resolves the nl80211 family and its multicast groups, reports one
+ * interface, acknowledges every request and answers the feature set,
+ * concurrency matrix, TDLS, gscan configuration and capability, LL stats
+ * and NAN subcommands the way the driver does; everything else is just
+ * acknowledged. fake_driver_set_handler() replaces the answer to a
+ * subcommand and fake_driver_add_stream() emits vendor events at a given
+ * rate from a thread of the fake driver.
+ *
+ * Replies and events wait in queues until the HAL reads them, one message
+ * per read as from a socket. Once FAKE_DRIVER_EVENT_QUEUE events are
+ * waiting, further ones are dropped and the next read of event_sock fails
+ * the way a full socket does, with ENOBUFS.
+ */
+
+#define FAKE_DRIVER_NL80211_ID  (0x1c)
+#define FAKE_DRIVER_IFINDEX     (1000)
+#define FAKE_DRIVER_MAX_STREAMS (16)
+#define FAKE_DRIVER_EVENT_QUEUE (1024)
+
+typedef struct {
+    const char *iface;                              // interface name, "wlan0" if NULL
+    uint32_t features;                              // GET_SUPPORTED_FEATURES answer
+    unsigned event_queue;                           // 0 for FAKE_DRIVER_EVENT_QUEUE
+} fake_driver_config;
+
+/* A vendor request as the fake driver received it */
+typedef struct {
+    int subcmd;
+    int ifindex;                                    // 0 if none was given
+    struct nlattr *data;                            // NL80211_ATTR_VENDOR_DATA
+    int len;                                        // ... and its length
+    uint32_t seq;
+    uint32_t port;
+} fake_request;
+
+/* Answers req; 0 to acknowledge it, else a negative errno to fail it */
+typedef int (*fake_vendor_handler)(const fake_request *req, void *arg);
+/* Adds attributes to the vendor data of event n of a stream */
+typedef void (*fake_event_fill)(struct nl_msg *msg, uint32_t n, void *arg);
+
+extern const hal_transport_ops fake_driver_transport;
+
+/* Applies to the next attach; NULL restores the defaults */
+void fake_driver_configure(const fake_driver_config *config);
+
+/* Replaces the answer to a vendor subcommand; fn NULL restores it */
+void fake_driver_set_handler(int subcmd, fake_vendor_handler fn, void *arg);
+
+/* Starts a vendor message from the driver with the vendor data nest
+ * opened; add attributes, then queue it with one of the two below */
+struct nl_msg *fake_driver_msg(int subcmd, int ifindex, struct nlattr **data);
+/* Queues msg as a reply to req; only valid within a handler */
+void fake_driver_reply(const fake_request *req, struct nl_msg *msg,
+        struct nlattr *data);
+/* Queues msg as an event on event_sock */
+void fake_driver_event(struct nl_msg *msg, struct nlattr *data);
+
+/* Emits count events of subcmd, 0 for no limit, at rate_hz; fill may be
+ * NULL for empty vendor data */
+wifi_error fake_driver_add_stream(int subcmd, unsigned rate_hz, unsigned count,
+        fake_event_fill fill, void *arg);
+void fake_driver_stop_streams();
+
+#endif /* __WIFI_HAL_FAKE_DRIVER_H__ */
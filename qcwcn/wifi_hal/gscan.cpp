@@ -23,6 +23,7 @@
 #include "cpp_bindings.h"
 #include "gscancommand.h"
 #include "gscan_event_handler.h"
+#include "cap_snapshot.h"
 
 #define GSCAN_EVENT_WAIT_TIME_SECONDS 4
 
@@ -45,7 +46,7 @@ wifi_error wifi_get_valid_channels(wifi_interface_handle handle,
     hal_info *info = getHalInfo(wifiHandle);
 
     ALOGI("GSCAN : Get valid channels");
-    if (!(info->supported_feature_set & WIFI_FEATURE_GSCAN)) {
+    if (!(hal_feature_set(info) & WIFI_FEATURE_GSCAN)) {
         ALOGE("%s: GSCAN is not supported by driver",
             __func__);
         return WIFI_ERROR_NOT_SUPPORTED;
@@ -113,7 +114,7 @@ wifi_error wifi_get_valid_channels(wifi_interface_handle handle,
 
 cleanup:
     ALOGI("%s: Delete object.", __func__);
-    delete gScanCommand;
+    gScanCommand->release();
     return (wifi_error)ret;
 }
 
@@ -150,7 +151,7 @@ wifi_error wifi_get_gscan_capabilities(wifi_interface_handle handle,
     hal_info *info = getHalInfo(wifiHandle);
 
     ALOGI("GSCAN : Get Capabilities");
-    if (!(info->supported_feature_set & WIFI_FEATURE_GSCAN)) {
+    if (!(hal_feature_set(info) & WIFI_FEATURE_GSCAN)) {
         ALOGE("%s: GSCAN is not supported by driver",
             __func__);
         return WIFI_ERROR_NOT_SUPPORTED;
@@ -163,6 +164,14 @@ wifi_error wifi_get_gscan_capabilities(wifi_interface_handle handle,
         return WIFI_ERROR_INVALID_ARGS;
     }
 
+    if (cap_snapshot_get(info, CAP_GSCAN, 0, 0, capabilities,
+                sizeof(*capabilities)) == sizeof(*capabilities)) {
+        /* validateGscanConfig() checks against these */
+        memcpy(&Capabilities, capabilities, sizeof(wifi_gscan_capabilities));
+        CapabilitiesUpdated = true;
+        return WIFI_SUCCESS;
+    }
+
     /* No request id from caller, so generate one and pass it on to the driver.
      * Generate it randomly.
      */
@@ -224,11 +233,14 @@ wifi_error wifi_get_gscan_capabilities(wifi_interface_handle handle,
     }
 
     gScanCommand->getGetCapabilitiesRspParams(capabilities, (u32 *)&ret);
+    if (ret == 0)
+        cap_snapshot_put(info, CAP_GSCAN, 0, 0, capabilities,
+                sizeof(*capabilities));
 
 cleanup:
     gScanCommand->freeRspParams(eGScanGetCapabilitiesRspParams);
     ALOGI("%s: Delete object.", __func__);
-    delete gScanCommand;
+    gScanCommand->release();
     return (wifi_error)ret;
 }
 
@@ -364,13 +376,13 @@ wifi_error wifi_start_gscan(wifi_request_id id,
     interface_info *ifaceInfo = getIfaceInfo(iface);
     wifi_handle wifiHandle = getWifiHandle(iface);
     u32 num_scan_buckets, numChannelSpecs;
-    wifi_scan_bucket_spec bucketSpec;
+    wifi_scan_bucket_spec *bucketSpec;
     struct nlattr *nlBuckectSpecList;
     bool previousGScanRunning = false;
     hal_info *info = getHalInfo(wifiHandle);
 
     ALOGI("GSCAN : start");
-    if (!(info->supported_feature_set & WIFI_FEATURE_GSCAN)) {
+    if (!(hal_feature_set(info) & WIFI_FEATURE_GSCAN)) {
         ALOGE("%s: GSCAN is not supported by driver",
             __func__);
         return WIFI_ERROR_NOT_SUPPORTED;
@@ -405,6 +417,29 @@ wifi_error wifi_start_gscan(wifi_request_id id,
     if (ret < 0)
         goto cleanup;
 
+    num_scan_buckets = (unsigned int)params.num_buckets > MAX_BUCKETS ?
+                            MAX_BUCKETS : params.num_buckets;
+
+    /* Size the NL message for the whole bucket/channel spec up front; a
+     * large configuration does not fit the default buffer. */
+    {
+        WifiRequestSize size;
+        size.vendor_cmd().attr_start();
+        size.put_u32().put_u32().put_u32().put_u8().put_u8();
+        size.attr_start();
+        for (i = 0; i < num_scan_buckets; i++) {
+            numChannelSpecs =
+                (unsigned int)params.buckets[i].num_channels > MAX_CHANNELS ?
+                    MAX_CHANNELS : params.buckets[i].num_channels;
+            size.attr_start();
+            size.put_u8().put_u8().put_u32().put_u8().put_u32();
+            size.attr_start();
+            for (j = 0; j < numChannelSpecs; j++)
+                size.attr_start().put_u32().put_u32().put_u8();
+        }
+        gScanCommand->set_size_hint(size.size());
+    }
+
     /* Create the NL message. */
     ret = gScanCommand->create();
     if (ret < 0)
@@ -416,88 +451,72 @@ wifi_error wifi_start_gscan(wifi_request_id id,
         goto cleanup;
 
     /* Add the vendor specific attributes for the NL command. */
-    nlData = gScanCommand->attr_start(NL80211_ATTR_VENDOR_DATA);
-    if (!nlData)
-        goto cleanup;
-
-    num_scan_buckets = (unsigned int)params.num_buckets > MAX_BUCKETS ?
-                            MAX_BUCKETS : params.num_buckets;
-
-    if (gScanCommand->put_u32(
-            QCA_WLAN_VENDOR_ATTR_GSCAN_SUBCMD_CONFIG_PARAM_REQUEST_ID,
-            id) ||
-        gScanCommand->put_u32(
-            QCA_WLAN_VENDOR_ATTR_GSCAN_SCAN_CMD_PARAMS_BASE_PERIOD,
-            params.base_period) ||
-        gScanCommand->put_u32(
-            QCA_WLAN_VENDOR_ATTR_GSCAN_SCAN_CMD_PARAMS_MAX_AP_PER_SCAN,
-            params.max_ap_per_scan) ||
-        gScanCommand->put_u8(
-            QCA_WLAN_VENDOR_ATTR_GSCAN_SCAN_CMD_PARAMS_REPORT_THRESHOLD,
-            params.report_threshold) ||
-        gScanCommand->put_u8(
-            QCA_WLAN_VENDOR_ATTR_GSCAN_SCAN_CMD_PARAMS_NUM_BUCKETS,
-            num_scan_buckets))
     {
-        goto cleanup;
-    }
-
-    nlBuckectSpecList =
-        gScanCommand->attr_start(QCA_WLAN_VENDOR_ATTR_GSCAN_BUCKET_SPEC);
-    /* Add NL attributes for scan bucket specs . */
-    for (i = 0; i < num_scan_buckets; i++) {
-        bucketSpec = params.buckets[i];
-        numChannelSpecs = (unsigned int)bucketSpec.num_channels > MAX_CHANNELS ?
-                                MAX_CHANNELS : bucketSpec.num_channels;
-        struct nlattr *nlBucketSpec = gScanCommand->attr_start(i);
-        if (gScanCommand->put_u8(
-                QCA_WLAN_VENDOR_ATTR_GSCAN_BUCKET_SPEC_INDEX,
-                bucketSpec.bucket) ||
-            gScanCommand->put_u8(
-                QCA_WLAN_VENDOR_ATTR_GSCAN_BUCKET_SPEC_BAND,
-                bucketSpec.band) ||
-            gScanCommand->put_u32(
-                QCA_WLAN_VENDOR_ATTR_GSCAN_BUCKET_SPEC_PERIOD,
-                bucketSpec.period) ||
-            gScanCommand->put_u8(
-                QCA_WLAN_VENDOR_ATTR_GSCAN_BUCKET_SPEC_REPORT_EVENTS,
-                bucketSpec.report_events) ||
-            gScanCommand->put_u32(
-                QCA_WLAN_VENDOR_ATTR_GSCAN_BUCKET_SPEC_NUM_CHANNEL_SPECS,
-                numChannelSpecs))
-        {
-            goto cleanup;
-        }
-
-        struct nlattr *nl_channelSpecList =
-            gScanCommand->attr_start(QCA_WLAN_VENDOR_ATTR_GSCAN_CHANNEL_SPEC);
-
-        /* Add NL attributes for scan channel specs . */
-        for (j = 0; j < numChannelSpecs; j++) {
-            struct nlattr *nl_channelSpec = gScanCommand->attr_start(j);
-            wifi_scan_channel_spec channel_spec = bucketSpec.channels[j];
-
-            if ( gScanCommand->put_u32(
-                    QCA_WLAN_VENDOR_ATTR_GSCAN_CHANNEL_SPEC_CHANNEL,
-                    channel_spec.channel) ||
-                gScanCommand->put_u32(
-                    QCA_WLAN_VENDOR_ATTR_GSCAN_CHANNEL_SPEC_DWELL_TIME,
-                    channel_spec.dwellTimeMs) ||
-                gScanCommand->put_u8(
-                    QCA_WLAN_VENDOR_ATTR_GSCAN_CHANNEL_SPEC_PASSIVE,
-                    channel_spec.passive) )
-            {
-                goto cleanup;
+        WifiAttrBuilder msg = gScanCommand->builder();
+
+        nlData = msg.attr_start(NL80211_ATTR_VENDOR_DATA);
+        msg.put_u32(QCA_WLAN_VENDOR_ATTR_GSCAN_SUBCMD_CONFIG_PARAM_REQUEST_ID,
+                id)
+           .put_u32(QCA_WLAN_VENDOR_ATTR_GSCAN_SCAN_CMD_PARAMS_BASE_PERIOD,
+                params.base_period)
+           .put_u32(QCA_WLAN_VENDOR_ATTR_GSCAN_SCAN_CMD_PARAMS_MAX_AP_PER_SCAN,
+                params.max_ap_per_scan)
+           .put_u8(QCA_WLAN_VENDOR_ATTR_GSCAN_SCAN_CMD_PARAMS_REPORT_THRESHOLD,
+                params.report_threshold)
+           .put_u8(QCA_WLAN_VENDOR_ATTR_GSCAN_SCAN_CMD_PARAMS_NUM_BUCKETS,
+                num_scan_buckets);
+
+        nlBuckectSpecList =
+            msg.attr_start(QCA_WLAN_VENDOR_ATTR_GSCAN_BUCKET_SPEC);
+        /* Add NL attributes for scan bucket specs . */
+        for (i = 0; i < num_scan_buckets; i++) {
+            bucketSpec = &params.buckets[i];
+            numChannelSpecs =
+                (unsigned int)bucketSpec->num_channels > MAX_CHANNELS ?
+                    MAX_CHANNELS : bucketSpec->num_channels;
+            struct nlattr *nlBucketSpec = msg.attr_start(i);
+            msg.put_u8(QCA_WLAN_VENDOR_ATTR_GSCAN_BUCKET_SPEC_INDEX,
+                    bucketSpec->bucket)
+               .put_u8(QCA_WLAN_VENDOR_ATTR_GSCAN_BUCKET_SPEC_BAND,
+                    bucketSpec->band)
+               .put_u32(QCA_WLAN_VENDOR_ATTR_GSCAN_BUCKET_SPEC_PERIOD,
+                    bucketSpec->period)
+               .put_u8(QCA_WLAN_VENDOR_ATTR_GSCAN_BUCKET_SPEC_REPORT_EVENTS,
+                    bucketSpec->report_events)
+               .put_u32(
+                    QCA_WLAN_VENDOR_ATTR_GSCAN_BUCKET_SPEC_NUM_CHANNEL_SPECS,
+                    numChannelSpecs);
+
+            struct nlattr *nl_channelSpecList =
+                msg.attr_start(QCA_WLAN_VENDOR_ATTR_GSCAN_CHANNEL_SPEC);
+
+            /* Add NL attributes for scan channel specs . */
+            for (j = 0; j < numChannelSpecs; j++) {
+                struct nlattr *nl_channelSpec = msg.attr_start(j);
+                wifi_scan_channel_spec *channel_spec =
+                    &bucketSpec->channels[j];
+
+                msg.put_u32(QCA_WLAN_VENDOR_ATTR_GSCAN_CHANNEL_SPEC_CHANNEL,
+                        channel_spec->channel)
+                   .put_u32(QCA_WLAN_VENDOR_ATTR_GSCAN_CHANNEL_SPEC_DWELL_TIME,
+                        channel_spec->dwellTimeMs)
+                   .put_u8(QCA_WLAN_VENDOR_ATTR_GSCAN_CHANNEL_SPEC_PASSIVE,
+                        channel_spec->passive);
+                msg.attr_end(nl_channelSpec);
             }
+            msg.attr_end(nl_channelSpecList);
+            msg.attr_end(nlBucketSpec);
+        }
+        msg.attr_end(nlBuckectSpecList);
+        msg.attr_end(nlData);
 
-            gScanCommand->attr_end(nl_channelSpec);
+        if (msg.failed()) {
+            ALOGE("wifi_start_gscan(): the scan spec does not fit the "
+                "request");
+            ret = WIFI_ERROR_OUT_OF_MEMORY;
+            goto cleanup;
         }
-        gScanCommand->attr_end(nl_channelSpecList);
-        gScanCommand->attr_end(nlBucketSpec);
     }
-    gScanCommand->attr_end(nlBuckectSpecList);
-
-    gScanCommand->attr_end(nlData);
 
     ret = gScanCommand->allocRspParams(eGScanStartRspParams);
     if (ret != 0) {
@@ -551,12 +570,12 @@ wifi_error wifi_start_gscan(wifi_request_id id,
 cleanup:
     gScanCommand->freeRspParams(eGScanStartRspParams);
     ALOGI("wifi_start_gscan(): Delete object.");
-    delete gScanCommand;
+    gScanCommand->release();
     /* Delete the command event handler object if ret != 0 */
     if (!previousGScanRunning && ret && GScanStartCmdEventHandler) {
         ALOGI("wifi_start_gscan(): Error ret:%d, delete event handler object.",
             ret);
-        delete GScanStartCmdEventHandler;
+        GScanStartCmdEventHandler->release();
         GScanStartCmdEventHandler = NULL;
     }
     return (wifi_error)ret;
@@ -580,7 +599,7 @@ wifi_error wifi_stop_gscan(wifi_request_id id,
     hal_info *info = getHalInfo(wifiHandle);
 
     ALOGI("GSCAN : stop, halHandle = %p", wifiHandle);
-    if (!(info->supported_feature_set & WIFI_FEATURE_GSCAN)) {
+    if (!(hal_feature_set(info) & WIFI_FEATURE_GSCAN)) {
         ALOGE("%s: GSCAN is not supported by driver",
             __func__);
         return WIFI_ERROR_NOT_SUPPORTED;
@@ -649,7 +668,7 @@ wifi_error wifi_stop_gscan(wifi_request_id id,
             /* Delete different GSCAN event handlers for the
                specified Request ID. */
             if (GScanStartCmdEventHandler) {
-                delete GScanStartCmdEventHandler;
+                GScanStartCmdEventHandler->release();
                 GScanStartCmdEventHandler = NULL;
             }
         }
@@ -664,14 +683,14 @@ wifi_error wifi_stop_gscan(wifi_request_id id,
 
     /* Delete different GSCAN event handlers for the specified Request ID. */
     if (GScanStartCmdEventHandler) {
-        delete GScanStartCmdEventHandler;
+        GScanStartCmdEventHandler->release();
         GScanStartCmdEventHandler = NULL;
     }
 
 cleanup:
     gScanCommand->freeRspParams(eGScanStopRspParams);
     ALOGI("%s: Delete object.", __func__);
-    delete gScanCommand;
+    gScanCommand->release();
     return (wifi_error)ret;
 }
 
@@ -716,7 +735,7 @@ wifi_error wifi_set_bssid_hotlist(wifi_request_id id,
     hal_info *info = getHalInfo(wifiHandle);
 
     ALOGD("GSCAN : set BSSID hotlist, halHandle = %p", wifiHandle);
-    if (!(info->supported_feature_set & WIFI_FEATURE_GSCAN)) {
+    if (!(hal_feature_set(info) & WIFI_FEATURE_GSCAN)) {
         ALOGE("%s: GSCAN is not supported by driver",
             __func__);
         return WIFI_ERROR_NOT_SUPPORTED;
@@ -754,6 +773,20 @@ wifi_error wifi_set_bssid_hotlist(wifi_request_id id,
     if (ret < 0)
         goto cleanup;
 
+    numAp = (unsigned int)params.num_ap > MAX_HOTLIST_APS ?
+        MAX_HOTLIST_APS : params.num_ap;
+
+    /* Size the NL message for the whole AP list up front. */
+    {
+        WifiRequestSize size;
+        size.vendor_cmd().attr_start();
+        size.put_u32().put_u32().put_u32();
+        size.attr_start();
+        for (i = 0; i < numAp; i++)
+            size.attr_start().put_addr().put_u32().put_u32().put_u32();
+        gScanCommand->set_size_hint(size.size());
+    }
+
     /* Create the NL message. */
     ret = gScanCommand->create();
     if (ret < 0)
@@ -765,60 +798,45 @@ wifi_error wifi_set_bssid_hotlist(wifi_request_id id,
         goto cleanup;
 
     /* Add the vendor specific attributes for the NL command. */
-    nlData = gScanCommand->attr_start(NL80211_ATTR_VENDOR_DATA);
-    if (!nlData)
-        goto cleanup;
-
-    numAp = (unsigned int)params.num_ap > MAX_HOTLIST_APS ?
-        MAX_HOTLIST_APS : params.num_ap;
-    if (gScanCommand->put_u32(
-            QCA_WLAN_VENDOR_ATTR_GSCAN_SUBCMD_CONFIG_PARAM_REQUEST_ID,
-            id) ||
-        gScanCommand->put_u32(
-            QCA_WLAN_VENDOR_ATTR_GSCAN_BSSID_HOTLIST_PARAMS_LOST_AP_SAMPLE_SIZE,
-            params.lost_ap_sample_size) ||
-        gScanCommand->put_u32(
-            QCA_WLAN_VENDOR_ATTR_GSCAN_BSSID_HOTLIST_PARAMS_NUM_AP,
-            numAp))
     {
-        goto cleanup;
-    }
-
-    /* Add the vendor specific attributes for the NL command. */
-    nlApThresholdParamList =
-        gScanCommand->attr_start(
-                                QCA_WLAN_VENDOR_ATTR_GSCAN_AP_THRESHOLD_PARAM);
-    if (!nlApThresholdParamList)
-        goto cleanup;
+        WifiAttrBuilder msg = gScanCommand->builder();
+
+        nlData = msg.attr_start(NL80211_ATTR_VENDOR_DATA);
+        msg.put_u32(QCA_WLAN_VENDOR_ATTR_GSCAN_SUBCMD_CONFIG_PARAM_REQUEST_ID,
+                id)
+           .put_u32(
+               QCA_WLAN_VENDOR_ATTR_GSCAN_BSSID_HOTLIST_PARAMS_LOST_AP_SAMPLE_SIZE,
+                params.lost_ap_sample_size)
+           .put_u32(QCA_WLAN_VENDOR_ATTR_GSCAN_BSSID_HOTLIST_PARAMS_NUM_AP,
+                numAp);
+
+        nlApThresholdParamList =
+            msg.attr_start(QCA_WLAN_VENDOR_ATTR_GSCAN_AP_THRESHOLD_PARAM);
+        /* Add nested NL attributes for AP Threshold Param list. */
+        for (i = 0; i < numAp; i++) {
+            ap_threshold_param *apThreshold = &params.ap[i];
+            struct nlattr *nlApThresholdParam = msg.attr_start(i);
+
+            msg.put_addr(QCA_WLAN_VENDOR_ATTR_GSCAN_AP_THRESHOLD_PARAM_BSSID,
+                    apThreshold->bssid)
+               .put_s32(QCA_WLAN_VENDOR_ATTR_GSCAN_AP_THRESHOLD_PARAM_RSSI_LOW,
+                    apThreshold->low)
+               .put_s32(QCA_WLAN_VENDOR_ATTR_GSCAN_AP_THRESHOLD_PARAM_RSSI_HIGH,
+                    apThreshold->high)
+               .put_u32(QCA_WLAN_VENDOR_ATTR_GSCAN_AP_THRESHOLD_PARAM_CHANNEL,
+                    apThreshold->channel);
+            msg.attr_end(nlApThresholdParam);
+        }
+        msg.attr_end(nlApThresholdParamList);
+        msg.attr_end(nlData);
 
-    /* Add nested NL attributes for AP Threshold Param. */
-    for (i = 0; i < numAp; i++) {
-        ap_threshold_param apThreshold = params.ap[i];
-        struct nlattr *nlApThresholdParam = gScanCommand->attr_start(i);
-        if (!nlApThresholdParam)
-            goto cleanup;
-        if (gScanCommand->put_addr(
-                QCA_WLAN_VENDOR_ATTR_GSCAN_AP_THRESHOLD_PARAM_BSSID,
-                apThreshold.bssid) ||
-            gScanCommand->put_s32(
-                QCA_WLAN_VENDOR_ATTR_GSCAN_AP_THRESHOLD_PARAM_RSSI_LOW,
-                apThreshold.low) ||
-            gScanCommand->put_s32(
-                QCA_WLAN_VENDOR_ATTR_GSCAN_AP_THRESHOLD_PARAM_RSSI_HIGH,
-                apThreshold.high) ||
-            gScanCommand->put_u32(
-                QCA_WLAN_VENDOR_ATTR_GSCAN_AP_THRESHOLD_PARAM_CHANNEL,
-                apThreshold.channel))
-        {
+        if (msg.failed()) {
+            ALOGE("%s: the hotlist does not fit the request", __func__);
+            ret = WIFI_ERROR_OUT_OF_MEMORY;
             goto cleanup;
         }
-        gScanCommand->attr_end(nlApThresholdParam);
     }
 
-    gScanCommand->attr_end(nlApThresholdParamList);
-
-    gScanCommand->attr_end(nlData);
-
     ret = gScanCommand->allocRspParams(eGScanSetBssidHotlistRspParams);
     if (ret != 0) {
         ALOGE("%s: Failed to allocate memory to the response struct. "
@@ -872,11 +890,11 @@ wifi_error wifi_set_bssid_hotlist(wifi_request_id id,
 cleanup:
     gScanCommand->freeRspParams(eGScanSetBssidHotlistRspParams);
     ALOGI("%s: Delete object. ", __func__);
-    delete gScanCommand;
+    gScanCommand->release();
     /* Delete the command event handler object if ret != 0 */
     if (!previousGScanSetBssidRunning && ret
         && GScanSetBssidHotlistCmdEventHandler) {
-        delete GScanSetBssidHotlistCmdEventHandler;
+        GScanSetBssidHotlistCmdEventHandler->release();
         GScanSetBssidHotlistCmdEventHandler = NULL;
     }
     return (wifi_error)ret;
@@ -898,7 +916,7 @@ wifi_error wifi_reset_bssid_hotlist(wifi_request_id id,
     hal_info *info = getHalInfo(wifiHandle);
 
     ALOGI("GSCAN: Reset BSSID Hotlist, halHandle = %p", wifiHandle);
-    if (!(info->supported_feature_set & WIFI_FEATURE_GSCAN)) {
+    if (!(hal_feature_set(info) & WIFI_FEATURE_GSCAN)) {
         ALOGE("%s: GSCAN is not supported by driver",
             __func__);
         return WIFI_ERROR_NOT_SUPPORTED;
@@ -965,7 +983,7 @@ wifi_error wifi_reset_bssid_hotlist(wifi_request_id id,
         if (ret == ETIMEDOUT)
         {
             if (GScanSetBssidHotlistCmdEventHandler) {
-                delete GScanSetBssidHotlistCmdEventHandler;
+                GScanSetBssidHotlistCmdEventHandler->release();
                 GScanSetBssidHotlistCmdEventHandler = NULL;
             }
         }
@@ -978,14 +996,14 @@ wifi_error wifi_reset_bssid_hotlist(wifi_request_id id,
         goto cleanup;
     }
     if (GScanSetBssidHotlistCmdEventHandler) {
-        delete GScanSetBssidHotlistCmdEventHandler;
+        GScanSetBssidHotlistCmdEventHandler->release();
         GScanSetBssidHotlistCmdEventHandler = NULL;
     }
 
 cleanup:
     gScanCommand->freeRspParams(eGScanResetBssidHotlistRspParams);
     ALOGI("%s: Delete object.", __func__);
-    delete gScanCommand;
+    gScanCommand->release();
     return (wifi_error)ret;
 }
 
@@ -1059,7 +1077,7 @@ wifi_error wifi_set_significant_change_handler(wifi_request_id id,
     hal_info *info = getHalInfo(wifiHandle);
 
     ALOGE("GSCAN: Set Significant Change, halHandle = %p", wifiHandle);
-    if (!(info->supported_feature_set & WIFI_FEATURE_GSCAN)) {
+    if (!(hal_feature_set(info) & WIFI_FEATURE_GSCAN)) {
         ALOGE("%s: GSCAN is not supported by driver",
             __func__);
         return WIFI_ERROR_NOT_SUPPORTED;
@@ -1095,6 +1113,20 @@ wifi_error wifi_set_significant_change_handler(wifi_request_id id,
     if (ret < 0)
         goto cleanup;
 
+    numAp = (unsigned int)params.num_ap > MAX_SIGNIFICANT_CHANGE_APS ?
+        MAX_SIGNIFICANT_CHANGE_APS : params.num_ap;
+
+    /* Size the NL message for the whole AP list up front. */
+    {
+        WifiRequestSize size;
+        size.vendor_cmd().attr_start();
+        size.put_u32().put_u32().put_u32().put_u32().put_u32();
+        size.attr_start();
+        for (i = 0; i < numAp; i++)
+            size.attr_start().put_addr().put_u32().put_u32().put_u32();
+        gScanCommand->set_size_hint(size.size());
+    }
+
     /* Create the NL message. */
     ret = gScanCommand->create();
     if (ret < 0)
@@ -1106,67 +1138,51 @@ wifi_error wifi_set_significant_change_handler(wifi_request_id id,
         goto cleanup;
 
     /* Add the vendor specific attributes for the NL command. */
-    nlData = gScanCommand->attr_start(NL80211_ATTR_VENDOR_DATA);
-    if (!nlData)
-        goto cleanup;
-
-    numAp = (unsigned int)params.num_ap > MAX_SIGNIFICANT_CHANGE_APS ?
-        MAX_SIGNIFICANT_CHANGE_APS : params.num_ap;
-
-    if (gScanCommand->put_u32(
-            QCA_WLAN_VENDOR_ATTR_GSCAN_SUBCMD_CONFIG_PARAM_REQUEST_ID,
-            id) ||
-        gScanCommand->put_u32(
-        QCA_WLAN_VENDOR_ATTR_GSCAN_SIGNIFICANT_CHANGE_PARAMS_RSSI_SAMPLE_SIZE,
-            params.rssi_sample_size) ||
-        gScanCommand->put_u32(
-        QCA_WLAN_VENDOR_ATTR_GSCAN_SIGNIFICANT_CHANGE_PARAMS_LOST_AP_SAMPLE_SIZE,
-            params.lost_ap_sample_size) ||
-        gScanCommand->put_u32(
-            QCA_WLAN_VENDOR_ATTR_GSCAN_SIGNIFICANT_CHANGE_PARAMS_MIN_BREACHING,
-            params.min_breaching) ||
-        gScanCommand->put_u32(
-            QCA_WLAN_VENDOR_ATTR_GSCAN_SIGNIFICANT_CHANGE_PARAMS_NUM_AP,
-            numAp))
     {
-        goto cleanup;
-    }
-
-    /* Add the vendor specific attributes for the NL command. */
-    nlApThresholdParamList =
-        gScanCommand->attr_start(
-                                QCA_WLAN_VENDOR_ATTR_GSCAN_AP_THRESHOLD_PARAM);
-    if (!nlApThresholdParamList)
-        goto cleanup;
+        WifiAttrBuilder msg = gScanCommand->builder();
+
+        nlData = msg.attr_start(NL80211_ATTR_VENDOR_DATA);
+        msg.put_u32(QCA_WLAN_VENDOR_ATTR_GSCAN_SUBCMD_CONFIG_PARAM_REQUEST_ID,
+                id)
+           .put_u32(
+               QCA_WLAN_VENDOR_ATTR_GSCAN_SIGNIFICANT_CHANGE_PARAMS_RSSI_SAMPLE_SIZE,
+                params.rssi_sample_size)
+           .put_u32(
+               QCA_WLAN_VENDOR_ATTR_GSCAN_SIGNIFICANT_CHANGE_PARAMS_LOST_AP_SAMPLE_SIZE,
+                params.lost_ap_sample_size)
+           .put_u32(
+               QCA_WLAN_VENDOR_ATTR_GSCAN_SIGNIFICANT_CHANGE_PARAMS_MIN_BREACHING,
+                params.min_breaching)
+           .put_u32(QCA_WLAN_VENDOR_ATTR_GSCAN_SIGNIFICANT_CHANGE_PARAMS_NUM_AP,
+                numAp);
+
+        nlApThresholdParamList =
+            msg.attr_start(QCA_WLAN_VENDOR_ATTR_GSCAN_AP_THRESHOLD_PARAM);
+        /* Add nested NL attributes for AP Threshold Param list. */
+        for (i = 0; i < numAp; i++) {
+            ap_threshold_param *apThreshold = &params.ap[i];
+            struct nlattr *nlApThresholdParam = msg.attr_start(i);
+
+            msg.put_addr(QCA_WLAN_VENDOR_ATTR_GSCAN_AP_THRESHOLD_PARAM_BSSID,
+                    apThreshold->bssid)
+               .put_s32(QCA_WLAN_VENDOR_ATTR_GSCAN_AP_THRESHOLD_PARAM_RSSI_LOW,
+                    apThreshold->low)
+               .put_s32(QCA_WLAN_VENDOR_ATTR_GSCAN_AP_THRESHOLD_PARAM_RSSI_HIGH,
+                    apThreshold->high)
+               .put_u32(QCA_WLAN_VENDOR_ATTR_GSCAN_AP_THRESHOLD_PARAM_CHANNEL,
+                    apThreshold->channel);
+            msg.attr_end(nlApThresholdParam);
+        }
+        msg.attr_end(nlApThresholdParamList);
+        msg.attr_end(nlData);
 
-    /* Add nested NL attributes for AP Threshold Param list. */
-    for (i = 0; i < numAp; i++) {
-        ap_threshold_param apThreshold = params.ap[i];
-        struct nlattr *nlApThresholdParam = gScanCommand->attr_start(i);
-        if (!nlApThresholdParam)
-            goto cleanup;
-        if ( gScanCommand->put_addr(
-                QCA_WLAN_VENDOR_ATTR_GSCAN_AP_THRESHOLD_PARAM_BSSID,
-                apThreshold.bssid) ||
-            gScanCommand->put_s32(
-                QCA_WLAN_VENDOR_ATTR_GSCAN_AP_THRESHOLD_PARAM_RSSI_LOW,
-                apThreshold.low) ||
-            gScanCommand->put_s32(
-                QCA_WLAN_VENDOR_ATTR_GSCAN_AP_THRESHOLD_PARAM_RSSI_HIGH,
-                apThreshold.high) ||
-            gScanCommand->put_u32(
-                QCA_WLAN_VENDOR_ATTR_GSCAN_AP_THRESHOLD_PARAM_CHANNEL,
-                apThreshold.channel) )
-        {
+        if (msg.failed()) {
+            ALOGE("%s: the AP list does not fit the request", __func__);
+            ret = WIFI_ERROR_OUT_OF_MEMORY;
             goto cleanup;
         }
-        gScanCommand->attr_end(nlApThresholdParam);
     }
 
-    gScanCommand->attr_end(nlApThresholdParamList);
-
-    gScanCommand->attr_end(nlData);
-
     ret = gScanCommand->allocRspParams(eGScanSetSignificantChangeRspParams);
     if (ret != 0) {
         ALOGE("%s: Failed to allocate memory to the response struct. "
@@ -1226,10 +1242,10 @@ cleanup:
     /* Delete the command event handler object if ret != 0 */
     if (!previousGScanSetSigChangeRunning && ret
         && GScanSetSignificantChangeCmdEventHandler) {
-        delete GScanSetSignificantChangeCmdEventHandler;
+        GScanSetSignificantChangeCmdEventHandler->release();
         GScanSetSignificantChangeCmdEventHandler = NULL;
     }
-    delete gScanCommand;
+    gScanCommand->release();
     return (wifi_error)ret;
 }
 
@@ -1250,7 +1266,7 @@ wifi_error wifi_reset_significant_change_handler(wifi_request_id id,
     hal_info *info = getHalInfo(wifiHandle);
 
     ALOGD("GSCAN: Reset Significant Change, halHandle = %p", wifiHandle);
-    if (!(info->supported_feature_set & WIFI_FEATURE_GSCAN)) {
+    if (!(hal_feature_set(info) & WIFI_FEATURE_GSCAN)) {
         ALOGE("%s: GSCAN is not supported by driver",
             __func__);
         return WIFI_ERROR_NOT_SUPPORTED;
@@ -1319,7 +1335,7 @@ wifi_error wifi_reset_significant_change_handler(wifi_request_id id,
         if (ret == ETIMEDOUT)
         {
             if (GScanSetSignificantChangeCmdEventHandler) {
-                delete GScanSetSignificantChangeCmdEventHandler;
+                GScanSetSignificantChangeCmdEventHandler->release();
                 GScanSetSignificantChangeCmdEventHandler = NULL;
             }
         }
@@ -1332,14 +1348,14 @@ wifi_error wifi_reset_significant_change_handler(wifi_request_id id,
         goto cleanup;
     }
     if (GScanSetSignificantChangeCmdEventHandler) {
-        delete GScanSetSignificantChangeCmdEventHandler;
+        GScanSetSignificantChangeCmdEventHandler->release();
         GScanSetSignificantChangeCmdEventHandler = NULL;
     }
 
 cleanup:
     gScanCommand->freeRspParams(eGScanResetSignificantChangeRspParams);
     ALOGI("%s: Delete object.", __func__);
-    delete gScanCommand;
+    gScanCommand->release();
     return (wifi_error)ret;
 }
 
@@ -1369,7 +1385,7 @@ wifi_error wifi_get_cached_gscan_results(wifi_interface_handle iface,
     hal_info *info = getHalInfo(wifiHandle);
 
     ALOGE("GSCAN: Get Cached Results, halHandle = %p", wifiHandle);
-    if (!(info->supported_feature_set & WIFI_FEATURE_GSCAN)) {
+    if (!(hal_feature_set(info) & WIFI_FEATURE_GSCAN)) {
         ALOGE("%s: GSCAN is not supported by driver",
             __func__);
         return WIFI_ERROR_NOT_SUPPORTED;
@@ -1475,26 +1491,27 @@ wifi_error wifi_get_cached_gscan_results(wifi_interface_handle iface,
                                                    num,
                                                    results);
     }
-    if (!ret) {
+    if (!ret && HAL_LOG_ON(HAL_LOG_GSCAN, HAL_LOG_LEVEL_VERBOSE)) {
         for(i=0; i< *num; i++)
         {
-            ALOGI("HAL:  Result : %d\n", i+1);
-            ALOGI("HAL:  ts  %lld \n", result->ts);
-            ALOGI("HAL:  SSID  %s \n", result->ssid);
-            ALOGI("HAL:  BSSID: "
+            ALOGD("HAL:  Result : %d\n", i+1);
+            ALOGD("HAL:  ts  %lld \n", result->ts);
+            ALOGD("HAL:  SSID  %s \n", result->ssid);
+            ALOGD("HAL:  BSSID: "
                "%02x:%02x:%02x:%02x:%02x:%02x \n",
                result->bssid[0], result->bssid[1], result->bssid[2],
                result->bssid[3], result->bssid[4], result->bssid[5]);
-            ALOGI("HAL:  channel %d \n", result->channel);
-            ALOGI("HAL:  rssi  %d \n", result->rssi);
-            ALOGI("HAL:  rtt  %lld \n", result->rtt);
-            ALOGI("HAL:  rtt_sd  %lld \n", result->rtt_sd);
-            ALOGI("HAL:  beacon period  %d \n",
+            ALOGD("HAL:  channel %d \n", result->channel);
+            ALOGD("HAL:  rssi  %d \n", result->rssi);
+            ALOGD("HAL:  rtt  %lld \n", result->rtt);
+            ALOGD("HAL:  rtt_sd  %lld \n", result->rtt_sd);
+            ALOGD("HAL:  beacon period  %d \n",
             result->beacon_period);
-            ALOGI("HAL:  capability  %d \n", result->capability);
-            ALOGI("HAL:  IE length  %d \n", result->ie_length);
-            ALOGI("HAL:  IE Data \n");
-            hexdump(result->ie_data, result->ie_length);
+            ALOGD("HAL:  capability  %d \n", result->capability);
+            ALOGD("HAL:  IE length  %d \n", result->ie_length);
+            ALOGD("HAL:  IE Data \n");
+            hal_log_dump(HAL_LOG_GSCAN, "cached result IEs", result->ie_data,
+                    result->ie_length);
             result = (wifi_scan_result *)
                ((u8 *)&results[i] + sizeof(wifi_scan_result) +
                 result->ie_length);
@@ -1503,7 +1520,7 @@ wifi_error wifi_get_cached_gscan_results(wifi_interface_handle iface,
 cleanup:
     gScanCommand->freeRspParams(eGScanGetCachedResultsRspParams);
     ALOGI("%s: Delete object.", __func__);
-    delete gScanCommand;
+    gScanCommand->release();
     return (wifi_error)ret;
 }
 
@@ -1568,6 +1585,17 @@ GScanCommand::GScanCommand(wifi_handle handle, int id, u32 vendor_id,
         : WifiVendorCommand(handle, id, vendor_id, subcmd)
 {
     ALOGD("GScanCommand %p constructed", this);
+    switch (subcmd) {
+    case QCA_NL80211_VENDOR_SUBCMD_GSCAN_GET_CACHED_RESULTS:
+        set_priority(CMD_PRIO_BULK);
+        break;
+    case QCA_NL80211_VENDOR_SUBCMD_GSCAN_GET_VALID_CHANNELS:
+    case QCA_NL80211_VENDOR_SUBCMD_GSCAN_GET_CAPABILITIES:
+        break;
+    default:
+        set_priority(CMD_PRIO_BACKGROUND);
+        break;
+    }
     /* Initialize the member data variables here */
     mStartGScanRspParams = NULL;
     mStopGScanRspParams = NULL;
@@ -1596,6 +1624,7 @@ GScanCommand::~GScanCommand()
 
 /* This function implements creation of Vendor command */
 int GScanCommand::create() {
+    resetCancelled();
     int ret = mMsg.create(NL80211_CMD_VENDOR, 0, 0);
     if (ret < 0) {
         return ret;
@@ -1617,93 +1646,56 @@ out:
     return ret;
 }
 
-/* Callback handlers registered for nl message send */
-static int error_handler_gscan(struct sockaddr_nl *nla, struct nlmsgerr *err,
-                                   void *arg)
-{
-    struct sockaddr_nl *tmp;
-    int *ret = (int *)arg;
-    tmp = nla;
-    *ret = err->error;
-    ALOGE("%s: Error code:%d (%s)", __func__, *ret, strerror(-(*ret)));
-    return NL_STOP;
-}
-
-/* Callback handlers registered for nl message send */
-static int ack_handler_gscan(struct nl_msg *msg, void *arg)
-{
-    int *ret = (int *)arg;
-    struct nl_msg * a;
-
-    ALOGE("%s: called", __func__);
-    a = msg;
-    *ret = 0;
-    return NL_STOP;
-}
-
-/* Callback handlers registered for nl message send */
-static int finish_handler_gscan(struct nl_msg *msg, void *arg)
-{
-  int *ret = (int *)arg;
-  struct nl_msg * a;
-
-  ALOGE("%s: called", __func__);
-  a = msg;
-  *ret = 0;
-  return NL_SKIP;
-}
-
 /*
  * Override base class requestEvent and implement little differently here.
- * This will send the request message.
- * We don't wait for any response back in case of gscan as it is asynchronous,
- * thus no wait for condition.
+ * The request goes out asynchronously; the event loop reads the ACK while
+ * this thread waits for the event, which a failed request cuts short.
+ * We don't wait for any event back in case of gscan as it is asynchronous,
+ * unless mWaitforRsp is set.
  */
 int GScanCommand::requestEvent()
 {
     int res = -1;
-    struct nl_cb *cb;
+    int ack;
 
     ALOGD("%s: Entry.", __func__);
 
-    cb = nl_cb_alloc(NL_CB_DEFAULT);
-    if (!cb) {
-        ALOGE("%s: Callback allocation failed",__func__);
-        res = -1;
-        goto out;
-    }
+    /* Send message; the event loop reads the driver's acknowledgement */
+    mCompletion.reset();
+    res = sendRequest(mMsg, mWaitforRsp);
 
-    /* Send message */
-    ALOGE("%s:Handle:%p Socket Value:%p", __func__, mInfo, mInfo->cmd_sock);
-    res = nl_send_auto_complete(mInfo->cmd_sock, mMsg.getMessage());
+    ALOGD("%s: Msg sent, res=%d, mWaitForRsp=%d", __func__, res, mWaitforRsp);
     if (res < 0)
-        goto out;
-    res = 1;
-
-    nl_cb_err(cb, NL_CB_CUSTOM, error_handler_gscan, &res);
-    nl_cb_set(cb, NL_CB_FINISH, NL_CB_CUSTOM, finish_handler_gscan, &res);
-    nl_cb_set(cb, NL_CB_ACK, NL_CB_CUSTOM, ack_handler_gscan, &res);
-
-    /* Err is populated as part of finish_handler. */
-    while (res > 0){
-         nl_recvmsgs(mInfo->cmd_sock, cb);
-    }
+        goto cleanup;
 
-    ALOGD("%s: Msg sent, res=%d, mWaitForRsp=%d", __func__, res, mWaitforRsp);
-    /* Only wait for the asynchronous event if HDD returns success, res=0 */
-    if (!res && (mWaitforRsp == true)) {
-        struct timespec abstime;
-        abstime.tv_sec = 4;
-        abstime.tv_nsec = 0;
-        res = mCondition.wait(abstime);
+    /* Wait for the asynchronous event; if HDD fails the request we are
+     * woken up right away */
+    if (mWaitforRsp == true) {
+        struct timespec timeout;
+        timeout.tv_sec = 4;
+        timeout.tv_nsec = 0;
+        res = mCompletion.wait(timeout);
         if (res == ETIMEDOUT)
         {
             ALOGE("%s: Time out happened.", __func__);
         }
+    }
+
+    /* Only the event counts if HDD returns success, res=0 */
+    ack = awaitResponse();
+    if (ack < 0) {
+        res = ack;
+    } else if (mWaitforRsp == true) {
+        if (cancelled())
+        {
+            ALOGI("%s: Request cancelled.", __func__);
+            res = -ECANCELED;
+        }
         ALOGD("%s: Command invoked return value:%d, mWaitForRsp=%d",
             __func__, res, mWaitforRsp);
     }
-out:
+
+cleanup:
     /* Cleanup the mMsg */
     mMsg.destroy();
     return res;
@@ -1771,6 +1763,22 @@ int GScanCommand::handleResponse(WifiEvent &reply) {
     return NL_SKIP;
 }
 
+#define GSCAN_RESULT(st, attr, kind, member) \
+    ATTR_FIELD(st, QCA_WLAN_VENDOR_ATTR_GSCAN_RESULTS_##attr, kind, member, \
+               ATTR_REQUIRED)
+
+static const attr_field gscan_scan_result_fields[] = {
+    GSCAN_RESULT(wifi_scan_result, SCAN_RESULT_TIME_STAMP, U64, ts),
+    GSCAN_RESULT(wifi_scan_result, SCAN_RESULT_SSID, BINARY, ssid),
+    GSCAN_RESULT(wifi_scan_result, SCAN_RESULT_BSSID, BINARY, bssid),
+    GSCAN_RESULT(wifi_scan_result, SCAN_RESULT_CHANNEL, U32, channel),
+    GSCAN_RESULT(wifi_scan_result, SCAN_RESULT_RSSI, S32, rssi),
+    GSCAN_RESULT(wifi_scan_result, SCAN_RESULT_RTT, U32, rtt),
+    GSCAN_RESULT(wifi_scan_result, SCAN_RESULT_RTT_SD, U32, rtt_sd),
+};
+ATTR_SCHEMA(gscan_scan_result_schema, gscan_scan_result_fields,
+            QCA_WLAN_VENDOR_ATTR_GSCAN_RESULTS_MAX);
+
 /* Called to parse and extract cached results. */
 int GScanCommand::gscan_get_cached_results(u32 num_results,
                                           wifi_scan_result *results,
@@ -1780,131 +1788,39 @@ int GScanCommand::gscan_get_cached_results(u32 num_results,
     u32 i = starting_index;
     struct nlattr *scanResultsInfo;
     int rem = 0;
-    u32 len = 0;
-    ALOGE("starting counter: %d", i);
+    int ret;
+    HAL_LOGD(HAL_LOG_GSCAN, "starting counter: %d", i);
 
-    for (scanResultsInfo = (struct nlattr *) nla_data(tb_vendor[
-            QCA_WLAN_VENDOR_ATTR_GSCAN_RESULTS_LIST]),
-            rem = nla_len(tb_vendor[
-            QCA_WLAN_VENDOR_ATTR_GSCAN_RESULTS_LIST
-            ]);
-        nla_ok(scanResultsInfo, rem);
-        scanResultsInfo = nla_next(scanResultsInfo, &(rem)))
+    nla_for_each_nested(scanResultsInfo,
+            tb_vendor[QCA_WLAN_VENDOR_ATTR_GSCAN_RESULTS_LIST], rem)
     {
-        struct nlattr *tb2[ QCA_WLAN_VENDOR_ATTR_GSCAN_RESULTS_MAX + 1];
-        nla_parse(tb2, QCA_WLAN_VENDOR_ATTR_GSCAN_RESULTS_MAX,
-        (struct nlattr *) nla_data(scanResultsInfo),
-                nla_len(scanResultsInfo), NULL);
-
-        if (!
-            tb2[
-                QCA_WLAN_VENDOR_ATTR_GSCAN_RESULTS_SCAN_RESULT_TIME_STAMP
-                ])
-        {
-            ALOGE("gscan_get_cached_results: RESULTS_SCAN_RESULT_TIME_STAMP"
-                " not found");
-            return WIFI_ERROR_INVALID_ARGS;
-        }
-        results[i].ts =
-            nla_get_u64(
-            tb2[
-                QCA_WLAN_VENDOR_ATTR_GSCAN_RESULTS_SCAN_RESULT_TIME_STAMP
-                ]);
-        if (!
-            tb2[
-                QCA_WLAN_VENDOR_ATTR_GSCAN_RESULTS_SCAN_RESULT_SSID
-                ])
-        {
-            ALOGE("gscan_get_cached_results: RESULTS_SCAN_RESULT_SSID "
-                "not found");
-            return WIFI_ERROR_INVALID_ARGS;
-        }
-        len = nla_len(tb2[
-                QCA_WLAN_VENDOR_ATTR_GSCAN_RESULTS_SCAN_RESULT_SSID]);
-        len =
-            sizeof(results->ssid) <= len ? sizeof(results->ssid) : len;
-        memcpy((void *)&results[i].ssid,
-            nla_data(
-            tb2[QCA_WLAN_VENDOR_ATTR_GSCAN_RESULTS_SCAN_RESULT_SSID]), len);
-        if (!
-            tb2[
-                QCA_WLAN_VENDOR_ATTR_GSCAN_RESULTS_SCAN_RESULT_BSSID
-                ])
-        {
-            ALOGE("gscan_get_cached_results: RESULTS_SCAN_RESULT_BSSID "
-                "not found");
-            return WIFI_ERROR_INVALID_ARGS;
-        }
-        len = nla_len(
-            tb2[QCA_WLAN_VENDOR_ATTR_GSCAN_RESULTS_SCAN_RESULT_BSSID]);
-        len =
-            sizeof(results->bssid) <= len ? sizeof(results->bssid) : len;
-        memcpy(&results[i].bssid,
-            nla_data(
-            tb2[QCA_WLAN_VENDOR_ATTR_GSCAN_RESULTS_SCAN_RESULT_BSSID]), len);
-        if (!
-            tb2[
-                QCA_WLAN_VENDOR_ATTR_GSCAN_RESULTS_SCAN_RESULT_CHANNEL
-                ])
-        {
-            ALOGE("gscan_get_cached_results: RESULTS_SCAN_RESULT_CHANNEL "
-                "not found");
-            return WIFI_ERROR_INVALID_ARGS;
-        }
-        results[i].channel =
-            nla_get_u32(
-            tb2[QCA_WLAN_VENDOR_ATTR_GSCAN_RESULTS_SCAN_RESULT_CHANNEL]);
-        if (!
-            tb2[
-                QCA_WLAN_VENDOR_ATTR_GSCAN_RESULTS_SCAN_RESULT_RSSI
-                ])
-        {
-            ALOGE("gscan_get_cached_results: RESULTS_SCAN_RESULT_RSSI "
-                "not found");
-            return WIFI_ERROR_INVALID_ARGS;
-        }
-        results[i].rssi =
-            get_s32(
-            tb2[QCA_WLAN_VENDOR_ATTR_GSCAN_RESULTS_SCAN_RESULT_RSSI]);
-        if (!
-            tb2[
-                QCA_WLAN_VENDOR_ATTR_GSCAN_RESULTS_SCAN_RESULT_RTT
-                ])
+        if (i >= starting_index + num_results)
         {
-            ALOGE("gscan_get_cached_results: RESULTS_SCAN_RESULT_RTT "
-                "not found");
-            return WIFI_ERROR_INVALID_ARGS;
+            ALOGE("%s: more results than the %u announced", __func__,
+                    num_results);
+            break;
         }
-        results[i].rtt =
-            nla_get_u32(
-            tb2[QCA_WLAN_VENDOR_ATTR_GSCAN_RESULTS_SCAN_RESULT_RTT]);
-        if (!
-            tb2[
-                QCA_WLAN_VENDOR_ATTR_GSCAN_RESULTS_SCAN_RESULT_RTT_SD
-            ])
-        {
-            ALOGE("gscan_get_cached_results: RESULTS_SCAN_RESULT_RTT_SD "
-                "not found");
-            return WIFI_ERROR_INVALID_ARGS;
+        ret = attr_decode_nested(&gscan_scan_result_schema, &results[i],
+                NULL, scanResultsInfo);
+        if (ret != WIFI_SUCCESS)
+            return ret;
+
+        if (HAL_LOG_ON(HAL_LOG_GSCAN, HAL_LOG_LEVEL_VERBOSE)) {
+            ALOGD("gscan_get_cached_results: ts  %lld ", results[i].ts);
+            ALOGD("gscan_get_cached_results: SSID  %s ", results[i].ssid);
+            ALOGD("gscan_get_cached_results: "
+                "BSSID: %02x:%02x:%02x:%02x:%02x:%02x \n",
+                results[i].bssid[0], results[i].bssid[1], results[i].bssid[2],
+                results[i].bssid[3], results[i].bssid[4], results[i].bssid[5]);
+            ALOGD("gscan_get_cached_results: channel %d ", results[i].channel);
+            ALOGD("gscan_get_cached_results: rssi  %d ", results[i].rssi);
+            ALOGD("gscan_get_cached_results: rtt  %lld ", results[i].rtt);
+            ALOGD("gscan_get_cached_results: rtt_sd  %lld ", results[i].rtt_sd);
         }
-        results[i].rtt_sd =
-            nla_get_u32(
-            tb2[QCA_WLAN_VENDOR_ATTR_GSCAN_RESULTS_SCAN_RESULT_RTT_SD]);
-
-        ALOGE("gscan_get_cached_results: ts  %lld ", results[i].ts);
-        ALOGE("gscan_get_cached_results: SSID  %s ", results[i].ssid);
-        ALOGE("gscan_get_cached_results: "
-            "BSSID: %02x:%02x:%02x:%02x:%02x:%02x \n",
-            results[i].bssid[0], results[i].bssid[1], results[i].bssid[2],
-            results[i].bssid[3], results[i].bssid[4], results[i].bssid[5]);
-        ALOGE("gscan_get_cached_results: channel %d ", results[i].channel);
-        ALOGE("gscan_get_cached_results: rssi  %d ", results[i].rssi);
-        ALOGE("gscan_get_cached_results: rtt  %lld ", results[i].rtt);
-        ALOGE("gscan_get_cached_results: rtt_sd  %lld ", results[i].rtt_sd);
         /* Increment loop index for next record */
         i++;
     }
-    ALOGE("%s: Exited the for loop", __func__);
+    HAL_LOGD(HAL_LOG_GSCAN, "%s: Exited the for loop", __func__);
     return WIFI_SUCCESS;
 }
 
@@ -2302,7 +2218,7 @@ int GScanCommand::allocRspParams(eGScanRspRarams cmd)
     {
         case eGScanStartRspParams:
             mStartGScanRspParams = (GScanStartRspParams *)
-                malloc(sizeof(GScanStartRspParams));
+                cmd_slab_alloc(sizeof(GScanStartRspParams));
             if (!mStartGScanRspParams)
                 ret = -1;
             else
@@ -2310,7 +2226,7 @@ int GScanCommand::allocRspParams(eGScanRspRarams cmd)
         break;
         case eGScanStopRspParams:
             mStopGScanRspParams = (GScanStopRspParams *)
-                malloc(sizeof(GScanStopRspParams));
+                cmd_slab_alloc(sizeof(GScanStopRspParams));
             if (!mStopGScanRspParams)
                 ret = -1;
             else
@@ -2318,7 +2234,7 @@ int GScanCommand::allocRspParams(eGScanRspRarams cmd)
         break;
         case eGScanSetBssidHotlistRspParams:
             mSetBssidHotlistRspParams = (GScanSetBssidHotlistRspParams *)
-                malloc(sizeof(GScanSetBssidHotlistRspParams));
+                cmd_slab_alloc(sizeof(GScanSetBssidHotlistRspParams));
             if (!mSetBssidHotlistRspParams)
                 ret = -1;
             else
@@ -2326,7 +2242,7 @@ int GScanCommand::allocRspParams(eGScanRspRarams cmd)
         break;
         case eGScanResetBssidHotlistRspParams:
             mResetBssidHotlistRspParams = (GScanResetBssidHotlistRspParams *)
-                malloc(sizeof(GScanResetBssidHotlistRspParams));
+                cmd_slab_alloc(sizeof(GScanResetBssidHotlistRspParams));
             if (!mResetBssidHotlistRspParams)
                 ret = -1;
             else
@@ -2335,7 +2251,7 @@ int GScanCommand::allocRspParams(eGScanRspRarams cmd)
         case eGScanSetSignificantChangeRspParams:
             mSetSignificantChangeRspParams =
                 (GScanSetSignificantChangeRspParams *)
-                malloc(sizeof(GScanSetSignificantChangeRspParams));
+                cmd_slab_alloc(sizeof(GScanSetSignificantChangeRspParams));
             if (!mSetSignificantChangeRspParams)
                 ret = -1;
             else
@@ -2344,7 +2260,7 @@ int GScanCommand::allocRspParams(eGScanRspRarams cmd)
         case eGScanResetSignificantChangeRspParams:
             mResetSignificantChangeRspParams =
                 (GScanResetSignificantChangeRspParams *)
-                malloc(sizeof(GScanResetSignificantChangeRspParams));
+                cmd_slab_alloc(sizeof(GScanResetSignificantChangeRspParams));
             if (!mResetSignificantChangeRspParams)
                 ret = -1;
             else
@@ -2352,7 +2268,7 @@ int GScanCommand::allocRspParams(eGScanRspRarams cmd)
         break;
         case eGScanGetCapabilitiesRspParams:
             mGetCapabilitiesRspParams = (GScanGetCapabilitiesRspParams *)
-                malloc(sizeof(GScanGetCapabilitiesRspParams));
+                cmd_slab_alloc(sizeof(GScanGetCapabilitiesRspParams));
             if (!mGetCapabilitiesRspParams)
                 ret = -1;
             else  {
@@ -2363,7 +2279,7 @@ int GScanCommand::allocRspParams(eGScanRspRarams cmd)
         break;
         case eGScanGetCachedResultsRspParams:
             mGetCachedResultsRspParams = (GScanGetCachedResultsRspParams *)
-                malloc(sizeof(GScanGetCachedResultsRspParams));
+                cmd_slab_alloc(sizeof(GScanGetCachedResultsRspParams));
             if (!mGetCachedResultsRspParams)
                 ret = -1;
             else {
@@ -2385,43 +2301,50 @@ void GScanCommand::freeRspParams(eGScanRspRarams cmd)
     {
         case eGScanStartRspParams:
             if (mStartGScanRspParams) {
-                free(mStartGScanRspParams);
+                cmd_slab_free(mStartGScanRspParams,
+                        sizeof(*mStartGScanRspParams));
                 mStartGScanRspParams = NULL;
             }
         break;
         case eGScanStopRspParams:
             if (mStopGScanRspParams) {
-                free(mStopGScanRspParams);
+                cmd_slab_free(mStopGScanRspParams,
+                        sizeof(*mStopGScanRspParams));
                 mStopGScanRspParams = NULL;
             }
         break;
         case eGScanSetBssidHotlistRspParams:
             if (mSetBssidHotlistRspParams) {
-                free(mSetBssidHotlistRspParams);
+                cmd_slab_free(mSetBssidHotlistRspParams,
+                        sizeof(*mSetBssidHotlistRspParams));
                 mSetBssidHotlistRspParams = NULL;
             }
         break;
         case eGScanResetBssidHotlistRspParams:
             if (mResetBssidHotlistRspParams) {
-                free(mResetBssidHotlistRspParams);
+                cmd_slab_free(mResetBssidHotlistRspParams,
+                        sizeof(*mResetBssidHotlistRspParams));
                 mResetBssidHotlistRspParams = NULL;
             }
         break;
         case eGScanSetSignificantChangeRspParams:
             if (mSetSignificantChangeRspParams) {
-                free(mSetSignificantChangeRspParams);
+                cmd_slab_free(mSetSignificantChangeRspParams,
+                        sizeof(*mSetSignificantChangeRspParams));
                 mSetSignificantChangeRspParams = NULL;
             }
         break;
         case eGScanResetSignificantChangeRspParams:
             if (mResetSignificantChangeRspParams) {
-                free(mResetSignificantChangeRspParams);
+                cmd_slab_free(mResetSignificantChangeRspParams,
+                        sizeof(*mResetSignificantChangeRspParams));
                 mResetSignificantChangeRspParams = NULL;
             }
         break;
         case eGScanGetCapabilitiesRspParams:
             if (mGetCapabilitiesRspParams) {
-                free(mGetCapabilitiesRspParams);
+                cmd_slab_free(mGetCapabilitiesRspParams,
+                        sizeof(*mGetCapabilitiesRspParams));
                 mGetCapabilitiesRspParams = NULL;
             }
         break;
@@ -2431,7 +2354,8 @@ void GScanCommand::freeRspParams(eGScanRspRarams cmd)
                     free(mGetCachedResultsRspParams->results);
                     mGetCachedResultsRspParams->results = NULL;
                 }
-                free(mGetCachedResultsRspParams);
+                cmd_slab_free(mGetCachedResultsRspParams,
+                        sizeof(*mGetCachedResultsRspParams));
                 mGetCachedResultsRspParams = NULL;
             }
         break;
@@ -2542,11 +2466,11 @@ void GScanCommand::getResetSignificantChangeRspParams(u32 *status)
 
 int GScanCommand::timed_wait(u16 wait_time)
 {
-    struct timespec absTime;
+    struct timespec timeout;
     int res;
-    absTime.tv_sec = wait_time;
-    absTime.tv_nsec = 0;
-    return mCondition.wait(absTime);
+    timeout.tv_sec = wait_time;
+    timeout.tv_nsec = 0;
+    return mCompletion.wait(timeout);
 }
 
 void GScanCommand::waitForRsp(bool wait)
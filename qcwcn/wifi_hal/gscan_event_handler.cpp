@@ -20,8 +20,32 @@
 #include "gscan_event_handler.h"
 #include "vendor_definitions.h"
 
+/* Events for this request may have been dropped by the kernel. Scan
+ * results are not lost with them: the driver still holds them in its
+ * cache, so report the buffer as full to make the framework fetch them
+ * with wifi_get_cached_gscan_results(). Hotlist and significant change
+ * events cannot be fetched again. */
+void GScanCommandEventHandler::handleOverrun()
+{
+    switch (mSubCommandId)
+    {
+        case QCA_NL80211_VENDOR_SUBCMD_GSCAN_START:
+            ALOGW("%s: scan events of request %d may have been lost, "
+                "requesting a cached results fetch", __func__, mRequestId);
+            if (mHandler.on_scan_event)
+                (*mHandler.on_scan_event)(WIFI_SCAN_BUFFER_FULL, 0);
+            break;
+
+        default:
+            ALOGW("%s: events of request %d (subcmd %u) may have been lost",
+                __func__, mRequestId, mSubCommandId);
+            break;
+    }
+}
+
 /* This function implements creation of Vendor command event handler. */
 int GScanCommandEventHandler::create() {
+    resetCancelled();
     int ret = mMsg.create(NL80211_CMD_VENDOR, 0, 0);
     if (ret < 0) {
         return ret;
@@ -161,129 +185,35 @@ wifi_error GScanCommandEventHandler::gscan_parse_hotlist_ap_results(
     u32 i = starting_index;
     struct nlattr *scanResultsInfo;
     int rem = 0;
-    u32 len = 0;
-    ALOGE("gscan_parse_hotlist_ap_results: starting counter: %d", i);
-
-    for (scanResultsInfo = (struct nlattr *) nla_data(tb_vendor[
-            QCA_WLAN_VENDOR_ATTR_GSCAN_RESULTS_LIST]),
-            rem = nla_len(tb_vendor[
-            QCA_WLAN_VENDOR_ATTR_GSCAN_RESULTS_LIST
-            ]);
-                nla_ok(scanResultsInfo, rem);
-                scanResultsInfo = nla_next(scanResultsInfo, &(rem)))
-    {
-        struct nlattr *tb2[ QCA_WLAN_VENDOR_ATTR_GSCAN_RESULTS_MAX + 1];
-        nla_parse(tb2, QCA_WLAN_VENDOR_ATTR_GSCAN_RESULTS_MAX,
-        (struct nlattr *) nla_data(scanResultsInfo),
-                nla_len(scanResultsInfo), NULL);
+    wifi_error ret;
+    HAL_LOGV(HAL_LOG_GSCAN, "gscan_parse_hotlist_ap_results: starting counter: %d", i);
 
-        if (!
-            tb2[
-                QCA_WLAN_VENDOR_ATTR_GSCAN_RESULTS_SCAN_RESULT_TIME_STAMP
-                ])
-        {
-            ALOGE("gscan_parse_hotlist_ap_results: "
-                "RESULTS_SCAN_RESULT_TIME_STAMP not found");
-            return WIFI_ERROR_INVALID_ARGS;
-        }
-        results[i].ts =
-            nla_get_u64(
-            tb2[
-                QCA_WLAN_VENDOR_ATTR_GSCAN_RESULTS_SCAN_RESULT_TIME_STAMP
-                ]);
-        if (!
-            tb2[
-                QCA_WLAN_VENDOR_ATTR_GSCAN_RESULTS_SCAN_RESULT_SSID
-                ])
-        {
-            ALOGE("gscan_parse_hotlist_ap_results: "
-                "RESULTS_SCAN_RESULT_SSID not found");
-            return WIFI_ERROR_INVALID_ARGS;
-        }
-        len = nla_len(tb2[
-                QCA_WLAN_VENDOR_ATTR_GSCAN_RESULTS_SCAN_RESULT_SSID]);
-        len =
-            sizeof(results->ssid) <= len ? sizeof(results->ssid) : len;
-        memcpy((void *)&results[i].ssid,
-            nla_data(
-            tb2[QCA_WLAN_VENDOR_ATTR_GSCAN_RESULTS_SCAN_RESULT_SSID]), len);
-        if (!
-            tb2[
-                QCA_WLAN_VENDOR_ATTR_GSCAN_RESULTS_SCAN_RESULT_BSSID
-                ])
-        {
-            ALOGE("gscan_parse_hotlist_ap_results: "
-                "RESULTS_SCAN_RESULT_BSSID not found");
-            return WIFI_ERROR_INVALID_ARGS;
-        }
-        len = nla_len(
-            tb2[QCA_WLAN_VENDOR_ATTR_GSCAN_RESULTS_SCAN_RESULT_BSSID]);
-        len =
-            sizeof(results->bssid) <= len ? sizeof(results->bssid) : len;
-        memcpy(&results[i].bssid,
-            nla_data(
-            tb2[QCA_WLAN_VENDOR_ATTR_GSCAN_RESULTS_SCAN_RESULT_BSSID]), len);
-        if (!
-            tb2[
-                QCA_WLAN_VENDOR_ATTR_GSCAN_RESULTS_SCAN_RESULT_CHANNEL
-                ])
-        {
-            ALOGE("gscan_parse_hotlist_ap_results: "
-                "RESULTS_SCAN_RESULT_CHANNEL not found");
-            return WIFI_ERROR_INVALID_ARGS;
-        }
-        results[i].channel =
-            nla_get_u32(
-            tb2[QCA_WLAN_VENDOR_ATTR_GSCAN_RESULTS_SCAN_RESULT_CHANNEL]);
-        if (!
-            tb2[
-                QCA_WLAN_VENDOR_ATTR_GSCAN_RESULTS_SCAN_RESULT_RSSI
-                ])
-        {
-            ALOGE("gscan_parse_hotlist_ap_results: "
-                "RESULTS_SCAN_RESULT_RSSI not found");
-            return WIFI_ERROR_INVALID_ARGS;
-        }
-        results[i].rssi =
-            get_s32(
-            tb2[QCA_WLAN_VENDOR_ATTR_GSCAN_RESULTS_SCAN_RESULT_RSSI]);
-        if (!
-            tb2[
-                QCA_WLAN_VENDOR_ATTR_GSCAN_RESULTS_SCAN_RESULT_RTT
-                ])
-        {
-            ALOGE("gscan_parse_hotlist_ap_results: "
-                "RESULTS_SCAN_RESULT_RTT not found");
-            return WIFI_ERROR_INVALID_ARGS;
-        }
-        results[i].rtt =
-            nla_get_u32(
-            tb2[QCA_WLAN_VENDOR_ATTR_GSCAN_RESULTS_SCAN_RESULT_RTT]);
-        if (!
-            tb2[
-                QCA_WLAN_VENDOR_ATTR_GSCAN_RESULTS_SCAN_RESULT_RTT_SD
-            ])
+    nla_for_each_nested(scanResultsInfo,
+            tb_vendor[QCA_WLAN_VENDOR_ATTR_GSCAN_RESULTS_LIST], rem)
+    {
+        if (i >= starting_index + num_results)
         {
-            ALOGE("gscan_parse_hotlist_ap_results: "
-                "RESULTS_SCAN_RESULT_RTT_SD not found");
-            return WIFI_ERROR_INVALID_ARGS;
+            ALOGE("%s: more results than the %u announced", __func__,
+                    num_results);
+            break;
         }
-        results[i].rtt_sd =
-            nla_get_u32(
-            tb2[QCA_WLAN_VENDOR_ATTR_GSCAN_RESULTS_SCAN_RESULT_RTT_SD]);
+        ret = attr_decode_nested(&gscan_scan_result_schema, &results[i],
+                NULL, scanResultsInfo);
+        if (ret != WIFI_SUCCESS)
+            return ret;
 
-        ALOGE("gscan_parse_hotlist_ap_results: ts  %lld ", results[i].ts);
-        ALOGE("gscan_parse_hotlist_ap_results: SSID  %s ",
+        HAL_LOGV(HAL_LOG_GSCAN, "gscan_parse_hotlist_ap_results: ts  %lld ", results[i].ts);
+        HAL_LOGV(HAL_LOG_GSCAN, "gscan_parse_hotlist_ap_results: SSID  %s ",
             results[i].ssid) ;
-        ALOGE("gscan_parse_hotlist_ap_results: "
+        HAL_LOGV(HAL_LOG_GSCAN, "gscan_parse_hotlist_ap_results: "
             "BSSID: %02x:%02x:%02x:%02x:%02x:%02x \n",
             results[i].bssid[0], results[i].bssid[1], results[i].bssid[2],
             results[i].bssid[3], results[i].bssid[4], results[i].bssid[5]);
-        ALOGE("gscan_parse_hotlist_ap_results: channel %d ",
+        HAL_LOGV(HAL_LOG_GSCAN, "gscan_parse_hotlist_ap_results: channel %d ",
             results[i].channel);
-        ALOGE("gscan_parse_hotlist_ap_results: rssi %d ", results[i].rssi);
-        ALOGE("gscan_parse_hotlist_ap_results: rtt %lld ", results[i].rtt);
-        ALOGE("gscan_parse_hotlist_ap_results: rtt_sd %lld ",
+        HAL_LOGV(HAL_LOG_GSCAN, "gscan_parse_hotlist_ap_results: rssi %d ", results[i].rssi);
+        HAL_LOGV(HAL_LOG_GSCAN, "gscan_parse_hotlist_ap_results: rtt %lld ", results[i].rtt);
+        HAL_LOGV(HAL_LOG_GSCAN, "gscan_parse_hotlist_ap_results: rtt_sd %lld ",
             results[i].rtt_sd);
         /* Increment loop index for next record */
         i++;
@@ -291,6 +221,26 @@ wifi_error GScanCommandEventHandler::gscan_parse_hotlist_ap_results(
     return WIFI_SUCCESS;
 }
 
+enum {
+    SIGNIFICANT_CHANGE_SLOT_RSSI_LIST,
+    SIGNIFICANT_CHANGE_SLOT_MAX
+};
+
+#define SIGNIFICANT_CHANGE(attr, kind, member) \
+    ATTR_FIELD(wifi_significant_change_result, \
+        QCA_WLAN_VENDOR_ATTR_GSCAN_RESULTS_SIGNIFICANT_CHANGE_RESULT_##attr, \
+        kind, member, ATTR_REQUIRED)
+
+static const attr_field gscan_significant_change_fields[] = {
+    SIGNIFICANT_CHANGE(BSSID, BINARY, bssid),
+    SIGNIFICANT_CHANGE(CHANNEL, U32, channel),
+    SIGNIFICANT_CHANGE(NUM_RSSI, U32, num_rssi),
+    ATTR_NLA(QCA_WLAN_VENDOR_ATTR_GSCAN_RESULTS_SIGNIFICANT_CHANGE_RESULT_RSSI_LIST,
+             SIGNIFICANT_CHANGE_SLOT_RSSI_LIST, ATTR_REQUIRED),
+};
+ATTR_SCHEMA(gscan_significant_change_schema, gscan_significant_change_fields,
+            QCA_WLAN_VENDOR_ATTR_GSCAN_RESULTS_MAX);
+
 static wifi_error gscan_get_significant_change_results(u32 num_results,
                                     wifi_significant_change_result **results,
                                     u32 starting_index,
@@ -299,102 +249,55 @@ static wifi_error gscan_get_significant_change_results(u32 num_results,
     u32 i = starting_index;
     int j;
     int rem = 0;
-    u32 len = 0;
     struct nlattr *scanResultsInfo;
+    struct nlattr *slot[SIGNIFICANT_CHANGE_SLOT_MAX];
+    wifi_error ret;
 
-    ALOGE("gscan_get_significant_change_results: starting counter: %d", i);
+    HAL_LOGV(HAL_LOG_GSCAN, "gscan_get_significant_change_results: starting counter: %d", i);
 
-    for (scanResultsInfo = (struct nlattr *) nla_data(tb_vendor[
-            QCA_WLAN_VENDOR_ATTR_GSCAN_RESULTS_LIST]),
-            rem = nla_len(tb_vendor[
-            QCA_WLAN_VENDOR_ATTR_GSCAN_RESULTS_LIST]);
-        nla_ok(scanResultsInfo, rem);
-        scanResultsInfo = nla_next(scanResultsInfo, &(rem)))
+    nla_for_each_nested(scanResultsInfo,
+            tb_vendor[QCA_WLAN_VENDOR_ATTR_GSCAN_RESULTS_LIST], rem)
     {
-        struct nlattr *tb2[QCA_WLAN_VENDOR_ATTR_GSCAN_RESULTS_MAX + 1];
-        nla_parse(tb2, QCA_WLAN_VENDOR_ATTR_GSCAN_RESULTS_MAX,
-            (struct nlattr *) nla_data(scanResultsInfo),
-                nla_len(scanResultsInfo), NULL);
-        if (!
-            tb2[
-            QCA_WLAN_VENDOR_ATTR_GSCAN_RESULTS_SIGNIFICANT_CHANGE_RESULT_BSSID
-            ])
+        if (i >= starting_index + num_results)
         {
-            ALOGE("gscan_get_significant_change_results: "
-                "SIGNIFICANT_CHANGE_RESULT_BSSID not found");
-            return WIFI_ERROR_INVALID_ARGS;
+            ALOGE("%s: more results than the %u announced", __func__,
+                    num_results);
+            break;
         }
-        len = nla_len(
-            tb2[
-            QCA_WLAN_VENDOR_ATTR_GSCAN_RESULTS_SIGNIFICANT_CHANGE_RESULT_BSSID]
-            );
-        len =
-            sizeof(results[i]->bssid) <= len ? sizeof(results[i]->bssid) : len;
-        memcpy(&results[i]->bssid[0],
-            nla_data(
-            tb2[
-        QCA_WLAN_VENDOR_ATTR_GSCAN_RESULTS_SIGNIFICANT_CHANGE_RESULT_BSSID]),
-            len);
-        ALOGI("\nsignificant_change_result:%d, BSSID:"
+        ret = attr_decode_nested(&gscan_significant_change_schema, results[i],
+                slot, scanResultsInfo);
+        if (ret != WIFI_SUCCESS)
+            return ret;
+
+        HAL_LOGV(HAL_LOG_GSCAN, "\nsignificant_change_result:%d, BSSID:"
             "%02x:%02x:%02x:%02x:%02x:%02x \n", i, results[i]->bssid[0],
             results[i]->bssid[1], results[i]->bssid[2], results[i]->bssid[3],
             results[i]->bssid[4], results[i]->bssid[5]);
-
-        if (!
-            tb2[
-        QCA_WLAN_VENDOR_ATTR_GSCAN_RESULTS_SIGNIFICANT_CHANGE_RESULT_CHANNEL
-                ])
-        {
-            ALOGE("gscan_get_significant_change_results: "
-                "SIGNIFICANT_CHANGE_RESULT_CHANNEL not found");
-            return WIFI_ERROR_INVALID_ARGS;
-        }
-        results[i]->channel =
-            nla_get_u32(
-            tb2[
-        QCA_WLAN_VENDOR_ATTR_GSCAN_RESULTS_SIGNIFICANT_CHANGE_RESULT_CHANNEL]);
-        ALOGI("significant_change_result:%d, channel:%d.\n",
+        HAL_LOGV(HAL_LOG_GSCAN, "significant_change_result:%d, channel:%d.\n",
             i, results[i]->channel);
-
-        if (!
-            tb2[
-        QCA_WLAN_VENDOR_ATTR_GSCAN_RESULTS_SIGNIFICANT_CHANGE_RESULT_NUM_RSSI
-            ])
-        {
-            ALOGE("gscan_get_significant_change_results: "
-                "SIGNIFICANT_CHANGE_RESULT_NUM_RSSI not found");
-            return WIFI_ERROR_INVALID_ARGS;
-        }
-        results[i]->num_rssi =
-            nla_get_u32(
-            tb2[
-        QCA_WLAN_VENDOR_ATTR_GSCAN_RESULTS_SIGNIFICANT_CHANGE_RESULT_NUM_RSSI]);
-        ALOGI("gscan_get_significant_change_results: "
+        HAL_LOGV(HAL_LOG_GSCAN, "gscan_get_significant_change_results: "
             "significant_change_result:%d, num_rssi:%d.\n",
             i, results[i]->num_rssi);
 
-        if (!
-            tb2[
-        QCA_WLAN_VENDOR_ATTR_GSCAN_RESULTS_SIGNIFICANT_CHANGE_RESULT_RSSI_LIST
-            ])
-        {
-            ALOGE("gscan_get_significant_change_results: "
-                "SIGNIFICANT_CHANGE_RESULT_RSSI_LIST not found");
-            return WIFI_ERROR_INVALID_ARGS;
-        }
-        ALOGI("gscan_get_significant_change_results: before reading the RSSI "
+        HAL_LOGV(HAL_LOG_GSCAN, "gscan_get_significant_change_results: before reading the RSSI "
             "list: num_rssi:%d, size_of_rssi:%d, total size:%d, ",
             results[i]->num_rssi,
             sizeof(wifi_rssi), results[i]->num_rssi * sizeof(wifi_rssi));
 
+        if (results[i]->num_rssi < 0 ||
+            nla_len(slot[SIGNIFICANT_CHANGE_SLOT_RSSI_LIST]) <
+                (int)(results[i]->num_rssi * sizeof(wifi_rssi)))
+        {
+            ALOGE("gscan_get_significant_change_results: "
+                "SIGNIFICANT_CHANGE_RESULT_RSSI_LIST shorter than num_rssi");
+            return WIFI_ERROR_INVALID_ARGS;
+        }
         memcpy(&(results[i]->rssi[0]),
-            nla_data(
-            tb2[
-        QCA_WLAN_VENDOR_ATTR_GSCAN_RESULTS_SIGNIFICANT_CHANGE_RESULT_RSSI_LIST]
-            ), results[i]->num_rssi * sizeof(wifi_rssi));
+            nla_data(slot[SIGNIFICANT_CHANGE_SLOT_RSSI_LIST]),
+            results[i]->num_rssi * sizeof(wifi_rssi));
 
         for (j = 0; j < results[i]->num_rssi; j++)
-            ALOGI("     significant_change_result: %d, rssi[%d]:%d, ",
+            HAL_LOGV(HAL_LOG_GSCAN, "     significant_change_result: %d, rssi[%d]:%d, ",
             i, j, results[i]->rssi[j]);
 
         /* Increment loop index to prase next record. */
@@ -409,7 +312,7 @@ static wifi_error gscan_get_significant_change_results(u32 num_results,
  */
 int GScanCommandEventHandler::handleEvent(WifiEvent &event)
 {
-    ALOGI("GScanCommandEventHandler::handleEvent: Got a GSCAN Event"
+    HAL_LOGD(HAL_LOG_GSCAN, "GScanCommandEventHandler::handleEvent: Got a GSCAN Event"
         " message from the Driver.");
     unsigned i=0;
     int ret = WIFI_SUCCESS;
@@ -432,7 +335,7 @@ int GScanCommandEventHandler::handleEvent(WifiEvent &event)
             u32 resultsBufSize = 0;
             u32 lengthOfInfoElements = 0;
 
-            ALOGD("Event QCA_NL80211_VENDOR_SUBCMD_GSCAN_FULL_SCAN_RESULT "
+            HAL_LOGD(HAL_LOG_GSCAN, "Event QCA_NL80211_VENDOR_SUBCMD_GSCAN_FULL_SCAN_RESULT "
                 "received.");
 
             if (!tbVendor[
@@ -469,7 +372,7 @@ int GScanCommandEventHandler::handleEvent(WifiEvent &event)
                 nla_get_u32(
                 tbVendor[
                 QCA_WLAN_VENDOR_ATTR_GSCAN_RESULTS_SCAN_RESULT_IE_LENGTH]);
-            ALOGI("%s: RESULTS_SCAN_RESULT_IE_LENGTH =%d",
+            HAL_LOGV(HAL_LOG_GSCAN, "%s: RESULTS_SCAN_RESULT_IE_LENGTH =%d",
                 __func__, lengthOfInfoElements);
             resultsBufSize =
                 lengthOfInfoElements + sizeof(wifi_scan_result);
@@ -635,26 +538,26 @@ int GScanCommandEventHandler::handleEvent(WifiEvent &event)
                     QCA_WLAN_VENDOR_ATTR_GSCAN_RESULTS_SCAN_RESULT_IE_DATA]),
                 lengthOfInfoElements);
 
-            ALOGE("handleEvent:FULL_SCAN_RESULTS: ts  %lld ", result->ts);
-            ALOGE("handleEvent:FULL_SCAN_RESULTS: SSID  %s ", result->ssid) ;
-            ALOGE("handleEvent:FULL_SCAN_RESULTS: "
+            HAL_LOGV(HAL_LOG_GSCAN, "handleEvent:FULL_SCAN_RESULTS: ts  %lld ", result->ts);
+            HAL_LOGV(HAL_LOG_GSCAN, "handleEvent:FULL_SCAN_RESULTS: SSID  %s ", result->ssid) ;
+            HAL_LOGV(HAL_LOG_GSCAN, "handleEvent:FULL_SCAN_RESULTS: "
                 "BSSID: %02x:%02x:%02x:%02x:%02x:%02x \n",
                 result->bssid[0], result->bssid[1], result->bssid[2],
                 result->bssid[3], result->bssid[4], result->bssid[5]);
-            ALOGE("handleEvent:FULL_SCAN_RESULTS: channel %d ",
+            HAL_LOGV(HAL_LOG_GSCAN, "handleEvent:FULL_SCAN_RESULTS: channel %d ",
                 result->channel);
-            ALOGE("handleEvent:FULL_SCAN_RESULTS: rssi  %d ", result->rssi);
-            ALOGE("handleEvent:FULL_SCAN_RESULTS: rtt  %lld ", result->rtt);
-            ALOGE("handleEvent:FULL_SCAN_RESULTS: rtt_sd  %lld ",
+            HAL_LOGV(HAL_LOG_GSCAN, "handleEvent:FULL_SCAN_RESULTS: rssi  %d ", result->rssi);
+            HAL_LOGV(HAL_LOG_GSCAN, "handleEvent:FULL_SCAN_RESULTS: rtt  %lld ", result->rtt);
+            HAL_LOGV(HAL_LOG_GSCAN, "handleEvent:FULL_SCAN_RESULTS: rtt_sd  %lld ",
                 result->rtt_sd);
-            ALOGE("handleEvent:FULL_SCAN_RESULTS: beacon period  %d ",
+            HAL_LOGV(HAL_LOG_GSCAN, "handleEvent:FULL_SCAN_RESULTS: beacon period  %d ",
                 result->beacon_period);
-            ALOGE("handleEvent:FULL_SCAN_RESULTS: capability  %d ",
+            HAL_LOGV(HAL_LOG_GSCAN, "handleEvent:FULL_SCAN_RESULTS: capability  %d ",
                 result->capability);
-            ALOGE("handleEvent:FULL_SCAN_RESULTS: IE length  %d ",
+            HAL_LOGV(HAL_LOG_GSCAN, "handleEvent:FULL_SCAN_RESULTS: IE length  %d ",
                 result->ie_length);
 
-            ALOGE("%s: Invoking the callback. \n", __func__);
+            HAL_LOGD(HAL_LOG_GSCAN, "%s: Invoking the callback. \n", __func__);
             if (mHandler.on_full_scan_result) {
                 (*mHandler.on_full_scan_result)(reqId, result);
                 /* Reset flag and num counter. */
@@ -669,7 +572,7 @@ int GScanCommandEventHandler::handleEvent(WifiEvent &event)
             wifi_request_id id;
             u32 numResults = 0;
 
-            ALOGD("Event "
+            HAL_LOGD(HAL_LOG_GSCAN, "Event "
                 "QCA_NL80211_VENDOR_SUBCMD_GSCAN_SCAN_RESULTS_AVAILABLE "
                 "received.");
 
@@ -697,10 +600,10 @@ int GScanCommandEventHandler::handleEvent(WifiEvent &event)
             }
             numResults = nla_get_u32(tbVendor[
                 QCA_WLAN_VENDOR_ATTR_GSCAN_RESULTS_NUM_RESULTS_AVAILABLE]);
-            ALOGE("%s: number of results:%d", __func__, numResults);
+            HAL_LOGD(HAL_LOG_GSCAN, "%s: number of results:%d", __func__, numResults);
 
             /* Invoke the callback func to report the number of results. */
-            ALOGE("%s: Calling on_scan_results_available handler",
+            HAL_LOGD(HAL_LOG_GSCAN, "%s: Calling on_scan_results_available handler",
                 __func__);
             if (!mHandler.on_scan_results_available) {
                 break;
@@ -716,7 +619,7 @@ int GScanCommandEventHandler::handleEvent(WifiEvent &event)
             u32 numResults = 0;
             u32 startingIndex, sizeOfObtainedResults;
 
-            ALOGD("Event QCA_NL80211_VENDOR_SUBCMD_GSCAN_HOTLIST_AP_FOUND "
+            HAL_LOGD(HAL_LOG_GSCAN, "Event QCA_NL80211_VENDOR_SUBCMD_GSCAN_HOTLIST_AP_FOUND "
                 "received.");
 
             id = nla_get_u32(
@@ -737,7 +640,7 @@ int GScanCommandEventHandler::handleEvent(WifiEvent &event)
             }
             numResults = nla_get_u32(tbVendor[
                 QCA_WLAN_VENDOR_ATTR_GSCAN_RESULTS_NUM_RESULTS_AVAILABLE]);
-            ALOGE("%s: number of results:%d", __func__, numResults);
+            HAL_LOGD(HAL_LOG_GSCAN, "%s: number of results:%d", __func__, numResults);
 
             /* Get the memory size of previous fragments, if any. */
             sizeOfObtainedResults = mHotlistApFoundNumResults *
@@ -768,7 +671,7 @@ int GScanCommandEventHandler::handleEvent(WifiEvent &event)
             memset((u8 *)mHotlistApFoundResults + sizeOfObtainedResults, 0,
                     resultsBufSize - sizeOfObtainedResults);
 
-            ALOGE("%s: Num of AP FOUND results = %d. \n", __func__,
+            HAL_LOGD(HAL_LOG_GSCAN, "%s: Num of AP FOUND results = %d. \n", __func__,
                                             mHotlistApFoundNumResults);
 
             /* To support fragmentation from firmware, monitor the
@@ -786,13 +689,13 @@ int GScanCommandEventHandler::handleEvent(WifiEvent &event)
                 mHotlistApFoundMoreData = nla_get_u8(
                     tbVendor[
                     QCA_WLAN_VENDOR_ATTR_GSCAN_RESULTS_SCAN_RESULT_MORE_DATA]);
-                ALOGE("%s: More data = %d. \n",
+                HAL_LOGD(HAL_LOG_GSCAN, "%s: More data = %d. \n",
                     __func__, mHotlistApFoundMoreData);
             }
 
-            ALOGE("%s: Extract hotlist_ap_found results.\n", __func__);
+            HAL_LOGD(HAL_LOG_GSCAN, "%s: Extract hotlist_ap_found results.\n", __func__);
             startingIndex = mHotlistApFoundNumResults - numResults;
-            ALOGE("%s: starting_index:%d",
+            HAL_LOGD(HAL_LOG_GSCAN, "%s: starting_index:%d",
                 __func__, startingIndex);
             ret = gscan_parse_hotlist_ap_results(numResults,
                                                 mHotlistApFoundResults,
@@ -822,7 +725,7 @@ int GScanCommandEventHandler::handleEvent(WifiEvent &event)
             u32 numResults = 0;
             u32 startingIndex, sizeOfObtainedResults;
 
-            ALOGD("Event QCA_NL80211_VENDOR_SUBCMD_GSCAN_HOTLIST_AP_LOST "
+            HAL_LOGD(HAL_LOG_GSCAN, "Event QCA_NL80211_VENDOR_SUBCMD_GSCAN_HOTLIST_AP_LOST "
                 "received.");
 
             id = nla_get_u32(
@@ -843,7 +746,7 @@ int GScanCommandEventHandler::handleEvent(WifiEvent &event)
             }
             numResults = nla_get_u32(tbVendor[
                 QCA_WLAN_VENDOR_ATTR_GSCAN_RESULTS_NUM_RESULTS_AVAILABLE]);
-            ALOGE("%s: number of results:%d", __func__, numResults);
+            HAL_LOGD(HAL_LOG_GSCAN, "%s: number of results:%d", __func__, numResults);
 
             /* Get the memory size of previous fragments, if any. */
             sizeOfObtainedResults = mHotlistApLostNumResults *
@@ -874,7 +777,7 @@ int GScanCommandEventHandler::handleEvent(WifiEvent &event)
             memset((u8 *)mHotlistApLostResults + sizeOfObtainedResults, 0,
                     resultsBufSize - sizeOfObtainedResults);
 
-            ALOGE("%s: Num of AP Lost results = %d. \n", __func__,
+            HAL_LOGD(HAL_LOG_GSCAN, "%s: Num of AP Lost results = %d. \n", __func__,
                                             mHotlistApLostNumResults);
 
             /* To support fragmentation from firmware, monitor the
@@ -892,13 +795,13 @@ int GScanCommandEventHandler::handleEvent(WifiEvent &event)
                 mHotlistApLostMoreData = nla_get_u8(
                     tbVendor[
                     QCA_WLAN_VENDOR_ATTR_GSCAN_RESULTS_SCAN_RESULT_MORE_DATA]);
-                ALOGE("%s: More data = %d. \n",
+                HAL_LOGD(HAL_LOG_GSCAN, "%s: More data = %d. \n",
                     __func__, mHotlistApLostMoreData);
             }
 
-            ALOGE("%s: Extract hotlist_ap_Lost results.\n", __func__);
+            HAL_LOGD(HAL_LOG_GSCAN, "%s: Extract hotlist_ap_Lost results.\n", __func__);
             startingIndex = mHotlistApLostNumResults - numResults;
-            ALOGE("%s: starting_index:%d",
+            HAL_LOGD(HAL_LOG_GSCAN, "%s: starting_index:%d",
                 __func__, startingIndex);
             ret = gscan_parse_hotlist_ap_results(numResults,
                                                 mHotlistApLostResults,
@@ -929,7 +832,7 @@ int GScanCommandEventHandler::handleEvent(WifiEvent &event)
             struct nlattr *scanResultsInfo;
             int rem = 0;
 
-            ALOGD("Event QCA_NL80211_VENDOR_SUBCMD_GSCAN_SIGNIFICANT_CHANGE "
+            HAL_LOGD(HAL_LOG_GSCAN, "Event QCA_NL80211_VENDOR_SUBCMD_GSCAN_SIGNIFICANT_CHANGE "
                 "received.");
 
             if (!tbVendor[
@@ -992,7 +895,7 @@ int GScanCommandEventHandler::handleEvent(WifiEvent &event)
             memset((u8 *)mSignificantChangeResults + sizeOfObtainedResults, 0,
                     sizeof(wifi_significant_change_result *) *
                                 numResults);
-            ALOGD("%s: mSignificantChangeMoreData = %d",
+            HAL_LOGD(HAL_LOG_GSCAN, "%s: mSignificantChangeMoreData = %d",
                     __func__, mSignificantChangeMoreData);
 
             for (scanResultsInfo = (struct nlattr *) nla_data(tbVendor[
@@ -1036,12 +939,12 @@ int GScanCommandEventHandler::handleEvent(WifiEvent &event)
                 memset((u8 *)mSignificantChangeResults[index],
                         0, resultsBufSize);
 
-                ALOGE("%s: For Significant Change results[%d], num_rssi:%d\n",
+                HAL_LOGV(HAL_LOG_GSCAN, "%s: For Significant Change results[%d], num_rssi:%d\n",
                     __func__, index, num_rssi);
                 index++;
             }
 
-            ALOGE("%s: Extract significant change results.\n", __func__);
+            HAL_LOGD(HAL_LOG_GSCAN, "%s: Extract significant change results.\n", __func__);
             startingIndex =
                 mSignificantChangeNumResults - numResults;
             ret = gscan_get_significant_change_results(numResults,
@@ -1065,12 +968,12 @@ int GScanCommandEventHandler::handleEvent(WifiEvent &event)
             mSignificantChangeMoreData = nla_get_u8(
                 tbVendor[
                 QCA_WLAN_VENDOR_ATTR_GSCAN_RESULTS_SCAN_RESULT_MORE_DATA]);
-            ALOGE("%s: More data = %d. \n",
+            HAL_LOGD(HAL_LOG_GSCAN, "%s: More data = %d. \n",
                 __func__, mSignificantChangeMoreData);
 
             /* Send the results if no more result fragments are expected */
             if (!mSignificantChangeMoreData) {
-                ALOGE("%s: Invoking the callback. \n", __func__);
+                HAL_LOGD(HAL_LOG_GSCAN, "%s: Invoking the callback. \n", __func__);
                 (*mHandler.on_significant_change)(reqId,
                                               mSignificantChangeNumResults,
                                               mSignificantChangeResults);
@@ -1097,7 +1000,7 @@ int GScanCommandEventHandler::handleEvent(WifiEvent &event)
             u32 scanEventStatus = 0;
             wifi_request_id reqId;
 
-            ALOGD("Event QCA_NL80211_VENDOR_SUBCMD_GSCAN_SCAN_EVENT "
+            HAL_LOGD(HAL_LOG_GSCAN, "Event QCA_NL80211_VENDOR_SUBCMD_GSCAN_SCAN_EVENT "
                 "received.");
 
             if (!tbVendor[
@@ -1136,7 +1039,7 @@ int GScanCommandEventHandler::handleEvent(WifiEvent &event)
             scanEventStatus = nla_get_u32(tbVendor[
                 QCA_WLAN_VENDOR_ATTR_GSCAN_RESULTS_SCAN_EVENT_STATUS]);
 
-            ALOGE("%s: Scan event type: %d, status = %d. \n", __func__,
+            HAL_LOGD(HAL_LOG_GSCAN, "%s: Scan event type: %d, status = %d. \n", __func__,
                                     scanEvent, scanEventStatus);
             /* Send the results if no more result fragments are expected. */
             (*mHandler.on_scan_event)(scanEvent, scanEventStatus);
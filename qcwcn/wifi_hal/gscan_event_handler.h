@@ -55,6 +55,7 @@ public:
     virtual int get_request_id();
     virtual void set_request_id(int request_id);
     virtual int handleEvent(WifiEvent &event);
+    virtual void handleOverrun();
     wifi_error gscan_parse_hotlist_ap_results(
             u32 num_results,
             wifi_scan_result *results,
@@ -29,6 +29,7 @@
 #include "qca-vendor.h"
 #include "vendor_definitions.h"
 #include "gscan.h"
+#include "attr_schema.h"
 
 #ifdef __cplusplus
 extern "C"
@@ -207,6 +208,9 @@ public:
 #define MIN_BREACHING_MIN 1
 #define SIGNIFICANT_CHANGE_NUM_AP_MIN 1
 
+/* One wifi_scan_result nested in QCA_WLAN_VENDOR_ATTR_GSCAN_RESULTS_LIST */
+extern attr_schema gscan_scan_result_schema;
+
 #ifdef __cplusplus
 }
 #endif /* __cplusplus */
@@ -0,0 +1,168 @@
+/*
+ * Copyright (C) 2014 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <pthread.h>
+#include <cutils/properties.h>
+
+#include "common.h"
+#include "hal_log.h"
+
+#define HAL_LOG_DUMP_RING_SIZE  (16 * 1024)
+#define HAL_LOG_DUMP_MAX_LEN    (1024)      /* longer dumps are truncated */
+
+unsigned char hal_log_level[HAL_LOG_MAX] = {
+    HAL_LOG_LEVEL_INFO, HAL_LOG_LEVEL_INFO, HAL_LOG_LEVEL_INFO,
+    HAL_LOG_LEVEL_INFO, HAL_LOG_LEVEL_INFO
+};
+
+static const char *hal_log_subsys_name[HAL_LOG_MAX] = {
+    "core", "gscan", "llstats", "nan", "tdls"
+};
+
+typedef struct {
+    const char *tag;
+    struct timespec ts;
+    uint16_t subsys;
+    uint16_t len;                               // bytes of data following
+} hal_log_dump_hdr;
+
+/* Pending dumps, oldest first, each a header followed by its data */
+static pthread_mutex_t dump_lock = PTHREAD_MUTEX_INITIALIZER;
+static uint8_t dump_ring[HAL_LOG_DUMP_RING_SIZE];
+static size_t dump_tail;                        // offset of the oldest record
+static size_t dump_used;                        // bytes held in the ring
+static unsigned dump_dropped;                   // records overwritten unread
+
+static void dump_ring_write(size_t off, const void *src, size_t len)
+{
+    size_t first = HAL_LOG_DUMP_RING_SIZE - off;
+    if (first > len)
+        first = len;
+    memcpy(dump_ring + off, src, first);
+    memcpy(dump_ring, (const uint8_t *)src + first, len - first);
+}
+
+static void dump_ring_read(size_t off, void *dst, size_t len)
+{
+    size_t first = HAL_LOG_DUMP_RING_SIZE - off;
+    if (first > len)
+        first = len;
+    memcpy(dst, dump_ring + off, first);
+    memcpy((uint8_t *)dst + first, dump_ring, len - first);
+}
+
+/* Removes the oldest record; dump_lock must be held and the ring non-empty */
+static void dump_ring_pop(hal_log_dump_hdr *hdr, void *data)
+{
+    dump_ring_read(dump_tail, hdr, sizeof(*hdr));
+    size_t off = (dump_tail + sizeof(*hdr)) % HAL_LOG_DUMP_RING_SIZE;
+    if (data != NULL)
+        dump_ring_read(off, data, hdr->len);
+    dump_tail = (off + hdr->len) % HAL_LOG_DUMP_RING_SIZE;
+    dump_used -= sizeof(*hdr) + hdr->len;
+}
+
+static void dump_print(const hal_log_dump_hdr *hdr, const uint8_t *data)
+{
+    ALOGD("[%s] %s: %u bytes at %ld.%06ld", hal_log_subsys_name[hdr->subsys],
+            hdr->tag, hdr->len, (long)hdr->ts.tv_sec, hdr->ts.tv_nsec / 1000);
+
+    for (unsigned i = 0; i < hdr->len; i += 16) {
+        char line[16 * 3 + 1];
+        unsigned n = hdr->len - i < 16 ? hdr->len - i : 16;
+        for (unsigned j = 0; j < n; j++)
+            snprintf(line + j * 3, sizeof(line) - j * 3, "%02x ", data[i + j]);
+        line[n * 3 - 1] = '\0';
+        ALOGD("  %04x: %s", i, line);
+    }
+}
+
+void hal_log_init(void)
+{
+    for (int i = 0; i < HAL_LOG_MAX; i++) {
+        char key[PROPERTY_KEY_MAX];
+        char value[PROPERTY_VALUE_MAX];
+
+        snprintf(key, sizeof(key), "wifi.hal.log.%s", hal_log_subsys_name[i]);
+        if (property_get(key, value, NULL) > 0)
+            hal_log_set_level((hal_log_subsys)i, atoi(value));
+    }
+}
+
+void hal_log_set_level(hal_log_subsys subsys, int level)
+{
+    if (subsys < 0 || subsys >= HAL_LOG_MAX)
+        return;
+    if (level < HAL_LOG_LEVEL_ERROR)
+        level = HAL_LOG_LEVEL_ERROR;
+    else if (level > HAL_LOG_LEVEL_VERBOSE)
+        level = HAL_LOG_LEVEL_VERBOSE;
+    __atomic_store_n(&hal_log_level[subsys], (unsigned char)level, __ATOMIC_RELAXED);
+}
+
+void hal_log_dump(hal_log_subsys subsys, const char *tag, const void *data, size_t len)
+{
+    hal_log_dump_hdr hdr;
+
+    hdr.tag = tag;
+    hdr.subsys = (uint16_t)subsys;
+    hdr.len = (uint16_t)(len > HAL_LOG_DUMP_MAX_LEN ? HAL_LOG_DUMP_MAX_LEN : len);
+    clock_gettime(CLOCK_MONOTONIC, &hdr.ts);
+
+    if (HAL_LOG_ON(subsys, HAL_LOG_LEVEL_VERBOSE)) {
+        hal_log_flush_dumps();
+        dump_print(&hdr, (const uint8_t *)data);
+        return;
+    }
+
+    size_t need = sizeof(hdr) + hdr.len;
+    pthread_mutex_lock(&dump_lock);
+    while (dump_used + need > HAL_LOG_DUMP_RING_SIZE) {
+        hal_log_dump_hdr old;
+        dump_ring_pop(&old, NULL);
+        dump_dropped++;
+    }
+    size_t head = (dump_tail + dump_used) % HAL_LOG_DUMP_RING_SIZE;
+    dump_ring_write(head, &hdr, sizeof(hdr));
+    dump_ring_write((head + sizeof(hdr)) % HAL_LOG_DUMP_RING_SIZE, data, hdr.len);
+    dump_used += need;
+    pthread_mutex_unlock(&dump_lock);
+}
+
+void hal_log_flush_dumps(void)
+{
+    uint8_t data[HAL_LOG_DUMP_MAX_LEN];
+    hal_log_dump_hdr hdr;
+
+    pthread_mutex_lock(&dump_lock);
+    if (dump_dropped) {
+        ALOGD("%u hex dumps were dropped before they were read", dump_dropped);
+        dump_dropped = 0;
+    }
+    while (dump_used > 0) {
+        dump_ring_pop(&hdr, data);
+        /* format outside the lock so the hot paths are not held up */
+        pthread_mutex_unlock(&dump_lock);
+        dump_print(&hdr, data);
+        pthread_mutex_lock(&dump_lock);
+    }
+    pthread_mutex_unlock(&dump_lock);
+}
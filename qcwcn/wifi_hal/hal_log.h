@@ -0,0 +1,89 @@
+/*
+ * Copyright (C) 2014 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef __WIFI_HAL_LOG_H__
+#define __WIFI_HAL_LOG_H__
+
+#include <stddef.h>
+#include <utils/Log.h>
+
+/*
+ * Leveled logging for the per-message paths of the HAL.
+ *
+ * Every message carries a subsystem and a level. Levels above
+ * WIFI_HAL_LOG_LEVEL are removed at compile time, arguments included; the
+ * remaining ones are checked against a per-subsystem runtime level, which
+ * defaults to HAL_LOG_LEVEL_INFO and can be raised with the
+ * "wifi.hal.log.<subsystem>" property (0 = error ... 4 = verbose) or
+ * hal_log_set_level().
+ *
+ * Hex dumps are not formatted when they are taken: HAL_LOG_DUMP() copies
+ * the bytes into a ring and hal_log_flush_dumps() prints them later. At
+ * verbose level they are printed straight away.
+ */
+
+#define HAL_LOG_LEVEL_ERROR     0
+#define HAL_LOG_LEVEL_WARN      1
+#define HAL_LOG_LEVEL_INFO      2
+#define HAL_LOG_LEVEL_DEBUG     3
+#define HAL_LOG_LEVEL_VERBOSE   4
+
+#ifndef WIFI_HAL_LOG_LEVEL
+#define WIFI_HAL_LOG_LEVEL      HAL_LOG_LEVEL_INFO
+#endif
+
+typedef enum {
+    HAL_LOG_CORE = 0,
+    HAL_LOG_GSCAN,
+    HAL_LOG_LLSTATS,
+    HAL_LOG_NAN,
+    HAL_LOG_TDLS,
+    HAL_LOG_MAX
+} hal_log_subsys;
+
+extern unsigned char hal_log_level[HAL_LOG_MAX];
+
+#define HAL_LOG_ON(subsys, level) \
+    ((level) <= WIFI_HAL_LOG_LEVEL && \
+     (level) <= __atomic_load_n(&hal_log_level[(subsys)], __ATOMIC_RELAXED))
+
+#define HAL_LOG_IF(subsys, level, logger, ...) \
+    do { \
+        if (HAL_LOG_ON(subsys, level)) \
+            logger(__VA_ARGS__); \
+    } while (0)
+
+#define HAL_LOGE(subsys, ...) HAL_LOG_IF(subsys, HAL_LOG_LEVEL_ERROR, ALOGE, __VA_ARGS__)
+#define HAL_LOGW(subsys, ...) HAL_LOG_IF(subsys, HAL_LOG_LEVEL_WARN, ALOGW, __VA_ARGS__)
+#define HAL_LOGI(subsys, ...) HAL_LOG_IF(subsys, HAL_LOG_LEVEL_INFO, ALOGI, __VA_ARGS__)
+#define HAL_LOGD(subsys, ...) HAL_LOG_IF(subsys, HAL_LOG_LEVEL_DEBUG, ALOGD, __VA_ARGS__)
+/* ALOGV may be compiled out by LOG_NDEBUG; verbose messages use ALOGD */
+#define HAL_LOGV(subsys, ...) HAL_LOG_IF(subsys, HAL_LOG_LEVEL_VERBOSE, ALOGD, __VA_ARGS__)
+
+/* Records len bytes at data for a later hex dump at debug level; tag must
+ * be a string literal or otherwise outlive the dump. */
+#define HAL_LOG_DUMP(subsys, tag, data, len) \
+    do { \
+        if (HAL_LOG_ON(subsys, HAL_LOG_LEVEL_DEBUG)) \
+            hal_log_dump((subsys), (tag), (data), (len)); \
+    } while (0)
+
+void hal_log_init(void);
+void hal_log_set_level(hal_log_subsys subsys, int level);
+void hal_log_dump(hal_log_subsys subsys, const char *tag, const void *data, size_t len);
+void hal_log_flush_dumps(void);
+
+#endif /* __WIFI_HAL_LOG_H__ */
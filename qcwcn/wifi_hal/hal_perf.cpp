@@ -0,0 +1,177 @@
+/*
+ * Copyright (C) 2014 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "wifi_hal.h"
+#include "common.h"
+#include "hal_perf.h"
+
+#define HAL_PERF_SUB_BITS       (2)
+#define HAL_PERF_SUB_BUCKETS    (1 << HAL_PERF_SUB_BITS)
+#define HAL_PERF_BUCKETS        ((32 - HAL_PERF_SUB_BITS + 1) * HAL_PERF_SUB_BUCKETS)
+
+typedef struct {
+    uint32_t bucket[HAL_PERF_BUCKETS];
+    uint32_t max;
+} hal_perf_hist;
+
+struct hal_perf_entry {
+    hal_perf_hist hist[HAL_PERF_METRICS];
+};
+
+uint64_t hal_perf_now_us()
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+}
+
+int hal_perf_msg_key(struct nl_msg *msg)
+{
+    struct genlmsghdr *gnlh = (struct genlmsghdr *)nlmsg_data(nlmsg_hdr(msg));
+    if (gnlh->cmd != NL80211_CMD_VENDOR)
+        return -1;
+
+    struct nlattr *attr = nla_find(genlmsg_attrdata(gnlh, 0),
+            genlmsg_attrlen(gnlh, 0), NL80211_ATTR_VENDOR_SUBCMD);
+    return attr != NULL ? (int)nla_get_u32(attr) : -1;
+}
+
+/* Values below HAL_PERF_SUB_BUCKETS get a bucket each; above, the bucket
+ * is the position of the top bit plus the HAL_PERF_SUB_BITS below it. */
+static inline unsigned bucket_of(uint32_t v)
+{
+    if (v < HAL_PERF_SUB_BUCKETS)
+        return v;
+    unsigned e = 31 - __builtin_clz(v);
+    unsigned sub = (v >> (e - HAL_PERF_SUB_BITS)) & (HAL_PERF_SUB_BUCKETS - 1);
+    return (e - HAL_PERF_SUB_BITS + 1) * HAL_PERF_SUB_BUCKETS + sub;
+}
+
+/* Largest value that falls into bucket b */
+static inline uint32_t bucket_top(unsigned b)
+{
+    if (b < HAL_PERF_SUB_BUCKETS)
+        return b;
+    unsigned e = b / HAL_PERF_SUB_BUCKETS + HAL_PERF_SUB_BITS - 1;
+    unsigned sub = b % HAL_PERF_SUB_BUCKETS;
+    uint64_t low = (uint64_t)(HAL_PERF_SUB_BUCKETS + sub) << (e - HAL_PERF_SUB_BITS);
+    return (uint32_t)(low + (1ULL << (e - HAL_PERF_SUB_BITS)) - 1);
+}
+
+static struct hal_perf_entry *get_entry(hal_info *info, int key)
+{
+    struct hal_perf_entry *e = __atomic_load_n(&info->perf[key],
+            __ATOMIC_ACQUIRE);
+    if (e != NULL)
+        return e;
+
+    struct hal_perf_entry *fresh =
+        (struct hal_perf_entry *)calloc(1, sizeof(*fresh));
+    if (fresh == NULL)
+        return NULL;
+    if (!__atomic_compare_exchange_n(&info->perf[key], &e, fresh, false,
+                __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE)) {
+        free(fresh);
+        return e;
+    }
+    return fresh;
+}
+
+void hal_perf_record(hal_info *info, int key, int metric, uint64_t us)
+{
+    if (key < 0 || key >= HAL_PERF_KEYS)
+        return;
+
+    struct hal_perf_entry *e = get_entry(info, key);
+    if (e == NULL)
+        return;
+
+    uint32_t v = us > UINT32_MAX ? UINT32_MAX : (uint32_t)us;
+    hal_perf_hist *h = &e->hist[metric];
+    __atomic_add_fetch(&h->bucket[bucket_of(v)], 1, __ATOMIC_RELAXED);
+
+    uint32_t max = __atomic_load_n(&h->max, __ATOMIC_RELAXED);
+    while (v > max && !__atomic_compare_exchange_n(&h->max, &max, v, true,
+                __ATOMIC_RELAXED, __ATOMIC_RELAXED))
+        ;
+}
+
+static void summarize(hal_perf_hist *h, wifi_perf_summary *s)
+{
+    uint32_t snap[HAL_PERF_BUCKETS];
+    uint64_t count = 0;
+
+    for (unsigned b = 0; b < HAL_PERF_BUCKETS; b++) {
+        snap[b] = __atomic_load_n(&h->bucket[b], __ATOMIC_RELAXED);
+        count += snap[b];
+    }
+
+    memset(s, 0, sizeof(*s));
+    s->count = (uint32_t)count;
+    s->max_us = __atomic_load_n(&h->max, __ATOMIC_RELAXED);
+    if (count == 0)
+        return;
+
+    uint64_t p50 = (count * 50 + 99) / 100;
+    uint64_t p99 = (count * 99 + 99) / 100;
+    uint64_t seen = 0;
+    for (unsigned b = 0; b < HAL_PERF_BUCKETS; b++) {
+        seen += snap[b];
+        if (s->p50_us == 0 && seen >= p50)
+            s->p50_us = min(bucket_top(b), s->max_us);
+        if (seen >= p99) {
+            s->p99_us = min(bucket_top(b), s->max_us);
+            break;
+        }
+    }
+}
+
+void hal_perf_cleanup(hal_info *info)
+{
+    for (int key = 0; key < HAL_PERF_KEYS; key++) {
+        free(info->perf[key]);
+        info->perf[key] = NULL;
+    }
+}
+
+wifi_error wifi_get_hal_perf_stats(wifi_handle handle,
+        wifi_cmd_perf_stats *stats, int max_stats, int *num)
+{
+    hal_info *info = (hal_info *)handle;
+    int n = 0;
+
+    for (int key = 0; key < HAL_PERF_KEYS && n < max_stats; key++) {
+        struct hal_perf_entry *e = __atomic_load_n(&info->perf[key],
+                __ATOMIC_ACQUIRE);
+        if (e == NULL)
+            continue;
+
+        stats[n].subcmd = key;
+        summarize(&e->hist[HAL_PERF_BUILD], &stats[n].build);
+        summarize(&e->hist[HAL_PERF_ACK], &stats[n].ack);
+        summarize(&e->hist[HAL_PERF_EVENT], &stats[n].event);
+        summarize(&e->hist[HAL_PERF_DISPATCH], &stats[n].dispatch);
+        n++;
+    }
+
+    *num = n;
+    return WIFI_SUCCESS;
+}
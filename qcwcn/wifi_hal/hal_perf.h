@@ -0,0 +1,50 @@
+/*
+ * Copyright (C) 2014 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef __WIFI_HAL_PERF_H__
+#define __WIFI_HAL_PERF_H__
+
+#include "common.h"
+
+/*
+ * Latency histograms per vendor subcommand, always on.
+ *
+ * Each histogram is log-linear: every power of two of microseconds is
+ * split into HAL_PERF_SUB_BUCKETS buckets, which bounds the error of a
+ * percentile to 25% with a fixed table covering all of uint32_t. Recording
+ * is a couple of relaxed atomic increments and never takes a lock; the
+ * table of a subcommand is allocated the first time it is seen.
+ */
+
+enum {
+    HAL_PERF_BUILD,                                 // create() until the request is sent
+    HAL_PERF_ACK,                                   // sent until acknowledged
+    HAL_PERF_EVENT,                                 // acknowledged until the event came
+    HAL_PERF_DISPATCH,                              // handlers run for an event
+    HAL_PERF_METRICS
+};
+
+uint64_t hal_perf_now_us();
+
+/* Vendor subcommand of a request or event, or -1 for other messages */
+int hal_perf_msg_key(struct nl_msg *msg);
+
+/* Adds one sample; keys outside [0, HAL_PERF_KEYS) are not tracked */
+void hal_perf_record(hal_info *info, int key, int metric, uint64_t us);
+
+void hal_perf_cleanup(hal_info *info);
+
+#endif /* __WIFI_HAL_PERF_H__ */
@@ -0,0 +1,58 @@
+/*
+ * Copyright (C) 2014 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef __WIFI_HAL_TRANSPORT_H__
+#define __WIFI_HAL_TRANSPORT_H__
+
+#include "common.h"
+
+/*
+ * What sits below cmd_sock and event_sock.
+ *
+ * Normally that is the kernel and hal_info::transport is NULL. A transport
+ * plugged in with wifi_set_transport() before wifi_initialize() takes the
+ * place of the driver instead: attach() installs libnl send and receive
+ * overrides (nl_cb_overwrite_send/_recv) on both sockets, so every
+ * WifiCommand, genl_ctrl_resolve() and nl_recvmsgs() call works unchanged
+ * on top of it, and get_fd() names the descriptors the event loop and the
+ * cmd_sock reader wait on in place of the sockets.
+ */
+
+typedef struct hal_transport_ops {
+    const char *name;
+    /* Takes over cmd_sock and event_sock; nothing has been sent yet */
+    wifi_error (*attach)(hal_info *info);
+    /* Called once no thread uses the sockets any more */
+    void (*detach)(hal_info *info);
+    /* Descriptor that polls readable while sock has messages to read */
+    int (*get_fd)(hal_info *info, struct nl_sock *sock);
+    /* Reports the wifi interfaces there are, in place of /sys/class/net */
+    void (*scan_ifaces)(hal_info *info,
+            void (*add)(hal_info *info, const char *name, int ifindex));
+} hal_transport_ops;
+
+/* Has the next wifi_initialize() run on ops; NULL for the kernel */
+void wifi_set_transport(const hal_transport_ops *ops);
+
+/* Descriptor to poll for messages on sock */
+static inline int hal_transport_fd(hal_info *info, struct nl_sock *sock)
+{
+    if (info->transport != NULL)
+        return info->transport->get_fd(info, sock);
+    return nl_socket_get_fd(sock);
+}
+
+#endif /* __WIFI_HAL_TRANSPORT_H__ */
@@ -0,0 +1,297 @@
+/*
+ * Copyright (C) 2014 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+#include <dirent.h>
+#include <net/if.h>
+#include <sys/socket.h>
+#include <linux/netlink.h>
+#include <linux/rtnetlink.h>
+
+#include "wifi_hal.h"
+#include "common.h"
+#include "iface_cache.h"
+#include "event_loop.h"
+#include "hal_transport.h"
+
+#define LINK_SOCK_BUF_SIZE      (8192)
+
+static bool is_wifi_interface(const char *name)
+{
+    if (strncmp(name, "wlan", 4) != 0 && strncmp(name, "p2p", 3) != 0
+            && strncmp(name, "softap", 6) != 0) {
+        /* not a wifi interface; ignore it */
+        return false;
+    } else {
+        return true;
+    }
+}
+
+/* iface_lock must be held */
+static interface_info *find_locked(hal_info *info, const char *name)
+{
+    for (int i = 0; i < info->num_interfaces; i++) {
+        if (!strcmp(info->interfaces[i]->name, name))
+            return info->interfaces[i];
+    }
+    return NULL;
+}
+
+/* Records that the named interface now has the given ifindex, 0 meaning
+ * it is gone. */
+static void iface_cache_update(hal_info *info, const char *name, int ifindex)
+{
+    interface_info *ifinfo;
+
+    if (!is_wifi_interface(name))
+        return;
+
+    pthread_mutex_lock(&info->iface_lock);
+
+    /* a renamed interface keeps its ifindex; retire the old name */
+    for (int i = 0; ifindex != 0 && i < info->num_interfaces; i++) {
+        ifinfo = info->interfaces[i];
+        if (ifinfo->id == ifindex && strcmp(ifinfo->name, name)) {
+            ALOGI("Interface %s went away", ifinfo->name);
+            ifinfo->id = 0;
+        }
+    }
+
+    ifinfo = find_locked(info, name);
+    if (ifinfo != NULL) {
+        if (ifinfo->id != ifindex) {
+            ALOGI("Interface %s %s, id = %d", name,
+                    ifindex ? "is up" : "went away", ifindex);
+            __atomic_store_n(&ifinfo->id, ifindex, __ATOMIC_RELAXED);
+        }
+    } else if (ifindex != 0) {
+        if (info->num_interfaces == MAX_INTERFACES) {
+            /* Interfaces such as p2p-wlan0-N get a new name each time, so
+             * the table fills with dead entries. The framework may still
+             * hold the handle of a dead one, so it is renamed in place
+             * rather than freed. */
+            for (int i = 0; i < info->num_interfaces; i++) {
+                if (info->interfaces[i]->id == 0) {
+                    ifinfo = info->interfaces[i];
+                    break;
+                }
+            }
+            if (ifinfo == NULL) {
+                ALOGE("%s: no room for interface %s", __func__, name);
+            } else {
+                ALOGI("Interface %s takes the entry of %s, id = %d", name,
+                        ifinfo->name, ifindex);
+                strlcpy(ifinfo->name, name, sizeof(ifinfo->name));
+                __atomic_store_n(&ifinfo->id, ifindex, __ATOMIC_RELAXED);
+            }
+        } else {
+            ifinfo = (interface_info *)malloc(sizeof(interface_info));
+            if (ifinfo == NULL) {
+                ALOGE("%s: Error ifinfo NULL", __func__);
+            } else {
+                ifinfo->handle = (wifi_handle)info;
+                strlcpy(ifinfo->name, name, sizeof(ifinfo->name));
+                ifinfo->id = ifindex;
+                info->interfaces[info->num_interfaces] = ifinfo;
+                /* publish the entry before it can be counted */
+                __atomic_store_n(&info->num_interfaces, info->num_interfaces + 1,
+                        __ATOMIC_RELEASE);
+                ALOGI("found an interface : %s, id = %d", name, ifindex);
+            }
+        }
+    }
+
+    pthread_mutex_unlock(&info->iface_lock);
+}
+
+/* Brings the table in line with /sys/class/net */
+static wifi_error iface_cache_scan(hal_info *info)
+{
+    struct dirent *de;
+
+    if (info->transport != NULL) {
+        info->transport->scan_ifaces(info, iface_cache_update);
+        return WIFI_SUCCESS;
+    }
+
+    DIR *d = opendir("/sys/class/net");
+    if (d == 0)
+        return WIFI_ERROR_UNKNOWN;
+
+    while ((de = readdir(d))) {
+        if (de->d_name[0] == '.')
+            continue;
+        if (is_wifi_interface(de->d_name))
+            iface_cache_update(info, de->d_name, if_nametoindex(de->d_name));
+    }
+    closedir(d);
+
+    /* drop ifindexes of interfaces that vanished without us noticing */
+    pthread_mutex_lock(&info->iface_lock);
+    for (int i = 0; i < info->num_interfaces; i++) {
+        interface_info *ifinfo = info->interfaces[i];
+        if (ifinfo->id != 0 && if_nametoindex(ifinfo->name) == 0)
+            __atomic_store_n(&ifinfo->id, 0, __ATOMIC_RELAXED);
+    }
+    pthread_mutex_unlock(&info->iface_lock);
+
+    return WIFI_SUCCESS;
+}
+
+static int open_link_sock()
+{
+    struct sockaddr_nl addr;
+    int sock = socket(AF_NETLINK, SOCK_RAW | SOCK_NONBLOCK | SOCK_CLOEXEC,
+            NETLINK_ROUTE);
+    if (sock < 0)
+        return -errno;
+
+    memset(&addr, 0, sizeof(addr));
+    addr.nl_family = AF_NETLINK;
+    addr.nl_groups = RTMGRP_LINK;
+    if (bind(sock, (struct sockaddr *)&addr, sizeof(addr)) < 0) {
+        int err = -errno;
+        close(sock);
+        return err;
+    }
+    return sock;
+}
+
+static void link_sock_handler(hal_info *info, int fd, uint32_t events,
+        void *arg);
+
+wifi_error iface_cache_init(hal_info *info)
+{
+    info->interfaces = (interface_info **)calloc(MAX_INTERFACES,
+            sizeof(interface_info *));
+    if (info->interfaces == NULL) {
+        ALOGE("%s: Error info->interfaces NULL", __func__);
+        return WIFI_ERROR_OUT_OF_MEMORY;
+    }
+    info->num_interfaces = 0;
+    pthread_mutex_init(&info->iface_lock, NULL);
+
+    /* subscribe before scanning so that no change falls in between */
+    info->link_sock = open_link_sock();
+    if (info->link_sock < 0) {
+        /* keep going with a table that only reflects the scan below */
+        ALOGE("Could not monitor interfaces: %d", info->link_sock);
+        info->link_sock = -1;
+    } else if (event_loop_add_fd(info, info->link_sock, EPOLLIN,
+                link_sock_handler, NULL) != WIFI_SUCCESS) {
+        close(info->link_sock);
+        info->link_sock = -1;
+    }
+
+    wifi_error ret = iface_cache_scan(info);
+    if (ret != WIFI_SUCCESS) {
+        iface_cache_cleanup(info);
+        return ret;
+    }
+
+    ALOGI("Found %d interfaces", info->num_interfaces);
+    return WIFI_SUCCESS;
+}
+
+void iface_cache_cleanup(hal_info *info)
+{
+    if (info->interfaces == NULL)
+        return;
+
+    if (info->link_sock >= 0) {
+        event_loop_del_fd(info, info->link_sock);
+        close(info->link_sock);
+    }
+    info->link_sock = -1;
+
+    for (int i = 0; i < info->num_interfaces; i++)
+        free(info->interfaces[i]);
+    free(info->interfaces);
+    info->interfaces = NULL;
+    info->num_interfaces = 0;
+    pthread_mutex_destroy(&info->iface_lock);
+}
+
+static void handle_link_msg(hal_info *info, struct nlmsghdr *nlh)
+{
+    struct ifinfomsg *ifi = (struct ifinfomsg *)NLMSG_DATA(nlh);
+    int len = IFLA_PAYLOAD(nlh);
+    const char *name = NULL;
+
+    if (nlh->nlmsg_len < NLMSG_LENGTH(sizeof(*ifi)))
+        return;
+
+    for (struct rtattr *rta = IFLA_RTA(ifi); RTA_OK(rta, len);
+            rta = RTA_NEXT(rta, len)) {
+        if (rta->rta_type == IFLA_IFNAME) {
+            size_t plen = RTA_PAYLOAD(rta);
+            name = (const char *)RTA_DATA(rta);
+            if (strnlen(name, plen) == plen || strnlen(name, plen) >= IFNAMSIZ)
+                return;
+            break;
+        }
+    }
+    if (name == NULL)
+        return;
+
+    iface_cache_update(info, name,
+            nlh->nlmsg_type == RTM_NEWLINK ? ifi->ifi_index : 0);
+}
+
+static void link_sock_handler(hal_info *info, int fd, uint32_t events,
+        void *arg)
+{
+    char buf[LINK_SOCK_BUF_SIZE] __attribute__((aligned(NLMSG_ALIGNTO)));
+
+    for (;;) {
+        ssize_t len = recv(info->link_sock, buf, sizeof(buf), MSG_DONTWAIT);
+        if (len < 0) {
+            if (errno == ENOBUFS) {
+                /* notifications were lost; start over from sysfs */
+                ALOGW("Interface notifications overran, rescanning");
+                iface_cache_scan(info);
+                continue;
+            }
+            if (errno != EAGAIN && errno != EINTR)
+                ALOGE("Error reading link notifications: %d", -errno);
+            return;
+        }
+
+        for (struct nlmsghdr *nlh = (struct nlmsghdr *)buf;
+                NLMSG_OK(nlh, len); nlh = NLMSG_NEXT(nlh, len)) {
+            if (nlh->nlmsg_type == RTM_NEWLINK || nlh->nlmsg_type == RTM_DELLINK)
+                handle_link_msg(info, nlh);
+        }
+    }
+}
+
+interface_info *iface_cache_find(hal_info *info, const char *name)
+{
+    pthread_mutex_lock(&info->iface_lock);
+    interface_info *ifinfo = find_locked(info, name);
+    pthread_mutex_unlock(&info->iface_lock);
+    return ifinfo;
+}
+
+int iface_cache_get_ifindex(hal_info *info, const char *name)
+{
+    interface_info *ifinfo = iface_cache_find(info, name);
+    return ifinfo ? __atomic_load_n(&ifinfo->id, __ATOMIC_RELAXED) : 0;
+}
@@ -0,0 +1,44 @@
+/*
+ * Copyright (C) 2014 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef __WIFI_HAL_IFACE_CACHE_H__
+#define __WIFI_HAL_IFACE_CACHE_H__
+
+#include "common.h"
+
+/*
+ * Table of the wifi interfaces (wlan*, p2p*, softap*) and their ifindex.
+ *
+ * It is seeded from /sys/class/net and then kept current from
+ * RTM_NEWLINK/RTM_DELLINK notifications read by the event loop, so
+ * interfaces that come and go after initialization are picked up and
+ * looking up an ifindex never needs a syscall. Entries are never freed
+ * while the HAL is up since their address is the wifi_interface_handle
+ * handed to the framework; an interface that goes away keeps its entry
+ * with an id of 0 and gets its id back if it reappears. Once the table is
+ * full, a new interface takes over the entry of one that went away.
+ */
+
+/* Opens the link monitor and fills the table from /sys/class/net */
+wifi_error iface_cache_init(hal_info *info);
+void iface_cache_cleanup(hal_info *info);
+
+interface_info *iface_cache_find(hal_info *info, const char *name);
+
+/* Returns the cached ifindex of the named interface, or 0 if unknown */
+int iface_cache_get_ifindex(hal_info *info, const char *name);
+
+#endif /* __WIFI_HAL_IFACE_CACHE_H__ */
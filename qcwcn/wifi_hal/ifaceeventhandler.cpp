@@ -89,7 +89,7 @@ wifi_error wifi_reset_iface_event_handler(wifi_request_id id,
     {
         if (id == mwifiEventHandler->get_request_id()) {
             ALOGI("Delete Object mwifiEventHandler for id = %d", id);
-            delete mwifiEventHandler;
+            mwifiEventHandler->release();
             mwifiEventHandler = NULL;
         } else {
             ALOGE("%s: Iface Event Handler Set for a different Request "
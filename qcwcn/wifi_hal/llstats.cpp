@@ -24,6 +24,7 @@
 #include "common.h"
 #include "cpp_bindings.h"
 #include "llstatscommand.h"
+#include "attr_schema.h"
 
 //Singleton Static Instance
 LLStatsCommand* LLStatsCommand::mLLStatsCommandInstance  = NULL;
@@ -32,6 +33,7 @@ LLStatsCommand* LLStatsCommand::mLLStatsCommandInstance  = NULL;
 // For LLStats just call base Vendor command create
 int LLStatsCommand::create() {
     int ifindex;
+    resetCancelled();
     int ret = mMsg.create(NL80211_CMD_VENDOR, 0, 0);
     if (ret < 0) {
         return ret;
@@ -46,7 +48,7 @@ int LLStatsCommand::create() {
     if (ret < 0)
         goto out;
 
-    ALOGI("mVendor_id = %d, Subcmd = %d in  %s:%d\n", mVendor_id, mSubcmd, __func__, __LINE__);
+    HAL_LOGD(HAL_LOG_LLSTATS, "mVendor_id = %d, Subcmd = %d in  %s:%d\n", mVendor_id, mSubcmd, __func__, __LINE__);
 out:
     return ret;
 }
@@ -55,6 +57,7 @@ LLStatsCommand::LLStatsCommand(wifi_handle handle, int id, u32 vendor_id, u32 su
         : WifiVendorCommand(handle, id, vendor_id, subcmd)
 {
     ALOGV("LLStatsCommand %p constructed", this);
+    set_priority(CMD_PRIO_BULK);
     memset(&mClearRspParams, 0,sizeof(LLStatsClearRspParams));
     memset(&mResultsParams, 0,sizeof(LLStatsResultsParams));
     memset(&mHandler, 0,sizeof(mHandler));
@@ -63,10 +66,18 @@ LLStatsCommand::LLStatsCommand(wifi_handle handle, int id, u32 vendor_id, u32 su
 LLStatsCommand::~LLStatsCommand()
 {
     ALOGW("LLStatsCommand %p distructor", this);
-    mLLStatsCommandInstance = NULL;
+    if (mLLStatsCommandInstance == this)
+        mLLStatsCommandInstance = NULL;
     unregisterVendorHandler(mVendor_id, mSubcmd);
 }
 
+void LLStatsCommand::release()
+{
+    /* the next instance() must not hand out a command on its way out */
+    mLLStatsCommandInstance = NULL;
+    WifiCommand::release();
+}
+
 LLStatsCommand* LLStatsCommand::instance(wifi_handle handle)
 {
     if (handle == NULL) {
@@ -103,686 +114,325 @@ void LLStatsCommand::setSubCmd(u32 subcmd)
 {
     mSubcmd = subcmd;
 }
-//callback handlers registered for nl message send
-static int error_handler_LLStats(struct sockaddr_nl *nla, struct nlmsgerr *err,
-                         void *arg)
+
+/* Attribute schemas for the LL stats results. Every nested set shares the
+ * QCA_WLAN_VENDOR_ATTR_LL_STATS_* namespace. */
+#define LL_STATS(st, attr, kind, member) \
+    ATTR_FIELD(st, QCA_WLAN_VENDOR_ATTR_LL_STATS_##attr, kind, member, \
+               ATTR_REQUIRED)
+
+enum {
+    LL_STATS_SLOT_LIST,         /* WMM_INFO, CH_INFO, RATE_INFO, PEER_INFO */
+    LL_STATS_SLOT_NUM_PEERS,
+    LL_STATS_SLOT_MAX
+};
+
+static const attr_field ll_stats_iface_fields[] = {
+    LL_STATS(wifi_iface_stat, IFACE_INFO_MODE, U32, info.mode),
+    LL_STATS(wifi_iface_stat, IFACE_INFO_MAC_ADDR, BINARY, info.mac_addr),
+    LL_STATS(wifi_iface_stat, IFACE_INFO_STATE, U32, info.state),
+    LL_STATS(wifi_iface_stat, IFACE_INFO_ROAMING, U32, info.roaming),
+    LL_STATS(wifi_iface_stat, IFACE_INFO_CAPABILITIES, U32, info.capabilities),
+    LL_STATS(wifi_iface_stat, IFACE_INFO_SSID, BINARY, info.ssid),
+    LL_STATS(wifi_iface_stat, IFACE_INFO_BSSID, BINARY, info.bssid),
+    LL_STATS(wifi_iface_stat, IFACE_INFO_AP_COUNTRY_STR, BINARY,
+             info.ap_country_str),
+    LL_STATS(wifi_iface_stat, IFACE_INFO_COUNTRY_STR, BINARY,
+             info.country_str),
+    LL_STATS(wifi_iface_stat, IFACE_BEACON_RX, U32, beacon_rx),
+    LL_STATS(wifi_iface_stat, IFACE_MGMT_RX, U32, mgmt_rx),
+    LL_STATS(wifi_iface_stat, IFACE_MGMT_ACTION_RX, U32, mgmt_action_rx),
+    LL_STATS(wifi_iface_stat, IFACE_MGMT_ACTION_TX, U32, mgmt_action_tx),
+    LL_STATS(wifi_iface_stat, IFACE_RSSI_MGMT, S32, rssi_mgmt),
+    LL_STATS(wifi_iface_stat, IFACE_RSSI_DATA, S32, rssi_data),
+    LL_STATS(wifi_iface_stat, IFACE_RSSI_ACK, S32, rssi_ack),
+    ATTR_NLA(QCA_WLAN_VENDOR_ATTR_LL_STATS_WMM_INFO, LL_STATS_SLOT_LIST,
+             ATTR_REQUIRED),
+    ATTR_NLA(QCA_WLAN_VENDOR_ATTR_LL_STATS_IFACE_NUM_PEERS,
+             LL_STATS_SLOT_NUM_PEERS, ATTR_OPTIONAL),
+};
+ATTR_SCHEMA(ll_stats_iface_schema, ll_stats_iface_fields,
+            QCA_WLAN_VENDOR_ATTR_LL_STATS_MAX);
+
+static const attr_field ll_stats_wmm_ac_fields[] = {
+    LL_STATS(wifi_wmm_ac_stat, WMM_AC_AC, U32, ac),
+    LL_STATS(wifi_wmm_ac_stat, WMM_AC_TX_MPDU, U32, tx_mpdu),
+    LL_STATS(wifi_wmm_ac_stat, WMM_AC_RX_MPDU, U32, rx_mpdu),
+    LL_STATS(wifi_wmm_ac_stat, WMM_AC_TX_MCAST, U32, tx_mcast),
+    LL_STATS(wifi_wmm_ac_stat, WMM_AC_RX_MCAST, U32, rx_mcast),
+    LL_STATS(wifi_wmm_ac_stat, WMM_AC_RX_AMPDU, U32, rx_ampdu),
+    LL_STATS(wifi_wmm_ac_stat, WMM_AC_TX_AMPDU, U32, tx_ampdu),
+    LL_STATS(wifi_wmm_ac_stat, WMM_AC_MPDU_LOST, U32, mpdu_lost),
+    LL_STATS(wifi_wmm_ac_stat, WMM_AC_RETRIES, U32, retries),
+    LL_STATS(wifi_wmm_ac_stat, WMM_AC_RETRIES_SHORT, U32, retries_short),
+    LL_STATS(wifi_wmm_ac_stat, WMM_AC_RETRIES_LONG, U32, retries_long),
+    LL_STATS(wifi_wmm_ac_stat, WMM_AC_CONTENTION_TIME_MIN, U32,
+             contention_time_min),
+    LL_STATS(wifi_wmm_ac_stat, WMM_AC_CONTENTION_TIME_MAX, U32,
+             contention_time_max),
+    LL_STATS(wifi_wmm_ac_stat, WMM_AC_CONTENTION_TIME_AVG, U32,
+             contention_time_avg),
+    LL_STATS(wifi_wmm_ac_stat, WMM_AC_CONTENTION_NUM_SAMPLES, U32,
+             contention_num_samples),
+};
+ATTR_SCHEMA(ll_stats_wmm_ac_schema, ll_stats_wmm_ac_fields,
+            QCA_WLAN_VENDOR_ATTR_LL_STATS_MAX);
+
+/* wifi_rate is made of bit fields, which offsetof() cannot address. */
+static void set_rate_preamble(void *out, const struct nlattr *nla)
 {
-    struct sockaddr_nl * tmp;
-    int *ret = (int *)arg;
-    tmp = nla;
-    *ret = err->error;
-    ALOGE("%s: Error code:%d (%s)", __func__, *ret, strerror(-(*ret)));
-    return NL_STOP;
+    ((wifi_rate_stat *)out)->rate.preamble = nla_get_u8(nla);
 }
 
-//callback handlers registered for nl message send
-static int ack_handler_LLStats(struct nl_msg *msg, void *arg)
+static void set_rate_nss(void *out, const struct nlattr *nla)
 {
-    int *ret = (int *)arg;
-    struct nl_msg * a;
-
-    ALOGE("%s: called", __func__);
-    a = msg;
-    *ret = 0;
-    return NL_STOP;
+    ((wifi_rate_stat *)out)->rate.nss = nla_get_u8(nla);
 }
 
-//callback handlers registered for nl message send
-static int finish_handler_LLStats(struct nl_msg *msg, void *arg)
+static void set_rate_bw(void *out, const struct nlattr *nla)
 {
-  int *ret = (int *)arg;
-  struct nl_msg * a;
-
-  ALOGE("%s: called", __func__);
-  a = msg;
-  *ret = 0;
-  return NL_SKIP;
+    ((wifi_rate_stat *)out)->rate.bw = nla_get_u8(nla);
 }
 
-static int get_wifi_interface_info(wifi_interface_link_layer_info *stats, struct nlattr **tb_vendor)
+static void set_rate_mcs_index(void *out, const struct nlattr *nla)
 {
-    u32 len = 0;
-    u8 *data;
-
-    if (!tb_vendor[QCA_WLAN_VENDOR_ATTR_LL_STATS_IFACE_INFO_MODE])
-    {
-        ALOGE("%s: QCA_WLAN_VENDOR_ATTR_LL_STATS_IFACE_INFO_MODE not found", __func__);
-        return WIFI_ERROR_INVALID_ARGS;
-    }
-    stats->mode = (wifi_interface_mode)nla_get_u32(tb_vendor[QCA_WLAN_VENDOR_ATTR_LL_STATS_IFACE_INFO_MODE]);
-
-
-    if (!tb_vendor[QCA_WLAN_VENDOR_ATTR_LL_STATS_IFACE_INFO_MAC_ADDR])
-    {
-        ALOGE("%s: QCA_WLAN_VENDOR_ATTR_LL_STATS_IFACE_INFO_MAC_ADDR not found", __func__);
-        return WIFI_ERROR_INVALID_ARGS;
-    }
-    len = nla_len(tb_vendor[QCA_WLAN_VENDOR_ATTR_LL_STATS_IFACE_INFO_MAC_ADDR]);
-    len = ((sizeof(stats->mac_addr) <= len) ? sizeof(stats->mac_addr) : len);
-    memcpy(&stats->mac_addr[0], nla_data(tb_vendor[QCA_WLAN_VENDOR_ATTR_LL_STATS_IFACE_INFO_MAC_ADDR]), len);
-
-    if (!tb_vendor[QCA_WLAN_VENDOR_ATTR_LL_STATS_IFACE_INFO_STATE])
-    {
-        ALOGE("%s: QCA_WLAN_VENDOR_ATTR_LL_STATS_IFACE_INFO_STATE not found", __func__);
-        return WIFI_ERROR_INVALID_ARGS;
-    }
-    stats->state = (wifi_connection_state)nla_get_u32(tb_vendor[QCA_WLAN_VENDOR_ATTR_LL_STATS_IFACE_INFO_STATE]);
-
-    if (!tb_vendor[QCA_WLAN_VENDOR_ATTR_LL_STATS_IFACE_INFO_ROAMING])
-    {
-        ALOGE("%s: QCA_WLAN_VENDOR_ATTR_LL_STATS_IFACE_INFO_ROAMING not found", __func__);
-        return WIFI_ERROR_INVALID_ARGS;
-    }
-    stats->roaming = (wifi_roam_state)nla_get_u32(tb_vendor[QCA_WLAN_VENDOR_ATTR_LL_STATS_IFACE_INFO_ROAMING]);
-
-    if (!tb_vendor[QCA_WLAN_VENDOR_ATTR_LL_STATS_IFACE_INFO_CAPABILITIES])
-    {
-        ALOGE("%s: QCA_WLAN_VENDOR_ATTR_LL_STATS_IFACE_INFO_CAPABILITIES not found", __func__);
-        return WIFI_ERROR_INVALID_ARGS;
-    }
-    stats->capabilities = nla_get_u32(tb_vendor[QCA_WLAN_VENDOR_ATTR_LL_STATS_IFACE_INFO_CAPABILITIES]);
-
-    if (!tb_vendor[QCA_WLAN_VENDOR_ATTR_LL_STATS_IFACE_INFO_SSID])
-    {
-        ALOGE("%s: QCA_WLAN_VENDOR_ATTR_LL_STATS_IFACE_INFO_SSID not found", __func__);
-        return WIFI_ERROR_INVALID_ARGS;
-    }
-    len = nla_len(tb_vendor[QCA_WLAN_VENDOR_ATTR_LL_STATS_IFACE_INFO_SSID]);
-    len = ((sizeof(stats->ssid) <= len) ? sizeof(stats->ssid) : len);
-    memcpy(&stats->ssid[0], nla_data(tb_vendor[QCA_WLAN_VENDOR_ATTR_LL_STATS_IFACE_INFO_SSID]), len);
-
-    if (!tb_vendor[QCA_WLAN_VENDOR_ATTR_LL_STATS_IFACE_INFO_BSSID])
-    {
-        ALOGE("%s: QCA_WLAN_VENDOR_ATTR_LL_STATS_IFACE_INFO_BSSID not found", __func__);
-        return WIFI_ERROR_INVALID_ARGS;
-    }
-    len = nla_len(tb_vendor[QCA_WLAN_VENDOR_ATTR_LL_STATS_IFACE_INFO_BSSID]);
-    len = ((sizeof(stats->bssid) <= len) ? sizeof(stats->bssid) : len);
-    memcpy(&stats->bssid[0], nla_data(tb_vendor[QCA_WLAN_VENDOR_ATTR_LL_STATS_IFACE_INFO_BSSID]), len);
-
-    if (!tb_vendor[QCA_WLAN_VENDOR_ATTR_LL_STATS_IFACE_INFO_AP_COUNTRY_STR])
-    {
-        ALOGE("%s: QCA_WLAN_VENDOR_ATTR_LL_STATS_IFACE_INFO_AP_COUNTRY_STR not found", __func__);
-        return WIFI_ERROR_INVALID_ARGS;
-    }
-    len = nla_len(tb_vendor[QCA_WLAN_VENDOR_ATTR_LL_STATS_IFACE_INFO_AP_COUNTRY_STR]);
-    len = ((sizeof(stats->ap_country_str) <= len) ? sizeof(stats->ap_country_str) : len);
-    memcpy(&stats->ap_country_str[0], nla_data(tb_vendor[QCA_WLAN_VENDOR_ATTR_LL_STATS_IFACE_INFO_AP_COUNTRY_STR]),
-           len);
+    ((wifi_rate_stat *)out)->rate.rateMcsIdx = nla_get_u8(nla);
+}
 
-    if (!tb_vendor[QCA_WLAN_VENDOR_ATTR_LL_STATS_IFACE_INFO_COUNTRY_STR])
-    {
-        ALOGE("%s: QCA_WLAN_VENDOR_ATTR_LL_STATS_IFACE_INFO_COUNTRY_STR not found", __func__);
-        return WIFI_ERROR_INVALID_ARGS;
-    }
-    len = nla_len(tb_vendor[QCA_WLAN_VENDOR_ATTR_LL_STATS_IFACE_INFO_COUNTRY_STR]);
-    len = ((sizeof(stats->country_str) < len) ? sizeof(stats->country_str) : len);
-    memcpy(&stats->country_str[0], nla_data(tb_vendor[QCA_WLAN_VENDOR_ATTR_LL_STATS_IFACE_INFO_COUNTRY_STR]),
-           len);
-
-    ALOGI("STATS IFACE: Mode %d", stats->mode);
-    ALOGI("STATS IFACE: MAC %pM", stats->mac_addr);
-    ALOGI("STATS IFACE: State %d ", stats->state);
-    ALOGI("STATS IFACE: Roaming %d ", stats->roaming);
-    ALOGI("STATS IFACE: capabilities %0x ", stats->capabilities);
-    ALOGI("STATS IFACE: SSID %s ", stats->ssid);
-    ALOGI("STATS IFACE: BSSID %pM ", stats->bssid);
-    ALOGI("STATS IFACE: AP country str %c%c%c ", stats->ap_country_str[0],
+static const attr_field ll_stats_rate_fields[] = {
+    ATTR_SETTER(QCA_WLAN_VENDOR_ATTR_LL_STATS_RATE_PREAMBLE,
+                set_rate_preamble, sizeof(u8), ATTR_REQUIRED),
+    ATTR_SETTER(QCA_WLAN_VENDOR_ATTR_LL_STATS_RATE_NSS,
+                set_rate_nss, sizeof(u8), ATTR_REQUIRED),
+    ATTR_SETTER(QCA_WLAN_VENDOR_ATTR_LL_STATS_RATE_BW,
+                set_rate_bw, sizeof(u8), ATTR_REQUIRED),
+    ATTR_SETTER(QCA_WLAN_VENDOR_ATTR_LL_STATS_RATE_MCS_INDEX,
+                set_rate_mcs_index, sizeof(u8), ATTR_REQUIRED),
+    LL_STATS(wifi_rate_stat, RATE_BIT_RATE, U32, rate.bitrate),
+    LL_STATS(wifi_rate_stat, RATE_TX_MPDU, U32, tx_mpdu),
+    LL_STATS(wifi_rate_stat, RATE_RX_MPDU, U32, rx_mpdu),
+    LL_STATS(wifi_rate_stat, RATE_MPDU_LOST, U32, mpdu_lost),
+    LL_STATS(wifi_rate_stat, RATE_RETRIES, U32, retries),
+    LL_STATS(wifi_rate_stat, RATE_RETRIES_SHORT, U32, retries_short),
+    LL_STATS(wifi_rate_stat, RATE_RETRIES_LONG, U32, retries_long),
+};
+ATTR_SCHEMA(ll_stats_rate_schema, ll_stats_rate_fields,
+            QCA_WLAN_VENDOR_ATTR_LL_STATS_MAX);
+
+static const attr_field ll_stats_peer_fields[] = {
+    LL_STATS(wifi_peer_info, PEER_INFO_TYPE, U32, type),
+    LL_STATS(wifi_peer_info, PEER_INFO_MAC_ADDRESS, BINARY, peer_mac_address),
+    LL_STATS(wifi_peer_info, PEER_INFO_CAPABILITIES, U32, capabilities),
+    LL_STATS(wifi_peer_info, PEER_INFO_NUM_RATES, U32, num_rate),
+    ATTR_NLA(QCA_WLAN_VENDOR_ATTR_LL_STATS_PEER_INFO_RATE_INFO,
+             LL_STATS_SLOT_LIST, ATTR_REQUIRED),
+};
+ATTR_SCHEMA(ll_stats_peer_schema, ll_stats_peer_fields,
+            QCA_WLAN_VENDOR_ATTR_LL_STATS_MAX);
+
+/* Top level of a PEERS_RESULTS event; nothing is stored directly. */
+static const attr_field ll_stats_peers_event_fields[] = {
+    ATTR_NLA(QCA_WLAN_VENDOR_ATTR_LL_STATS_IFACE_NUM_PEERS,
+             LL_STATS_SLOT_NUM_PEERS, ATTR_REQUIRED),
+    ATTR_NLA(QCA_WLAN_VENDOR_ATTR_LL_STATS_PEER_INFO,
+             LL_STATS_SLOT_LIST, ATTR_OPTIONAL),
+};
+ATTR_SCHEMA(ll_stats_peers_event_schema, ll_stats_peers_event_fields,
+            QCA_WLAN_VENDOR_ATTR_LL_STATS_MAX);
+
+static const attr_field ll_stats_radio_fields[] = {
+    LL_STATS(wifi_radio_stat, RADIO_ID, U32, radio),
+    LL_STATS(wifi_radio_stat, RADIO_ON_TIME, U32, on_time),
+    LL_STATS(wifi_radio_stat, RADIO_TX_TIME, U32, tx_time),
+    LL_STATS(wifi_radio_stat, RADIO_RX_TIME, U32, rx_time),
+    LL_STATS(wifi_radio_stat, RADIO_ON_TIME_SCAN, U32, on_time_scan),
+    LL_STATS(wifi_radio_stat, RADIO_ON_TIME_NBD, U32, on_time_nbd),
+    LL_STATS(wifi_radio_stat, RADIO_ON_TIME_GSCAN, U32, on_time_gscan),
+    LL_STATS(wifi_radio_stat, RADIO_ON_TIME_ROAM_SCAN, U32, on_time_roam_scan),
+    LL_STATS(wifi_radio_stat, RADIO_ON_TIME_PNO_SCAN, U32, on_time_pno_scan),
+    LL_STATS(wifi_radio_stat, RADIO_ON_TIME_HS20, U32, on_time_hs20),
+    LL_STATS(wifi_radio_stat, RADIO_NUM_CHANNELS, U32, num_channels),
+    ATTR_NLA(QCA_WLAN_VENDOR_ATTR_LL_STATS_CH_INFO, LL_STATS_SLOT_LIST,
+             ATTR_REQUIRED),
+};
+ATTR_SCHEMA(ll_stats_radio_schema, ll_stats_radio_fields,
+            QCA_WLAN_VENDOR_ATTR_LL_STATS_MAX);
+
+static const attr_field ll_stats_channel_fields[] = {
+    LL_STATS(wifi_channel_stat, CHANNEL_INFO_WIDTH, U32, channel.width),
+    LL_STATS(wifi_channel_stat, CHANNEL_INFO_CENTER_FREQ, U32,
+             channel.center_freq),
+    LL_STATS(wifi_channel_stat, CHANNEL_INFO_CENTER_FREQ0, U32,
+             channel.center_freq0),
+    LL_STATS(wifi_channel_stat, CHANNEL_INFO_CENTER_FREQ1, U32,
+             channel.center_freq1),
+    LL_STATS(wifi_channel_stat, CHANNEL_ON_TIME, U32, on_time),
+    LL_STATS(wifi_channel_stat, CHANNEL_CCA_BUSY_TIME, U32, cca_busy_time),
+};
+ATTR_SCHEMA(ll_stats_channel_schema, ll_stats_channel_fields,
+            QCA_WLAN_VENDOR_ATTR_LL_STATS_MAX);
+
+static void log_wifi_interface_info(wifi_interface_link_layer_info *stats)
+{
+    HAL_LOGV(HAL_LOG_LLSTATS, "STATS IFACE: Mode %d", stats->mode);
+    HAL_LOGV(HAL_LOG_LLSTATS, "STATS IFACE: MAC %pM", stats->mac_addr);
+    HAL_LOGV(HAL_LOG_LLSTATS, "STATS IFACE: State %d ", stats->state);
+    HAL_LOGV(HAL_LOG_LLSTATS, "STATS IFACE: Roaming %d ", stats->roaming);
+    HAL_LOGV(HAL_LOG_LLSTATS, "STATS IFACE: capabilities %0x ", stats->capabilities);
+    HAL_LOGV(HAL_LOG_LLSTATS, "STATS IFACE: SSID %s ", stats->ssid);
+    HAL_LOGV(HAL_LOG_LLSTATS, "STATS IFACE: BSSID %pM ", stats->bssid);
+    HAL_LOGV(HAL_LOG_LLSTATS, "STATS IFACE: AP country str %c%c%c ", stats->ap_country_str[0],
             stats->ap_country_str[1], stats->ap_country_str[2]);
-    ALOGI("STATS IFACE:Country String for this Association %c%c%c", stats->country_str[0],
+    HAL_LOGV(HAL_LOG_LLSTATS, "STATS IFACE:Country String for this Association %c%c%c", stats->country_str[0],
             stats->country_str[1], stats->country_str[2]);
-    return WIFI_SUCCESS;
 }
 
-static int get_wifi_wmm_ac_stat(wifi_wmm_ac_stat *stats, struct nlattr **tb_vendor)
+static void log_wifi_wmm_ac_stat(wifi_wmm_ac_stat *stats)
 {
-
-    if (!tb_vendor[QCA_WLAN_VENDOR_ATTR_LL_STATS_WMM_AC_AC])
-    {
-        ALOGE("%s: QCA_WLAN_VENDOR_ATTR_LL_STATS_WMM_AC_AC not found", __func__);
-        return WIFI_ERROR_INVALID_ARGS;
-    }
-    stats->ac                     = (wifi_traffic_ac)nla_get_u32(tb_vendor[QCA_WLAN_VENDOR_ATTR_LL_STATS_WMM_AC_AC]);
-
-    if (!tb_vendor[QCA_WLAN_VENDOR_ATTR_LL_STATS_WMM_AC_TX_MPDU])
-    {
-        ALOGE("%s: QCA_WLAN_VENDOR_ATTR_LL_STATS_WMM_AC_TX_MPDU not found", __func__);
-        return WIFI_ERROR_INVALID_ARGS;
-    }
-    stats->tx_mpdu                = nla_get_u32(tb_vendor[QCA_WLAN_VENDOR_ATTR_LL_STATS_WMM_AC_TX_MPDU]);
-
-    if (!tb_vendor[QCA_WLAN_VENDOR_ATTR_LL_STATS_WMM_AC_RX_MPDU])
-    {
-        ALOGE("%s: QCA_WLAN_VENDOR_ATTR_LL_STATS_WMM_AC_RX_MPDU not found", __func__);
-        return WIFI_ERROR_INVALID_ARGS;
-    }
-    stats->rx_mpdu                = nla_get_u32(tb_vendor[QCA_WLAN_VENDOR_ATTR_LL_STATS_WMM_AC_RX_MPDU]);
-
-    if (!tb_vendor[QCA_WLAN_VENDOR_ATTR_LL_STATS_WMM_AC_TX_MCAST])
-    {
-        ALOGE("%s: QCA_WLAN_VENDOR_ATTR_LL_STATS_WMM_AC_TX_MCAST not found", __func__);
-        return WIFI_ERROR_INVALID_ARGS;
-    }
-    stats->tx_mcast               = nla_get_u32(tb_vendor[QCA_WLAN_VENDOR_ATTR_LL_STATS_WMM_AC_TX_MCAST]);
-
-    if (!tb_vendor[QCA_WLAN_VENDOR_ATTR_LL_STATS_WMM_AC_RX_MCAST])
-    {
-        ALOGE("%s: QCA_WLAN_VENDOR_ATTR_LL_STATS_WMM_AC_RX_MCAST not found", __func__);
-        return WIFI_ERROR_INVALID_ARGS;
-    }
-    stats->rx_mcast               = nla_get_u32(tb_vendor[QCA_WLAN_VENDOR_ATTR_LL_STATS_WMM_AC_RX_MCAST]);
-
-    if (!tb_vendor[QCA_WLAN_VENDOR_ATTR_LL_STATS_WMM_AC_RX_AMPDU])
-    {
-        ALOGE("%s: QCA_WLAN_VENDOR_ATTR_LL_STATS_WMM_AC_RX_AMPDU not found", __func__);
-        return WIFI_ERROR_INVALID_ARGS;
-    }
-    stats->rx_ampdu               = nla_get_u32(tb_vendor[QCA_WLAN_VENDOR_ATTR_LL_STATS_WMM_AC_RX_AMPDU]);
-
-    if (!tb_vendor[QCA_WLAN_VENDOR_ATTR_LL_STATS_WMM_AC_TX_AMPDU])
-    {
-        ALOGE("%s: QCA_WLAN_VENDOR_ATTR_LL_STATS_WMM_AC_TX_AMPDU not found", __func__);
-        return WIFI_ERROR_INVALID_ARGS;
-    }
-    stats->tx_ampdu               = nla_get_u32(tb_vendor[QCA_WLAN_VENDOR_ATTR_LL_STATS_WMM_AC_TX_AMPDU]);
-
-    if (!tb_vendor[QCA_WLAN_VENDOR_ATTR_LL_STATS_WMM_AC_MPDU_LOST])
-    {
-        ALOGE("%s: QCA_WLAN_VENDOR_ATTR_LL_STATS_WMM_AC_MPDU_LOST not found", __func__);
-        return WIFI_ERROR_INVALID_ARGS;
-    }
-    stats->mpdu_lost              = nla_get_u32(tb_vendor[QCA_WLAN_VENDOR_ATTR_LL_STATS_WMM_AC_MPDU_LOST]);
-
-    if (!tb_vendor[QCA_WLAN_VENDOR_ATTR_LL_STATS_WMM_AC_RETRIES])
-    {
-        ALOGE("%s: QCA_WLAN_VENDOR_ATTR_LL_STATS_WMM_AC_RETRIES not found", __func__);
-        return WIFI_ERROR_INVALID_ARGS;
-    }
-    stats->retries                = nla_get_u32(tb_vendor[QCA_WLAN_VENDOR_ATTR_LL_STATS_WMM_AC_RETRIES]);
-
-    if (!tb_vendor[QCA_WLAN_VENDOR_ATTR_LL_STATS_WMM_AC_RETRIES_SHORT])
-    {
-        ALOGE("%s: QCA_WLAN_VENDOR_ATTR_LL_STATS_WMM_AC_RETRIES_SHORT not found", __func__);
-        return WIFI_ERROR_INVALID_ARGS;
-    }
-    stats->retries_short          = nla_get_u32(tb_vendor[QCA_WLAN_VENDOR_ATTR_LL_STATS_WMM_AC_RETRIES_SHORT]);
-
-    if (!tb_vendor[QCA_WLAN_VENDOR_ATTR_LL_STATS_WMM_AC_RETRIES_LONG])
-    {
-        ALOGE("%s: QCA_WLAN_VENDOR_ATTR_LL_STATS_WMM_AC_RETRIES_LONG not found", __func__);
-        return WIFI_ERROR_INVALID_ARGS;
-    }
-    stats->retries_long           = nla_get_u32(tb_vendor[QCA_WLAN_VENDOR_ATTR_LL_STATS_WMM_AC_RETRIES_LONG]);
-
-    if (!tb_vendor[QCA_WLAN_VENDOR_ATTR_LL_STATS_WMM_AC_CONTENTION_TIME_MIN])
-    {
-        ALOGE("%s: QCA_WLAN_VENDOR_ATTR_LL_STATS_WMM_AC_CONTENTION_TIME_MIN not found", __func__);
-        return WIFI_ERROR_INVALID_ARGS;
-    }
-    stats->contention_time_min    = nla_get_u32(tb_vendor[QCA_WLAN_VENDOR_ATTR_LL_STATS_WMM_AC_CONTENTION_TIME_MIN]);
-
-    if (!tb_vendor[QCA_WLAN_VENDOR_ATTR_LL_STATS_WMM_AC_CONTENTION_TIME_MAX])
-    {
-        ALOGE("%s: QCA_WLAN_VENDOR_ATTR_LL_STATS_WMM_AC_CONTENTION_TIME_MAX not found", __func__);
-        return WIFI_ERROR_INVALID_ARGS;
-    }
-    stats->contention_time_max    = nla_get_u32(tb_vendor[QCA_WLAN_VENDOR_ATTR_LL_STATS_WMM_AC_CONTENTION_TIME_MAX]);
-
-    if (!tb_vendor[QCA_WLAN_VENDOR_ATTR_LL_STATS_WMM_AC_CONTENTION_TIME_AVG])
-    {
-        ALOGE("%s: QCA_WLAN_VENDOR_ATTR_LL_STATS_WMM_AC_CONTENTION_TIME_AVG not found", __func__);
-        return WIFI_ERROR_INVALID_ARGS;
-    }
-    stats->contention_time_avg    = nla_get_u32(tb_vendor[QCA_WLAN_VENDOR_ATTR_LL_STATS_WMM_AC_CONTENTION_TIME_AVG]);
-
-    if (!tb_vendor[QCA_WLAN_VENDOR_ATTR_LL_STATS_WMM_AC_CONTENTION_NUM_SAMPLES])
-    {
-        ALOGE("%s: QCA_WLAN_VENDOR_ATTR_LL_STATS_WMM_AC_CONTENTION_NUM_SAMPLES not found", __func__);
-        return WIFI_ERROR_INVALID_ARGS;
-    }
-    stats->contention_num_samples = nla_get_u32(tb_vendor[QCA_WLAN_VENDOR_ATTR_LL_STATS_WMM_AC_CONTENTION_NUM_SAMPLES]);
-
-    ALOGI("STATS IFACE: ac  %u ", stats->ac);
-    ALOGI("STATS IFACE: txMpdu  %u ", stats->tx_mpdu) ;
-    ALOGI("STATS IFACE: rxMpdu  %u ", stats->rx_mpdu);
-    ALOGI("STATS IFACE: txMcast  %u ", stats->tx_mcast);
-    ALOGI("STATS IFACE: rxMcast  %u ", stats->rx_mcast);
-    ALOGI("STATS IFACE: rxAmpdu  %u ", stats->rx_ampdu);
-    ALOGI("STATS IFACE: txAmpdu  %u ", stats->tx_ampdu);
-    ALOGI("STATS IFACE: mpduLost  %u ", stats->mpdu_lost);
-    ALOGI("STATS IFACE: retries %u  ", stats->retries);
-    ALOGI("STATS IFACE: retriesShort  %u ",
+    HAL_LOGV(HAL_LOG_LLSTATS, "STATS IFACE: ac  %u ", stats->ac);
+    HAL_LOGV(HAL_LOG_LLSTATS, "STATS IFACE: txMpdu  %u ", stats->tx_mpdu) ;
+    HAL_LOGV(HAL_LOG_LLSTATS, "STATS IFACE: rxMpdu  %u ", stats->rx_mpdu);
+    HAL_LOGV(HAL_LOG_LLSTATS, "STATS IFACE: txMcast  %u ", stats->tx_mcast);
+    HAL_LOGV(HAL_LOG_LLSTATS, "STATS IFACE: rxMcast  %u ", stats->rx_mcast);
+    HAL_LOGV(HAL_LOG_LLSTATS, "STATS IFACE: rxAmpdu  %u ", stats->rx_ampdu);
+    HAL_LOGV(HAL_LOG_LLSTATS, "STATS IFACE: txAmpdu  %u ", stats->tx_ampdu);
+    HAL_LOGV(HAL_LOG_LLSTATS, "STATS IFACE: mpduLost  %u ", stats->mpdu_lost);
+    HAL_LOGV(HAL_LOG_LLSTATS, "STATS IFACE: retries %u  ", stats->retries);
+    HAL_LOGV(HAL_LOG_LLSTATS, "STATS IFACE: retriesShort  %u ",
             stats->retries_short);
-    ALOGI("STATS IFACE: retriesLong  %u  ",
+    HAL_LOGV(HAL_LOG_LLSTATS, "STATS IFACE: retriesLong  %u  ",
             stats->retries_long);
-    ALOGI("STATS IFACE: contentionTimeMin  %u ",
+    HAL_LOGV(HAL_LOG_LLSTATS, "STATS IFACE: contentionTimeMin  %u ",
             stats->contention_time_min);
-    ALOGI("STATS IFACE: contentionTimeMax  %u ",
+    HAL_LOGV(HAL_LOG_LLSTATS, "STATS IFACE: contentionTimeMax  %u ",
             stats->contention_time_max);
-    ALOGI("STATS IFACE: contentionTimeAvg  %u ",
+    HAL_LOGV(HAL_LOG_LLSTATS, "STATS IFACE: contentionTimeAvg  %u ",
             stats->contention_time_avg);
-    ALOGI("STATS IFACE: contentionNumSamples  %u ",
+    HAL_LOGV(HAL_LOG_LLSTATS, "STATS IFACE: contentionNumSamples  %u ",
             stats->contention_num_samples);
-    return WIFI_SUCCESS;
 }
 
-static int get_wifi_rate_stat(wifi_rate_stat *stats, struct nlattr **tb_vendor)
+static void log_wifi_rate_stat(wifi_rate_stat *stats)
 {
-
-    if (!tb_vendor[QCA_WLAN_VENDOR_ATTR_LL_STATS_RATE_PREAMBLE])
-    {
-        ALOGE("%s: QCA_WLAN_VENDOR_ATTR_LL_STATS_RATE_PREAMBLE not found", __func__);
-        return WIFI_ERROR_INVALID_ARGS;
-    }
-    stats->rate.preamble        = nla_get_u8(tb_vendor[QCA_WLAN_VENDOR_ATTR_LL_STATS_RATE_PREAMBLE]);
-
-    if (!tb_vendor[QCA_WLAN_VENDOR_ATTR_LL_STATS_RATE_NSS])
-    {
-        ALOGE("%s: QCA_WLAN_VENDOR_ATTR_LL_STATS_RATE_NSS not found", __func__);
-        return WIFI_ERROR_INVALID_ARGS;
-    }
-    stats->rate.nss             = nla_get_u8(tb_vendor[QCA_WLAN_VENDOR_ATTR_LL_STATS_RATE_NSS]);
-
-    if (!tb_vendor[QCA_WLAN_VENDOR_ATTR_LL_STATS_RATE_BW])
-    {
-        ALOGE("%s: QCA_WLAN_VENDOR_ATTR_LL_STATS_RATE_BW not found", __func__);
-        return WIFI_ERROR_INVALID_ARGS;
-    }
-    stats->rate.bw              = nla_get_u8(tb_vendor[QCA_WLAN_VENDOR_ATTR_LL_STATS_RATE_BW]);
-
-    if (!tb_vendor[QCA_WLAN_VENDOR_ATTR_LL_STATS_RATE_MCS_INDEX])
-    {
-        ALOGE("%s: QCA_WLAN_VENDOR_ATTR_LL_STATS_RATE_MCS_INDEX not found", __func__);
-        return WIFI_ERROR_INVALID_ARGS;
-    }
-    stats->rate.rateMcsIdx      = nla_get_u8(tb_vendor[QCA_WLAN_VENDOR_ATTR_LL_STATS_RATE_MCS_INDEX]);
-
-    if (!tb_vendor[QCA_WLAN_VENDOR_ATTR_LL_STATS_RATE_BIT_RATE])
-    {
-        ALOGE("%s: QCA_WLAN_VENDOR_ATTR_LL_STATS_RATE_BIT_RATE not found", __func__);
-        return WIFI_ERROR_INVALID_ARGS;
-    }
-    stats->rate.bitrate         = nla_get_u32(tb_vendor[QCA_WLAN_VENDOR_ATTR_LL_STATS_RATE_BIT_RATE]);
-
-    if (!tb_vendor[QCA_WLAN_VENDOR_ATTR_LL_STATS_RATE_TX_MPDU])
-    {
-        ALOGE("%s: QCA_WLAN_VENDOR_ATTR_LL_STATS_RATE_TX_MPDU not found", __func__);
-        return WIFI_ERROR_INVALID_ARGS;
-    }
-    stats->tx_mpdu              = nla_get_u32(tb_vendor[QCA_WLAN_VENDOR_ATTR_LL_STATS_RATE_TX_MPDU]);
-
-    if (!tb_vendor[QCA_WLAN_VENDOR_ATTR_LL_STATS_RATE_RX_MPDU])
-    {
-        ALOGE("%s: QCA_WLAN_VENDOR_ATTR_LL_STATS_RATE_RX_MPDU not found", __func__);
-        return WIFI_ERROR_INVALID_ARGS;
-    }
-    stats->rx_mpdu              = nla_get_u32(tb_vendor[QCA_WLAN_VENDOR_ATTR_LL_STATS_RATE_RX_MPDU]);
-
-    if (!tb_vendor[QCA_WLAN_VENDOR_ATTR_LL_STATS_RATE_MPDU_LOST])
-    {
-        ALOGE("%s: QCA_WLAN_VENDOR_ATTR_LL_STATS_RATE_MPDU_LOST not found", __func__);
-        return WIFI_ERROR_INVALID_ARGS;
-    }
-    stats->mpdu_lost            = nla_get_u32(tb_vendor[QCA_WLAN_VENDOR_ATTR_LL_STATS_RATE_MPDU_LOST]);
-
-    if (!tb_vendor[QCA_WLAN_VENDOR_ATTR_LL_STATS_RATE_RETRIES])
-    {
-        ALOGE("%s: QCA_WLAN_VENDOR_ATTR_LL_STATS_RATE_RETRIES not found", __func__);
-        return WIFI_ERROR_INVALID_ARGS;
-    }
-    stats->retries              = nla_get_u32(tb_vendor[QCA_WLAN_VENDOR_ATTR_LL_STATS_RATE_RETRIES]);
-
-    if (!tb_vendor[QCA_WLAN_VENDOR_ATTR_LL_STATS_RATE_RETRIES_SHORT])
-    {
-        ALOGE("%s: QCA_WLAN_VENDOR_ATTR_LL_STATS_RATE_RETRIES_SHORT not found", __func__);
-        return WIFI_ERROR_INVALID_ARGS;
-    }
-    stats->retries_short        = nla_get_u32(tb_vendor[QCA_WLAN_VENDOR_ATTR_LL_STATS_RATE_RETRIES_SHORT]);
-
-    if (!tb_vendor[QCA_WLAN_VENDOR_ATTR_LL_STATS_RATE_RETRIES_LONG])
-    {
-        ALOGE("%s: QCA_WLAN_VENDOR_ATTR_LL_STATS_RATE_RETRIES_LONG not found", __func__);
-        return WIFI_ERROR_INVALID_ARGS;
-    }
-    stats->retries_long         = nla_get_u32(tb_vendor[QCA_WLAN_VENDOR_ATTR_LL_STATS_RATE_RETRIES_LONG]);
-
-    ALOGI("STATS PEER_ALL : preamble  %u", stats->rate.preamble);
-    ALOGI("STATS PEER_ALL : nss %u", stats->rate.nss);
-    ALOGI("STATS PEER_ALL : bw %u", stats->rate.bw);
-    ALOGI("STATS PEER_ALL : rateMcsIdx  %u", stats->rate.rateMcsIdx);
-    ALOGI("STATS PEER_ALL : bitrate %u", stats->rate.bitrate);
-
-    ALOGI("STATS PEER_ALL : txMpdu %u", stats->tx_mpdu);
-    ALOGI("STATS PEER_ALL : rxMpdu %u", stats->rx_mpdu);
-    ALOGI("STATS PEER_ALL : mpduLost %u", stats->mpdu_lost);
-    ALOGI("STATS PEER_ALL : retries %u", stats->retries);
-    ALOGI("STATS PEER_ALL : retriesShort %u", stats->retries_short);
-    ALOGI("STATS PEER_ALL : retriesLong %u", stats->retries_long);
-    return WIFI_SUCCESS;
+    HAL_LOGV(HAL_LOG_LLSTATS, "STATS PEER_ALL : preamble  %u", stats->rate.preamble);
+    HAL_LOGV(HAL_LOG_LLSTATS, "STATS PEER_ALL : nss %u", stats->rate.nss);
+    HAL_LOGV(HAL_LOG_LLSTATS, "STATS PEER_ALL : bw %u", stats->rate.bw);
+    HAL_LOGV(HAL_LOG_LLSTATS, "STATS PEER_ALL : rateMcsIdx  %u", stats->rate.rateMcsIdx);
+    HAL_LOGV(HAL_LOG_LLSTATS, "STATS PEER_ALL : bitrate %u", stats->rate.bitrate);
+
+    HAL_LOGV(HAL_LOG_LLSTATS, "STATS PEER_ALL : txMpdu %u", stats->tx_mpdu);
+    HAL_LOGV(HAL_LOG_LLSTATS, "STATS PEER_ALL : rxMpdu %u", stats->rx_mpdu);
+    HAL_LOGV(HAL_LOG_LLSTATS, "STATS PEER_ALL : mpduLost %u", stats->mpdu_lost);
+    HAL_LOGV(HAL_LOG_LLSTATS, "STATS PEER_ALL : retries %u", stats->retries);
+    HAL_LOGV(HAL_LOG_LLSTATS, "STATS PEER_ALL : retriesShort %u", stats->retries_short);
+    HAL_LOGV(HAL_LOG_LLSTATS, "STATS PEER_ALL : retriesLong %u", stats->retries_long);
 }
 
-static int get_wifi_peer_info(wifi_peer_info *stats, struct nlattr **tb_vendor)
+static int get_wifi_peer_info(wifi_peer_info *stats, struct nlattr *peerInfo)
 {
-    u32 i = 0, len = 0;
-    int rem;
-    wifi_rate_stat * pRateStats;
+    struct nlattr *slot[LL_STATS_SLOT_MAX];
     struct nlattr *rateInfo;
-    int ret = WIFI_SUCCESS;
-
-    if (!tb_vendor[QCA_WLAN_VENDOR_ATTR_LL_STATS_PEER_INFO_TYPE])
-    {
-        ALOGE("%s: QCA_WLAN_VENDOR_ATTR_LL_STATS_PEER_INFO_TYPE not found", __func__);
-        return WIFI_ERROR_INVALID_ARGS;
-    }
-    stats->type                   = (wifi_peer_type)nla_get_u32(tb_vendor[QCA_WLAN_VENDOR_ATTR_LL_STATS_PEER_INFO_TYPE]);
-
-    if (!tb_vendor[QCA_WLAN_VENDOR_ATTR_LL_STATS_PEER_INFO_MAC_ADDRESS])
-    {
-        ALOGE("%s: QCA_WLAN_VENDOR_ATTR_LL_STATS_PEER_INFO_MAC_ADDRESS not found", __func__);
-        return WIFI_ERROR_INVALID_ARGS;
-    }
-    len = nla_len(tb_vendor[QCA_WLAN_VENDOR_ATTR_LL_STATS_PEER_INFO_MAC_ADDRESS]);
-    len = ((sizeof(stats->peer_mac_address) <= len) ? sizeof(stats->peer_mac_address) : len);
-    memcpy((void *)&stats->peer_mac_address[0], nla_data(tb_vendor[QCA_WLAN_VENDOR_ATTR_LL_STATS_PEER_INFO_MAC_ADDRESS]),
-            len);
-
-    if (!tb_vendor[QCA_WLAN_VENDOR_ATTR_LL_STATS_PEER_INFO_CAPABILITIES])
-    {
-        ALOGE("%s: QCA_WLAN_VENDOR_ATTR_LL_STATS_PEER_INFO_CAPABILITIES not found", __func__);
-        return WIFI_ERROR_INVALID_ARGS;
-    }
-    stats->capabilities           = nla_get_u32(tb_vendor[QCA_WLAN_VENDOR_ATTR_LL_STATS_PEER_INFO_CAPABILITIES]);
+    u32 i = 0;
+    int rem;
+    int ret;
 
-    if (!tb_vendor[QCA_WLAN_VENDOR_ATTR_LL_STATS_PEER_INFO_NUM_RATES])
-    {
-        ALOGE("%s: QCA_WLAN_VENDOR_ATTR_LL_STATS_PEER_INFO_NUM_RATES not found", __func__);
-        return WIFI_ERROR_INVALID_ARGS;
-    }
-    stats->num_rate               = nla_get_u32(tb_vendor[QCA_WLAN_VENDOR_ATTR_LL_STATS_PEER_INFO_NUM_RATES]);
+    ret = attr_decode_nested(&ll_stats_peer_schema, stats, slot, peerInfo);
+    if (ret != WIFI_SUCCESS)
+        return ret;
 
-    ALOGI("STATS PEER_ALL : numPeers %u", stats->type);
-    ALOGI("STATS PEER_ALL : peerMacAddress  %0x:%0x:%0x:%0x:%0x:%0x ",
+    HAL_LOGV(HAL_LOG_LLSTATS, "STATS PEER_ALL : numPeers %u", stats->type);
+    HAL_LOGV(HAL_LOG_LLSTATS, "STATS PEER_ALL : peerMacAddress  %0x:%0x:%0x:%0x:%0x:%0x ",
             stats->peer_mac_address[0], stats->peer_mac_address[1],
             stats->peer_mac_address[2],stats->peer_mac_address[3],
             stats->peer_mac_address[4],stats->peer_mac_address[5]);
-    ALOGI("STATS PEER_ALL : capabilities %0x", stats->capabilities);
-    ALOGI("STATS PEER_ALL :  numRate %u", stats->num_rate);
-
+    HAL_LOGV(HAL_LOG_LLSTATS, "STATS PEER_ALL : capabilities %0x", stats->capabilities);
+    HAL_LOGV(HAL_LOG_LLSTATS, "STATS PEER_ALL :  numRate %u", stats->num_rate);
 
-    if (!tb_vendor[QCA_WLAN_VENDOR_ATTR_LL_STATS_PEER_INFO_RATE_INFO])
-    {
-        ALOGE("%s: QCA_WLAN_VENDOR_ATTR_LL_STATS_PEER_INFO_RATE_INFO not found", __func__);
-        return WIFI_ERROR_INVALID_ARGS;
-    }
-    for (rateInfo = (struct nlattr *) nla_data(tb_vendor[QCA_WLAN_VENDOR_ATTR_LL_STATS_PEER_INFO_RATE_INFO]), rem = nla_len(tb_vendor[QCA_WLAN_VENDOR_ATTR_LL_STATS_PEER_INFO_RATE_INFO]);
-            nla_ok(rateInfo, rem);
-            rateInfo = nla_next(rateInfo, &(rem)))
+    nla_for_each_nested(rateInfo, slot[LL_STATS_SLOT_LIST], rem)
     {
-        struct nlattr *tb2[ QCA_WLAN_VENDOR_ATTR_LL_STATS_MAX+ 1];
-        pRateStats = (wifi_rate_stat *) ((u8 *)stats->rate_stats + (i++ * sizeof(wifi_rate_stat)));
-
-        nla_parse(tb2, QCA_WLAN_VENDOR_ATTR_LL_STATS_MAX, (struct nlattr *) nla_data(rateInfo), nla_len(rateInfo), NULL);
-        ret = get_wifi_rate_stat(pRateStats, tb2);
+        if (i >= stats->num_rate)
+        {
+            ALOGE("%s: more rates than the %u announced", __func__,
+                    stats->num_rate);
+            break;
+        }
+        ret = attr_decode_nested(&ll_stats_rate_schema, &stats->rate_stats[i],
+                NULL, rateInfo);
         if(ret != WIFI_SUCCESS)
         {
             return ret;
         }
+        log_wifi_rate_stat(&stats->rate_stats[i++]);
     }
     return WIFI_SUCCESS;
 }
 
-int LLStatsCommand::get_wifi_iface_stats(wifi_iface_stat *stats, struct nlattr **tb_vendor)
+static int get_wifi_iface_stats(wifi_iface_stat *stats, struct nlattr **slot,
+                                struct nlattr *data, int len)
 {
     struct nlattr *wmmInfo;
-    wifi_wmm_ac_stat *pWmmStats;
-    int i=0, rem;
-    int ret = WIFI_SUCCESS;
-
-    if (!tb_vendor[QCA_WLAN_VENDOR_ATTR_LL_STATS_IFACE_BEACON_RX])
-    {
-        ALOGE("%s: QCA_WLAN_VENDOR_ATTR_LL_STATS_IFACE_BEACON_RX"
-                "not found", __func__);
-        return WIFI_ERROR_INVALID_ARGS;
-    }
-    stats->beacon_rx = nla_get_u32(tb_vendor[
-            QCA_WLAN_VENDOR_ATTR_LL_STATS_IFACE_BEACON_RX]);
-    if (!tb_vendor[QCA_WLAN_VENDOR_ATTR_LL_STATS_IFACE_MGMT_RX])
-    {
-        ALOGE("%s: QCA_WLAN_VENDOR_ATTR_LL_STATS_IFACE_MGMT_RX"
-                " not found", __func__);
-        return WIFI_ERROR_INVALID_ARGS;
-    }
-    stats->mgmt_rx         = nla_get_u32(tb_vendor[
-            QCA_WLAN_VENDOR_ATTR_LL_STATS_IFACE_MGMT_RX]);
-
-    if (!tb_vendor[
-            QCA_WLAN_VENDOR_ATTR_LL_STATS_IFACE_MGMT_ACTION_RX])
-    {
-        ALOGE("%s: "
-                "QCA_WLAN_VENDOR_ATTR_LL_STATS_IFACE_MGMT_ACTION_RX"
-                " not found", __func__);
-        return WIFI_ERROR_INVALID_ARGS;
-    }
-    stats->mgmt_action_rx  = nla_get_u32(tb_vendor[
-            QCA_WLAN_VENDOR_ATTR_LL_STATS_IFACE_MGMT_ACTION_RX]);
-
-    if (!tb_vendor[
-            QCA_WLAN_VENDOR_ATTR_LL_STATS_IFACE_MGMT_ACTION_TX])
-    {
-        ALOGE("%s: "
-                "QCA_WLAN_VENDOR_ATTR_LL_STATS_IFACE_MGMT_ACTION_TX"
-                " not found", __func__);
-        return WIFI_ERROR_INVALID_ARGS;
-    }
-    stats->mgmt_action_tx  = nla_get_u32(tb_vendor[
-            QCA_WLAN_VENDOR_ATTR_LL_STATS_IFACE_MGMT_ACTION_TX]);
+    int i = 0, rem;
+    int ret;
 
-    if (!tb_vendor[QCA_WLAN_VENDOR_ATTR_LL_STATS_IFACE_RSSI_MGMT])
-    {
-        ALOGE("%s: QCA_WLAN_VENDOR_ATTR_LL_STATS_IFACE_RSSI_MGMT"
-                " not found", __func__);
-        return WIFI_ERROR_INVALID_ARGS;
-    }
-    stats->rssi_mgmt       = get_s32(tb_vendor[
-            QCA_WLAN_VENDOR_ATTR_LL_STATS_IFACE_RSSI_MGMT]);
-
-    if (!tb_vendor[QCA_WLAN_VENDOR_ATTR_LL_STATS_IFACE_RSSI_DATA])
-    {
-        ALOGE("%s: QCA_WLAN_VENDOR_ATTR_LL_STATS_IFACE_RSSI_DATA"
-                " not found", __func__);
-        return WIFI_ERROR_INVALID_ARGS;
-    }
-    stats->rssi_data       = get_s32(tb_vendor[
-            QCA_WLAN_VENDOR_ATTR_LL_STATS_IFACE_RSSI_DATA]);
+    ret = attr_decode(&ll_stats_iface_schema, stats, slot, data, len);
+    if (ret != WIFI_SUCCESS)
+        return ret;
 
-    if (!tb_vendor[QCA_WLAN_VENDOR_ATTR_LL_STATS_IFACE_RSSI_ACK])
-    {
-        ALOGE("%s: QCA_WLAN_VENDOR_ATTR_LL_STATS_IFACE_RSSI_ACK"
-                " not found", __func__);
-        return WIFI_ERROR_INVALID_ARGS;
-    }
-    stats->rssi_ack        = get_s32(tb_vendor[
-            QCA_WLAN_VENDOR_ATTR_LL_STATS_IFACE_RSSI_ACK]);
-
-    ALOGI("STATS IFACE: beaconRx : %u ", stats->beacon_rx);
-    ALOGI("STATS IFACE: mgmtRx %u ", stats->mgmt_rx);
-    ALOGI("STATS IFACE: mgmtActionRx  %u ", stats->mgmt_action_rx);
-    ALOGI("STATS IFACE: mgmtActionTx %u ", stats->mgmt_action_tx);
-    ALOGI("STATS IFACE: rssiMgmt %d ", stats->rssi_mgmt);
-    ALOGI("STATS IFACE: rssiData %d ", stats->rssi_data);
-    ALOGI("STATS IFACE: rssiAck  %d ", stats->rssi_ack);
-
-    if (!tb_vendor[QCA_WLAN_VENDOR_ATTR_LL_STATS_WMM_INFO])
-    {
-        ALOGE("%s: QCA_WLAN_VENDOR_ATTR_LL_STATS_WMM_INFO"
-                " not found", __func__);
-        return WIFI_ERROR_INVALID_ARGS;
-    }
+    log_wifi_interface_info(&stats->info);
+    HAL_LOGV(HAL_LOG_LLSTATS, "STATS IFACE: beaconRx : %u ", stats->beacon_rx);
+    HAL_LOGV(HAL_LOG_LLSTATS, "STATS IFACE: mgmtRx %u ", stats->mgmt_rx);
+    HAL_LOGV(HAL_LOG_LLSTATS, "STATS IFACE: mgmtActionRx  %u ", stats->mgmt_action_rx);
+    HAL_LOGV(HAL_LOG_LLSTATS, "STATS IFACE: mgmtActionTx %u ", stats->mgmt_action_tx);
+    HAL_LOGV(HAL_LOG_LLSTATS, "STATS IFACE: rssiMgmt %d ", stats->rssi_mgmt);
+    HAL_LOGV(HAL_LOG_LLSTATS, "STATS IFACE: rssiData %d ", stats->rssi_data);
+    HAL_LOGV(HAL_LOG_LLSTATS, "STATS IFACE: rssiAck  %d ", stats->rssi_ack);
 
-    for (wmmInfo = (struct nlattr *) nla_data(tb_vendor[
-                QCA_WLAN_VENDOR_ATTR_LL_STATS_WMM_INFO]),
-            rem = nla_len(tb_vendor[
-                QCA_WLAN_VENDOR_ATTR_LL_STATS_WMM_INFO]);
-            nla_ok(wmmInfo, rem);
-            wmmInfo = nla_next(wmmInfo, &(rem)))
+    nla_for_each_nested(wmmInfo, slot[LL_STATS_SLOT_LIST], rem)
     {
-        struct nlattr *tb2[ QCA_WLAN_VENDOR_ATTR_LL_STATS_MAX+ 1];
-        pWmmStats = (wifi_wmm_ac_stat *) ((u8 *)stats->ac
-                + (i++ * sizeof(wifi_wmm_ac_stat)));
-        nla_parse(tb2, QCA_WLAN_VENDOR_ATTR_LL_STATS_MAX,
-                (struct nlattr *) nla_data(wmmInfo),
-                nla_len(wmmInfo), NULL);
-        ret = get_wifi_wmm_ac_stat(pWmmStats, tb2);
+        if (i >= WIFI_AC_MAX)
+        {
+            ALOGE("%s: more than %d access categories", __func__, WIFI_AC_MAX);
+            break;
+        }
+        ret = attr_decode_nested(&ll_stats_wmm_ac_schema, &stats->ac[i],
+                NULL, wmmInfo);
         if(ret != WIFI_SUCCESS)
         {
             return ret;
         }
+        log_wifi_wmm_ac_stat(&stats->ac[i++]);
     }
 
     return WIFI_SUCCESS;
 }
 
-static int get_wifi_radio_stats(wifi_radio_stat *stats, struct nlattr **tb_vendor)
+static int get_wifi_radio_stats(wifi_radio_stat *stats, struct nlattr *data,
+                                int len)
 {
-    u32 i = 0;
+    struct nlattr *slot[LL_STATS_SLOT_MAX];
     struct nlattr *chInfo;
-    wifi_channel_stat *pChStats;
+    u32 i = 0;
     int rem;
-    int ret = WIFI_SUCCESS;
-
-    if (!tb_vendor[QCA_WLAN_VENDOR_ATTR_LL_STATS_RADIO_ID])
-    {
-        ALOGE("%s: QCA_WLAN_VENDOR_ATTR_LL_STATS_RADIO_ID not found", __func__);
-        return WIFI_ERROR_INVALID_ARGS;
-    }
-    stats->radio             = nla_get_u32(tb_vendor[QCA_WLAN_VENDOR_ATTR_LL_STATS_RADIO_ID]);
-
-    if (!tb_vendor[QCA_WLAN_VENDOR_ATTR_LL_STATS_RADIO_ON_TIME])
-    {
-        ALOGE("%s: QCA_WLAN_VENDOR_ATTR_LL_STATS_RADIO_ON_TIME not found", __func__);
-        return WIFI_ERROR_INVALID_ARGS;
-    }
-    stats->on_time           = nla_get_u32(tb_vendor[QCA_WLAN_VENDOR_ATTR_LL_STATS_RADIO_ON_TIME]);
-
-    if (!tb_vendor[QCA_WLAN_VENDOR_ATTR_LL_STATS_RADIO_TX_TIME])
-    {
-        ALOGE("%s: QCA_WLAN_VENDOR_ATTR_LL_STATS_RADIO_TX_TIME not found", __func__);
-        return WIFI_ERROR_INVALID_ARGS;
-    }
-    stats->tx_time           = nla_get_u32(tb_vendor[QCA_WLAN_VENDOR_ATTR_LL_STATS_RADIO_TX_TIME]);
-
-    if (!tb_vendor[QCA_WLAN_VENDOR_ATTR_LL_STATS_RADIO_RX_TIME])
-    {
-        ALOGE("%s: QCA_WLAN_VENDOR_ATTR_LL_STATS_RADIO_RX_TIME not found", __func__);
-        return WIFI_ERROR_INVALID_ARGS;
-    }
-    stats->rx_time           = nla_get_u32(tb_vendor[QCA_WLAN_VENDOR_ATTR_LL_STATS_RADIO_RX_TIME]);
-
-    if (!tb_vendor[QCA_WLAN_VENDOR_ATTR_LL_STATS_RADIO_ON_TIME_SCAN])
-    {
-        ALOGE("%s: QCA_WLAN_VENDOR_ATTR_LL_STATS_RADIO_ON_TIME_SCAN not found", __func__);
-        return WIFI_ERROR_INVALID_ARGS;
-    }
-    stats->on_time_scan      = nla_get_u32(tb_vendor[QCA_WLAN_VENDOR_ATTR_LL_STATS_RADIO_ON_TIME_SCAN]);
-
-    if (!tb_vendor[QCA_WLAN_VENDOR_ATTR_LL_STATS_RADIO_ON_TIME_NBD])
-    {
-        ALOGE("%s: QCA_WLAN_VENDOR_ATTR_LL_STATS_RADIO_ON_TIME_NBD not found", __func__);
-        return WIFI_ERROR_INVALID_ARGS;
-    }
-    stats->on_time_nbd       = nla_get_u32(tb_vendor[QCA_WLAN_VENDOR_ATTR_LL_STATS_RADIO_ON_TIME_NBD]);
-
-    if (!tb_vendor[QCA_WLAN_VENDOR_ATTR_LL_STATS_RADIO_ON_TIME_GSCAN])
-    {
-        ALOGE("%s: QCA_WLAN_VENDOR_ATTR_LL_STATS_RADIO_ON_TIME_GSCAN not found", __func__);
-        return WIFI_ERROR_INVALID_ARGS;
-    }
-    stats->on_time_gscan     = nla_get_u32(tb_vendor[QCA_WLAN_VENDOR_ATTR_LL_STATS_RADIO_ON_TIME_GSCAN]);
-
-    if (!tb_vendor[QCA_WLAN_VENDOR_ATTR_LL_STATS_RADIO_ON_TIME_ROAM_SCAN])
-    {
-        ALOGE("%s: QCA_WLAN_VENDOR_ATTR_LL_STATS_RADIO_ON_TIME_ROAM_SCAN not found", __func__);
-        return WIFI_ERROR_INVALID_ARGS;
-    }
-    stats->on_time_roam_scan = nla_get_u32(tb_vendor[QCA_WLAN_VENDOR_ATTR_LL_STATS_RADIO_ON_TIME_ROAM_SCAN]);
-
-    if (!tb_vendor[QCA_WLAN_VENDOR_ATTR_LL_STATS_RADIO_ON_TIME_PNO_SCAN])
-    {
-        ALOGE("%s: QCA_WLAN_VENDOR_ATTR_LL_STATS_RADIO_ON_TIME_PNO_SCAN not found", __func__);
-        return WIFI_ERROR_INVALID_ARGS;
-    }
-    stats->on_time_pno_scan  = nla_get_u32(tb_vendor[QCA_WLAN_VENDOR_ATTR_LL_STATS_RADIO_ON_TIME_PNO_SCAN]);
-
-    if (!tb_vendor[QCA_WLAN_VENDOR_ATTR_LL_STATS_RADIO_ON_TIME_HS20])
-    {
-        ALOGE("%s: QCA_WLAN_VENDOR_ATTR_LL_STATS_RADIO_ON_TIME_HS20 not found", __func__);
-        return WIFI_ERROR_INVALID_ARGS;
-    }
-    stats->on_time_hs20      = nla_get_u32(tb_vendor[QCA_WLAN_VENDOR_ATTR_LL_STATS_RADIO_ON_TIME_HS20]);
-
-
-    if (!tb_vendor[QCA_WLAN_VENDOR_ATTR_LL_STATS_RADIO_NUM_CHANNELS])
-    {
-        ALOGE("%s: QCA_WLAN_VENDOR_ATTR_LL_STATS_RADIO_NUM_CHANNELS not found", __func__);
-        return WIFI_ERROR_INVALID_ARGS;
-    }
-    stats->num_channels                           = nla_get_u32(tb_vendor[QCA_WLAN_VENDOR_ATTR_LL_STATS_RADIO_NUM_CHANNELS]);
+    int ret;
 
+    ret = attr_decode(&ll_stats_radio_schema, stats, slot, data, len);
+    if (ret != WIFI_SUCCESS)
+        return ret;
 
-    if (!tb_vendor[QCA_WLAN_VENDOR_ATTR_LL_STATS_CH_INFO])
-    {
-        ALOGE("%s: QCA_WLAN_VENDOR_ATTR_LL_STATS_CH_INFO not found", __func__);
-        return WIFI_ERROR_INVALID_ARGS;
-    }
-    for (chInfo = (struct nlattr *) nla_data(tb_vendor[QCA_WLAN_VENDOR_ATTR_LL_STATS_CH_INFO]), rem = nla_len(tb_vendor[QCA_WLAN_VENDOR_ATTR_LL_STATS_CH_INFO]);
-            nla_ok(chInfo, rem);
-            chInfo = nla_next(chInfo, &(rem)))
+    nla_for_each_nested(chInfo, slot[LL_STATS_SLOT_LIST], rem)
     {
-        struct nlattr *tb2[ QCA_WLAN_VENDOR_ATTR_LL_STATS_MAX+ 1];
-        pChStats = (wifi_channel_stat *) ((u8 *)stats->channels + (i++ * (sizeof(wifi_channel_stat))));
-        nla_parse(tb2, QCA_WLAN_VENDOR_ATTR_LL_STATS_MAX, (struct nlattr *) nla_data(chInfo), nla_len(chInfo), NULL);
-
-        if (!tb2[QCA_WLAN_VENDOR_ATTR_LL_STATS_CHANNEL_INFO_WIDTH])
-        {
-            ALOGE("%s: QCA_WLAN_VENDOR_ATTR_LL_STATS_CHANNEL_INFO_WIDTH not found", __func__);
-            return WIFI_ERROR_INVALID_ARGS;
-        }
-        pChStats->channel.width                  = (wifi_channel_width)nla_get_u32(tb2[QCA_WLAN_VENDOR_ATTR_LL_STATS_CHANNEL_INFO_WIDTH]);
-
-        if (!tb2[QCA_WLAN_VENDOR_ATTR_LL_STATS_CHANNEL_INFO_CENTER_FREQ])
-        {
-            ALOGE("%s: QCA_WLAN_VENDOR_ATTR_LL_STATS_CHANNEL_INFO_CENTER_FREQ not found", __func__);
-            return WIFI_ERROR_INVALID_ARGS;
-        }
-        pChStats->channel.center_freq            = (wifi_channel)nla_get_u32(tb2[QCA_WLAN_VENDOR_ATTR_LL_STATS_CHANNEL_INFO_CENTER_FREQ]);
-
-        if (!tb2[QCA_WLAN_VENDOR_ATTR_LL_STATS_CHANNEL_INFO_CENTER_FREQ0])
-        {
-            ALOGE("%s: QCA_WLAN_VENDOR_ATTR_LL_STATS_CHANNEL_INFO_CENTER_FREQ0 not found", __func__);
-            return WIFI_ERROR_INVALID_ARGS;
-        }
-        pChStats->channel.center_freq0           = (wifi_channel)nla_get_u32(tb2[QCA_WLAN_VENDOR_ATTR_LL_STATS_CHANNEL_INFO_CENTER_FREQ0]);
-
-        if (!tb2[QCA_WLAN_VENDOR_ATTR_LL_STATS_CHANNEL_INFO_CENTER_FREQ1])
-        {
-            ALOGE("%s: QCA_WLAN_VENDOR_ATTR_LL_STATS_CHANNEL_INFO_CENTER_FREQ1 not found", __func__);
-            return WIFI_ERROR_INVALID_ARGS;
-        }
-        pChStats->channel.center_freq1           = (wifi_channel)nla_get_u32(tb2[QCA_WLAN_VENDOR_ATTR_LL_STATS_CHANNEL_INFO_CENTER_FREQ1]);
-
-        if (!tb2[QCA_WLAN_VENDOR_ATTR_LL_STATS_CHANNEL_ON_TIME])
+        if (i >= stats->num_channels)
         {
-            ALOGE("%s: QCA_WLAN_VENDOR_ATTR_LL_STATS_CHANNEL_ON_TIME not found", __func__);
-            return WIFI_ERROR_INVALID_ARGS;
+            ALOGE("%s: more channels than the %u announced", __func__,
+                    stats->num_channels);
+            break;
         }
-        pChStats->on_time                = nla_get_u32(tb2[QCA_WLAN_VENDOR_ATTR_LL_STATS_CHANNEL_ON_TIME]);
-
-        if (!tb2[QCA_WLAN_VENDOR_ATTR_LL_STATS_CHANNEL_CCA_BUSY_TIME])
+        ret = attr_decode_nested(&ll_stats_channel_schema,
+                &stats->channels[i++], NULL, chInfo);
+        if(ret != WIFI_SUCCESS)
         {
-            ALOGE("%s: QCA_WLAN_VENDOR_ATTR_LL_STATS_CHANNEL_CCA_BUSY_TIME not found", __func__);
-            return WIFI_ERROR_INVALID_ARGS;
+            return ret;
         }
-        pChStats->cca_busy_time          = nla_get_u32(tb2[QCA_WLAN_VENDOR_ATTR_LL_STATS_CHANNEL_CCA_BUSY_TIME]);
     }
     return WIFI_SUCCESS;
 }
@@ -791,7 +441,7 @@ static int get_wifi_radio_stats(wifi_radio_stat *stats, struct nlattr **tb_vendo
 //Call the appropriate callback handler after parsing the vendor data.
 int LLStatsCommand::handleEvent(WifiEvent &event)
 {
-    ALOGI("Got a LLStats message from Driver");
+    HAL_LOGD(HAL_LOG_LLSTATS, "Got a LLStats message from Driver");
     unsigned i=0;
     u32 status;
     int ret = WIFI_SUCCESS;
@@ -803,25 +453,23 @@ int LLStatsCommand::handleEvent(WifiEvent &event)
     {
         case QCA_NL80211_VENDOR_SUBCMD_LL_STATS_RADIO_RESULTS:
             {
-                wifi_request_id id;
                 u32 resultsBufSize = 0;
-                struct nlattr *tb_vendor[QCA_WLAN_VENDOR_ATTR_LL_STATS_MAX + 1];
-                int rem;
-                nla_parse(tb_vendor, QCA_WLAN_VENDOR_ATTR_LL_STATS_MAX,
-                        (struct nlattr *)mVendorData,
-                        mDataLen, NULL);
+                struct nlattr *numChannels;
 
-                ALOGI("QCA_NL80211_VENDOR_SUBCMD_LL_STATS_RADIO_RESULTS Received");
-                if (!tb_vendor[QCA_WLAN_VENDOR_ATTR_LL_STATS_RADIO_NUM_CHANNELS])
+                HAL_LOGD(HAL_LOG_LLSTATS, "QCA_NL80211_VENDOR_SUBCMD_LL_STATS_RADIO_RESULTS Received");
+                /* Sizes the buffer; the decode below validates the rest. */
+                numChannels = nla_find((struct nlattr *)mVendorData, mDataLen,
+                        QCA_WLAN_VENDOR_ATTR_LL_STATS_RADIO_NUM_CHANNELS);
+                if (!numChannels || nla_len(numChannels) < (int)sizeof(u32))
                 {
                     ALOGE("%s: QCA_WLAN_VENDOR_ATTR_LL_STATS_RADIO_NUM_CHANNELS not found", __func__);
                     return WIFI_ERROR_INVALID_ARGS;
                 }
 
-                ALOGI(" NumChan is %d\n ",
-                        nla_get_u32(tb_vendor[QCA_WLAN_VENDOR_ATTR_LL_STATS_RADIO_NUM_CHANNELS]));
+                HAL_LOGV(HAL_LOG_LLSTATS, " NumChan is %d\n ",
+                        nla_get_u32(numChannels));
 
-                resultsBufSize += (nla_get_u32(tb_vendor[QCA_WLAN_VENDOR_ATTR_LL_STATS_RADIO_NUM_CHANNELS]) * sizeof(wifi_channel_stat)
+                resultsBufSize += (nla_get_u32(numChannels) * sizeof(wifi_channel_stat)
                         + sizeof(wifi_radio_stat));
                 mResultsParams.radio_stat = (wifi_radio_stat *)malloc(resultsBufSize);
                 if (!mResultsParams.radio_stat)
@@ -830,52 +478,48 @@ int LLStatsCommand::handleEvent(WifiEvent &event)
                     return WIFI_ERROR_OUT_OF_MEMORY;
                 }
                 memset(mResultsParams.radio_stat, 0, resultsBufSize);
-                ALOGI(" rxTime is %u\n ", mResultsParams.radio_stat->rx_time);
 
                 wifi_channel_stat *pWifiChannelStats;
                 u32 i =0;
-                ret = get_wifi_radio_stats(mResultsParams.radio_stat, tb_vendor);
+                ret = get_wifi_radio_stats(mResultsParams.radio_stat,
+                        (struct nlattr *)mVendorData, mDataLen);
                 if(ret != WIFI_SUCCESS)
                 {
                     return ret;
                 }
 
-                ALOGI(" radio is %u ", mResultsParams.radio_stat->radio);
-                ALOGI(" onTime is %u ", mResultsParams.radio_stat->on_time);
-                ALOGI(" txTime is %u ", mResultsParams.radio_stat->tx_time);
-                ALOGI(" rxTime is %u ", mResultsParams.radio_stat->rx_time);
-                ALOGI(" onTimeScan is %u ", mResultsParams.radio_stat->on_time_scan);
-                ALOGI(" onTimeNbd is %u ", mResultsParams.radio_stat->on_time_nbd);
-                ALOGI(" onTimeGscan is %u ", mResultsParams.radio_stat->on_time_gscan);
-                ALOGI(" onTimeRoamScan is %u", mResultsParams.radio_stat->on_time_roam_scan);
-                ALOGI(" onTimePnoScan is %u ", mResultsParams.radio_stat->on_time_pno_scan);
-                ALOGI(" onTimeHs20 is %u ", mResultsParams.radio_stat->on_time_hs20);
-                ALOGI(" numChannels is %u ", mResultsParams.radio_stat->num_channels);
+                HAL_LOGV(HAL_LOG_LLSTATS, " radio is %u ", mResultsParams.radio_stat->radio);
+                HAL_LOGV(HAL_LOG_LLSTATS, " onTime is %u ", mResultsParams.radio_stat->on_time);
+                HAL_LOGV(HAL_LOG_LLSTATS, " txTime is %u ", mResultsParams.radio_stat->tx_time);
+                HAL_LOGV(HAL_LOG_LLSTATS, " rxTime is %u ", mResultsParams.radio_stat->rx_time);
+                HAL_LOGV(HAL_LOG_LLSTATS, " onTimeScan is %u ", mResultsParams.radio_stat->on_time_scan);
+                HAL_LOGV(HAL_LOG_LLSTATS, " onTimeNbd is %u ", mResultsParams.radio_stat->on_time_nbd);
+                HAL_LOGV(HAL_LOG_LLSTATS, " onTimeGscan is %u ", mResultsParams.radio_stat->on_time_gscan);
+                HAL_LOGV(HAL_LOG_LLSTATS, " onTimeRoamScan is %u", mResultsParams.radio_stat->on_time_roam_scan);
+                HAL_LOGV(HAL_LOG_LLSTATS, " onTimePnoScan is %u ", mResultsParams.radio_stat->on_time_pno_scan);
+                HAL_LOGV(HAL_LOG_LLSTATS, " onTimeHs20 is %u ", mResultsParams.radio_stat->on_time_hs20);
+                HAL_LOGV(HAL_LOG_LLSTATS, " numChannels is %u ", mResultsParams.radio_stat->num_channels);
                 for ( i=0; i < mResultsParams.radio_stat->num_channels; i++)
                 {
-                    pWifiChannelStats = (wifi_channel_stat *) ((u8 *)mResultsParams.radio_stat->channels + (i * sizeof(wifi_channel_stat)));
-
-                    ALOGI("  width is %u ", pWifiChannelStats->channel.width);
-                    ALOGI("  CenterFreq %u ", pWifiChannelStats->channel.center_freq);
-                    ALOGI("  CenterFreq0 %u ", pWifiChannelStats->channel.center_freq0);
-                    ALOGI("  CenterFreq1 %u ", pWifiChannelStats->channel.center_freq1);
-                    ALOGI("  onTime %u ", pWifiChannelStats->on_time);
-                    ALOGI("  ccaBusyTime %u ", pWifiChannelStats->cca_busy_time);
+                    pWifiChannelStats = &mResultsParams.radio_stat->channels[i];
+
+                    HAL_LOGV(HAL_LOG_LLSTATS, "  width is %u ", pWifiChannelStats->channel.width);
+                    HAL_LOGV(HAL_LOG_LLSTATS, "  CenterFreq %u ", pWifiChannelStats->channel.center_freq);
+                    HAL_LOGV(HAL_LOG_LLSTATS, "  CenterFreq0 %u ", pWifiChannelStats->channel.center_freq0);
+                    HAL_LOGV(HAL_LOG_LLSTATS, "  CenterFreq1 %u ", pWifiChannelStats->channel.center_freq1);
+                    HAL_LOGV(HAL_LOG_LLSTATS, "  onTime %u ", pWifiChannelStats->on_time);
+                    HAL_LOGV(HAL_LOG_LLSTATS, "  ccaBusyTime %u ", pWifiChannelStats->cca_busy_time);
                 }
-                ALOGI(" rxTime is %u in %s:%d\n", mResultsParams.radio_stat->rx_time, __func__, __LINE__);
+                HAL_LOGV(HAL_LOG_LLSTATS, " rxTime is %u in %s:%d\n", mResultsParams.radio_stat->rx_time, __func__, __LINE__);
             }
             break;
 
         case QCA_NL80211_VENDOR_SUBCMD_LL_STATS_IFACE_RESULTS:
             {
-                wifi_request_id id;
                 u32 resultsBufSize = 0;
-                struct nlattr *tb_vendor[QCA_WLAN_VENDOR_ATTR_LL_STATS_MAX + 1];
-                nla_parse(tb_vendor, QCA_WLAN_VENDOR_ATTR_LL_STATS_MAX,
-                        (struct nlattr *)mVendorData,
-                        mDataLen, NULL);
+                struct nlattr *slot[LL_STATS_SLOT_MAX];
 
-                ALOGI("QCA_NL80211_VENDOR_SUBCMD_LL_STATS_IFACE_RESULTS"
+                HAL_LOGD(HAL_LOG_LLSTATS, "QCA_NL80211_VENDOR_SUBCMD_LL_STATS_IFACE_RESULTS"
                         " Received");
                 resultsBufSize = sizeof(wifi_iface_stat);
                 mResultsParams.iface_stat =
@@ -886,36 +530,32 @@ int LLStatsCommand::handleEvent(WifiEvent &event)
                     return WIFI_ERROR_OUT_OF_MEMORY;
                 }
                 memset(mResultsParams.iface_stat, 0, resultsBufSize);
-                ret = get_wifi_interface_info(&mResultsParams.iface_stat->info,
-                        tb_vendor);
-                if(ret != WIFI_SUCCESS)
-                {
-                   return ret;
-                }
-                ret = get_wifi_iface_stats(mResultsParams.iface_stat, tb_vendor);
+                ret = get_wifi_iface_stats(mResultsParams.iface_stat, slot,
+                        (struct nlattr *)mVendorData, mDataLen);
                 if(ret != WIFI_SUCCESS)
                 {
                    return ret;
                 }
-                if (!tb_vendor[QCA_WLAN_VENDOR_ATTR_LL_STATS_IFACE_NUM_PEERS])
+                if (!slot[LL_STATS_SLOT_NUM_PEERS] ||
+                    nla_len(slot[LL_STATS_SLOT_NUM_PEERS]) < (int)sizeof(u32))
                 {
                     ALOGE("%s: QCA_WLAN_VENDOR_ATTR_LL_STATS_IFACE_NUM_PEERS"
                             " not found", __func__);
                     ALOGE("Expecting Peer stats event");
                 } else {
                     mResultsParams.iface_stat->num_peers =
-                        nla_get_u32(tb_vendor[
-                                QCA_WLAN_VENDOR_ATTR_LL_STATS_IFACE_NUM_PEERS]);
-                    ALOGI("%s: numPeers is %u\n", __func__,
+                        nla_get_u32(slot[LL_STATS_SLOT_NUM_PEERS]);
+                    HAL_LOGV(HAL_LOG_LLSTATS, "%s: numPeers is %u\n", __func__,
                             mResultsParams.iface_stat->num_peers);
                     if(mResultsParams.iface_stat->num_peers == 0)
                     {
                         ALOGE("Not Expecting Peer stats event");
                         // Number of Radios are 1 for now
-                        mHandler.on_link_stats_results(mRequestId,
-                                mResultsParams.iface_stat,
-                                1,
-                                mResultsParams.radio_stat);
+                        if (mHandler.on_link_stats_results)
+                            mHandler.on_link_stats_results(mRequestId,
+                                    mResultsParams.iface_stat,
+                                    1,
+                                    mResultsParams.radio_stat);
                         if(mResultsParams.radio_stat)
                         {
                             free(mResultsParams.radio_stat);
@@ -930,51 +570,52 @@ int LLStatsCommand::handleEvent(WifiEvent &event)
 
         case QCA_NL80211_VENDOR_SUBCMD_LL_STATS_PEERS_RESULTS:
             {
-                wifi_request_id id;
                 u32 resultsBufSize = 0, i=0, num_rates = 0;
                 u32 numPeers;
                 int rem;
-                struct nlattr *tb_vendor[QCA_WLAN_VENDOR_ATTR_LL_STATS_MAX + 1];
+                struct nlattr *slot[LL_STATS_SLOT_MAX];
                 struct nlattr *peerInfo;
                 wifi_iface_stat *pIfaceStat;
-                nla_parse(tb_vendor, QCA_WLAN_VENDOR_ATTR_LL_STATS_MAX,
-                        (struct nlattr *)mVendorData,
-                        mDataLen, NULL);
 
-                ALOGI("QCA_NL80211_VENDOR_SUBCMD_LL_STATS_PEERS_RESULTS Received");
-                if (!tb_vendor[QCA_WLAN_VENDOR_ATTR_LL_STATS_IFACE_NUM_PEERS])
+                HAL_LOGD(HAL_LOG_LLSTATS, "QCA_NL80211_VENDOR_SUBCMD_LL_STATS_PEERS_RESULTS Received");
+                ret = attr_decode(&ll_stats_peers_event_schema, NULL, slot,
+                        (struct nlattr *)mVendorData, mDataLen);
+                if (ret != WIFI_SUCCESS)
+                    return ret;
+                if (nla_len(slot[LL_STATS_SLOT_NUM_PEERS]) < (int)sizeof(u32))
                 {
-                    ALOGE("%s: QCA_WLAN_VENDOR_ATTR_LL_STATS_IFACE_NUM_PEERS not found", __func__);
+                    ALOGE("%s: QCA_WLAN_VENDOR_ATTR_LL_STATS_IFACE_NUM_PEERS too short", __func__);
                     return WIFI_ERROR_INVALID_ARGS;
                 }
-                ALOGI(" numPeers is %u in %s:%d\n", nla_get_u32(tb_vendor[QCA_WLAN_VENDOR_ATTR_LL_STATS_IFACE_NUM_PEERS]), __func__, __LINE__);
+                numPeers = nla_get_u32(slot[LL_STATS_SLOT_NUM_PEERS]);
+                HAL_LOGV(HAL_LOG_LLSTATS, " numPeers is %u in %s:%d\n", numPeers, __func__, __LINE__);
 
-                if (!tb_vendor[QCA_WLAN_VENDOR_ATTR_LL_STATS_IFACE_NUM_PEERS])
-                {
-                    ALOGE("%s: QCA_WLAN_VENDOR_ATTR_LL_STATS_IFACE_NUM_PEERS not found", __func__);
-                    return WIFI_ERROR_INVALID_ARGS;
-                }
-                if((numPeers = nla_get_u32(tb_vendor[QCA_WLAN_VENDOR_ATTR_LL_STATS_IFACE_NUM_PEERS])) > 0)
+                if(numPeers > 0)
                 {
-                    if (!tb_vendor[QCA_WLAN_VENDOR_ATTR_LL_STATS_PEER_INFO])
+                    if (!slot[LL_STATS_SLOT_LIST])
                     {
                         ALOGE("%s: QCA_WLAN_VENDOR_ATTR_LL_STATS_PEER_INFO not found", __func__);
                         return WIFI_ERROR_INVALID_ARGS;
                     }
-                    for (peerInfo = (struct nlattr *) nla_data(tb_vendor[QCA_WLAN_VENDOR_ATTR_LL_STATS_PEER_INFO]), rem = nla_len(tb_vendor[QCA_WLAN_VENDOR_ATTR_LL_STATS_PEER_INFO]);
-                            nla_ok(peerInfo, rem);
-                            peerInfo = nla_next(peerInfo, &(rem)))
+                    nla_for_each_nested(peerInfo, slot[LL_STATS_SLOT_LIST], rem)
                     {
-                        struct nlattr *tb2[ QCA_WLAN_VENDOR_ATTR_LL_STATS_MAX+ 1];
-
-                        nla_parse(tb2, QCA_WLAN_VENDOR_ATTR_LL_STATS_MAX, (struct nlattr *) nla_data(peerInfo), nla_len(peerInfo), NULL);
+                        struct nlattr *numRates;
 
-                        if (!tb2[QCA_WLAN_VENDOR_ATTR_LL_STATS_PEER_INFO_NUM_RATES])
+                        if (i++ >= numPeers)
+                        {
+                            ALOGE("%s: more peers than the %u announced",
+                                    __func__, numPeers);
+                            break;
+                        }
+                        numRates = nla_find((struct nlattr *)nla_data(peerInfo),
+                                nla_len(peerInfo),
+                                QCA_WLAN_VENDOR_ATTR_LL_STATS_PEER_INFO_NUM_RATES);
+                        if (!numRates || nla_len(numRates) < (int)sizeof(u32))
                         {
                             ALOGE("%s: QCA_WLAN_VENDOR_ATTR_LL_STATS_PEER_INFO_NUM_RATES not found", __func__);
                             return WIFI_ERROR_INVALID_ARGS;
                         }
-                        num_rates += nla_get_u32(tb2[QCA_WLAN_VENDOR_ATTR_LL_STATS_PEER_INFO_NUM_RATES]);
+                        num_rates += nla_get_u32(numRates);
                     }
                     resultsBufSize += (numPeers * sizeof(wifi_peer_info)
                             + num_rates * sizeof(wifi_rate_stat) + sizeof (wifi_iface_stat));
@@ -985,27 +626,23 @@ int LLStatsCommand::handleEvent(WifiEvent &event)
                         return WIFI_ERROR_OUT_OF_MEMORY;
                     }
 
+                    i = 0;
                     memset(pIfaceStat, 0, resultsBufSize);
                     if(mResultsParams.iface_stat)
                         memcpy ( pIfaceStat, mResultsParams.iface_stat , sizeof(wifi_iface_stat));
                     wifi_peer_info *pPeerStats;
                     pIfaceStat->num_peers = numPeers;
 
-                    if (!tb_vendor[QCA_WLAN_VENDOR_ATTR_LL_STATS_PEER_INFO])
+                    nla_for_each_nested(peerInfo, slot[LL_STATS_SLOT_LIST], rem)
                     {
-                        ALOGE("%s: QCA_WLAN_VENDOR_ATTR_LL_STATS_PEER_INFO not found", __func__);
-                        return WIFI_ERROR_INVALID_ARGS;
-                    }
-                    for (peerInfo = (struct nlattr *) nla_data(tb_vendor[QCA_WLAN_VENDOR_ATTR_LL_STATS_PEER_INFO]), rem = nla_len(tb_vendor[QCA_WLAN_VENDOR_ATTR_LL_STATS_PEER_INFO]);
-                            nla_ok(peerInfo, rem);
-                            peerInfo = nla_next(peerInfo, &(rem)))
-                    {
-                        struct nlattr *tb2[ QCA_WLAN_VENDOR_ATTR_LL_STATS_MAX+ 1];
+                        /* the peers counted above */
+                        if (i >= numPeers)
+                            break;
                         pPeerStats = (wifi_peer_info *) ((u8 *)pIfaceStat->peer_info + (i++ * sizeof(wifi_peer_info)));
-                        nla_parse(tb2, QCA_WLAN_VENDOR_ATTR_LL_STATS_MAX, (struct nlattr *) nla_data(peerInfo), nla_len(peerInfo), NULL);
-                        ret = get_wifi_peer_info(pPeerStats, tb2);
+                        ret = get_wifi_peer_info(pPeerStats, peerInfo);
                         if(ret != WIFI_SUCCESS)
                         {
+                            free(pIfaceStat);
                             return ret;
                         }
                     }
@@ -1015,7 +652,9 @@ int LLStatsCommand::handleEvent(WifiEvent &event)
                 }
 
                 // Number of Radios are 1 for now
-                mHandler.on_link_stats_results(mRequestId,
+                /* NULL while a new request is being set up */
+                if (mHandler.on_link_stats_results)
+                    mHandler.on_link_stats_results(mRequestId,
                         mResultsParams.iface_stat, 1, mResultsParams.radio_stat);
                 if(mResultsParams.radio_stat)
                 {
@@ -1064,12 +703,17 @@ void LLStatsCommand::getClearRspParams(u32 *stats_clear_rsp_mask, u8 *stop_rsp)
 
 int LLStatsCommand::requestResponse()
 {
-    return WifiCommand::requestResponse(mMsg);
+    /* The stats are parsed on the thread reading cmd_sock while this one
+     * sleeps until the driver has acknowledged the request */
+    int res = sendRequest(mMsg);
+    if (res < 0)
+        return res;
+    return awaitResponse();
 }
 
 int LLStatsCommand::handleResponse(WifiEvent &reply)
 {
-    ALOGI("Got a LLStats message from Driver");
+    HAL_LOGD(HAL_LOG_LLSTATS, "Got a LLStats message from Driver");
     unsigned i=0;
     u32 status;
     WifiVendorCommand::handleResponse(reply);
@@ -1090,14 +734,14 @@ int LLStatsCommand::handleResponse(WifiEvent &reply)
                     ALOGE("%s: QCA_WLAN_VENDOR_ATTR_LL_STATS_CLR_CONFIG_RSP_MASK not found", __func__);
                     return WIFI_ERROR_INVALID_ARGS;
                 }
-                ALOGI("Resp mask : %d\n", nla_get_u32(tb_vendor[QCA_WLAN_VENDOR_ATTR_LL_STATS_CLR_CONFIG_RSP_MASK]));
+                HAL_LOGD(HAL_LOG_LLSTATS, "Resp mask : %d\n", nla_get_u32(tb_vendor[QCA_WLAN_VENDOR_ATTR_LL_STATS_CLR_CONFIG_RSP_MASK]));
 
                 if (!tb_vendor[QCA_WLAN_VENDOR_ATTR_LL_STATS_CLR_CONFIG_STOP_RSP])
                 {
                     ALOGE("%s: QCA_WLAN_VENDOR_ATTR_LL_STATS_CLR_CONFIG_STOP_RSP not found", __func__);
                     return WIFI_ERROR_INVALID_ARGS;
                 }
-                ALOGI("STOP resp : %d\n", nla_get_u32(tb_vendor[QCA_WLAN_VENDOR_ATTR_LL_STATS_CLR_CONFIG_STOP_RSP]));
+                HAL_LOGD(HAL_LOG_LLSTATS, "STOP resp : %d\n", nla_get_u32(tb_vendor[QCA_WLAN_VENDOR_ATTR_LL_STATS_CLR_CONFIG_STOP_RSP]));
 
                 if (!tb_vendor[QCA_WLAN_VENDOR_ATTR_LL_STATS_CLR_CONFIG_RSP_MASK])
                 {
@@ -1221,13 +865,8 @@ wifi_error wifi_get_link_stats(wifi_request_id id,
     /**/
     LLCommand->attr_end(nl_data);
 
-    ret = LLCommand->requestResponse();
-    if (ret != 0) {
-        ALOGE("%s: requestResponse Error:%d",__func__, ret);
-    }
-    if (ret < 0)
-        goto cleanup;
-
+    /* The results may follow the acknowledgement at once, so listen for
+     * them before asking */
     ret = LLCommand->setCallbackHandler(callbackHandler, QCA_NL80211_VENDOR_SUBCMD_LL_STATS_RADIO_RESULTS);
     if (ret < 0)
         goto cleanup;
@@ -1237,6 +876,11 @@ wifi_error wifi_get_link_stats(wifi_request_id id,
     ret = LLCommand->setCallbackHandler(callbackHandler, QCA_NL80211_VENDOR_SUBCMD_LL_STATS_PEERS_RESULTS);
     if (ret < 0)
         goto cleanup;
+
+    ret = LLCommand->requestResponse();
+    if (ret != 0) {
+        ALOGE("%s: requestResponse Error:%d",__func__, ret);
+    }
 cleanup:
     return (wifi_error)ret;
 }
@@ -1296,7 +940,7 @@ cleanup:
     LLCommand->unregisterHandler(QCA_NL80211_VENDOR_SUBCMD_LL_STATS_RADIO_RESULTS);
     LLCommand->unregisterHandler(QCA_NL80211_VENDOR_SUBCMD_LL_STATS_IFACE_RESULTS);
     LLCommand->unregisterHandler(QCA_NL80211_VENDOR_SUBCMD_LL_STATS_PEERS_RESULTS);
-    delete LLCommand;
+    LLCommand->release();
     return (wifi_error)ret;
 }
 
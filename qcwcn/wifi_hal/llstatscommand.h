@@ -100,6 +100,8 @@ public:
 
     virtual ~LLStatsCommand();
 
+    virtual void release();
+
     // This function implements creation of LLStats specific Request
     // based on  the request type
     virtual int create();
@@ -119,8 +121,6 @@ public:
     virtual void unregisterHandler(u32 subCmd);
 
     virtual void getClearRspParams(u32 *stats_clear_rsp_mask, u8 *stop_rsp);
-
-    virtual int get_wifi_iface_stats(wifi_iface_stat *stats, struct nlattr **tb_vendor);
 };
 
 #ifdef __cplusplus
@@ -405,6 +405,7 @@ NanCommand::NanCommand(wifi_handle handle, int id, u32 vendor_id, u32 subcmd)
         : WifiVendorCommand(handle, id, vendor_id, subcmd)
 {
     ALOGV("NanCommand %p constructed", this);
+    set_priority(CMD_PRIO_RANGING);
     memset(&mHandler, 0,sizeof(mHandler));
     mNanVendorEvent = NULL;
     mNanDataLen = 0;
@@ -32,10 +32,10 @@ int NanCommand::handleNanIndication()
     u16 msg_id;
     int res = 0;
 
-    ALOGI("handleNanIndication called %p", this);
+    HAL_LOGD(HAL_LOG_NAN, "handleNanIndication called %p", this);
     msg_id = getIndicationType();
 
-    ALOGI("handleNanIndication msg_id:%u", msg_id);
+    HAL_LOGD(HAL_LOG_NAN, "handleNanIndication msg_id:%u", msg_id);
     switch (msg_id) {
     case NAN_INDICATION_PUBLISH_REPLIED:
         NanPublishRepliedInd publishRepliedInd;
@@ -203,13 +203,13 @@ int NanCommand::getNanPublishReplied(NanPublishRepliedInd *event)
     //NAN_FURTHER_AVAILABILITY_MAP
     //NAN_CLUSTER_ATTRIBUTE
     if (remainingLen <= 0) {
-        ALOGI("%s: No TLV's present",__func__);
+        HAL_LOGD(HAL_LOG_NAN, "%s: No TLV's present",__func__);
         return WIFI_SUCCESS;
     }
-    ALOGI("%s: TLV remaining Len:%d",__func__, remainingLen);
+    HAL_LOGD(HAL_LOG_NAN, "%s: TLV remaining Len:%d",__func__, remainingLen);
     while ((remainingLen > 0) &&
            (0 != (readLen = NANTLV_ReadTlv(pInputTlv, &outputTlv)))) {
-        ALOGI("%s: Remaining Len:%d readLen:%d type:%d length:%d",
+        HAL_LOGD(HAL_LOG_NAN, "%s: Remaining Len:%d readLen:%d type:%d length:%d",
               __func__, remainingLen, readLen, outputTlv.type,
               outputTlv.length);
         switch (outputTlv.type) {
@@ -275,7 +275,7 @@ int NanCommand::getNanPublishReplied(NanPublishRepliedInd *event)
             event->cluster_attribute_len = outputTlv.length;
             break;
         default:
-            ALOGI("Unknown TLV type skipped");
+            HAL_LOGD(HAL_LOG_NAN, "Unknown TLV type skipped");
             break;
         }
         remainingLen -= readLen;
@@ -333,13 +333,13 @@ int NanCommand::getNanMatch(NanMatchInd *event)
 
     //Has SDF match filter and service specific info TLV
     if (remainingLen <= 0) {
-        ALOGI("%s: No TLV's present",__func__);
+        HAL_LOGD(HAL_LOG_NAN, "%s: No TLV's present",__func__);
         return WIFI_SUCCESS;
     }
-    ALOGI("%s: TLV remaining Len:%d",__func__, remainingLen);
+    HAL_LOGD(HAL_LOG_NAN, "%s: TLV remaining Len:%d",__func__, remainingLen);
     while ((remainingLen > 0) &&
            (0 != (readLen = NANTLV_ReadTlv(pInputTlv, &outputTlv)))) {
-        ALOGI("%s: Remaining Len:%d readLen:%d type:%d length:%d",
+        HAL_LOGD(HAL_LOG_NAN, "%s: Remaining Len:%d readLen:%d type:%d length:%d",
               __func__, remainingLen, readLen, outputTlv.type,
               outputTlv.length);
         switch (outputTlv.type) {
@@ -423,7 +423,7 @@ int NanCommand::getNanMatch(NanMatchInd *event)
             break;
 #endif /* NAN_2_0 */
         default:
-            ALOGI("Unknown TLV type skipped");
+            HAL_LOGD(HAL_LOG_NAN, "Unknown TLV type skipped");
             break;
         }
         remainingLen -= readLen;
@@ -492,13 +492,13 @@ int NanCommand::getNanFollowup(NanFollowupInd *event)
 
     //Has service specific info and extended service specific info TLV
     if (remainingLen <= 0) {
-        ALOGI("%s: No TLV's present",__func__);
+        HAL_LOGD(HAL_LOG_NAN, "%s: No TLV's present",__func__);
         return WIFI_SUCCESS;
     }
-    ALOGI("%s: TLV remaining Len:%d",__func__, remainingLen);
+    HAL_LOGD(HAL_LOG_NAN, "%s: TLV remaining Len:%d",__func__, remainingLen);
     while ((remainingLen > 0) &&
            (0 != (readLen = NANTLV_ReadTlv(pInputTlv, &outputTlv)))) {
-        ALOGI("%s: Remaining Len:%d readLen:%d type:%d length:%d",
+        HAL_LOGD(HAL_LOG_NAN, "%s: Remaining Len:%d readLen:%d type:%d length:%d",
               __func__, remainingLen, readLen, outputTlv.type,
               outputTlv.length);
         switch (outputTlv.type) {
@@ -520,7 +520,7 @@ int NanCommand::getNanFollowup(NanFollowupInd *event)
             break;
 #endif /* NAN_2_0 */
         default:
-            ALOGI("Unknown TLV type skipped");
+            HAL_LOGD(HAL_LOG_NAN, "Unknown TLV type skipped");
             break;
         }
         remainingLen -= readLen;
@@ -559,15 +559,15 @@ int NanCommand::getNanDiscEngEvent(NanDiscEngEventInd *event)
 
     //Has Self-STA Mac TLV
     if (remainingLen <= 0) {
-        ALOGI("%s: No TLV's present",__func__);
+        HAL_LOGD(HAL_LOG_NAN, "%s: No TLV's present",__func__);
         return WIFI_SUCCESS;
     }
 
-    ALOGI("%s: TLV remaining Len:%d event_id:%d",__func__,
+    HAL_LOGD(HAL_LOG_NAN, "%s: TLV remaining Len:%d event_id:%d",__func__,
           remainingLen, event->event_id);
     while ((remainingLen > 0) &&
            (0 != (readLen = NANTLV_ReadTlv(pInputTlv, &outputTlv)))) {
-        ALOGI("%s: Remaining Len:%d readLen:%d type:%d length:%d",
+        HAL_LOGD(HAL_LOG_NAN, "%s: Remaining Len:%d readLen:%d type:%d length:%d",
               __func__, remainingLen, readLen, outputTlv.type,
               outputTlv.length);
 #ifdef NAN_2_0
@@ -577,7 +577,7 @@ int NanCommand::getNanDiscEngEvent(NanDiscEngEventInd *event)
         switch (event->event_id) {
         case NAN_EVENT_ID_STA_MAC_ADDR:
             if (outputTlv.length > NAN_MAC_ADDR_LEN) {
-                ALOGI("%s: Reading only first %d bytes of TLV",
+                HAL_LOGD(HAL_LOG_NAN, "%s: Reading only first %d bytes of TLV",
                       __func__, NAN_MAC_ADDR_LEN);
                 outputTlv.length = NAN_MAC_ADDR_LEN;
             }
@@ -587,7 +587,7 @@ int NanCommand::getNanDiscEngEvent(NanDiscEngEventInd *event)
         case NAN_EVENT_ID_STARTED_CLUSTER:
         case NAN_EVENT_ID_JOINED_CLUSTER:
             if (outputTlv.length > NAN_MAC_ADDR_LEN) {
-                ALOGI("%s: Reading only first %d bytes of TLV",
+                HAL_LOGD(HAL_LOG_NAN, "%s: Reading only first %d bytes of TLV",
                       __func__, NAN_MAC_ADDR_LEN);
                 outputTlv.length = NAN_MAC_ADDR_LEN;
             }
@@ -595,7 +595,7 @@ int NanCommand::getNanDiscEngEvent(NanDiscEngEventInd *event)
                    outputTlv.length);
             break;
         default:
-            ALOGI("Unhandled eventId:%d", event->event_id);
+            HAL_LOGD(HAL_LOG_NAN, "Unhandled eventId:%d", event->event_id);
             break;
         }
         remainingLen -= readLen;
@@ -652,15 +652,15 @@ int NanCommand::getNanTca(NanTCAInd *event)
 
     //Has NAN_TCA_ID_CLUSTER_SIZE
     if (remainingLen <= 0) {
-        ALOGI("%s: No TLV's present",__func__);
+        HAL_LOGD(HAL_LOG_NAN, "%s: No TLV's present",__func__);
         return WIFI_SUCCESS;
     }
 
-    ALOGI("%s: TLV remaining Len:%d tca_id:%d",__func__,
+    HAL_LOGD(HAL_LOG_NAN, "%s: TLV remaining Len:%d tca_id:%d",__func__,
           remainingLen, event->tca_id);
     while ((remainingLen > 0) &&
            (0 != (readLen = NANTLV_ReadTlv(pInputTlv, &outputTlv)))) {
-        ALOGI("%s: Remaining Len:%d readLen:%d type:%d length:%d",
+        HAL_LOGD(HAL_LOG_NAN, "%s: Remaining Len:%d readLen:%d type:%d length:%d",
               __func__, remainingLen, readLen, outputTlv.type,
               outputTlv.length);
         //Here we should check on the event_id
@@ -685,7 +685,7 @@ int NanCommand::getNanTca(NanTCAInd *event)
 #endif /* NAN_2_0 */
             break;
         default:
-            ALOGI("Unhandled eventId:%d", event->tca_id);
+            HAL_LOGD(HAL_LOG_NAN, "Unhandled eventId:%d", event->tca_id);
             break;
         }
         remainingLen -= readLen;
@@ -717,14 +717,14 @@ int NanCommand::getNanBeaconSdfPayload(NanBeaconSdfPayloadInd *event)
 
     //Has Mac address
     if (remainingLen <= 0) {
-        ALOGI("%s: No TLV's present",__func__);
+        HAL_LOGD(HAL_LOG_NAN, "%s: No TLV's present",__func__);
         return WIFI_SUCCESS;
     }
 
-    ALOGI("%s: TLV remaining Len:%d",__func__, remainingLen);
+    HAL_LOGD(HAL_LOG_NAN, "%s: TLV remaining Len:%d",__func__, remainingLen);
     while ((remainingLen > 0) &&
            (0 != (readLen = NANTLV_ReadTlv(pInputTlv, &outputTlv)))) {
-        ALOGI("%s: Remaining Len:%d readLen:%d type:%d length:%d",
+        HAL_LOGD(HAL_LOG_NAN, "%s: Remaining Len:%d readLen:%d type:%d length:%d",
               __func__, remainingLen, readLen, outputTlv.type,
               outputTlv.length);
         //Here we should check on the event_id
@@ -771,7 +771,7 @@ int NanCommand::getNanBeaconSdfPayload(NanBeaconSdfPayloadInd *event)
             break;
 
         default:
-            ALOGI("Unhandled TLV Type:%d", outputTlv.type);
+            HAL_LOGD(HAL_LOG_NAN, "Unhandled TLV Type:%d", outputTlv.type);
             break;
         }
         remainingLen -= readLen;
@@ -830,10 +830,10 @@ int NanCommand::getNanReceivePostDiscoveryVal(const u8 *pInValue,
         return -1;
     }
 
-    ALOGI("%s: TLV remaining Len:%d",__func__, remainingLen);
+    HAL_LOGD(HAL_LOG_NAN, "%s: TLV remaining Len:%d",__func__, remainingLen);
     while ((remainingLen > 0) &&
            (0 != (readLen = NANTLV_ReadTlv(pInputTlv, &outputTlv)))) {
-        ALOGI("%s: Remaining Len:%d readLen:%d type:%d length:%d",
+        HAL_LOGD(HAL_LOG_NAN, "%s: Remaining Len:%d readLen:%d type:%d length:%d",
               __func__, remainingLen, readLen, outputTlv.type,
               outputTlv.length);
         switch (outputTlv.type) {
@@ -858,7 +858,7 @@ int NanCommand::getNanReceivePostDiscoveryVal(const u8 *pInValue,
                    outputTlv.length);
             pRxDisc->infrastructure_ssid_len = outputTlv.length;
         default:
-            ALOGI("Unhandled TLV Type:%d", outputTlv.type);
+            HAL_LOGD(HAL_LOG_NAN, "Unhandled TLV Type:%d", outputTlv.type);
             break;
         }
         remainingLen -= readLen;
@@ -935,17 +935,17 @@ int NanCommand::getNanStaParameter(NanStaParameter *pRsp)
         goto cleanup;
     }
 
-    struct timespec abstime;
-    abstime.tv_sec = 4;
-    abstime.tv_nsec = 0;
-    res = mCondition.wait(abstime);
+    struct timespec timeout;
+    timeout.tv_sec = 4;
+    timeout.tv_nsec = 0;
+    res = mCompletion.wait(timeout);
     if (res == ETIMEDOUT)
     {
         ALOGE("%s: Time out happened.", __func__);
         ret = WIFI_ERROR_TIMED_OUT;
         goto cleanup;
     }
-    ALOGI("%s: NanStaparameter Master_pref:%x," \
+    HAL_LOGD(HAL_LOG_NAN, "%s: NanStaparameter Master_pref:%x," \
           " Random_factor:%x, hop_count:%x " \
           " beacon_transmit_time:%d", __func__,
           pRsp->master_pref, pRsp->random_factor,
@@ -862,43 +862,6 @@ int NanCommand::putNanBeaconSdfPayload(const NanBeaconSdfPayloadRequest *pReq)
 #endif /* NAN_2_0 */
     return ret;
 }
-//callback handlers registered for nl message send
-static int error_handler_nan(struct sockaddr_nl *nla, struct nlmsgerr *err,
-                         void *arg)
-{
-    struct sockaddr_nl * tmp;
-    int *ret = (int *)arg;
-    tmp = nla;
-    *ret = err->error;
-    ALOGE("%s: Error code:%d (%s)", __func__, *ret, strerror(-(*ret)));
-    return NL_STOP;
-}
-
-//callback handlers registered for nl message send
-static int ack_handler_nan(struct nl_msg *msg, void *arg)
-{
-    int *ret = (int *)arg;
-    struct nl_msg * a;
-
-    ALOGE("%s: called", __func__);
-    a = msg;
-    *ret = 0;
-    return NL_STOP;
-}
-
-//callback handlers registered for nl message send
-static int finish_handler_nan(struct nl_msg *msg, void *arg)
-{
-  int *ret = (int *)arg;
-  struct nl_msg * a;
-
-  ALOGE("%s: called", __func__);
-  a = msg;
-  *ret = 0;
-  return NL_SKIP;
-}
-
-
 //Override base class requestEvent and implement little differently here
 //This will send the request message
 //We dont wait for any response back in case of Nan as it is asynchronous
@@ -906,34 +869,15 @@ static int finish_handler_nan(struct nl_msg *msg, void *arg)
 int NanCommand::requestEvent()
 {
     int res;
-    struct nl_cb * cb;
-
-    cb = nl_cb_alloc(NL_CB_DEFAULT);
-    if (!cb) {
-        ALOGE("%s: Callback allocation failed",__func__);
-        res = -1;
-        goto out;
-    }
 
     /* create the message */
     res = create();
     if (res < 0)
         goto out;
 
-    /* send message */
-    ALOGE("%s:Handle:%p Socket Value:%p", __func__, mInfo, mInfo->cmd_sock);
-    res = nl_send_auto_complete(mInfo->cmd_sock, mMsg.getMessage());
-    if (res < 0)
-        goto out;
-    res = 1;
-
-    nl_cb_err(cb, NL_CB_CUSTOM, error_handler_nan, &res);
-    nl_cb_set(cb, NL_CB_FINISH, NL_CB_CUSTOM, finish_handler_nan, &res);
-    nl_cb_set(cb, NL_CB_ACK, NL_CB_CUSTOM, ack_handler_nan, &res);
-
-    // err is populated as part of finish_handler
-    while (res > 0)
-        nl_recvmsgs(mInfo->cmd_sock, cb);
+    /* send message and wait for the driver to acknowledge it */
+    mCompletion.reset();
+    res = transact(mMsg, NULL, NULL, true);
 
     ALOGD("%s: Command invoked return value:%d",__func__, res);
 
@@ -989,7 +933,7 @@ void NanCommand::fillNanSocialChannelParamVal(
         pChannelParamArr[NAN_CHANNEL_44]|= 44;
         pChannelParamArr[NAN_CHANNEL_149]|= 149;
         ALOGI("%s: Filled SocialChannelParamVal", __func__);
-        hexdump((char*)pChannelParamArr, NAN_MAX_SOCIAL_CHANNEL * sizeof(u32));
+        HAL_LOG_DUMP(HAL_LOG_NAN, "nan social channels", pChannelParamArr, NAN_MAX_SOCIAL_CHANNEL * sizeof(u32));
     }
     return;
 }
@@ -1039,7 +983,7 @@ void NanCommand::fillNanTransmitPostDiscoveryVal(
                         tlvs);
         }
         ALOGI("%s: Filled TransmitPostDiscoveryVal", __func__);
-        hexdump((char*)pOutValue, calcNanTransmitPostDiscoverySize(pTxDisc));
+        HAL_LOG_DUMP(HAL_LOG_NAN, "nan post discovery", pOutValue, calcNanTransmitPostDiscoverySize(pTxDisc));
     }
 #endif /* NAN_2_0 */
     return;
@@ -1064,7 +1008,7 @@ void NanCommand::fillNanFurtherAvailabilityMapVal(
                pFam->vendor_elements,
                pFam->vendor_elements_len);
         ALOGI("%s: Filled FurtherAvailabilityMapVal", __func__);
-        hexdump((char*)pOutValue, famsize);
+        HAL_LOG_DUMP(HAL_LOG_NAN, "nan further availability", pOutValue, famsize);
     }
     return;
 }
@@ -169,14 +169,14 @@ int NanCommand::getNanResponse(NanResponseMsg *pRsp)
                     sizeof(pRsp->body.stats_response.data)) {
                     memcpy(&pRsp->body.stats_response.data, outputTlv.value,
                            outputTlv.length);
-                    hexdump((char*)&pRsp->body.stats_response.data, outputTlv.length);
+                    HAL_LOG_DUMP(HAL_LOG_NAN, "nan stats", &pRsp->body.stats_response.data, outputTlv.length);
                 }
                 else {
                     ALOGE("%s:copying only sizeof(pRsp->body.stats_response.data):%d",
                           __func__, sizeof(pRsp->body.stats_response.data));
                     memcpy(&pRsp->body.stats_response.data, outputTlv.value,
                            sizeof(pRsp->body.stats_response.data));
-                    hexdump((char*)&pRsp->body.stats_response.data,
+                    HAL_LOG_DUMP(HAL_LOG_NAN, "nan stats", &pRsp->body.stats_response.data,
                             sizeof(pRsp->body.stats_response.data));
                 }
             }
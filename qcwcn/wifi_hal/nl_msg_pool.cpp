@@ -0,0 +1,116 @@
+/*
+ * Copyright (C) 2014 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <stdint.h>
+#include <string.h>
+#include <unistd.h>
+#include <netlink/msg.h>
+#include <netlink/netlink.h>
+#include <netlink-types.h>
+
+#include "wifi_hal.h"
+#include "common.h"
+#include "nl_msg_pool.h"
+
+/* Brings a used message back to the state nlmsg_alloc() leaves it in */
+static void nl_msg_reset(struct nl_msg *msg)
+{
+    struct nlmsghdr *nlh = msg->nm_nlh;
+    size_t used = nlh->nlmsg_len < msg->nm_size ? nlh->nlmsg_len : msg->nm_size;
+
+    memset(nlh, 0, used);
+    nlh->nlmsg_len = nlmsg_total_size(0);
+    msg->nm_protocol = -1;
+    msg->nm_flags = 0;
+    memset(&msg->nm_src, 0, sizeof(msg->nm_src));
+    memset(&msg->nm_dst, 0, sizeof(msg->nm_dst));
+    memset(&msg->nm_creds, 0, sizeof(msg->nm_creds));
+}
+
+void nl_msg_pool_init(hal_info *info)
+{
+    info->num_msg_pool = 0;
+    pthread_mutex_init(&info->msg_pool_lock, NULL);
+}
+
+void nl_msg_pool_cleanup(hal_info *info)
+{
+    for (int i = 0; i < info->num_msg_pool; i++)
+        nlmsg_free(info->msg_pool[i]);
+    info->num_msg_pool = 0;
+    pthread_mutex_destroy(&info->msg_pool_lock);
+}
+
+struct nl_msg *nl_msg_pool_get(hal_info *info, size_t size)
+{
+    size_t page = (size_t)getpagesize();
+    struct nl_msg *msg = NULL;
+    int best = -1;
+
+    if (size < page)
+        size = page;
+
+    pthread_mutex_lock(&info->msg_pool_lock);
+    /* Smallest cached buffer that fits */
+    for (int i = 0; i < info->num_msg_pool; i++) {
+        size_t avail = info->msg_pool[i]->nm_size;
+        if (avail >= size
+                && (best < 0 || avail < info->msg_pool[best]->nm_size))
+            best = i;
+    }
+    if (best >= 0) {
+        msg = info->msg_pool[best];
+        info->msg_pool[best] = info->msg_pool[--info->num_msg_pool];
+    }
+    pthread_mutex_unlock(&info->msg_pool_lock);
+
+    if (msg == NULL) {
+        msg = nlmsg_alloc_size(size);
+        if (msg == NULL)
+            ALOGE("%s: failed to allocate %zu byte message", __func__, size);
+    }
+    return msg;
+}
+
+void nl_msg_pool_put(hal_info *info, struct nl_msg *msg)
+{
+    if (msg->nm_refcnt != 1) {
+        nlmsg_free(msg);
+        return;
+    }
+
+    nl_msg_reset(msg);
+
+    pthread_mutex_lock(&info->msg_pool_lock);
+    if (info->num_msg_pool < NL_MSG_POOL_SIZE) {
+        info->msg_pool[info->num_msg_pool++] = msg;
+        msg = NULL;
+    } else {
+        /* Keep the larger buffers; they are the expensive ones */
+        for (int i = 0; i < info->num_msg_pool; i++) {
+            if (info->msg_pool[i]->nm_size < msg->nm_size) {
+                struct nl_msg *smaller = info->msg_pool[i];
+                info->msg_pool[i] = msg;
+                msg = smaller;
+                break;
+            }
+        }
+    }
+    pthread_mutex_unlock(&info->msg_pool_lock);
+
+    if (msg != NULL)
+        nlmsg_free(msg);
+}
@@ -0,0 +1,40 @@
+/*
+ * Copyright (C) 2014 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef __WIFI_HAL_NL_MSG_POOL_H__
+#define __WIFI_HAL_NL_MSG_POOL_H__
+
+#include "common.h"
+
+/*
+ * Per hal_info cache of netlink message buffers. Requests check out a
+ * buffer at least as large as they need and hand it back when done, so
+ * steady-state commands do not go through the allocator. Buffers are never
+ * smaller than a page, the libnl default.
+ */
+
+void nl_msg_pool_init(hal_info *info);
+void nl_msg_pool_cleanup(hal_info *info);
+
+/* Returns an empty message with room for at least 'size' bytes including
+ * the netlink header; size 0 asks for the default size. NULL on failure. */
+struct nl_msg *nl_msg_pool_get(hal_info *info, size_t size);
+
+/* Returns msg to the pool, or frees it if it is still referenced
+ * elsewhere or the pool is full. */
+void nl_msg_pool_put(hal_info *info, struct nl_msg *msg);
+
+#endif /* __WIFI_HAL_NL_MSG_POOL_H__ */
@@ -0,0 +1,424 @@
+/*
+ * Copyright (C) 2014 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <time.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <arpa/inet.h>
+#include <linux/netlink.h>
+#include <netpacket/packet.h>
+
+#include "wifi_hal.h"
+#include "common.h"
+#include "event_loop.h"
+#include "hal_perf.h"
+#include "nl_trace.h"
+
+#define PCAP_MAGIC              (0xa1b2c3d4)
+#define LINKTYPE_NETLINK        (253)
+#define ARPHRD_NETLINK          (824)
+#define NL_TRACE_REPLAY_BATCH   (64)    /* events per tick at full speed */
+
+/* A record in the ring; a record with wrap set, or less room than a
+ * header left before the end, means the next record is at offset 0. */
+typedef struct {
+    uint64_t ts;                                    // CLOCK_MONOTONIC us
+    uint32_t len;                                   // length of the message
+    uint16_t caplen;                                // bytes of it kept
+    uint8_t dir;                                    // NL_TRACE_TX or _RX
+    uint8_t wrap;
+} nl_trace_rec;
+
+typedef struct {
+    uint32_t magic;
+    uint16_t version_major;
+    uint16_t version_minor;
+    int32_t thiszone;
+    uint32_t sigfigs;
+    uint32_t snaplen;
+    uint32_t linktype;
+} pcap_file_hdr;
+
+typedef struct {
+    uint32_t ts_sec;
+    uint32_t ts_usec;
+    uint32_t incl_len;
+    uint32_t orig_len;
+} pcap_rec_hdr;
+
+/* What libpcap puts in front of every message captured on nlmon */
+typedef struct {
+    uint16_t pkttype;
+    uint16_t hatype;
+    uint16_t halen;
+    uint8_t addr[8];
+    uint16_t protocol;
+} nlmon_hdr;
+
+struct nl_trace_replay {
+    hal_timer timer;
+    uint8_t *data;                                  // the whole pcap file
+    size_t size;
+    size_t off;                                     // next record to look at
+    bool realtime;
+    uint64_t first_ts;                              // us, of the first event
+    uint64_t start;                                 // hal_perf_now_us() then
+    uint32_t events;                                // events fed so far
+    nl_trace_replay_fn fn;
+    void *arg;
+    struct nl_trace_replay *next;                   // replay it superseded
+};
+
+struct nl_trace {
+    pthread_mutex_t lock;
+    uint8_t buf[NL_TRACE_SIZE];
+    size_t head;                                    // where the next record goes
+    size_t tail;                                    // oldest record
+    uint32_t count;                                 // records in the ring
+    struct nl_trace_replay *replay;                 // current first, under lock
+};
+
+static inline size_t rec_size(uint32_t caplen)
+{
+    return (sizeof(nl_trace_rec) + caplen + 7) & ~(size_t)7;
+}
+
+/* Offset of the record after the one at off in the ring buf */
+static size_t next_rec(const uint8_t *buf, size_t off)
+{
+    const nl_trace_rec *rec = (const nl_trace_rec *)(buf + off);
+    off += rec_size(rec->caplen);
+    if (NL_TRACE_SIZE - off < sizeof(nl_trace_rec)
+            || ((const nl_trace_rec *)(buf + off))->wrap)
+        return 0;
+    return off;
+}
+
+/* Drops the oldest records for as long as one starts in [start, end) */
+static void evict(struct nl_trace *t, size_t start, size_t end)
+{
+    while (t->count > 0 && t->tail >= start && t->tail < end) {
+        t->tail = next_rec(t->buf, t->tail);
+        t->count--;
+    }
+}
+
+wifi_error nl_trace_init(hal_info *info)
+{
+    struct nl_trace *t = (struct nl_trace *)malloc(sizeof(*t));
+    if (t == NULL)
+        return WIFI_ERROR_OUT_OF_MEMORY;
+
+    memset(t, 0, sizeof(*t));
+    pthread_mutex_init(&t->lock, NULL);
+    info->trace = t;
+    return WIFI_SUCCESS;
+}
+
+static void replay_free(hal_info *info, struct nl_trace_replay *r)
+{
+    hal_timer_cancel(info, &r->timer);
+    free(r->data);
+    free(r);
+}
+
+void nl_trace_cleanup(hal_info *info)
+{
+    struct nl_trace *t = info->trace;
+    if (t == NULL)
+        return;
+
+    /* the event loop is gone, so no replay_tick() is left to free these */
+    while (t->replay != NULL) {
+        struct nl_trace_replay *next = t->replay->next;
+        replay_free(info, t->replay);
+        t->replay = next;
+    }
+    pthread_mutex_destroy(&t->lock);
+    free(t);
+    info->trace = NULL;
+}
+
+void nl_trace_record(hal_info *info, int dir, struct nlmsghdr *nlh)
+{
+    struct nl_trace *t = info->trace;
+    if (t == NULL)
+        return;
+
+    uint32_t caplen = min(nlh->nlmsg_len, (uint32_t)NL_TRACE_SNAPLEN);
+    size_t need = rec_size(caplen);
+    uint64_t now = hal_perf_now_us();
+
+    pthread_mutex_lock(&t->lock);
+    if (t->count == 0)
+        t->head = t->tail = 0;
+
+    if (NL_TRACE_SIZE - t->head < need) {
+        evict(t, t->head, NL_TRACE_SIZE);
+        if (NL_TRACE_SIZE - t->head >= sizeof(nl_trace_rec))
+            ((nl_trace_rec *)(t->buf + t->head))->wrap = 1;
+        t->head = 0;
+    }
+    evict(t, t->head, t->head + need);
+
+    nl_trace_rec *rec = (nl_trace_rec *)(t->buf + t->head);
+    rec->ts = now;
+    rec->len = nlh->nlmsg_len;
+    rec->caplen = caplen;
+    rec->dir = dir;
+    rec->wrap = 0;
+    memcpy(rec + 1, nlh, caplen);
+
+    t->head += need;
+    t->count++;
+    pthread_mutex_unlock(&t->lock);
+}
+
+static int write_all(int fd, const void *data, size_t len)
+{
+    const uint8_t *p = (const uint8_t *)data;
+    while (len > 0) {
+        ssize_t n = write(fd, p, len);
+        if (n < 0) {
+            if (errno == EINTR)
+                continue;
+            return -errno;
+        }
+        p += n;
+        len -= n;
+    }
+    return 0;
+}
+
+wifi_error wifi_dump_nl_trace(wifi_handle handle, int fd)
+{
+    struct nl_trace *t = getHalInfo(handle)->trace;
+
+    /* Copy the ring out so that senders are not held up by the writes */
+    uint8_t *snap = (uint8_t *)malloc(NL_TRACE_SIZE);
+    if (snap == NULL)
+        return WIFI_ERROR_OUT_OF_MEMORY;
+
+    pthread_mutex_lock(&t->lock);
+    memcpy(snap, t->buf, NL_TRACE_SIZE);
+    size_t off = t->tail;
+    uint32_t count = t->count;
+    pthread_mutex_unlock(&t->lock);
+
+    /* pcap wants wall clock time */
+    struct timespec rt;
+    clock_gettime(CLOCK_REALTIME, &rt);
+    int64_t offset = (int64_t)rt.tv_sec * 1000000 + rt.tv_nsec / 1000
+        - (int64_t)hal_perf_now_us();
+
+    pcap_file_hdr fh;
+    memset(&fh, 0, sizeof(fh));
+    fh.magic = PCAP_MAGIC;
+    fh.version_major = 2;
+    fh.version_minor = 4;
+    fh.snaplen = NL_TRACE_SNAPLEN + sizeof(nlmon_hdr);
+    fh.linktype = LINKTYPE_NETLINK;
+    int res = write_all(fd, &fh, sizeof(fh));
+
+    for (uint32_t i = 0; i < count && res == 0; i++) {
+        nl_trace_rec *rec = (nl_trace_rec *)(snap + off);
+        uint64_t ts = rec->ts + offset;
+
+        pcap_rec_hdr rh;
+        rh.ts_sec = ts / 1000000;
+        rh.ts_usec = ts % 1000000;
+        rh.incl_len = sizeof(nlmon_hdr) + rec->caplen;
+        rh.orig_len = sizeof(nlmon_hdr) + rec->len;
+
+        nlmon_hdr mh;
+        memset(&mh, 0, sizeof(mh));
+        mh.pkttype = htons(rec->dir == NL_TRACE_TX ? PACKET_OUTGOING : PACKET_HOST);
+        mh.hatype = htons(ARPHRD_NETLINK);
+        mh.protocol = htons(NETLINK_GENERIC);
+
+        res = write_all(fd, &rh, sizeof(rh));
+        if (res == 0)
+            res = write_all(fd, &mh, sizeof(mh));
+        if (res == 0)
+            res = write_all(fd, rec + 1, rec->caplen);
+
+        off = next_rec(snap, off);
+    }
+
+    free(snap);
+    if (res < 0) {
+        ALOGE("Failed to write netlink trace: %d", res);
+        return WIFI_ERROR_UNKNOWN;
+    }
+    return WIFI_SUCCESS;
+}
+
+/* Finds the next event in the file from r->off on; returns its netlink
+ * message and timestamp, or NULL at the end of the file */
+static struct nlmsghdr *replay_next(struct nl_trace_replay *r, uint64_t *ts)
+{
+    while (r->size - r->off >= sizeof(pcap_rec_hdr)) {
+        pcap_rec_hdr *rh = (pcap_rec_hdr *)(r->data + r->off);
+        if (rh->incl_len > r->size - r->off - sizeof(*rh))
+            break;
+        r->off += sizeof(*rh) + rh->incl_len;
+
+        /* requests, truncated messages and anything but genl are skipped */
+        if (rh->incl_len != rh->orig_len
+                || rh->incl_len < sizeof(nlmon_hdr) + sizeof(struct nlmsghdr))
+            continue;
+        nlmon_hdr *mh = (nlmon_hdr *)(rh + 1);
+        if (ntohs(mh->pkttype) != PACKET_HOST
+                || ntohs(mh->protocol) != NETLINK_GENERIC)
+            continue;
+
+        struct nlmsghdr *nlh = (struct nlmsghdr *)(mh + 1);
+        if (nlh->nlmsg_len > rh->incl_len - sizeof(nlmon_hdr))
+            continue;
+        *ts = (uint64_t)rh->ts_sec * 1000000 + rh->ts_usec;
+        return nlh;
+    }
+    return NULL;
+}
+
+/* Takes r off the replay list */
+static void replay_unlink(struct nl_trace *t, struct nl_trace_replay *r)
+{
+    struct nl_trace_replay **pp = &t->replay;
+
+    pthread_mutex_lock(&t->lock);
+    while (*pp != r)
+        pp = &(*pp)->next;
+    *pp = r->next;
+    pthread_mutex_unlock(&t->lock);
+}
+
+static void replay_tick(hal_info *info, void *arg)
+{
+    struct nl_trace_replay *r = (struct nl_trace_replay *)arg;
+    struct nl_trace *t = info->trace;
+
+    pthread_mutex_lock(&t->lock);
+    bool superseded = t->replay != r;
+    pthread_mutex_unlock(&t->lock);
+    if (superseded) {
+        ALOGI("Replay cancelled after %u events", r->events);
+        replay_unlink(t, r);
+        replay_free(info, r);
+        return;
+    }
+
+    for (int n = 0; n < NL_TRACE_REPLAY_BATCH; n++) {
+        size_t off = r->off;
+        uint64_t ts;
+        struct nlmsghdr *nlh = replay_next(r, &ts);
+        if (nlh == NULL) {
+            ALOGI("Replay done, %u events", r->events);
+            replay_unlink(t, r);
+            replay_free(info, r);
+            return;
+        }
+
+        if (r->events == 0) {
+            r->first_ts = ts;
+            r->start = hal_perf_now_us();
+        }
+        if (r->realtime) {
+            uint64_t due = r->start + (ts - r->first_ts);
+            uint64_t now = hal_perf_now_us();
+            if (due > now + 1000) {
+                /* not yet; look at this one again when it is due */
+                r->off = off;
+                hal_timer_start(info, &r->timer, (due - now) / 1000, 0);
+                return;
+            }
+        }
+
+        struct nl_msg *msg = nlmsg_convert(nlh);
+        if (msg != NULL) {
+            r->fn(msg, r->arg);
+            nlmsg_free(msg);
+        }
+        r->events++;
+    }
+
+    /* let the loop look at the sockets between batches */
+    hal_timer_start(info, &r->timer, 0, 0);
+}
+
+wifi_error nl_trace_replay(hal_info *info, const char *path, bool realtime,
+        nl_trace_replay_fn fn, void *arg)
+{
+    if (info->trace == NULL)
+        return WIFI_ERROR_NOT_AVAILABLE;
+
+    FILE *f = fopen(path, "rb");
+    if (f == NULL) {
+        ALOGE("Could not open %s: %s", path, strerror(errno));
+        return WIFI_ERROR_INVALID_ARGS;
+    }
+
+    struct nl_trace_replay *r =
+        (struct nl_trace_replay *)calloc(1, sizeof(*r));
+    if (r == NULL) {
+        fclose(f);
+        return WIFI_ERROR_OUT_OF_MEMORY;
+    }
+
+    fseek(f, 0, SEEK_END);
+    long size = ftell(f);
+    fseek(f, 0, SEEK_SET);
+    r->data = size > 0 ? (uint8_t *)malloc(size) : NULL;
+    if (r->data == NULL || fread(r->data, 1, size, f) != (size_t)size) {
+        ALOGE("Could not read %s", path);
+        fclose(f);
+        free(r->data);
+        free(r);
+        return WIFI_ERROR_UNKNOWN;
+    }
+    fclose(f);
+
+    pcap_file_hdr *fh = (pcap_file_hdr *)r->data;
+    if ((size_t)size < sizeof(*fh) || fh->magic != PCAP_MAGIC
+            || fh->linktype != LINKTYPE_NETLINK) {
+        ALOGE("%s is not a netlink capture", path);
+        free(r->data);
+        free(r);
+        return WIFI_ERROR_INVALID_ARGS;
+    }
+
+    r->size = size;
+    r->off = sizeof(*fh);
+    r->realtime = realtime;
+    r->fn = fn;
+    r->arg = arg;
+    ALOGI("Replaying %s %s", path, realtime ? "as recorded" : "at full speed");
+
+    /* A replay still running stops at its next tick. Until then it stays
+     * on the list, so nl_trace_cleanup() frees it if that comes first. */
+    hal_timer_init(&r->timer, replay_tick, r);
+    pthread_mutex_lock(&info->trace->lock);
+    r->next = info->trace->replay;
+    info->trace->replay = r;
+    pthread_mutex_unlock(&info->trace->lock);
+    hal_timer_start(info, &r->timer, 0, 0);
+    return WIFI_SUCCESS;
+}
@@ -0,0 +1,59 @@
+/*
+ * Copyright (C) 2014 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef __WIFI_HAL_NL_TRACE_H__
+#define __WIFI_HAL_NL_TRACE_H__
+
+#include "common.h"
+
+/*
+ * Always-on capture of the raw netlink traffic of the HAL.
+ *
+ * Every request sent on cmd_sock and every event read from event_sock is
+ * copied, up to NL_TRACE_SNAPLEN bytes, into a byte ring of NL_TRACE_SIZE
+ * bytes together with a CLOCK_MONOTONIC timestamp; the oldest messages
+ * are overwritten once it is full. wifi_dump_nl_trace() writes the ring
+ * out as a pcap file of link type LINKTYPE_NETLINK, the format tcpdump
+ * writes for an nlmon device, so it opens in Wireshark as is.
+ *
+ * wifi_replay_nl_trace() reads such a file back and feeds the events in
+ * it to the event handlers on the event thread, as though event_sock had
+ * just delivered them, either spaced out as they were recorded or as
+ * fast as the callback thread takes them.
+ */
+
+#define NL_TRACE_SIZE           (256 * 1024)
+#define NL_TRACE_SNAPLEN        (4096)
+
+enum {
+    NL_TRACE_TX,                                    // request sent on cmd_sock
+    NL_TRACE_RX,                                    // event read on event_sock
+};
+
+/* Feeds one replayed event to the HAL; msg is freed by the caller */
+typedef int (*nl_trace_replay_fn)(struct nl_msg *msg, void *arg);
+
+wifi_error nl_trace_init(hal_info *info);
+void nl_trace_cleanup(hal_info *info);
+
+void nl_trace_record(hal_info *info, int dir, struct nlmsghdr *nlh);
+
+/* Starts replaying the events in the pcap file at path on the event
+ * thread, cancelling any replay still running */
+wifi_error nl_trace_replay(hal_info *info, const char *path, bool realtime,
+        nl_trace_replay_fn fn, void *arg);
+
+#endif /* __WIFI_HAL_NL_TRACE_H__ */
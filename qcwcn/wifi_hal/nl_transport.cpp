@@ -0,0 +1,542 @@
+/*
+ * Copyright (C) 2014 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <stdint.h>
+#include <time.h>
+#include <errno.h>
+#include <poll.h>
+#include <stdlib.h>
+#include <netlink/genl/genl.h>
+#include <netlink/msg.h>
+#include <netlink/netlink.h>
+#include <netlink/socket.h>
+
+#include "wifi_hal.h"
+#include "common.h"
+#include "nl_transport.h"
+#include "cmd_sched.h"
+#include "nl_trace.h"
+#include "hal_transport.h"
+
+#define NL_TRANSPORT_POLL_MS    (500)   /* re-check for cancellation this often */
+
+/* Must be called with xport_lock held */
+static nl_pending_request *find_pending(hal_info *info, uint32_t seq)
+{
+    nl_pending_request *req;
+
+    for (req = info->pending_req; req != NULL; req = req->next) {
+        if (req->seq == seq)
+            return req;
+    }
+    return NULL;
+}
+
+/* Must be called with xport_lock held */
+static void unlink_pending(hal_info *info, nl_pending_request *req)
+{
+    nl_pending_request **pp;
+
+    for (pp = &info->pending_req; *pp != NULL; pp = &(*pp)->next) {
+        if (*pp == req) {
+            *pp = req->next;
+            return;
+        }
+    }
+}
+
+/* Marks req done. Synchronous owners are woken; asynchronous requests move
+ * to the completion queue. Must be called with xport_lock held. */
+static void finish_pending(hal_info *info, nl_pending_request *req, int err)
+{
+    req->err = err;
+    req->done = true;
+
+    if (req->done_cb == NULL) {
+        pthread_cond_broadcast(&info->xport_cond);
+        return;
+    }
+
+    nl_pending_request **pp = &info->completed_req;
+    hal_timer_cancel(info, &req->timeout);
+    unlink_pending(info, req);
+    cmd_sched_release(info, req->prio);
+    while (*pp != NULL)
+        pp = &(*pp)->next;
+    req->next = NULL;
+    *pp = req;
+    pthread_cond_signal(&info->completion_cond);
+}
+
+/* Must be called with xport_lock held */
+static void fail_all_pending(hal_info *info, int err)
+{
+    nl_pending_request *req = info->pending_req;
+
+    while (req != NULL) {
+        nl_pending_request *next = req->next;
+        if (!req->done)
+            finish_pending(info, req, err);
+        req = next;
+    }
+}
+
+static void complete_pending(hal_info *info, uint32_t seq, int err)
+{
+    pthread_mutex_lock(&info->xport_lock);
+    nl_pending_request *req = find_pending(info, seq);
+    if (req != NULL && !req->done) {
+        finish_pending(info, req, err);
+    } else if (req == NULL) {
+        ALOGD("%s: no request pending for seq %u", __func__, seq);
+    }
+    pthread_mutex_unlock(&info->xport_lock);
+}
+
+/* The demultiplexing handlers never return NL_STOP: a single datagram may
+ * carry messages for several requests and all of them must be routed. */
+static int seq_check_demux(struct nl_msg *msg, void *arg)
+{
+    return NL_OK;
+}
+
+static int valid_demux(struct nl_msg *msg, void *arg)
+{
+    hal_info *info = (hal_info *)arg;
+    uint32_t seq = nlmsg_hdr(msg)->nlmsg_seq;
+    nl_recvmsg_msg_cb_t valid_cb = NULL;
+    void *valid_arg = NULL;
+
+    pthread_mutex_lock(&info->xport_lock);
+    nl_pending_request *req = find_pending(info, seq);
+    if (req != NULL && !req->done && req->valid_cb != NULL) {
+        valid_cb = req->valid_cb;
+        valid_arg = req->valid_arg;
+        /* Holds off nl_transport_cancel() until the callback returns */
+        info->xport_cb_seq = seq;
+    } else if (req == NULL) {
+        ALOGD("%s: dropping reply with seq %u", __func__, seq);
+    }
+    pthread_mutex_unlock(&info->xport_lock);
+
+    if (valid_cb == NULL)
+        return NL_OK;
+
+    (*valid_cb)(msg, valid_arg);
+
+    pthread_mutex_lock(&info->xport_lock);
+    info->xport_cb_seq = 0;
+    pthread_cond_broadcast(&info->xport_cond);
+    pthread_mutex_unlock(&info->xport_lock);
+    return NL_OK;
+}
+
+static int ack_demux(struct nl_msg *msg, void *arg)
+{
+    complete_pending((hal_info *)arg, nlmsg_hdr(msg)->nlmsg_seq, 0);
+    return NL_OK;
+}
+
+static int finish_demux(struct nl_msg *msg, void *arg)
+{
+    complete_pending((hal_info *)arg, nlmsg_hdr(msg)->nlmsg_seq, 0);
+    return NL_OK;
+}
+
+static int error_demux(struct sockaddr_nl *nla, struct nlmsgerr *err,
+        void *arg)
+{
+    ALOGD("%s: seq %u failed with error %d", __func__, err->msg.nlmsg_seq,
+            err->error);
+    complete_pending((hal_info *)arg, err->msg.nlmsg_seq, err->error);
+    return NL_SKIP;
+}
+
+/* Reads and routes one batch of messages from cmd_sock, which is non
+ * blocking. With wait set, first waits a bounded time for it to become
+ * readable. */
+static int read_cmd_sock(hal_info *info, bool wait)
+{
+    if (wait) {
+        struct pollfd pfd;
+        pfd.fd = hal_transport_fd(info, info->cmd_sock);
+        pfd.events = POLLIN;
+        pfd.revents = 0;
+        int n = poll(&pfd, 1, NL_TRANSPORT_POLL_MS);
+        if (n <= 0)
+            return -NLE_AGAIN;
+    }
+
+    int res = nl_recvmsgs(info->cmd_sock, info->cmd_sock_cb);
+    if (res < 0 && res != -NLE_AGAIN)
+        ALOGE("nl80211: %s->nl_recvmsgs failed: %d", __func__, res);
+
+    return res;
+}
+
+/* Makes the event loop watch cmd_sock, or stop watching it while another
+ * thread reads it. Must be called with xport_lock held. */
+static void watch_cmd_sock(hal_info *info, bool watch)
+{
+    if (info->xport_parked != watch)
+        return;
+    if (event_loop_mod_fd(info, hal_transport_fd(info, info->cmd_sock),
+                watch ? EPOLLIN : 0) == WIFI_SUCCESS)
+        info->xport_parked = !watch;
+}
+
+/* Reads cmd_sock once as the reader. Must be called with xport_lock held
+ * and the reader role free; returns with the lock held and the role free. */
+static void read_as_reader(hal_info *info, bool wait)
+{
+    info->xport_reading = true;
+    info->xport_reader = pthread_self();
+    pthread_mutex_unlock(&info->xport_lock);
+
+    int res = read_cmd_sock(info, wait);
+
+    pthread_mutex_lock(&info->xport_lock);
+    info->xport_reading = false;
+    /* Whatever the reader left behind is the event loop's again */
+    watch_cmd_sock(info, true);
+
+    if (res < 0 && res != -NLE_INTR && res != -NLE_AGAIN) {
+        /* Replies may have been lost; fail everyone still waiting
+         * rather than leaving them blocked forever. */
+        fail_all_pending(info, res);
+    }
+    pthread_cond_broadcast(&info->xport_cond);
+}
+
+/* Runs on the event thread when an asynchronous request is overdue. Only
+ * the sequence number is trusted; the request may be gone already. */
+static void async_timeout_handler(hal_info *info, void *arg)
+{
+    uint32_t seq = (uint32_t)(uintptr_t)arg;
+
+    pthread_mutex_lock(&info->xport_lock);
+    /* let a reply handler that is running for it finish first */
+    while (info->xport_cb_seq == seq)
+        pthread_cond_wait(&info->xport_cond, &info->xport_lock);
+
+    nl_pending_request *req = find_pending(info, seq);
+    if (req != NULL && !req->done) {
+        ALOGE("%s: no answer to seq %u after %d ms", __func__, seq,
+                NL_TRANSPORT_ASYNC_TIMEOUT_MS);
+        finish_pending(info, req, -ETIMEDOUT);
+    }
+    pthread_mutex_unlock(&info->xport_lock);
+}
+
+static void *completion_thread(void *arg)
+{
+    hal_info *info = (hal_info *)arg;
+
+    pthread_mutex_lock(&info->xport_lock);
+    for (;;) {
+        while (info->completed_req == NULL && !info->completion_exit)
+            pthread_cond_wait(&info->completion_cond, &info->xport_lock);
+        nl_pending_request *req = info->completed_req;
+        if (req == NULL)
+            break;
+        info->completed_req = req->next;
+        pthread_mutex_unlock(&info->xport_lock);
+
+        (*req->done_cb)(req->done_arg, req->err);
+        free(req);
+
+        pthread_mutex_lock(&info->xport_lock);
+    }
+    pthread_mutex_unlock(&info->xport_lock);
+    return NULL;
+}
+
+/* Must be called with xport_lock held */
+static int start_completion_thread(hal_info *info)
+{
+    if (info->completion_running)
+        return 0;
+
+    int res = pthread_create(&info->completion_thread, NULL,
+            completion_thread, info);
+    if (res != 0) {
+        ALOGE("%s: failed to start completion thread: %d", __func__, res);
+        return -res;
+    }
+    info->completion_running = true;
+    return 0;
+}
+
+/* Threads that free scheduler slots by reading replies must never wait
+ * for one. Must be called with xport_lock held. */
+static bool sched_urgent(hal_info *info)
+{
+    pthread_t self = pthread_self();
+
+    return (info->xport_reading && pthread_equal(info->xport_reader, self))
+        || (info->in_event_loop && pthread_equal(info->event_thread, self));
+}
+
+/* Assigns a sequence number to req and links it into the pending table.
+ * Must be called with xport_lock held. */
+static void add_pending(hal_info *info, nl_pending_request *req,
+        struct nl_msg *msg, uint32_t *seq)
+{
+    do {
+        req->seq = ++info->nl_seq;
+    } while (req->seq == 0);    /* 0 asks libnl to pick the sequence number */
+    req->next = info->pending_req;
+    info->pending_req = req;
+
+    nlmsg_hdr(msg)->nlmsg_seq = req->seq;
+    if (seq != NULL)
+        *seq = req->seq;
+}
+
+wifi_error nl_transport_init(hal_info *info)
+{
+    info->pending_req = NULL;
+    info->completed_req = NULL;
+    info->xport_reading = false;
+    info->xport_parked = false;
+    info->xport_cb_seq = 0;
+    info->completion_running = false;
+    info->completion_exit = false;
+    /* Same starting point libnl uses for its own sequence numbers */
+    info->nl_seq = (uint32_t)time(NULL);
+    pthread_mutex_init(&info->xport_lock, NULL);
+    pthread_cond_init(&info->xport_cond, NULL);
+    pthread_cond_init(&info->completion_cond, NULL);
+
+    if (cmd_sched_init(info) != WIFI_SUCCESS) {
+        ALOGE("%s: Scheduler allocation failed", __func__);
+        return WIFI_ERROR_OUT_OF_MEMORY;
+    }
+
+    /* One callback set serves every request: the demux handlers find the
+     * per-request state through the pending table, keyed by sequence
+     * number, so nothing here changes from one request to the next. */
+    info->cmd_sock_cb = nl_cb_alloc(NL_CB_DEFAULT);
+    if (info->cmd_sock_cb == NULL) {
+        ALOGE("%s: Callback allocation failed", __func__);
+        return WIFI_ERROR_OUT_OF_MEMORY;
+    }
+    nl_cb_set(info->cmd_sock_cb, NL_CB_SEQ_CHECK, NL_CB_CUSTOM,
+            seq_check_demux, NULL);
+    nl_cb_set(info->cmd_sock_cb, NL_CB_VALID, NL_CB_CUSTOM, valid_demux, info);
+    nl_cb_set(info->cmd_sock_cb, NL_CB_ACK, NL_CB_CUSTOM, ack_demux, info);
+    nl_cb_set(info->cmd_sock_cb, NL_CB_FINISH, NL_CB_CUSTOM, finish_demux, info);
+    nl_cb_err(info->cmd_sock_cb, NL_CB_CUSTOM, error_demux, info);
+
+    /* The event loop must never block on cmd_sock; synchronous readers
+     * poll() before reading instead. */
+    if (nl_socket_set_nonblocking(info->cmd_sock) < 0) {
+        ALOGE("%s: failed to make cmd_sock non blocking", __func__);
+        return WIFI_ERROR_UNKNOWN;
+    }
+    return WIFI_SUCCESS;
+}
+
+void nl_transport_cleanup(hal_info *info)
+{
+    pthread_mutex_lock(&info->xport_lock);
+    fail_all_pending(info, -ECANCELED);
+    info->completion_exit = true;
+    pthread_cond_signal(&info->completion_cond);
+    bool running = info->completion_running;
+    pthread_mutex_unlock(&info->xport_lock);
+
+    /* The completion thread reports whatever is queued before it exits */
+    if (running)
+        pthread_join(info->completion_thread, NULL);
+
+    if (info->pending_req != NULL)
+        ALOGE("%s: requests still pending", __func__);
+    if (info->cmd_sock_cb != NULL) {
+        nl_cb_put(info->cmd_sock_cb);
+        info->cmd_sock_cb = NULL;
+    }
+    cmd_sched_cleanup(info);
+    pthread_cond_destroy(&info->completion_cond);
+    pthread_cond_destroy(&info->xport_cond);
+    pthread_mutex_destroy(&info->xport_lock);
+}
+
+int nl_transport_request(hal_info *info, struct nl_msg *msg, int prio,
+        nl_recvmsg_msg_cb_t valid_cb, void *valid_arg, uint32_t *seq)
+{
+    nl_pending_request req;
+    int res;
+
+    memset(&req, 0, sizeof(req));
+    req.valid_cb = valid_cb;
+    req.valid_arg = valid_arg;
+
+    pthread_mutex_lock(&info->xport_lock);
+    bool urgent = sched_urgent(info);
+    pthread_mutex_unlock(&info->xport_lock);
+    cmd_sched_acquire(info, prio, urgent);
+
+    pthread_mutex_lock(&info->xport_lock);
+    add_pending(info, &req, msg, seq);
+    pthread_mutex_unlock(&info->xport_lock);
+
+    res = nl_send_auto_complete(info->cmd_sock, msg);
+    if (res >= 0)
+        nl_trace_record(info, NL_TRACE_TX, nlmsg_hdr(msg));
+
+    pthread_mutex_lock(&info->xport_lock);
+    if (res < 0) {
+        ALOGE("%s: failed to send seq %u: %d", __func__, req.seq, res);
+        unlink_pending(info, &req);
+        pthread_mutex_unlock(&info->xport_lock);
+        cmd_sched_release(info, prio);
+        return res;
+    }
+
+    while (!req.done) {
+        if (info->xport_reading) {
+            pthread_cond_wait(&info->xport_cond, &info->xport_lock);
+            continue;
+        }
+
+        /* Nobody is reading the socket; take over until our request is
+         * done, then hand the role to the next waiter. */
+        read_as_reader(info, true);
+    }
+
+    unlink_pending(info, &req);
+    pthread_mutex_unlock(&info->xport_lock);
+    cmd_sched_release(info, prio);
+    return req.err;
+}
+
+int nl_transport_request_async(hal_info *info, struct nl_msg *msg, int prio,
+        nl_recvmsg_msg_cb_t valid_cb, void *valid_arg,
+        nl_transport_done_cb done_cb, void *done_arg, uint32_t *seq)
+{
+    nl_pending_request *req =
+        (nl_pending_request *)malloc(sizeof(nl_pending_request));
+    int res;
+
+    if (req == NULL)
+        return -NLE_NOMEM;
+
+    memset(req, 0, sizeof(*req));
+    req->valid_cb = valid_cb;
+    req->valid_arg = valid_arg;
+    req->done_cb = done_cb;
+    req->done_arg = done_arg;
+    req->prio = prio;
+
+    pthread_mutex_lock(&info->xport_lock);
+    res = start_completion_thread(info);
+    if (res < 0) {
+        pthread_mutex_unlock(&info->xport_lock);
+        free(req);
+        return res;
+    }
+    bool urgent = sched_urgent(info);
+    pthread_mutex_unlock(&info->xport_lock);
+    cmd_sched_acquire(info, prio, urgent);
+
+    pthread_mutex_lock(&info->xport_lock);
+    add_pending(info, req, msg, seq);
+    uint32_t req_seq = req->seq;
+    hal_timer_init(&req->timeout, async_timeout_handler,
+            (void *)(uintptr_t)req_seq);
+    hal_timer_start(info, &req->timeout, NL_TRANSPORT_ASYNC_TIMEOUT_MS, 0);
+    pthread_mutex_unlock(&info->xport_lock);
+
+    res = nl_send_auto_complete(info->cmd_sock, msg);
+    if (res < 0) {
+        ALOGE("%s: failed to send seq %u: %d", __func__, req_seq, res);
+        pthread_mutex_lock(&info->xport_lock);
+        /* Nothing can have completed it since nothing was sent, but it
+         * may have been cancelled; in that case done_cb reports it. */
+        req = find_pending(info, req_seq);
+        if (req != NULL) {
+            hal_timer_cancel(info, &req->timeout);
+            unlink_pending(info, req);
+            cmd_sched_release(info, prio);
+            free(req);
+        } else {
+            res = 0;
+        }
+        pthread_mutex_unlock(&info->xport_lock);
+        return res;
+    }
+
+    nl_trace_record(info, NL_TRACE_TX, nlmsg_hdr(msg));
+    return 0;
+}
+
+int nl_transport_cancel(hal_info *info, uint32_t seq)
+{
+    bool reader = false;
+    int res = -ENOENT;
+
+    pthread_mutex_lock(&info->xport_lock);
+
+    /* A reply handler for this request may be running on the reader; wait
+     * for it unless we are that reader, being called from the handler. */
+    while (info->xport_cb_seq == seq) {
+        reader = info->xport_reading
+            && pthread_equal(info->xport_reader, pthread_self());
+        if (reader)
+            break;
+        pthread_cond_wait(&info->xport_cond, &info->xport_lock);
+    }
+
+    nl_pending_request *req = find_pending(info, seq);
+    if (req != NULL && !req->done) {
+        ALOGI("%s: cancelling seq %u", __func__, seq);
+        finish_pending(info, req, -ECANCELED);
+        res = 0;
+    }
+
+    pthread_mutex_unlock(&info->xport_lock);
+    return res;
+}
+
+bool nl_transport_may_wait(hal_info *info)
+{
+    pthread_t self = pthread_self();
+
+    pthread_mutex_lock(&info->xport_lock);
+    bool ok = info->in_event_loop && !info->clean_up
+        && !pthread_equal(info->event_thread, self)
+        && !pthread_equal(info->callback_thread, self)
+        && !(info->completion_running
+                && pthread_equal(info->completion_thread, self));
+    pthread_mutex_unlock(&info->xport_lock);
+    return ok;
+}
+
+void nl_transport_poll(hal_info *info)
+{
+    pthread_mutex_lock(&info->xport_lock);
+    if (info->xport_reading) {
+        /* A synchronous caller is about to drain the socket. cmd_sock
+         * stays readable until it does, so stop watching it rather than
+         * spin; the reader hands it back when it lets go of the role. */
+        watch_cmd_sock(info, false);
+        pthread_mutex_unlock(&info->xport_lock);
+        return;
+    }
+    read_as_reader(info, false);
+    pthread_mutex_unlock(&info->xport_lock);
+}
@@ -0,0 +1,98 @@
+/*
+ * Copyright (C) 2014 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef __WIFI_HAL_NL_TRANSPORT_H__
+#define __WIFI_HAL_NL_TRANSPORT_H__
+
+#include "common.h"
+#include "event_loop.h"
+
+/*
+ * Request/response transport over hal_info::cmd_sock.
+ *
+ * Every request is stamped with its own netlink sequence number and
+ * recorded in a table of pending requests before it is sent, so any number
+ * of threads may have requests in flight on the shared socket. Whichever
+ * waiter finds the socket idle becomes the reader; it demultiplexes each
+ * reply, ACK, error and DONE message to the pending request with the
+ * matching sequence number and wakes its owner. The other waiters sleep
+ * until their request completes or the reader role is handed over.
+ *
+ * Asynchronous requests do not wait at all. When no synchronous caller is
+ * reading, the event loop drains cmd_sock on their behalf, and their
+ * completion callback runs on a dedicated completion thread so that it may
+ * block or issue further requests. An asynchronous request that is not
+ * answered within NL_TRANSPORT_ASYNC_TIMEOUT_MS completes with -ETIMEDOUT.
+ *
+ * Before it is sent every request, synchronous or not, waits for a slot
+ * from the command scheduler according to its wifi_cmd_priority class;
+ * see cmd_sched.h.
+ */
+
+#define NL_TRANSPORT_ASYNC_TIMEOUT_MS   (10000)
+
+/* Invoked exactly once per asynchronous request, with 0, a negative errno
+ * from the kernel, -ECANCELED, -ETIMEDOUT, or a negative libnl error. */
+typedef void (*nl_transport_done_cb)(void *arg, int err);
+
+typedef struct nl_pending_request {
+    uint32_t seq;                                   // nlmsg_seq of the request
+    int err;                                        // 0 or negative errno once done
+    bool done;                                      // ACK, error or DONE received
+    nl_recvmsg_msg_cb_t valid_cb;                   // invoked for each reply
+    void *valid_arg;
+    nl_transport_done_cb done_cb;                   // set for asynchronous requests
+    void *done_arg;
+    int prio;                                       // class the request was scheduled in
+    hal_timer timeout;                              // deadline of asynchronous requests
+    struct nl_pending_request *next;
+} nl_pending_request;
+
+wifi_error nl_transport_init(hal_info *info);
+void nl_transport_cleanup(hal_info *info);
+
+/* Sends msg on cmd_sock and blocks until the kernel acknowledges it.
+ * Replies are passed to valid_cb (if not NULL) on the reading thread.
+ * If seq is not NULL it receives the sequence number before the message
+ * is sent, for use with nl_transport_cancel(). Returns 0, a negative errno
+ * reported by the kernel, -ECANCELED, or a negative libnl error if the
+ * message could not be sent. */
+int nl_transport_request(hal_info *info, struct nl_msg *msg, int prio,
+        nl_recvmsg_msg_cb_t valid_cb, void *valid_arg, uint32_t *seq);
+
+/* Sends msg on cmd_sock and returns once it is sent. done_cb is invoked on the
+ * completion thread when the request finishes. If sending fails the error
+ * is returned and done_cb is not invoked; a request cancelled in the
+ * meantime returns 0 and reports -ECANCELED through done_cb instead. */
+int nl_transport_request_async(hal_info *info, struct nl_msg *msg, int prio,
+        nl_recvmsg_msg_cb_t valid_cb, void *valid_arg,
+        nl_transport_done_cb done_cb, void *done_arg, uint32_t *seq);
+
+/* Abandons the request with the given sequence number; it completes with
+ * -ECANCELED and any reply still in flight is dropped. Once this returns,
+ * valid_cb is not running and will not be invoked again for the request. */
+int nl_transport_cancel(hal_info *info, uint32_t seq);
+
+/* Whether the calling thread may sleep until an asynchronous request
+ * completes: the event loop must be running to read the answer, and
+ * neither it nor the completion thread can wait for themselves. Nor may
+ * the callback thread, which the event thread may be waiting for. */
+bool nl_transport_may_wait(hal_info *info);
+
+/* Called by the event loop when cmd_sock is readable */
+void nl_transport_poll(hal_info *info);
+
+#endif /* __WIFI_HAL_NL_TRANSPORT_H__ */
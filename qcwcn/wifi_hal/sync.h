@@ -14,7 +14,9 @@
  * limitations under the License.
  */
 
+#include <errno.h>
 #include <pthread.h>
+#include <time.h>
 
 #ifndef __WIFI_HAL_SYNC_H__
 #define __WIFI_HAL_SYNC_H__
@@ -41,49 +43,118 @@ public:
     }
 };
 
-class Condition
+/* Mutex and condition behind a Completion; pooled, see cmd_slab.h */
+typedef struct completion_slot {
+    pthread_mutex_t lock;
+    pthread_cond_t cond;                    /* on CLOCK_MONOTONIC */
+    bool done;
+    struct completion_slot *next;           /* while idle in the pool */
+} completion_slot;
+
+/* An idle slot with done cleared, or NULL if none could be allocated */
+completion_slot *completion_slot_get();
+void completion_slot_put(completion_slot *s);
+
+/* One-shot completion: signal() marks it complete and wakes the waiter;
+ * wait() returns once it is complete and consumes the completion. A signal
+ * that arrives before the waiter goes to sleep is therefore not lost.
+ * Timeouts are measured on CLOCK_MONOTONIC.
+ *
+ * Most commands never wait, so the mutex and condition are only taken
+ * from the pool on first use and go back to it with the Completion. */
+class Completion
 {
 private:
-    pthread_cond_t mCondition;
-    pthread_mutex_t mMutex;
+    completion_slot *mSlot;
+
+    completion_slot *slot() {
+        completion_slot *s = __atomic_load_n(&mSlot, __ATOMIC_ACQUIRE);
+        if (s != NULL)
+            return s;
+
+        /* signal() and wait() may race to bind the first slot */
+        completion_slot *fresh = completion_slot_get();
+        if (fresh == NULL)
+            return NULL;
+        if (__atomic_compare_exchange_n(&mSlot, &s, fresh, false,
+                    __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE))
+            return fresh;
+        completion_slot_put(fresh);
+        return s;
+    }
 
 public:
-    Condition() {
-        pthread_mutex_init(&mMutex, NULL);
-        pthread_cond_init(&mCondition, NULL);
+    Completion() : mSlot(NULL) {
     }
-    ~Condition() {
-        pthread_cond_destroy(&mCondition);
-        pthread_mutex_destroy(&mMutex);
+    ~Completion() {
+        if (mSlot != NULL)
+            completion_slot_put(mSlot);
+    }
+
+    /* Forget a completion nobody waited for; call before issuing the
+     * request whose completion is to be awaited. */
+    void reset() {
+        completion_slot *s = slot();
+        if (s == NULL)
+            return;
+        pthread_mutex_lock(&s->lock);
+        s->done = false;
+        pthread_mutex_unlock(&s->lock);
     }
 
     int wait() {
-        return pthread_cond_wait(&mCondition, &mMutex);
+        completion_slot *s = slot();
+        if (s == NULL)
+            return ENOMEM;
+        pthread_mutex_lock(&s->lock);
+        while (!s->done)
+            pthread_cond_wait(&s->cond, &s->lock);
+        s->done = false;
+        pthread_mutex_unlock(&s->lock);
+        return 0;
     }
 
-    int wait(struct timespec abstime)
+    /* Waits at most 'timeout' (relative); returns 0 or ETIMEDOUT */
+    int wait(struct timespec timeout)
     {
-        struct timeval now;
+        struct timespec deadline;
+        int res = 0;
 
-        gettimeofday(&now,NULL);
+        completion_slot *s = slot();
+        if (s == NULL)
+            return ENOMEM;
 
-        abstime.tv_sec += now.tv_sec;
-        if(((abstime.tv_nsec + now.tv_usec*1000) > 1000*1000*1000) || (abstime.tv_nsec + now.tv_usec*1000 < 0))
-        {
-           abstime.tv_sec += 1;
-           abstime.tv_nsec += now.tv_usec * 1000;
-           abstime.tv_nsec -= 1000*1000*1000;
+        clock_gettime(CLOCK_MONOTONIC, &deadline);
+        deadline.tv_sec += timeout.tv_sec;
+        deadline.tv_nsec += timeout.tv_nsec;
+        if (deadline.tv_nsec >= 1000000000L) {
+            deadline.tv_sec += deadline.tv_nsec / 1000000000L;
+            deadline.tv_nsec %= 1000000000L;
         }
-        else
-        {
-            abstime.tv_nsec += now.tv_usec * 1000;
+
+        pthread_mutex_lock(&s->lock);
+        while (!s->done && res != ETIMEDOUT)
+            res = pthread_cond_timedwait(&s->cond, &s->lock, &deadline);
+        if (s->done) {
+            s->done = false;
+            res = 0;
         }
-        return pthread_cond_timedwait(&mCondition, &mMutex, &abstime);
+        pthread_mutex_unlock(&s->lock);
+        return res;
     }
 
     void signal() {
-        pthread_cond_signal(&mCondition);
+        completion_slot *s = slot();
+        if (s == NULL)
+            return;
+        pthread_mutex_lock(&s->lock);
+        s->done = true;
+        pthread_cond_signal(&s->cond);
+        pthread_mutex_unlock(&s->lock);
     }
+
+private:
+    Completion(const Completion&);          // the slot is not shared
 };
 
 #endif
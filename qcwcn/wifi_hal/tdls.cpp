@@ -36,9 +36,43 @@
 #include "common.h"
 #include "cpp_bindings.h"
 #include "tdlsCommand.h"
+#include "attr_schema.h"
 
 //Singleton Static Instance
 TdlsCommand* TdlsCommand::mTdlsCommandInstance  = NULL;
+
+/* Payload of a QCA_NL80211_VENDOR_SUBCMD_TDLS_STATE event. */
+typedef struct {
+    mac_addr addr;
+    wifi_tdls_status status;
+} tdls_state_event;
+
+#define TDLS_STATE(attr, kind, member) \
+    ATTR_FIELD(tdls_state_event, QCA_WLAN_VENDOR_ATTR_TDLS_##attr, kind, \
+               member, ATTR_REQUIRED)
+
+static const attr_field tdls_state_fields[] = {
+    TDLS_STATE(MAC_ADDR, BINARY, addr),
+    TDLS_STATE(STATE, U32, status.state),
+    TDLS_STATE(REASON, S32, status.reason),
+    TDLS_STATE(CHANNEL, U32, status.channel),
+    TDLS_STATE(GLOBAL_OPERATING_CLASS, U32, status.global_operating_class),
+};
+ATTR_SCHEMA(tdls_state_schema, tdls_state_fields,
+            QCA_WLAN_VENDOR_ATTR_TDLS_STATE_MAX);
+
+#define TDLS_GET_STATUS(attr, kind, member) \
+    ATTR_FIELD(wifi_tdls_status, QCA_WLAN_VENDOR_ATTR_TDLS_GET_STATUS_##attr, \
+               kind, member, ATTR_REQUIRED)
+
+static const attr_field tdls_get_status_fields[] = {
+    TDLS_GET_STATUS(STATE, U32, state),
+    TDLS_GET_STATUS(REASON, S32, reason),
+    TDLS_GET_STATUS(CHANNEL, U32, channel),
+    TDLS_GET_STATUS(GLOBAL_OPERATING_CLASS, U32, global_operating_class),
+};
+ATTR_SCHEMA(tdls_get_status_schema, tdls_get_status_fields,
+            QCA_WLAN_VENDOR_ATTR_TDLS_GET_STATUS_MAX);
 TdlsCommand::TdlsCommand(wifi_handle handle, int id, u32 vendor_id, u32 subcmd)
         : WifiVendorCommand(handle, id, vendor_id, subcmd)
 {
@@ -84,46 +118,11 @@ void TdlsCommand::setSubCmd(u32 subcmd)
 {
     mSubcmd = subcmd;
 }
-//callback handlers registered for nl message send
-static int error_handler_LLStats(struct sockaddr_nl *nla, struct nlmsgerr *err,
-                         void *arg)
-{
-    struct sockaddr_nl * tmp;
-    int *ret = (int *)arg;
-    tmp = nla;
-    *ret = err->error;
-    ALOGE("%s: Error code:%d (%s)", __func__, *ret, strerror(-(*ret)));
-    return NL_STOP;
-}
-
-//callback handlers registered for nl message send
-static int ack_handler_LLStats(struct nl_msg *msg, void *arg)
-{
-    int *ret = (int *)arg;
-    struct nl_msg * a;
-
-    ALOGE("%s: called", __func__);
-    a = msg;
-    *ret = 0;
-    return NL_STOP;
-}
-
-//callback handlers registered for nl message send
-static int finish_handler_LLStats(struct nl_msg *msg, void *arg)
-{
-  int *ret = (int *)arg;
-  struct nl_msg * a;
-
-  ALOGE("%s: called", __func__);
-  a = msg;
-  *ret = 0;
-  return NL_SKIP;
-}
 // This function will be the main handler for incoming event LLStats_SUBCMD
 //Call the appropriate callback handler after parsing the vendor data.
 int TdlsCommand::handleEvent(WifiEvent &event)
 {
-    ALOGI("Got a TDLS message from Driver");
+    HAL_LOGD(HAL_LOG_TDLS, "Got a TDLS message from Driver");
     unsigned i=0;
     u32 status;
     int ret = WIFI_SUCCESS;
@@ -135,76 +134,24 @@ int TdlsCommand::handleEvent(WifiEvent &event)
     {
         case QCA_NL80211_VENDOR_SUBCMD_TDLS_STATE:
             {
-                wifi_request_id id;
-                struct nlattr *tb_vendor[QCA_WLAN_VENDOR_ATTR_TDLS_STATE_MAX
-                    + 1];
-                mac_addr addr;
-                wifi_tdls_status status;
-                int rem;
-
-                memset(&addr, 0, sizeof(mac_addr));
-                memset(&status, 0, sizeof(wifi_tdls_status));
-                nla_parse(tb_vendor, QCA_WLAN_VENDOR_ATTR_TDLS_STATE_MAX,
-                        (struct nlattr *)mVendorData,
-                        mDataLen, NULL);
-
-                ALOGI("QCA_NL80211_VENDOR_SUBCMD_TDLS_STATE Received");
-                if (!tb_vendor[QCA_WLAN_VENDOR_ATTR_TDLS_MAC_ADDR])
-                {
-                    ALOGE("%s: QCA_WLAN_VENDOR_ATTR_TDLS_MAC_ADDR not found",
-                            __func__);
-                    return WIFI_ERROR_INVALID_ARGS;
-                }
-                memcpy(addr,
-                  (u8 *)nla_data(tb_vendor[QCA_WLAN_VENDOR_ATTR_TDLS_MAC_ADDR]),
-                  nla_len(tb_vendor[QCA_WLAN_VENDOR_ATTR_TDLS_MAC_ADDR]));
-
-                ALOGI(MAC_ADDR_STR, MAC_ADDR_ARRAY(addr));
-
-                if (!tb_vendor[QCA_WLAN_VENDOR_ATTR_TDLS_STATE])
-                {
-                    ALOGE("%s: QCA_WLAN_VENDOR_ATTR_TDLS_STATE not found",
-                            __func__);
-                    return WIFI_ERROR_INVALID_ARGS;
-                }
-                status.state = (wifi_tdls_state)
-                    get_u32(tb_vendor[QCA_WLAN_VENDOR_ATTR_TDLS_STATE]);
-                ALOGI("TDLS: State New : %d ", status.state);
-
-                if (!tb_vendor[QCA_WLAN_VENDOR_ATTR_TDLS_REASON])
-                {
-                    ALOGE("%s: QCA_WLAN_VENDOR_ATTR_TDLS_REASON not found",
-                            __func__);
-                    return WIFI_ERROR_INVALID_ARGS;
-                }
-                status.reason = (wifi_tdls_reason)
-                    get_s32(tb_vendor[QCA_WLAN_VENDOR_ATTR_TDLS_REASON]);
-                ALOGI("TDLS: Reason : %d ", status.reason);
-
-                if (!tb_vendor[QCA_WLAN_VENDOR_ATTR_TDLS_CHANNEL])
-                {
-                    ALOGE("%s: QCA_WLAN_VENDOR_ATTR_TDLS_CHANNEL not found",
-                            __func__);
-                    return WIFI_ERROR_INVALID_ARGS;
-                }
-                status.channel =
-                    get_u32(tb_vendor[QCA_WLAN_VENDOR_ATTR_TDLS_CHANNEL]);
-                ALOGI("TDLS: channel : %d ", status.channel);
-
-                if (!tb_vendor[
-                        QCA_WLAN_VENDOR_ATTR_TDLS_GLOBAL_OPERATING_CLASS])
-                {
-                    ALOGE("%s: QCA_WLAN_VENDOR_ATTR_TDLS_GLOBAL_OPERATING_CLASS"
-                            " not found", __func__);
-                    return WIFI_ERROR_INVALID_ARGS;
-                }
-                status.global_operating_class = get_u32(
-                   tb_vendor[QCA_WLAN_VENDOR_ATTR_TDLS_GLOBAL_OPERATING_CLASS]);
-                ALOGI("TDLS: global_operating_class: %d ",
-                        status.global_operating_class);
+                tdls_state_event state;
+
+                memset(&state, 0, sizeof(tdls_state_event));
+                HAL_LOGD(HAL_LOG_TDLS, "QCA_NL80211_VENDOR_SUBCMD_TDLS_STATE Received");
+                ret = attr_decode(&tdls_state_schema, &state, NULL,
+                        (struct nlattr *)mVendorData, mDataLen);
+                if (ret != WIFI_SUCCESS)
+                    return ret;
+
+                HAL_LOGD(HAL_LOG_TDLS, MAC_ADDR_STR, MAC_ADDR_ARRAY(state.addr));
+                HAL_LOGD(HAL_LOG_TDLS, "TDLS: State New : %d ", state.status.state);
+                HAL_LOGD(HAL_LOG_TDLS, "TDLS: Reason : %d ", state.status.reason);
+                HAL_LOGD(HAL_LOG_TDLS, "TDLS: channel : %d ", state.status.channel);
+                HAL_LOGD(HAL_LOG_TDLS, "TDLS: global_operating_class: %d ",
+                        state.status.global_operating_class);
 
                 if (mHandler.on_tdls_state_changed)
-                    (*mHandler.on_tdls_state_changed)(addr, status);
+                    (*mHandler.on_tdls_state_changed)(state.addr, state.status);
                 else
                     ALOGE("TDLS: No Callback registered: ");
             }
@@ -220,7 +167,7 @@ int TdlsCommand::handleEvent(WifiEvent &event)
 
 int TdlsCommand::handleResponse(WifiEvent &reply)
 {
-    ALOGI("Received a TDLS response message from Driver");
+    HAL_LOGD(HAL_LOG_TDLS, "Received a TDLS response message from Driver");
     u32 status;
     int i = 0;
     WifiVendorCommand::handleResponse(reply);
@@ -229,59 +176,18 @@ int TdlsCommand::handleResponse(WifiEvent &reply)
     {
         case QCA_NL80211_VENDOR_SUBCMD_TDLS_GET_STATUS:
             {
-                wifi_request_id id;
-                struct nlattr *tb_vendor[
-                    QCA_WLAN_VENDOR_ATTR_TDLS_GET_STATUS_MAX + 1];
-                int rem;
-                nla_parse(tb_vendor, QCA_WLAN_VENDOR_ATTR_TDLS_GET_STATUS_MAX,
-                        (struct nlattr *)mVendorData,
-                        mDataLen, NULL);
-
-                ALOGI("QCA_NL80211_VENDOR_SUBCMD_TDLS_GET_STATUS Received");
+                HAL_LOGD(HAL_LOG_TDLS, "QCA_NL80211_VENDOR_SUBCMD_TDLS_GET_STATUS Received");
                 memset(&mTDLSgetStatusRspParams, 0, sizeof(wifi_tdls_status));
 
-                if (!tb_vendor[QCA_WLAN_VENDOR_ATTR_TDLS_GET_STATUS_STATE])
-                {
-                    ALOGE("%s: QCA_WLAN_VENDOR_ATTR_TDLS_GET_STATUS_STATE"
-                            " not found", __func__);
-                    return WIFI_ERROR_INVALID_ARGS;
-                }
-                mTDLSgetStatusRspParams.state = (wifi_tdls_state)get_u32(
-                        tb_vendor[QCA_WLAN_VENDOR_ATTR_TDLS_GET_STATUS_STATE]);
-                ALOGI("TDLS: State : %u ", mTDLSgetStatusRspParams.state);
-
-                if (!tb_vendor[QCA_WLAN_VENDOR_ATTR_TDLS_GET_STATUS_REASON])
-                {
-                    ALOGE("%s: QCA_WLAN_VENDOR_ATTR_TDLS_GET_STATUS_REASON"
-                            " not found", __func__);
-                    return WIFI_ERROR_INVALID_ARGS;
-                }
-                mTDLSgetStatusRspParams.reason = (wifi_tdls_reason)get_s32(
-                        tb_vendor[QCA_WLAN_VENDOR_ATTR_TDLS_GET_STATUS_REASON]);
-                ALOGI("TDLS: Reason : %d ", mTDLSgetStatusRspParams.reason);
-
-                if (!tb_vendor[QCA_WLAN_VENDOR_ATTR_TDLS_GET_STATUS_CHANNEL])
-                {
-                    ALOGE("%s: QCA_WLAN_VENDOR_ATTR_TDLS_GET_STATUS_CHANNEL"
-                            " not found", __func__);
+                if (attr_decode(&tdls_get_status_schema,
+                        &mTDLSgetStatusRspParams, NULL,
+                        (struct nlattr *)mVendorData, mDataLen) != WIFI_SUCCESS)
                     return WIFI_ERROR_INVALID_ARGS;
-                }
-                mTDLSgetStatusRspParams.channel = get_u32(tb_vendor[
-                        QCA_WLAN_VENDOR_ATTR_TDLS_GET_STATUS_CHANNEL]);
-                ALOGI("TDLS: channel : %d ", mTDLSgetStatusRspParams.channel);
-
-                if (!tb_vendor[
-                  QCA_WLAN_VENDOR_ATTR_TDLS_GET_STATUS_GLOBAL_OPERATING_CLASS])
-                {
-                    ALOGE("%s:"
-                   "QCA_WLAN_VENDOR_ATTR_TDLS_GET_STATUS_GLOBAL_OPERATING_CLASS"
-                    " not found", __func__);
-                    return WIFI_ERROR_INVALID_ARGS;
-                }
-                mTDLSgetStatusRspParams.global_operating_class =
-                  get_u32(tb_vendor[
-                  QCA_WLAN_VENDOR_ATTR_TDLS_GET_STATUS_GLOBAL_OPERATING_CLASS]);
-                ALOGI("TDLS: global_operating_class: %d ",
+
+                HAL_LOGD(HAL_LOG_TDLS, "TDLS: State : %u ", mTDLSgetStatusRspParams.state);
+                HAL_LOGD(HAL_LOG_TDLS, "TDLS: Reason : %d ", mTDLSgetStatusRspParams.reason);
+                HAL_LOGD(HAL_LOG_TDLS, "TDLS: channel : %d ", mTDLSgetStatusRspParams.channel);
+                HAL_LOGD(HAL_LOG_TDLS, "TDLS: global_operating_class: %d ",
                         mTDLSgetStatusRspParams.global_operating_class);
             }
             break;
@@ -322,7 +228,9 @@ void TdlsCommand::getStatusRspParams(wifi_tdls_status *status)
 
 int TdlsCommand::requestResponse()
 {
-    return WifiCommand::requestResponse(mMsg);
+    /* enable and disable are answered by a TDLS_STATE event */
+    return WifiCommand::requestResponse(mMsg,
+            mSubcmd != QCA_NL80211_VENDOR_SUBCMD_TDLS_GET_STATUS);
 }
 
 /* wifi_enable_tdls - enables TDLS-auto mode for a specific route
@@ -438,7 +346,7 @@ wifi_error wifi_disable_tdls(wifi_interface_handle iface, mac_addr addr)
     ret = pTdlsCommand->set_iface_id(iinfo->name);
     if (ret < 0)
         goto cleanup;
-    ALOGE("%s ifindex obtained:%d",__func__, ret);
+    HAL_LOGD(HAL_LOG_TDLS, "%s ifindex obtained:%d",__func__, ret);
 
     /*add the attributes*/
     nl_data = pTdlsCommand->attr_start(NL80211_ATTR_VENDOR_DATA);
@@ -485,7 +393,7 @@ wifi_error wifi_get_tdls_status(wifi_interface_handle iface, mac_addr addr,
     ret = pTdlsCommand->set_iface_id(iinfo->name);
     if (ret < 0)
         goto cleanup;
-    ALOGE("%s ifindex obtained:%d",__func__, ret);
+    HAL_LOGD(HAL_LOG_TDLS, "%s ifindex obtained:%d",__func__, ret);
 
     /*add the attributes*/
     nl_data = pTdlsCommand->attr_start(NL80211_ATTR_VENDOR_DATA);
@@ -33,8 +33,8 @@
 
 #include "nl80211_copy.h"
 
-#include <dirent.h>
 #include <net/if.h>
+#include <errno.h>
 
 #include "sync.h"
 
@@ -46,6 +46,16 @@
 #include "common.h"
 #include "cpp_bindings.h"
 #include "ifaceeventhandler.h"
+#include "nl_transport.h"
+#include "nl_msg_pool.h"
+#include "iface_cache.h"
+#include "event_loop.h"
+#include "event_filter.h"
+#include "event_ring.h"
+#include "hal_perf.h"
+#include "nl_trace.h"
+#include "hal_transport.h"
+#include "cap_snapshot.h"
 
 /*
  BUGBUG: normally, libnl allocates ports for all connections it makes; but
@@ -60,25 +70,26 @@
 #define WIFI_HAL_EVENT_SOCK_PORT     645
 
 static void internal_event_handler(wifi_handle handle, int events);
+static int internal_event_sock_handler(nl_msg *msg, void *arg);
 static int internal_valid_message_handler(nl_msg *msg, void *arg);
-static int wifi_get_multicast_id(wifi_handle handle, const char *name,
-        const char *group);
-static int wifi_add_membership(wifi_handle handle, const char *group);
-static wifi_error wifi_init_interfaces(wifi_handle handle);
+static void internal_deliver_event(hal_info *info, struct nl_msg *msg,
+        int cmd, uint32_t vendor_id, int subcmd);
+static int wifi_resolve_family(hal_info *info, const char *name);
+
+/* Transport the next wifi_initialize() runs on */
+static const hal_transport_ops *next_transport;
 
 /* Initialize/Cleanup */
 
+void wifi_set_transport(const hal_transport_ops *ops)
+{
+    next_transport = ops;
+}
+
 wifi_interface_handle wifi_get_iface_handle(wifi_handle handle, char *name)
 {
     hal_info *info = (hal_info *)handle;
-    for (int i=0;i<info->num_interfaces;i++)
-    {
-        if (!strcmp(info->interfaces[i]->name, name))
-        {
-            return ((wifi_interface_handle )(info->interfaces)[i]);
-        }
-    }
-    return NULL;
+    return (wifi_interface_handle)iface_cache_find(info, name);
 }
 
 void wifi_socket_set_local_port(struct nl_sock *sock, uint32_t port)
@@ -125,31 +136,22 @@ static nl_sock * wifi_create_nl_socket(int port)
     return sock;
 }
 
-int ack_handler(struct nl_msg *msg, void *arg)
+/* Sizes the kernel receive buffer of sock. SO_RCVBUFFORCE may go past
+ * net.core.rmem_max if the process is allowed to; otherwise SO_RCVBUF is
+ * used and the kernel caps it. Returns the size set, 0 on failure. */
+static unsigned wifi_set_rcvbuf(struct nl_sock *sock, unsigned size)
 {
-    int *err = (int *)arg;
-    *err = 0;
-    ALOGD("%s invoked",__func__);
-    return NL_STOP;
-}
+    int fd = nl_socket_get_fd(sock);
+    int val = (int)size;
 
-int finish_handler(struct nl_msg *msg, void *arg)
-{
-    int *ret = (int *)arg;
-    *ret = 0;
-    ALOGD("%s called",__func__);
-    return NL_SKIP;
+    if (setsockopt(fd, SOL_SOCKET, SO_RCVBUFFORCE, &val, sizeof(val)) < 0
+            && setsockopt(fd, SOL_SOCKET, SO_RCVBUF, &val, sizeof(val)) < 0) {
+        ALOGE("Could not set receive buffer to %u: %d", size, -errno);
+        return 0;
+    }
+    return size;
 }
 
-int error_handler(struct sockaddr_nl *nla,
-                  struct nlmsgerr *err, void *arg)
-{
-    int *ret = (int *)arg;
-    *ret = err->error;
-
-    ALOGD("%s invoked with error: %d", __func__, err->error);
-    return NL_SKIP;
-}
 static int no_seq_check(struct nl_msg *msg, void *arg)
 {
     ALOGD("no_seq_check received");
@@ -184,18 +186,28 @@ static wifi_error acquire_supported_features(wifi_interface_handle iface,
     }
 
     supportedFeatures.getResponseparams(set);
+    cap_snapshot_put(getHalInfo(handle), CAP_FEATURES, 0, 0, set, sizeof(*set));
 
 cleanup:
     return (wifi_error)ret;
 }
 
+/* Charges the time since *mark to phase and moves the mark */
+static void startup_phase(hal_info *info, int phase, uint64_t *mark)
+{
+    uint64_t now = hal_perf_now_us();
+
+    info->startup_us[phase] += (uint32_t)(now - *mark);
+    *mark = now;
+}
+
 wifi_error wifi_initialize(wifi_handle *handle)
 {
-    int err = 0;
     bool driver_loaded = false;
     wifi_error ret = WIFI_SUCCESS;
-    wifi_interface_handle iface_handle;
+    uint64_t start = hal_perf_now_us(), mark = start;
     srand(getpid());
+    hal_log_init();
 
     ALOGI("Initializing wifi");
     hal_info *info = (hal_info *)malloc(sizeof(hal_info));
@@ -205,6 +217,8 @@ wifi_error wifi_initialize(wifi_handle *handle)
     }
 
     memset(info, 0, sizeof(*info));
+    for (int g = 0; g < HAL_MCGRP_MAX; g++)
+        info->mcast_id[g] = -1;
 
     ALOGI("Creating socket");
     struct nl_sock *cmd_sock = wifi_create_nl_socket(WIFI_HAL_CMD_SOCK_PORT);
@@ -221,40 +235,122 @@ wifi_error wifi_initialize(wifi_handle *handle)
         return WIFI_ERROR_UNKNOWN;
     }
 
+    /* The event socket only carries multicast notifications, never ACKs,
+     * so only VALID needs a handler. The reference is kept for the event
+     * loop to reuse on every wakeup. */
     struct nl_cb *cb = nl_socket_get_cb(event_sock);
     if (cb == NULL) {
         ALOGE("Could not create handle");
         return WIFI_ERROR_UNKNOWN;
     }
 
-    err = 1;
     nl_cb_set(cb, NL_CB_SEQ_CHECK, NL_CB_CUSTOM, no_seq_check, NULL);
-    nl_cb_err(cb, NL_CB_CUSTOM, error_handler, &err);
-    nl_cb_set(cb, NL_CB_FINISH, NL_CB_CUSTOM, finish_handler, &err);
-    nl_cb_set(cb, NL_CB_ACK, NL_CB_CUSTOM, ack_handler, &err);
-
-    nl_cb_set(cb, NL_CB_VALID, NL_CB_CUSTOM, internal_valid_message_handler,
+    nl_cb_set(cb, NL_CB_VALID, NL_CB_CUSTOM, internal_event_sock_handler,
             info);
-    nl_cb_put(cb);
+    info->event_sock_cb = cb;
 
     info->cmd_sock = cmd_sock;
     info->event_sock = event_sock;
+    info->event_sock_rcvbuf = wifi_set_rcvbuf(event_sock, SOCKET_BUFFER_SIZE);
     info->clean_up = false;
     info->in_event_loop = false;
+    startup_phase(info, WIFI_STARTUP_SOCKETS, &mark);
+
+    if (wifi_init_event_handlers((wifi_handle)info) != WIFI_SUCCESS) {
+        ALOGE("Could not allocate event handler table");
+        nl_cb_put(info->event_sock_cb);
+        nl_socket_free(cmd_sock);
+        nl_socket_free(event_sock);
+        free(info);
+        return WIFI_ERROR_OUT_OF_MEMORY;
+    }
 
-    info->event_cb = (cb_info *)malloc(sizeof(cb_info) * DEFAULT_EVENT_CB_SIZE);
-    info->alloc_event_cb = DEFAULT_EVENT_CB_SIZE;
-    info->num_event_cb = 0;
+    if (event_loop_init(info) != WIFI_SUCCESS) {
+        ALOGE("Could not create event loop");
+        nl_cb_put(info->event_sock_cb);
+        nl_socket_free(cmd_sock);
+        nl_socket_free(event_sock);
+        wifi_free_event_handlers((wifi_handle)info);
+        free(info);
+        return WIFI_ERROR_UNKNOWN;
+    }
 
+    if (event_ring_init(info) != WIFI_SUCCESS) {
+        ALOGE("Could not allocate event ring");
+        nl_cb_put(info->event_sock_cb);
+        nl_socket_free(cmd_sock);
+        nl_socket_free(event_sock);
+        wifi_free_event_handlers((wifi_handle)info);
+        event_loop_cleanup(info);
+        free(info);
+        return WIFI_ERROR_OUT_OF_MEMORY;
+    }
+
+    if (nl_trace_init(info) != WIFI_SUCCESS) {
+        ALOGE("Could not allocate netlink trace");
+        nl_cb_put(info->event_sock_cb);
+        nl_socket_free(cmd_sock);
+        nl_socket_free(event_sock);
+        wifi_free_event_handlers((wifi_handle)info);
+        event_ring_cleanup(info);
+        event_loop_cleanup(info);
+        free(info);
+        return WIFI_ERROR_OUT_OF_MEMORY;
+    }
+
+    if (nl_transport_init(info) != WIFI_SUCCESS) {
+        ALOGE("Could not initialize command transport");
+        nl_cb_put(info->event_sock_cb);
+        nl_socket_free(cmd_sock);
+        nl_socket_free(event_sock);
+        wifi_free_event_handlers((wifi_handle)info);
+        event_ring_cleanup(info);
+        nl_trace_cleanup(info);
+        event_loop_cleanup(info);
+        free(info);
+        return WIFI_ERROR_UNKNOWN;
+    }
+
+    info->transport = next_transport;
+    if (info->transport != NULL && info->transport->attach(info) != WIFI_SUCCESS) {
+        ALOGE("Could not attach %s transport", info->transport->name);
+        nl_cb_put(info->event_sock_cb);
+        nl_socket_free(cmd_sock);
+        nl_socket_free(event_sock);
+        wifi_free_event_handlers((wifi_handle)info);
+        nl_transport_cleanup(info);
+        event_ring_cleanup(info);
+        nl_trace_cleanup(info);
+        event_loop_cleanup(info);
+        free(info);
+        return WIFI_ERROR_UNKNOWN;
+    }
+
+    nl_msg_pool_init(info);
+    pthread_mutex_init(&info->cmd_lock, NULL);
     info->cmd = (cmd_info *)malloc(sizeof(cmd_info) * DEFAULT_CMD_SIZE);
-    info->alloc_cmd = DEFAULT_CMD_SIZE;
+    info->alloc_cmd = info->cmd ? DEFAULT_CMD_SIZE : 0;
     info->num_cmd = 0;
+    pthread_mutex_init(&info->feature_lock, NULL);
+    startup_phase(info, WIFI_STARTUP_SUBSYSTEMS, &mark);
 
-    info->nl80211_family_id = genl_ctrl_resolve(cmd_sock, "nl80211");
+    info->nl80211_family_id = wifi_resolve_family(info, "nl80211");
     if (info->nl80211_family_id < 0) {
         ALOGE("Could not resolve nl80211 familty id");
+        if (info->transport != NULL)
+            info->transport->detach(info);
+        nl_cb_put(info->event_sock_cb);
         nl_socket_free(cmd_sock);
         nl_socket_free(event_sock);
+        wifi_free_event_handlers((wifi_handle)info);
+        nl_transport_cleanup(info);
+        nl_msg_pool_cleanup(info);
+        event_ring_cleanup(info);
+        nl_trace_cleanup(info);
+        event_loop_cleanup(info);
+        pthread_mutex_destroy(&info->cmd_lock);
+        pthread_mutex_destroy(&info->feature_lock);
+        free(info->cmd);
         free(info);
         return WIFI_ERROR_UNKNOWN;
     }
@@ -262,12 +358,11 @@ wifi_error wifi_initialize(wifi_handle *handle)
 
     *handle = (wifi_handle) info;
 
-    wifi_add_membership(*handle, "scan");
-    wifi_add_membership(*handle, "mlme");
-    wifi_add_membership(*handle, "regulatory");
-    wifi_add_membership(*handle, "vendor");
+    /* Groups are joined on demand as handlers register */
+    wifi_update_event_filter(*handle);
+    startup_phase(info, WIFI_STARTUP_FAMILY, &mark);
 
-    if (!is_wifi_driver_loaded()) {
+    if (info->transport == NULL && !is_wifi_driver_loaded()) {
         ret = (wifi_error)wifi_load_driver();
         if(ret != WIFI_SUCCESS) {
             ALOGE("%s Failed to load driver : %d\n", __func__, ret);
@@ -275,8 +370,9 @@ wifi_error wifi_initialize(wifi_handle *handle)
         }
         driver_loaded = true;
     }
+    startup_phase(info, WIFI_STARTUP_DRIVER, &mark);
 
-    ret = wifi_init_interfaces(*handle);
+    ret = iface_cache_init(info);
     if (ret != WIFI_SUCCESS) {
         ALOGI("Failed to init interfaces");
         goto unload;
@@ -288,29 +384,29 @@ wifi_error wifi_initialize(wifi_handle *handle)
         goto unload;
     }
 
-    iface_handle = wifi_get_iface_handle((info->interfaces[0])->handle,
-            (info->interfaces[0])->name);
-    if (iface_handle == NULL) {
-        int i;
-        for (i = 0; i < info->num_interfaces; i++)
-        {
-            free(info->interfaces[i]);
-        }
-        ALOGE("%s no iface with %s\n", __func__, info->interfaces[0]->name);
-        return WIFI_ERROR_UNKNOWN;
-    }
-    ret = acquire_supported_features(iface_handle,
-            &info->supported_feature_set);
-    if (ret != WIFI_SUCCESS) {
-        ALOGI("Failed to get supported feature set : %d", ret);
-        //acquire_supported_features failure is acceptable condition as legacy
-        //drivers might not support the required vendor command. So, do not
-        //consider it as failure of wifi_initialize
-        ret = WIFI_SUCCESS;
-    }
+    startup_phase(info, WIFI_STARTUP_INTERFACES, &mark);
+
+    if (cap_snapshot_init(info) != WIFI_SUCCESS)
+        ALOGE("Could not set up the capability snapshot");
+    startup_phase(info, WIFI_STARTUP_SNAPSHOT, &mark);
 
-    ALOGI("Initialized Wifi HAL Successfully; vendor cmd = %d Supported"
-            " features : %x", NL80211_CMD_VENDOR, info->supported_feature_set);
+    /* The command path is usable from here on. Features are asked for the
+     * first time something needs them, unless the driver only stays
+     * loaded for the duration of this call. */
+    if (driver_loaded)
+        hal_feature_set(info);
+
+    info->startup_total_us = (uint32_t)(hal_perf_now_us() - start);
+    ALOGI("Initialized Wifi HAL Successfully; vendor cmd = %d, took %u us"
+            " (sockets %u, subsystems %u, family %u, driver %u, interfaces %u,"
+            " snapshot %u)",
+            NL80211_CMD_VENDOR, info->startup_total_us,
+            info->startup_us[WIFI_STARTUP_SOCKETS],
+            info->startup_us[WIFI_STARTUP_SUBSYSTEMS],
+            info->startup_us[WIFI_STARTUP_FAMILY],
+            info->startup_us[WIFI_STARTUP_DRIVER],
+            info->startup_us[WIFI_STARTUP_INTERFACES],
+            info->startup_us[WIFI_STARTUP_SNAPSHOT]);
 
 unload:
     if (driver_loaded)
@@ -318,23 +414,50 @@ unload:
     return ret;
 }
 
-static int wifi_add_membership(wifi_handle handle, const char *group)
+feature_set hal_feature_set(hal_info *info)
 {
-    hal_info *info = getHalInfo(handle);
-
-    int id = wifi_get_multicast_id(handle, "nl80211", group);
-    if (id < 0) {
-        ALOGE("Could not find group %s", group);
-        return id;
+    if (__atomic_load_n(&info->features_known, __ATOMIC_ACQUIRE))
+        return info->supported_feature_set;
+
+    pthread_mutex_lock(&info->feature_lock);
+    if (!info->features_known) {
+        uint64_t start = hal_perf_now_us();
+        feature_set set = 0;
+        wifi_error ret = WIFI_ERROR_UNINITIALIZED;
+
+        if (cap_snapshot_get(info, CAP_FEATURES, 0, 0, &set, sizeof(set))
+                == sizeof(set))
+            ret = WIFI_SUCCESS;
+        else if (info->num_interfaces > 0)
+            ret = acquire_supported_features(
+                    getIfaceHandle(info->interfaces[0]), &set);
+        if (ret != WIFI_SUCCESS) {
+            //acquire_supported_features failure is acceptable condition as
+            //legacy drivers might not support the required vendor command
+            ALOGI("Failed to get supported feature set : %d", ret);
+            set = 0;
+        }
+        info->supported_feature_set = set;
+        info->startup_us[WIFI_STARTUP_FEATURES] =
+            (uint32_t)(hal_perf_now_us() - start);
+        __atomic_store_n(&info->features_known, true, __ATOMIC_RELEASE);
+        ALOGI("Supported features : %x, took %u us", set,
+                info->startup_us[WIFI_STARTUP_FEATURES]);
     }
+    pthread_mutex_unlock(&info->feature_lock);
 
-    int ret = nl_socket_add_membership(info->event_sock, id);
-    if (ret < 0) {
-        ALOGE("Could not add membership to group %s", group);
-    }
+    return info->supported_feature_set;
+}
 
-    // ALOGI("Successfully added membership for group %s", group);
-    return ret;
+wifi_error wifi_get_startup_timeline(wifi_handle handle,
+        wifi_startup_timeline *timeline)
+{
+    hal_info *info = getHalInfo(handle);
+
+    for (int i = 0; i < WIFI_STARTUP_PHASES; i++)
+        timeline->phase_us[i] = info->startup_us[i];
+    timeline->total_us = info->startup_total_us;
+    return WIFI_SUCCESS;
 }
 
 static void internal_cleaned_up_handler(wifi_handle handle)
@@ -342,7 +465,16 @@ static void internal_cleaned_up_handler(wifi_handle handle)
     hal_info *info = getHalInfo(handle);
     wifi_cleaned_up_handler cleaned_up_handler = info->cleaned_up_handler;
 
+    hal_log_flush_dumps();
+
+    /* no handler may run past this point */
+    event_ring_stop(info);
+    if (info->transport != NULL)
+        info->transport->detach(info);
+
     if (info->cmd_sock != 0) {
+        nl_cb_put(info->event_sock_cb);
+        info->event_sock_cb = NULL;
         nl_socket_free(info->cmd_sock);
         nl_socket_free(info->event_sock);
         info->cmd_sock = NULL;
@@ -350,6 +482,18 @@ static void internal_cleaned_up_handler(wifi_handle handle)
     }
 
     (*cleaned_up_handler)(handle);
+    wifi_free_event_handlers(handle);
+    nl_transport_cleanup(info);
+    nl_msg_pool_cleanup(info);
+    iface_cache_cleanup(info);
+    cap_snapshot_cleanup(info);
+    event_ring_cleanup(info);
+    nl_trace_cleanup(info);
+    event_loop_cleanup(info);
+    hal_perf_cleanup(info);
+    pthread_mutex_destroy(&info->cmd_lock);
+    pthread_mutex_destroy(&info->feature_lock);
+    free(info->cmd);
     free(info);
 
     ALOGI("Internal cleanup completed");
@@ -359,37 +503,83 @@ void wifi_cleanup(wifi_handle handle, wifi_cleaned_up_handler handler)
 {
     hal_info *info = getHalInfo(handle);
     info->cleaned_up_handler = handler;
+    /* revalidation may still wait for events the loop delivers */
+    cap_snapshot_stop(info);
     info->clean_up = true;
+    event_loop_wakeup(info);
 
     ALOGI("Wifi cleanup completed");
 }
 
+/* The kernel dropped events because event_sock was full: make room for
+ * the next burst and let the subsystems catch up on what was lost. */
+static void internal_overrun_handler(hal_info *info)
+{
+    uint32_t overruns = __atomic_add_fetch(&info->event_overruns, 1,
+            __ATOMIC_RELAXED);
+
+    if (info->event_sock_rcvbuf < SOCKET_BUFFER_SIZE_MAX) {
+        unsigned size = info->event_sock_rcvbuf ?
+            info->event_sock_rcvbuf * 2 : SOCKET_BUFFER_SIZE;
+        if (size > SOCKET_BUFFER_SIZE_MAX)
+            size = SOCKET_BUFFER_SIZE_MAX;
+        if (wifi_set_rcvbuf(info->event_sock, size))
+            info->event_sock_rcvbuf = size;
+    }
+    ALOGW("Events dropped by the kernel (overrun %u); receive buffer is %u",
+            overruns, info->event_sock_rcvbuf);
+
+    event_ring_post_overrun(info);
+}
+
+static void internal_deliver_overrun(hal_info *info)
+{
+    WifiCommand::notifyEventOverrun(info);
+}
+
 static int internal_pollin_handler(wifi_handle handle)
 {
     hal_info *info = getHalInfo(handle);
-    struct nl_cb *cb = nl_socket_get_cb(info->event_sock);
-    int res = nl_recvmsgs(info->event_sock, cb);
-    if(res)
+    errno = 0;
+    int res = nl_recvmsgs(info->event_sock, info->event_sock_cb);
+    if (res == -NLE_NOMEM && errno == ENOBUFS) {
+        /* libnl reports ENOBUFS from recvmsg() as NLE_NOMEM, and so it
+         * does a failed allocation, which is no overrun */
+        internal_overrun_handler(info);
+    } else if (res) {
         ALOGE("Error :%d while reading nl msg", res);
-    nl_cb_put(cb);
+    }
     return res;
 }
 
 static void internal_event_handler(wifi_handle handle, int events)
 {
-    if (events & POLLERR) {
+    if (events & EPOLLERR) {
         ALOGE("Error reading from socket");
         internal_pollin_handler(handle);
-    } else if (events & POLLHUP) {
+    } else if (events & EPOLLHUP) {
         ALOGE("Remote side hung up");
-    } else if (events & POLLIN) {
-        ALOGI("Found some events!!!");
+    } else if (events & EPOLLIN) {
+        HAL_LOGD(HAL_LOG_CORE, "Found some events!!!");
         internal_pollin_handler(handle);
     } else {
         ALOGE("Unknown event - %0x", events);
     }
 }
 
+static void event_sock_handler(hal_info *info, int fd, uint32_t events,
+        void *arg)
+{
+    internal_event_handler((wifi_handle)info, events);
+}
+
+/* Replies to asynchronous commands, when no caller is reading */
+static void cmd_sock_handler(hal_info *info, int fd, uint32_t events,
+        void *arg)
+{
+    nl_transport_poll(info);
+}
+
 /* Run event handler */
 void wifi_event_loop(wifi_handle handle)
 {
@@ -397,30 +587,21 @@ void wifi_event_loop(wifi_handle handle)
     if (info->in_event_loop) {
         return;
     } else {
+        info->event_thread = pthread_self();
         info->in_event_loop = true;
     }
 
-    pollfd pfd;
-    memset(&pfd, 0, sizeof(pfd));
-
-    pfd.fd = nl_socket_get_fd(info->event_sock);
-    pfd.events = POLLIN;
-
-    /* TODO: Add support for timeouts */
-
-    do {
-        int timeout = -1;                   /* Infinite timeout */
-        pfd.revents = 0;
-        //ALOGI("Polling socket");
-        int result = poll(&pfd, 1, -1);
-        ALOGI("Poll result = %0x", result);
-        if (result < 0) {
-            ALOGE("Error polling socket");
-        } else if (pfd.revents & (POLLIN | POLLHUP | POLLERR)) {
-            internal_event_handler(handle, pfd.revents);
-        }
-    } while (!info->clean_up);
+    event_ring_start(info, internal_deliver_event, internal_deliver_overrun);
 
+    if (event_loop_add_fd(info, hal_transport_fd(info, info->event_sock), EPOLLIN,
+                event_sock_handler, NULL) != WIFI_SUCCESS
+            || event_loop_add_fd(info, hal_transport_fd(info, info->cmd_sock), EPOLLIN,
+                cmd_sock_handler, NULL) != WIFI_SUCCESS) {
+        ALOGE("Could not watch netlink sockets");
+    } else {
+        cap_snapshot_revalidate(info);
+        event_loop_run(info);
+    }
 
     ALOGI("Cleaning up");
     internal_cleaned_up_handler(handle);
@@ -428,6 +609,13 @@ void wifi_event_loop(wifi_handle handle)
 
 ////////////////////////////////////////////////////////////////////////////////
 
+/* Valid callback of event_sock; replayed events skip the trace */
+static int internal_event_sock_handler(nl_msg *msg, void *arg)
+{
+    nl_trace_record(getHalInfo((wifi_handle)arg), NL_TRACE_RX, nlmsg_hdr(msg));
+    return internal_valid_message_handler(msg, arg);
+}
+
 static int internal_valid_message_handler(nl_msg *msg, void *arg)
 {
     wifi_handle handle = (wifi_handle)arg;
@@ -447,65 +635,84 @@ static int internal_valid_message_handler(nl_msg *msg, void *arg)
     if (cmd == NL80211_CMD_VENDOR) {
         vendor_id = event.get_u32(NL80211_ATTR_VENDOR_ID);
         subcmd = event.get_u32(NL80211_ATTR_VENDOR_SUBCMD);
-        ALOGI("event received %s, vendor_id = 0x%0x, subcmd = 0x%0x",
+        HAL_LOGD(HAL_LOG_CORE, "event received %s, vendor_id = 0x%0x, subcmd = 0x%0x",
                 event.get_cmdString(), vendor_id, subcmd);
     } else {
-        ALOGI("event received %s", event.get_cmdString());
+        HAL_LOGD(HAL_LOG_CORE, "event received %s", event.get_cmdString());
     }
 
-    ALOGI("event received %s, vendor_id = 0x%0x", event.get_cmdString(),
-            vendor_id);
-    // event.log();
+    if (HAL_LOG_ON(HAL_LOG_CORE, HAL_LOG_LEVEL_VERBOSE))
+        event.log();
 
-    bool dispatched = false;
-    for (int i = 0; i < info->num_event_cb; i++) {
-        if (cmd == info->event_cb[i].nl_cmd) {
-            if (cmd == NL80211_CMD_VENDOR
-                && ((vendor_id != info->event_cb[i].vendor_id)
-                || (subcmd != info->event_cb[i].vendor_subcmd)))
-            {
-                /* event for a different vendor, ignore it */
-                continue;
-            }
+    event_ring_post(info, msg, cmd, vendor_id, subcmd);
+    return NL_OK;
+}
 
-            cb_info *cbi = &(info->event_cb[i]);
-            (*(cbi->cb_func))(msg, cbi->cb_arg);
-            dispatched = true;
-        }
-    }
+static int internal_replay_handler(nl_msg *msg, void *arg)
+{
+    /* the family id may differ from the one of the recording device */
+    nlmsg_hdr(msg)->nlmsg_type = getHalInfo((wifi_handle)arg)->nl80211_family_id;
+    return internal_valid_message_handler(msg, arg);
+}
+
+wifi_error wifi_replay_nl_trace(wifi_handle handle, const char *path, bool realtime)
+{
+    return nl_trace_replay(getHalInfo(handle), path, realtime,
+            internal_replay_handler, handle);
+}
+
+/* Runs the handlers of an event, normally on the callback thread */
+static void internal_deliver_event(hal_info *info, struct nl_msg *msg,
+        int cmd, uint32_t vendor_id, int subcmd)
+{
+    WifiEvent event(msg);
+    if (event.parse() < 0)
+        return;
+
+    /* let the handlers reuse this view instead of parsing msg again */
+    uint64_t start = hal_perf_now_us();
+    info->current_event = &event;
+    int dispatched = wifi_dispatch_event(getWifiHandle(info), cmd, vendor_id,
+            subcmd, msg);
+    info->current_event = NULL;
+    if (cmd == NL80211_CMD_VENDOR)
+        hal_perf_record(info, subcmd, HAL_PERF_DISPATCH,
+                hal_perf_now_us() - start);
 
     if (!dispatched) {
-        ALOGI("event ignored!!");
+        HAL_LOGD(HAL_LOG_CORE, "event ignored!!");
     }
-
-    return NL_OK;
 }
 
 ////////////////////////////////////////////////////////////////////////////////
 
-class GetMulticastIdCommand : public WifiCommand
+/*
+ * Resolves a generic netlink family and the ids of all the multicast groups
+ * the HAL listens to with one CTRL_CMD_GETFAMILY. The request goes to
+ * GENL_ID_CTRL directly, the controller's id is fixed, so no extra round
+ * trip is spent looking up "nlctrl" itself.
+ */
+class GetFamilyCommand : public WifiCommand
 {
 private:
     const char *mName;
-    const char *mGroup;
-    int   mId;
+    int mFamilyId;
 public:
-    GetMulticastIdCommand(wifi_handle handle, const char *name,
-            const char *group) : WifiCommand(handle, 0)
+    GetFamilyCommand(hal_info *info, const char *name)
+        : WifiCommand(getWifiHandle(info), 0)
     {
         mName = name;
-        mGroup = group;
-        mId = -1;
+        mFamilyId = -1;
+        for (int g = 0; g < HAL_MCGRP_MAX; g++)
+            mInfo->mcast_id[g] = -1;
     }
 
-    int getId() {
-        return mId;
+    int getFamilyId() {
+        return mFamilyId;
     }
 
     virtual int create() {
-        int nlctrlFamily = genl_ctrl_resolve(mInfo->cmd_sock, "nlctrl");
-        // ALOGI("ctrl family = %d", nlctrlFamily);
-        int ret = mMsg.create(nlctrlFamily, CTRL_CMD_GETFAMILY, 0, 0);
+        int ret = mMsg.create(GENL_ID_CTRL, CTRL_CMD_GETFAMILY, 0, 0);
         if (ret < 0) {
             return ret;
         }
@@ -514,25 +721,22 @@ public:
     }
 
     virtual int handleResponse(WifiEvent& reply) {
-
-        // ALOGI("handling reponse in %s", __func__);
-
         struct nlattr **tb = reply.attributes();
-        struct genlmsghdr *gnlh = reply.header();
         struct nlattr *mcgrp = NULL;
         int i;
 
+        if (!tb[CTRL_ATTR_FAMILY_ID]) {
+            ALOGE("%s: no id for family %s", __func__, mName);
+            return NL_SKIP;
+        }
+        mFamilyId = nla_get_u16(tb[CTRL_ATTR_FAMILY_ID]);
+
         if (!tb[CTRL_ATTR_MCAST_GROUPS]) {
             ALOGI("No multicast groups found");
             return NL_SKIP;
-        } else {
-            // ALOGI("Multicast groups attr size = %d",
-            // nla_len(tb[CTRL_ATTR_MCAST_GROUPS]));
         }
 
         for_each_attr(mcgrp, tb[CTRL_ATTR_MCAST_GROUPS], i) {
-
-            // ALOGI("Processing group");
             struct nlattr *tb2[CTRL_ATTR_MCAST_GRP_MAX + 1];
             nla_parse(tb2, CTRL_ATTR_MCAST_GRP_MAX, (nlattr *)nla_data(mcgrp),
                 nla_len(mcgrp), NULL);
@@ -543,14 +747,15 @@ public:
 
             char *grpName = (char *)nla_data(tb2[CTRL_ATTR_MCAST_GRP_NAME]);
             int grpNameLen = nla_len(tb2[CTRL_ATTR_MCAST_GRP_NAME]);
+            int grpId = nla_get_u32(tb2[CTRL_ATTR_MCAST_GRP_ID]);
 
-            // ALOGI("Found group name %s", grpName);
-
-            if (strncmp(grpName, mGroup, grpNameLen) != 0)
-                continue;
-
-            mId = nla_get_u32(tb2[CTRL_ATTR_MCAST_GRP_ID]);
-            break;
+            for (int g = 0; g < HAL_MCGRP_MAX; g++) {
+                if (strncmp(grpName, event_filter_group_name(g),
+                            grpNameLen) == 0) {
+                    mInfo->mcast_id[g] = grpId;
+                    break;
+                }
+            }
         }
 
         return NL_SKIP;
@@ -558,99 +763,30 @@ public:
 
 };
 
-static int wifi_get_multicast_id(wifi_handle handle, const char *name,
-        const char *group)
+/* Returns the family id and fills info->mcast_id, -1 where a group is absent */
+static int wifi_resolve_family(hal_info *info, const char *name)
 {
-    GetMulticastIdCommand cmd(handle, name, group);
+    GetFamilyCommand cmd(info, name);
     int res = cmd.requestResponse();
     if (res < 0)
         return res;
-    else
-        return cmd.getId();
-}
-
-/////////////////////////////////////////////////////////////////////////
 
-static bool is_wifi_interface(const char *name)
-{
-    if (strncmp(name, "wlan", 4) != 0 && strncmp(name, "p2p", 3) != 0) {
-        /* not a wifi interface; ignore it */
-        return false;
-    } else {
-        return true;
+    for (int g = 0; g < HAL_MCGRP_MAX; g++) {
+        if (info->mcast_id[g] < 0)
+            ALOGE("Could not find group %s", event_filter_group_name(g));
     }
+    return cmd.getFamilyId();
 }
 
-static int get_interface(const char *name, interface_info *info)
-{
-    strlcpy(info->name, name, (IFNAMSIZ + 1));
-    info->id = if_nametoindex(name);
-    // ALOGI("found an interface : %s, id = %d", name, info->id);
-    return WIFI_SUCCESS;
-}
+/////////////////////////////////////////////////////////////////////////
 
-wifi_error wifi_init_interfaces(wifi_handle handle)
+wifi_error wifi_get_event_sock_stats(wifi_handle handle,
+        wifi_event_sock_stats *stats)
 {
     hal_info *info = (hal_info *)handle;
 
-    struct dirent *de;
-
-    DIR *d = opendir("/sys/class/net");
-    if (d == 0)
-        return WIFI_ERROR_UNKNOWN;
-
-    int n = 0;
-    while ((de = readdir(d))) {
-        if (de->d_name[0] == '.')
-            continue;
-        if (is_wifi_interface(de->d_name) ) {
-            n++;
-        }
-    }
-
-    closedir(d);
-
-    d = opendir("/sys/class/net");
-    if (d == 0)
-        return WIFI_ERROR_UNKNOWN;
-
-    info->interfaces = (interface_info **)malloc(sizeof(interface_info *) * n);
-    if (info->interfaces == NULL) {
-        ALOGE("%s: Error info->interfaces NULL", __func__);
-        return WIFI_ERROR_OUT_OF_MEMORY;
-    }
-
-    int i = 0;
-    while ((de = readdir(d))) {
-        if (de->d_name[0] == '.')
-            continue;
-        if (is_wifi_interface(de->d_name)) {
-            interface_info *ifinfo
-                = (interface_info *)malloc(sizeof(interface_info));
-            if (ifinfo == NULL) {
-                ALOGE("%s: Error ifinfo NULL", __func__);
-                while (i > 0) {
-                    free(info->interfaces[i-1]);
-                    i--;
-                }
-                free(info->interfaces);
-                return WIFI_ERROR_OUT_OF_MEMORY;
-            }
-            if (get_interface(de->d_name, ifinfo) != WIFI_SUCCESS) {
-                free(ifinfo);
-                continue;
-            }
-            ifinfo->handle = handle;
-            info->interfaces[i] = ifinfo;
-            i++;
-        }
-    }
-
-    closedir(d);
-
-    info->num_interfaces = n;
-    ALOGI("Found %d interfaces", info->num_interfaces);
-
+    stats->overruns = __atomic_load_n(&info->event_overruns, __ATOMIC_RELAXED);
+    stats->rcvbuf = info->event_sock_rcvbuf;
     return WIFI_SUCCESS;
 }
 
@@ -682,12 +818,21 @@ wifi_error wifi_get_supported_feature_set(wifi_interface_handle iface,
     *set = 0;
     hal_info *info = getHalInfo(handle);
 
+    if (cap_snapshot_get(info, CAP_FEATURES, 0, 0, set, sizeof(*set))
+            == sizeof(*set)) {
+        ALOGI("Supported feature set from the snapshot : %x", *set);
+        return WIFI_SUCCESS;
+    }
+
     ret = acquire_supported_features(iface, set);
     if (ret != WIFI_SUCCESS) {
-        *set = info->supported_feature_set;
-        ALOGI("Supported feature set acquired at initialization : %x", *set);
+        *set = hal_feature_set(info);
+        ALOGI("Supported feature set acquired earlier : %x", *set);
     } else {
+        pthread_mutex_lock(&info->feature_lock);
         info->supported_feature_set = *set;
+        __atomic_store_n(&info->features_known, true, __ATOMIC_RELEASE);
+        pthread_mutex_unlock(&info->feature_lock);
         ALOGI("Supported feature set acquired : %x", *set);
     }
     return WIFI_SUCCESS;
@@ -702,6 +847,7 @@ wifi_error wifi_get_concurrency_matrix(wifi_interface_handle handle,
     WifihalGeneric *vCommand = NULL;
     interface_info *ifaceInfo = getIfaceInfo(handle);
     wifi_handle wifiHandle = getWifiHandle(handle);
+    hal_info *info = getHalInfo(wifiHandle);
 
     if (set == NULL) {
         ALOGE("%s: NULL set pointer provided. Exit.",
@@ -709,6 +855,14 @@ wifi_error wifi_get_concurrency_matrix(wifi_interface_handle handle,
         return WIFI_ERROR_INVALID_ARGS;
     }
 
+    ret = cap_snapshot_get(info, CAP_CONCURRENCY, set_size_max, 0, set,
+            set_size_max * sizeof(feature_set));
+    if (ret >= 0) {
+        *set_size = ret / sizeof(feature_set);
+        return WIFI_SUCCESS;
+    }
+    ret = 0;
+
     vCommand = new WifihalGeneric(wifiHandle, 0,
             OUI_QCA,
             QCA_NL80211_VENDOR_SUBCMD_GET_CONCURRENCY_MATRIX);
@@ -747,6 +901,9 @@ wifi_error wifi_get_concurrency_matrix(wifi_interface_handle handle,
     ret = vCommand->requestResponse();
     if (ret) {
         ALOGE("%s: requestResponse() error: %d", __func__, ret);
+    } else {
+        cap_snapshot_put(info, CAP_CONCURRENCY, set_size_max, 0, set,
+                *set_size * sizeof(feature_set));
     }
 
 cleanup:
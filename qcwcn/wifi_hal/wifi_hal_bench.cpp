@@ -0,0 +1,877 @@
+/*
+ * Copyright (C) 2014 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/*
+ * Host microbenchmarks for the netlink paths of the HAL:
+ *
+ *     wifi_hal_bench [-t msec] [name...] 2>/dev/null
+ *
+ * The HAL runs on the fake driver; every benchmark works on a corpus of
+ * messages laid out the way the driver sends them, sized like a busy
+ * scan (32 cached results, 38 channels, a peer with 24 rates). Each one
+ * runs for at least -t milliseconds (default 200) and reports ns/op and
+ * malloc calls and bytes per op. Only the named benchmarks run if any
+ * are given. Logging is left at the level the HAL was built with, so
+ * log calls on these paths count too; send stderr somewhere cheap.
+ */
+
+#include <getopt.h>
+#include <pthread.h>
+#include <sched.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "wifi_hal.h"
+#include "common.h"
+#include "cpp_bindings.h"
+#include "fake_driver.h"
+#include "gscancommand.h"
+#include "gscan_event_handler.h"
+#include "llstatscommand.h"
+#include "nan_i.h"
+#include "vendor_definitions.h"
+
+/* Allocation counting: the bench interposes malloc for the whole process,
+ * libnl included, and forwards to the C library */
+static uint64_t alloc_calls;
+static uint64_t alloc_bytes;
+
+#ifdef __GLIBC__
+extern "C" void *__libc_malloc(size_t size);
+extern "C" void *__libc_calloc(size_t n, size_t size);
+extern "C" void *__libc_realloc(void *ptr, size_t size);
+
+static inline void count_alloc(size_t size)
+{
+    __atomic_fetch_add(&alloc_calls, 1, __ATOMIC_RELAXED);
+    __atomic_fetch_add(&alloc_bytes, size, __ATOMIC_RELAXED);
+}
+
+extern "C" void *malloc(size_t size)
+{
+    count_alloc(size);
+    return __libc_malloc(size);
+}
+
+extern "C" void *calloc(size_t n, size_t size)
+{
+    count_alloc(n * size);
+    return __libc_calloc(n, size);
+}
+
+extern "C" void *realloc(void *ptr, size_t size)
+{
+    count_alloc(size);
+    return __libc_realloc(ptr, size);
+}
+#define BENCH_COUNTS_ALLOCS     (1)
+#else
+#define BENCH_COUNTS_ALLOCS     (0)
+#endif
+
+/* The fake driver stands in for the kernel, so nothing is ever loaded */
+int is_wifi_driver_loaded()
+{
+    return 1;
+}
+
+int wifi_load_driver()
+{
+    return 0;
+}
+
+int wifi_unload_driver()
+{
+    return 0;
+}
+
+/* Benchmark state: time and allocations are only counted while running */
+
+typedef struct {
+    uint64_t ns;
+    uint64_t calls;
+    uint64_t bytes;
+    uint64_t t0, calls0, bytes0;
+} bench_state;
+
+static uint64_t now_ns()
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+static void bench_resume(bench_state *b)
+{
+    b->calls0 = __atomic_load_n(&alloc_calls, __ATOMIC_RELAXED);
+    b->bytes0 = __atomic_load_n(&alloc_bytes, __ATOMIC_RELAXED);
+    b->t0 = now_ns();
+}
+
+static void bench_pause(bench_state *b)
+{
+    b->ns += now_ns() - b->t0;
+    b->calls += __atomic_load_n(&alloc_calls, __ATOMIC_RELAXED) - b->calls0;
+    b->bytes += __atomic_load_n(&alloc_bytes, __ATOMIC_RELAXED) - b->bytes0;
+}
+
+typedef struct {
+    const char *name;
+    void (*run)(bench_state *b, unsigned iters);
+} bench;
+
+static wifi_handle bench_handle;
+static hal_info *bench_info;
+
+/* Corpus: driver messages built once, parsed many times */
+
+#define CORPUS_CACHED_RESULTS   (32)
+#define CORPUS_HOTLIST_APS      (8)
+#define CORPUS_CHANNELS         (38)
+#define CORPUS_WMM_ACS          (4)
+#define CORPUS_PEER_RATES       (24)
+
+enum {
+    CORPUS_CACHED,
+    CORPUS_HOTLIST,
+    CORPUS_RADIO,
+    CORPUS_IFACE,
+    CORPUS_PEERS,
+    CORPUS_PEERS_NONE,
+    CORPUS_MAX,
+};
+
+static struct nl_msg *corpus[CORPUS_MAX];
+
+static void put_scan_results(struct nl_msg *msg, unsigned num)
+{
+    struct nlattr *list = nla_nest_start(msg,
+            QCA_WLAN_VENDOR_ATTR_GSCAN_RESULTS_LIST);
+
+    for (unsigned i = 0; i < num; i++) {
+        struct nlattr *ap = nla_nest_start(msg, i);
+        char ssid[33];
+        mac_addr bssid = { 0x00, 0x03, 0x7f, 0x12, 0x34, (u8)i };
+        s32 rssi = -40 - (s32)i;
+
+        memset(ssid, 0, sizeof(ssid));
+        snprintf(ssid, sizeof(ssid), "corpus-ap-%02u", i);
+        nla_put_u64(msg, QCA_WLAN_VENDOR_ATTR_GSCAN_RESULTS_SCAN_RESULT_TIME_STAMP,
+                1000000ULL * i);
+        nla_put(msg, QCA_WLAN_VENDOR_ATTR_GSCAN_RESULTS_SCAN_RESULT_SSID,
+                sizeof(ssid), ssid);
+        nla_put(msg, QCA_WLAN_VENDOR_ATTR_GSCAN_RESULTS_SCAN_RESULT_BSSID,
+                sizeof(bssid), bssid);
+        nla_put_u32(msg, QCA_WLAN_VENDOR_ATTR_GSCAN_RESULTS_SCAN_RESULT_CHANNEL,
+                i % 2 ? 5180 + 20 * (i % 8) : 2412 + 5 * (i % 13));
+        nla_put(msg, QCA_WLAN_VENDOR_ATTR_GSCAN_RESULTS_SCAN_RESULT_RSSI,
+                sizeof(rssi), &rssi);
+        nla_put_u32(msg, QCA_WLAN_VENDOR_ATTR_GSCAN_RESULTS_SCAN_RESULT_RTT, 0);
+        nla_put_u32(msg, QCA_WLAN_VENDOR_ATTR_GSCAN_RESULTS_SCAN_RESULT_RTT_SD, 0);
+        nla_nest_end(msg, ap);
+    }
+    nla_nest_end(msg, list);
+}
+
+static struct nl_msg *corpus_scan_results(int subcmd, unsigned num)
+{
+    struct nlattr *data;
+    struct nl_msg *msg = fake_driver_msg(subcmd, 0, &data);
+
+    nla_put_u32(msg, QCA_WLAN_VENDOR_ATTR_GSCAN_RESULTS_REQUEST_ID, 1);
+    nla_put_u32(msg, QCA_WLAN_VENDOR_ATTR_GSCAN_RESULTS_NUM_RESULTS_AVAILABLE,
+            num);
+    nla_put_u8(msg, QCA_WLAN_VENDOR_ATTR_GSCAN_RESULTS_SCAN_RESULT_MORE_DATA, 0);
+    put_scan_results(msg, num);
+    nla_nest_end(msg, data);
+    return msg;
+}
+
+static struct nl_msg *corpus_radio()
+{
+    struct nlattr *data;
+    struct nl_msg *msg = fake_driver_msg(
+            QCA_NL80211_VENDOR_SUBCMD_LL_STATS_RADIO_RESULTS, 0, &data);
+
+    nla_put_u32(msg, QCA_WLAN_VENDOR_ATTR_LL_STATS_RADIO_ID, 0);
+    nla_put_u32(msg, QCA_WLAN_VENDOR_ATTR_LL_STATS_RADIO_ON_TIME, 60000);
+    nla_put_u32(msg, QCA_WLAN_VENDOR_ATTR_LL_STATS_RADIO_TX_TIME, 2000);
+    nla_put_u32(msg, QCA_WLAN_VENDOR_ATTR_LL_STATS_RADIO_RX_TIME, 9000);
+    nla_put_u32(msg, QCA_WLAN_VENDOR_ATTR_LL_STATS_RADIO_ON_TIME_SCAN, 3000);
+    nla_put_u32(msg, QCA_WLAN_VENDOR_ATTR_LL_STATS_RADIO_ON_TIME_NBD, 0);
+    nla_put_u32(msg, QCA_WLAN_VENDOR_ATTR_LL_STATS_RADIO_ON_TIME_GSCAN, 1500);
+    nla_put_u32(msg, QCA_WLAN_VENDOR_ATTR_LL_STATS_RADIO_ON_TIME_ROAM_SCAN, 200);
+    nla_put_u32(msg, QCA_WLAN_VENDOR_ATTR_LL_STATS_RADIO_ON_TIME_PNO_SCAN, 0);
+    nla_put_u32(msg, QCA_WLAN_VENDOR_ATTR_LL_STATS_RADIO_ON_TIME_HS20, 0);
+    nla_put_u32(msg, QCA_WLAN_VENDOR_ATTR_LL_STATS_RADIO_NUM_CHANNELS,
+            CORPUS_CHANNELS);
+
+    struct nlattr *list = nla_nest_start(msg,
+            QCA_WLAN_VENDOR_ATTR_LL_STATS_CH_INFO);
+    for (unsigned i = 0; i < CORPUS_CHANNELS; i++) {
+        struct nlattr *ch = nla_nest_start(msg, i);
+        u32 freq = i < 13 ? 2412 + 5 * i : 5180 + 20 * (i - 13);
+
+        nla_put_u32(msg, QCA_WLAN_VENDOR_ATTR_LL_STATS_CHANNEL_INFO_WIDTH,
+                i < 13 ? WIFI_CHAN_WIDTH_20 : WIFI_CHAN_WIDTH_80);
+        nla_put_u32(msg, QCA_WLAN_VENDOR_ATTR_LL_STATS_CHANNEL_INFO_CENTER_FREQ,
+                freq);
+        nla_put_u32(msg, QCA_WLAN_VENDOR_ATTR_LL_STATS_CHANNEL_INFO_CENTER_FREQ0,
+                freq);
+        nla_put_u32(msg, QCA_WLAN_VENDOR_ATTR_LL_STATS_CHANNEL_INFO_CENTER_FREQ1,
+                0);
+        nla_put_u32(msg, QCA_WLAN_VENDOR_ATTR_LL_STATS_CHANNEL_ON_TIME, 100 + i);
+        nla_put_u32(msg, QCA_WLAN_VENDOR_ATTR_LL_STATS_CHANNEL_CCA_BUSY_TIME,
+                10 + i);
+        nla_nest_end(msg, ch);
+    }
+    nla_nest_end(msg, list);
+    nla_nest_end(msg, data);
+    return msg;
+}
+
+static struct nl_msg *corpus_iface()
+{
+    struct nlattr *data;
+    struct nl_msg *msg = fake_driver_msg(
+            QCA_NL80211_VENDOR_SUBCMD_LL_STATS_IFACE_RESULTS, 0, &data);
+    mac_addr mac = { 0x02, 0x00, 0x00, 0x00, 0x00, 0x01 };
+    mac_addr bssid = { 0x00, 0x03, 0x7f, 0x12, 0x34, 0x00 };
+    char ssid[33] = "corpus-ap-00";
+    s32 rssi = -45;
+
+    nla_put_u32(msg, QCA_WLAN_VENDOR_ATTR_LL_STATS_IFACE_INFO_MODE, WIFI_INTERFACE_STA);
+    nla_put(msg, QCA_WLAN_VENDOR_ATTR_LL_STATS_IFACE_INFO_MAC_ADDR,
+            sizeof(mac), mac);
+    nla_put_u32(msg, QCA_WLAN_VENDOR_ATTR_LL_STATS_IFACE_INFO_STATE, WIFI_ASSOCIATED);
+    nla_put_u32(msg, QCA_WLAN_VENDOR_ATTR_LL_STATS_IFACE_INFO_ROAMING, WIFI_ROAMING_IDLE);
+    nla_put_u32(msg, QCA_WLAN_VENDOR_ATTR_LL_STATS_IFACE_INFO_CAPABILITIES, 0);
+    nla_put(msg, QCA_WLAN_VENDOR_ATTR_LL_STATS_IFACE_INFO_SSID,
+            sizeof(ssid), ssid);
+    nla_put(msg, QCA_WLAN_VENDOR_ATTR_LL_STATS_IFACE_INFO_BSSID,
+            sizeof(bssid), bssid);
+    nla_put(msg, QCA_WLAN_VENDOR_ATTR_LL_STATS_IFACE_INFO_AP_COUNTRY_STR, 3, "US");
+    nla_put(msg, QCA_WLAN_VENDOR_ATTR_LL_STATS_IFACE_INFO_COUNTRY_STR, 3, "US");
+    nla_put_u32(msg, QCA_WLAN_VENDOR_ATTR_LL_STATS_IFACE_BEACON_RX, 600);
+    nla_put_u32(msg, QCA_WLAN_VENDOR_ATTR_LL_STATS_IFACE_MGMT_RX, 620);
+    nla_put_u32(msg, QCA_WLAN_VENDOR_ATTR_LL_STATS_IFACE_MGMT_ACTION_RX, 4);
+    nla_put_u32(msg, QCA_WLAN_VENDOR_ATTR_LL_STATS_IFACE_MGMT_ACTION_TX, 4);
+    nla_put(msg, QCA_WLAN_VENDOR_ATTR_LL_STATS_IFACE_RSSI_MGMT, sizeof(rssi), &rssi);
+    nla_put(msg, QCA_WLAN_VENDOR_ATTR_LL_STATS_IFACE_RSSI_DATA, sizeof(rssi), &rssi);
+    nla_put(msg, QCA_WLAN_VENDOR_ATTR_LL_STATS_IFACE_RSSI_ACK, sizeof(rssi), &rssi);
+
+    struct nlattr *list = nla_nest_start(msg,
+            QCA_WLAN_VENDOR_ATTR_LL_STATS_WMM_INFO);
+    for (unsigned i = 0; i < CORPUS_WMM_ACS; i++) {
+        struct nlattr *ac = nla_nest_start(msg, i);
+
+        nla_put_u32(msg, QCA_WLAN_VENDOR_ATTR_LL_STATS_WMM_AC_AC, i);
+        nla_put_u32(msg, QCA_WLAN_VENDOR_ATTR_LL_STATS_WMM_AC_TX_MPDU, 5000);
+        nla_put_u32(msg, QCA_WLAN_VENDOR_ATTR_LL_STATS_WMM_AC_RX_MPDU, 9000);
+        nla_put_u32(msg, QCA_WLAN_VENDOR_ATTR_LL_STATS_WMM_AC_TX_MCAST, 10);
+        nla_put_u32(msg, QCA_WLAN_VENDOR_ATTR_LL_STATS_WMM_AC_RX_MCAST, 120);
+        nla_put_u32(msg, QCA_WLAN_VENDOR_ATTR_LL_STATS_WMM_AC_RX_AMPDU, 800);
+        nla_put_u32(msg, QCA_WLAN_VENDOR_ATTR_LL_STATS_WMM_AC_TX_AMPDU, 400);
+        nla_put_u32(msg, QCA_WLAN_VENDOR_ATTR_LL_STATS_WMM_AC_MPDU_LOST, 3);
+        nla_put_u32(msg, QCA_WLAN_VENDOR_ATTR_LL_STATS_WMM_AC_RETRIES, 40);
+        nla_put_u32(msg, QCA_WLAN_VENDOR_ATTR_LL_STATS_WMM_AC_RETRIES_SHORT, 30);
+        nla_put_u32(msg, QCA_WLAN_VENDOR_ATTR_LL_STATS_WMM_AC_RETRIES_LONG, 10);
+        nla_put_u32(msg, QCA_WLAN_VENDOR_ATTR_LL_STATS_WMM_AC_CONTENTION_TIME_MIN, 20);
+        nla_put_u32(msg, QCA_WLAN_VENDOR_ATTR_LL_STATS_WMM_AC_CONTENTION_TIME_MAX, 900);
+        nla_put_u32(msg, QCA_WLAN_VENDOR_ATTR_LL_STATS_WMM_AC_CONTENTION_TIME_AVG, 80);
+        nla_put_u32(msg, QCA_WLAN_VENDOR_ATTR_LL_STATS_WMM_AC_CONTENTION_NUM_SAMPLES,
+                100);
+        nla_nest_end(msg, ac);
+    }
+    nla_nest_end(msg, list);
+    /* the peer stats follow in their own event */
+    nla_put_u32(msg, QCA_WLAN_VENDOR_ATTR_LL_STATS_IFACE_NUM_PEERS, 1);
+    nla_nest_end(msg, data);
+    return msg;
+}
+
+static struct nl_msg *corpus_peers(unsigned num_peers)
+{
+    struct nlattr *data;
+    struct nl_msg *msg = fake_driver_msg(
+            QCA_NL80211_VENDOR_SUBCMD_LL_STATS_PEERS_RESULTS, 0, &data);
+
+    nla_put_u32(msg, QCA_WLAN_VENDOR_ATTR_LL_STATS_IFACE_NUM_PEERS, num_peers);
+    struct nlattr *peers = nla_nest_start(msg,
+            QCA_WLAN_VENDOR_ATTR_LL_STATS_PEER_INFO);
+    for (unsigned p = 0; p < num_peers; p++) {
+        struct nlattr *peer = nla_nest_start(msg, p);
+        mac_addr mac = { 0x00, 0x03, 0x7f, 0x12, 0x34, (u8)p };
+
+        nla_put_u32(msg, QCA_WLAN_VENDOR_ATTR_LL_STATS_PEER_INFO_TYPE, WIFI_PEER_AP);
+        nla_put(msg, QCA_WLAN_VENDOR_ATTR_LL_STATS_PEER_INFO_MAC_ADDRESS,
+                sizeof(mac), mac);
+        nla_put_u32(msg, QCA_WLAN_VENDOR_ATTR_LL_STATS_PEER_INFO_CAPABILITIES, 0);
+        nla_put_u32(msg, QCA_WLAN_VENDOR_ATTR_LL_STATS_PEER_INFO_NUM_RATES,
+                CORPUS_PEER_RATES);
+
+        struct nlattr *rates = nla_nest_start(msg,
+                QCA_WLAN_VENDOR_ATTR_LL_STATS_PEER_INFO_RATE_INFO);
+        for (unsigned i = 0; i < CORPUS_PEER_RATES; i++) {
+            struct nlattr *rate = nla_nest_start(msg, i);
+
+            nla_put_u8(msg, QCA_WLAN_VENDOR_ATTR_LL_STATS_RATE_PREAMBLE, i < 8 ? 0 : 2);
+            nla_put_u8(msg, QCA_WLAN_VENDOR_ATTR_LL_STATS_RATE_NSS, i < 16 ? 0 : 1);
+            nla_put_u8(msg, QCA_WLAN_VENDOR_ATTR_LL_STATS_RATE_BW, 2);
+            nla_put_u8(msg, QCA_WLAN_VENDOR_ATTR_LL_STATS_RATE_MCS_INDEX, i % 8);
+            nla_put_u32(msg, QCA_WLAN_VENDOR_ATTR_LL_STATS_RATE_BIT_RATE,
+                    6500 * (i + 1));
+            nla_put_u32(msg, QCA_WLAN_VENDOR_ATTR_LL_STATS_RATE_TX_MPDU, 200);
+            nla_put_u32(msg, QCA_WLAN_VENDOR_ATTR_LL_STATS_RATE_RX_MPDU, 350);
+            nla_put_u32(msg, QCA_WLAN_VENDOR_ATTR_LL_STATS_RATE_MPDU_LOST, 1);
+            nla_put_u32(msg, QCA_WLAN_VENDOR_ATTR_LL_STATS_RATE_RETRIES, 6);
+            nla_put_u32(msg, QCA_WLAN_VENDOR_ATTR_LL_STATS_RATE_RETRIES_SHORT, 4);
+            nla_put_u32(msg, QCA_WLAN_VENDOR_ATTR_LL_STATS_RATE_RETRIES_LONG, 2);
+            nla_nest_end(msg, rate);
+        }
+        nla_nest_end(msg, rates);
+        nla_nest_end(msg, peer);
+    }
+    nla_nest_end(msg, peers);
+    nla_nest_end(msg, data);
+    return msg;
+}
+
+static void corpus_init()
+{
+    corpus[CORPUS_CACHED] = corpus_scan_results(
+            QCA_NL80211_VENDOR_SUBCMD_GSCAN_GET_CACHED_RESULTS,
+            CORPUS_CACHED_RESULTS);
+    corpus[CORPUS_HOTLIST] = corpus_scan_results(
+            QCA_NL80211_VENDOR_SUBCMD_GSCAN_HOTLIST_AP_FOUND,
+            CORPUS_HOTLIST_APS);
+    corpus[CORPUS_RADIO] = corpus_radio();
+    corpus[CORPUS_IFACE] = corpus_iface();
+    corpus[CORPUS_PEERS] = corpus_peers(1);
+    corpus[CORPUS_PEERS_NONE] = corpus_peers(0);
+}
+
+static void corpus_cleanup()
+{
+    for (int i = 0; i < CORPUS_MAX; i++)
+        nlmsg_free(corpus[i]);
+}
+
+/* Vendor data of a corpus message, indexed the way the handlers index it */
+static void corpus_vendor_data(struct nl_msg *msg, struct nlattr **tb, int maxtype)
+{
+    WifiEvent event(msg);
+    nla_parse(tb, maxtype, (struct nlattr *)event.get_vendor_data(),
+            event.get_vendor_data_len(), NULL);
+}
+
+/* The benchmarks */
+
+static void bench_request_encode(bench_state *b, unsigned iters)
+{
+    int ifindex = bench_info->interfaces[0]->id;
+
+    bench_resume(b);
+    for (unsigned n = 0; n < iters; n++) {
+        WifiRequest request(bench_info, bench_info->nl80211_family_id, ifindex);
+
+        request.create(OUI_QCA, QCA_NL80211_VENDOR_SUBCMD_GSCAN_SET_BSSID_HOTLIST);
+        struct nlattr *data = request.attr_start(NL80211_ATTR_VENDOR_DATA);
+        request.put_u32(QCA_WLAN_VENDOR_ATTR_GSCAN_SUBCMD_CONFIG_PARAM_REQUEST_ID, 1);
+        request.put_u32(
+                QCA_WLAN_VENDOR_ATTR_GSCAN_BSSID_HOTLIST_PARAMS_LOST_AP_SAMPLE_SIZE, 3);
+        request.put_u32(QCA_WLAN_VENDOR_ATTR_GSCAN_BSSID_HOTLIST_PARAMS_NUM_AP,
+                CORPUS_HOTLIST_APS);
+        struct nlattr *list = request.attr_start(
+                QCA_WLAN_VENDOR_ATTR_GSCAN_AP_THRESHOLD_PARAM);
+        for (int i = 0; i < CORPUS_HOTLIST_APS; i++) {
+            mac_addr bssid = { 0x00, 0x03, 0x7f, 0x12, 0x34, (u8)i };
+            struct nlattr *ap = request.attr_start(i);
+
+            request.put_addr(QCA_WLAN_VENDOR_ATTR_GSCAN_AP_THRESHOLD_PARAM_BSSID,
+                    bssid);
+            request.put_s32(QCA_WLAN_VENDOR_ATTR_GSCAN_AP_THRESHOLD_PARAM_RSSI_LOW,
+                    -80);
+            request.put_s32(QCA_WLAN_VENDOR_ATTR_GSCAN_AP_THRESHOLD_PARAM_RSSI_HIGH,
+                    -40);
+            request.put_u32(QCA_WLAN_VENDOR_ATTR_GSCAN_AP_THRESHOLD_PARAM_CHANNEL,
+                    2437);
+            request.attr_end(ap);
+        }
+        request.attr_end(list);
+        request.attr_end(data);
+    }
+    bench_pause(b);
+}
+
+/* Same request as request_encode, through WifiAttrBuilder */
+static void bench_request_build(bench_state *b, unsigned iters)
+{
+    int ifindex = bench_info->interfaces[0]->id;
+
+    bench_resume(b);
+    for (unsigned n = 0; n < iters; n++) {
+        WifiRequest request(bench_info, bench_info->nl80211_family_id, ifindex);
+
+        request.create(OUI_QCA, QCA_NL80211_VENDOR_SUBCMD_GSCAN_SET_BSSID_HOTLIST);
+        WifiAttrBuilder msg(request.getMessage());
+        struct nlattr *data = msg.attr_start(NL80211_ATTR_VENDOR_DATA);
+        msg.put_u32(QCA_WLAN_VENDOR_ATTR_GSCAN_SUBCMD_CONFIG_PARAM_REQUEST_ID, 1)
+           .put_u32(QCA_WLAN_VENDOR_ATTR_GSCAN_BSSID_HOTLIST_PARAMS_LOST_AP_SAMPLE_SIZE,
+                3)
+           .put_u32(QCA_WLAN_VENDOR_ATTR_GSCAN_BSSID_HOTLIST_PARAMS_NUM_AP,
+                CORPUS_HOTLIST_APS);
+        struct nlattr *list = msg.attr_start(
+                QCA_WLAN_VENDOR_ATTR_GSCAN_AP_THRESHOLD_PARAM);
+        for (int i = 0; i < CORPUS_HOTLIST_APS; i++) {
+            mac_addr bssid = { 0x00, 0x03, 0x7f, 0x12, 0x34, (u8)i };
+            struct nlattr *ap = msg.attr_start(i);
+
+            msg.put_addr(QCA_WLAN_VENDOR_ATTR_GSCAN_AP_THRESHOLD_PARAM_BSSID, bssid)
+               .put_s32(QCA_WLAN_VENDOR_ATTR_GSCAN_AP_THRESHOLD_PARAM_RSSI_LOW, -80)
+               .put_s32(QCA_WLAN_VENDOR_ATTR_GSCAN_AP_THRESHOLD_PARAM_RSSI_HIGH, -40)
+               .put_u32(QCA_WLAN_VENDOR_ATTR_GSCAN_AP_THRESHOLD_PARAM_CHANNEL, 2437);
+            msg.attr_end(ap);
+        }
+        msg.attr_end(list);
+        msg.attr_end(data);
+        if (msg.failed())
+            abort();
+    }
+    bench_pause(b);
+}
+
+static void bench_event_parse(bench_state *b, unsigned iters)
+{
+    volatile uint32_t sink = 0;
+
+    bench_resume(b);
+    for (unsigned n = 0; n < iters; n++) {
+        WifiEvent event(corpus[n % CORPUS_MAX]);
+
+        if (event.parse() < 0)
+            continue;
+        sink += event.get_cmd() + event.get_vendor_id() +
+            event.get_vendor_subcmd() + event.get_vendor_data_len();
+    }
+    bench_pause(b);
+}
+
+static uint32_t dispatched;
+
+static int bench_dispatch_handler(struct nl_msg *msg, void *arg)
+{
+    __atomic_fetch_add(&dispatched, 1, __ATOMIC_RELEASE);
+    return NL_SKIP;
+}
+
+#define DISPATCH_BATCH          (256)
+
+/* A corpus event from the fake driver's queue through event_sock, the
+ * vendor handler lookup and the callback thread to the handler */
+static void bench_dispatch(bench_state *b, unsigned iters)
+{
+    struct nl_msg *msgs[DISPATCH_BATCH];
+    struct nlattr *data[DISPATCH_BATCH];
+    int subcmd = QCA_NL80211_VENDOR_SUBCMD_GSCAN_SCAN_RESULTS_AVAILABLE;
+
+    if (wifi_register_vendor_handler(bench_handle, OUI_QCA, subcmd,
+                bench_dispatch_handler, NULL) != WIFI_SUCCESS) {
+        ALOGE("%s: could not register the handler", __func__);
+        return;
+    }
+
+    for (unsigned done = 0; done < iters; ) {
+        unsigned batch = iters - done < DISPATCH_BATCH ? iters - done
+            : DISPATCH_BATCH;
+
+        for (unsigned i = 0; i < batch; i++) {
+            msgs[i] = fake_driver_msg(subcmd, 0, &data[i]);
+            nla_put_u32(msgs[i], QCA_WLAN_VENDOR_ATTR_GSCAN_RESULTS_REQUEST_ID, 1);
+            nla_put_u32(msgs[i],
+                    QCA_WLAN_VENDOR_ATTR_GSCAN_RESULTS_NUM_RESULTS_AVAILABLE, 32);
+        }
+
+        __atomic_store_n(&dispatched, 0, __ATOMIC_RELAXED);
+        bench_resume(b);
+        for (unsigned i = 0; i < batch; i++)
+            fake_driver_event(msgs[i], data[i]);
+        while (__atomic_load_n(&dispatched, __ATOMIC_ACQUIRE) < batch)
+            sched_yield();
+        bench_pause(b);
+        done += batch;
+    }
+
+    wifi_unregister_vendor_handler(bench_handle, OUI_QCA, subcmd, NULL);
+}
+
+#define LOOKUP_HANDLERS         (48)    /* about what a running HAL registers */
+#define LOOKUP_SUBCMD_BASE      (200)   /* clear of the subcmds in use */
+
+static int bench_lookup_handler(struct nl_msg *msg, void *arg)
+{
+    (*(unsigned *)arg)++;
+    return NL_SKIP;
+}
+
+/* Handler lookup as it was: one flat table, scanned in full per event */
+static void bench_dispatch_linear(bench_state *b, unsigned iters)
+{
+    cb_info table[LOOKUP_HANDLERS];
+    unsigned hits = 0;
+
+    memset(table, 0, sizeof(table));
+    for (int i = 0; i < LOOKUP_HANDLERS; i++) {
+        table[i].nl_cmd = NL80211_CMD_VENDOR;
+        table[i].vendor_id = OUI_QCA;
+        table[i].vendor_subcmd = LOOKUP_SUBCMD_BASE + i;
+        table[i].cb_func = bench_lookup_handler;
+        table[i].cb_arg = &hits;
+    }
+
+    bench_resume(b);
+    for (unsigned n = 0; n < iters; n++) {
+        int subcmd = LOOKUP_SUBCMD_BASE + n % LOOKUP_HANDLERS;
+
+        for (int i = 0; i < LOOKUP_HANDLERS; i++) {
+            if (NL80211_CMD_VENDOR != table[i].nl_cmd)
+                continue;
+            if (OUI_QCA != table[i].vendor_id
+                    || subcmd != table[i].vendor_subcmd)
+                continue;
+            (*(table[i].cb_func))(NULL, table[i].cb_arg);
+        }
+    }
+    bench_pause(b);
+
+    if (hits != iters)
+        abort();
+}
+
+/* The same lookups through the hashed snapshot of wifi_dispatch_event() */
+static void bench_dispatch_hashed(bench_state *b, unsigned iters)
+{
+    unsigned hits = 0;
+
+    for (int i = 0; i < LOOKUP_HANDLERS; i++) {
+        if (wifi_register_vendor_handler(bench_handle, OUI_QCA,
+                    LOOKUP_SUBCMD_BASE + i, bench_lookup_handler,
+                    &hits) != WIFI_SUCCESS) {
+            ALOGE("%s: could not register the handlers", __func__);
+            abort();
+        }
+    }
+
+    bench_resume(b);
+    for (unsigned n = 0; n < iters; n++)
+        wifi_dispatch_event(bench_handle, NL80211_CMD_VENDOR, OUI_QCA,
+                LOOKUP_SUBCMD_BASE + n % LOOKUP_HANDLERS, NULL);
+    bench_pause(b);
+
+    for (int i = 0; i < LOOKUP_HANDLERS; i++)
+        wifi_unregister_vendor_handler(bench_handle, OUI_QCA,
+                LOOKUP_SUBCMD_BASE + i, &hits);
+
+    if (hits != iters)
+        abort();
+}
+
+static int bench_cb_handler(struct nl_msg *msg, void *arg)
+{
+    return NL_OK;
+}
+
+static int bench_cb_error_handler(struct sockaddr_nl *nla,
+        struct nlmsgerr *err, void *arg)
+{
+    return NL_SKIP;
+}
+
+/* The callback set every cmd_sock read used to build and drop; reads now
+ * share the one nl_transport_init() builds */
+static void bench_cb_setup(bench_state *b, unsigned iters)
+{
+    bench_resume(b);
+    for (unsigned n = 0; n < iters; n++) {
+        struct nl_cb *cb = nl_cb_alloc(NL_CB_DEFAULT);
+        if (cb == NULL)
+            abort();
+
+        nl_cb_set(cb, NL_CB_SEQ_CHECK, NL_CB_CUSTOM, bench_cb_handler, NULL);
+        nl_cb_set(cb, NL_CB_VALID, NL_CB_CUSTOM, bench_cb_handler, bench_info);
+        nl_cb_set(cb, NL_CB_ACK, NL_CB_CUSTOM, bench_cb_handler, bench_info);
+        nl_cb_set(cb, NL_CB_FINISH, NL_CB_CUSTOM, bench_cb_handler, bench_info);
+        nl_cb_err(cb, NL_CB_CUSTOM, bench_cb_error_handler, bench_info);
+        nl_cb_put(cb);
+    }
+    bench_pause(b);
+}
+
+class BenchFeatureCommand : public WifiCommand
+{
+public:
+    BenchFeatureCommand(wifi_interface_handle iface)
+        : WifiCommand(iface, 0)
+    {
+    }
+
+    virtual int create() {
+        return mMsg.create(OUI_QCA, QCA_NL80211_VENDOR_SUBCMD_GET_SUPPORTED_FEATURES);
+    }
+};
+
+/* A whole request on the shared callback set, to weigh cb_setup against:
+ * sent on cmd_sock, answered by the fake driver and its reply read back */
+static void bench_request_response(bench_state *b, unsigned iters)
+{
+    wifi_interface_handle iface = getIfaceHandle(bench_info->interfaces[0]);
+
+    bench_resume(b);
+    for (unsigned n = 0; n < iters; n++) {
+        BenchFeatureCommand cmd(iface);
+
+        if (cmd.requestResponse() != 0)
+            abort();
+    }
+    bench_pause(b);
+}
+
+static void bench_gscan_cached_results(bench_state *b, unsigned iters)
+{
+    struct nlattr *tb[QCA_WLAN_VENDOR_ATTR_GSCAN_RESULTS_MAX + 1];
+    wifi_scan_result results[CORPUS_CACHED_RESULTS];
+    GScanCommand *cmd = new GScanCommand(bench_handle, 1, OUI_QCA,
+            QCA_NL80211_VENDOR_SUBCMD_GSCAN_GET_CACHED_RESULTS);
+
+    corpus_vendor_data(corpus[CORPUS_CACHED], tb,
+            QCA_WLAN_VENDOR_ATTR_GSCAN_RESULTS_MAX);
+    bench_resume(b);
+    for (unsigned n = 0; n < iters; n++)
+        cmd->gscan_get_cached_results(CORPUS_CACHED_RESULTS, results, 0, tb);
+    bench_pause(b);
+    delete cmd;
+}
+
+static void bench_gscan_hotlist_ap(bench_state *b, unsigned iters)
+{
+    struct nlattr *tb[QCA_WLAN_VENDOR_ATTR_GSCAN_RESULTS_MAX + 1];
+    wifi_scan_result results[CORPUS_HOTLIST_APS];
+    GScanCallbackHandler handler;
+
+    memset(&handler, 0, sizeof(handler));
+    /* no subcommand of its own, so that nothing gets registered */
+    GScanCommandEventHandler *cmd = new GScanCommandEventHandler(bench_handle,
+            1, OUI_QCA, 0, handler);
+
+    corpus_vendor_data(corpus[CORPUS_HOTLIST], tb,
+            QCA_WLAN_VENDOR_ATTR_GSCAN_RESULTS_MAX);
+    bench_resume(b);
+    for (unsigned n = 0; n < iters; n++)
+        cmd->gscan_parse_hotlist_ap_results(CORPUS_HOTLIST_APS, results, 0, tb);
+    bench_pause(b);
+    delete cmd;
+}
+
+static void on_link_stats_results(wifi_request_id id, wifi_iface_stat *iface_stat,
+        int num_radios, wifi_radio_stat *radio_stat)
+{
+}
+
+/* LLStatsCommand keeps the radio and iface results until the peer stats
+ * arrive; an event with no peers hands them over and frees them */
+static void llstats_flush(LLStatsCommand *cmd)
+{
+    WifiEvent event(corpus[CORPUS_PEERS_NONE]);
+    cmd->handleEvent(event);
+}
+
+static void bench_llstats(bench_state *b, unsigned iters, int which)
+{
+    LLStatsCommand *cmd = LLStatsCommand::instance(bench_handle);
+    LLStatsCallbackHandler handler;
+
+    if (cmd == NULL)
+        return;
+    handler.on_link_stats_results = on_link_stats_results;
+    cmd->setCallbackHandler(handler,
+            QCA_NL80211_VENDOR_SUBCMD_LL_STATS_RADIO_RESULTS);
+
+    for (unsigned n = 0; n < iters; n++) {
+        WifiEvent event(corpus[which]);
+
+        bench_resume(b);
+        cmd->handleEvent(event);
+        bench_pause(b);
+        if (which != CORPUS_PEERS)
+            llstats_flush(cmd);
+    }
+    cmd->unregisterHandler(QCA_NL80211_VENDOR_SUBCMD_LL_STATS_RADIO_RESULTS);
+}
+
+static void bench_llstats_radio(bench_state *b, unsigned iters)
+{
+    bench_llstats(b, iters, CORPUS_RADIO);
+}
+
+static void bench_llstats_iface(bench_state *b, unsigned iters)
+{
+    bench_llstats(b, iters, CORPUS_IFACE);
+}
+
+static void bench_llstats_peers(bench_state *b, unsigned iters)
+{
+    bench_llstats(b, iters, CORPUS_PEERS);
+}
+
+/* The TLVs of a NAN publish request, written and read back */
+static void bench_nan_tlv(bench_state *b, unsigned iters)
+{
+    static const char name[] = "corpus-service";
+    u8 ssi[64], filter[8], buf[256];
+    u32 support_5g = 1, period = 1;
+    volatile u32 sink = 0;
+    u8 *end;
+    NanTlv tlv;
+
+    memset(ssi, 0xa5, sizeof(ssi));
+    memset(filter, 0x5a, sizeof(filter));
+
+    bench_resume(b);
+    for (unsigned n = 0; n < iters; n++) {
+        end = addTlv(NAN_TLV_TYPE_SERVICE_NAME, sizeof(name) - 1,
+                (const u8 *)name, buf);
+        end = addTlv(NAN_TLV_TYPE_SERVICE_SPECIFIC_INFO, sizeof(ssi), ssi, end);
+        end = addTlv(NAN_TLV_TYPE_RX_MATCH_FILTER, sizeof(filter), filter, end);
+        end = addTlv(NAN_TLV_TYPE_TX_MATCH_FILTER, sizeof(filter), filter, end);
+        end = addTlv(NAN_TLV_TYPE_5G_SUPPORT, sizeof(support_5g),
+                (const u8 *)&support_5g, end);
+        end = addTlv(NAN_TLV_TYPE_RANDOM_UPDATE_TIME, sizeof(period),
+                (const u8 *)&period, end);
+
+        for (u8 *pos = buf; pos < end; pos += NANTLV_ReadTlv(pos, &tlv))
+            sink += tlv.length;
+    }
+    bench_pause(b);
+}
+
+static const bench benches[] = {
+    { "request_encode",         bench_request_encode },
+    { "request_build",          bench_request_build },
+    { "event_parse",            bench_event_parse },
+    { "dispatch",               bench_dispatch },
+    { "dispatch_linear",        bench_dispatch_linear },
+    { "dispatch_hashed",        bench_dispatch_hashed },
+    { "cb_setup",               bench_cb_setup },
+    { "request_response",       bench_request_response },
+    { "gscan_cached_results",   bench_gscan_cached_results },
+    { "gscan_hotlist_ap",       bench_gscan_hotlist_ap },
+    { "llstats_radio",          bench_llstats_radio },
+    { "llstats_iface",          bench_llstats_iface },
+    { "llstats_peers",          bench_llstats_peers },
+    { "nan_tlv",                bench_nan_tlv },
+};
+
+/* Doubles the iteration count until a run takes at least min_ns */
+static void bench_run(const bench *bench, uint64_t min_ns)
+{
+    bench_state b;
+    unsigned iters = 1;
+
+    memset(&b, 0, sizeof(b));
+    bench->run(&b, 16);                 /* warm up caches and pools */
+    for (;;) {
+        memset(&b, 0, sizeof(b));
+        bench->run(&b, iters);
+        if (b.ns >= min_ns || iters >= (1U << 30))
+            break;
+        iters *= 2;
+    }
+
+    printf("%-24s %10u %12.1f", bench->name, iters, (double)b.ns / iters);
+    if (BENCH_COUNTS_ALLOCS)
+        printf(" %10.2f %10.1f\n", (double)b.calls / iters,
+                (double)b.bytes / iters);
+    else
+        printf(" %10s %10s\n", "-", "-");
+    fflush(stdout);
+}
+
+static bool bench_selected(const char *name, int argc, char *argv[])
+{
+    if (optind >= argc)
+        return true;
+    for (int i = optind; i < argc; i++) {
+        if (strcmp(argv[i], name) == 0)
+            return true;
+    }
+    return false;
+}
+
+static void *bench_event_loop(void *arg)
+{
+    wifi_event_loop((wifi_handle)arg);
+    return NULL;
+}
+
+static void bench_cleaned_up(wifi_handle handle)
+{
+}
+
+int main(int argc, char *argv[])
+{
+    uint64_t min_ns = 200 * 1000000ULL;
+    pthread_t thread;
+    int opt;
+
+    while ((opt = getopt(argc, argv, "t:")) != -1) {
+        switch (opt) {
+        case 't':
+            min_ns = strtoull(optarg, NULL, 0) * 1000000ULL;
+            break;
+        default:
+            fprintf(stderr, "usage: %s [-t msec] [name...]\n", argv[0]);
+            return 2;
+        }
+    }
+
+    wifi_set_transport(&fake_driver_transport);
+    if (wifi_initialize(&bench_handle) != WIFI_SUCCESS) {
+        fprintf(stderr, "%s: the HAL failed to start\n", argv[0]);
+        return 1;
+    }
+    bench_info = getHalInfo(bench_handle);
+    if (bench_info->num_interfaces == 0) {
+        fprintf(stderr, "%s: the fake driver reported no interface\n", argv[0]);
+        return 1;
+    }
+    pthread_create(&thread, NULL, bench_event_loop, bench_handle);
+    corpus_init();
+
+    printf("%-24s %10s %12s %10s %10s\n", "benchmark", "iters", "ns/op",
+            "allocs/op", "bytes/op");
+    for (unsigned i = 0; i < sizeof(benches) / sizeof(benches[0]); i++) {
+        if (bench_selected(benches[i].name, argc, argv))
+            bench_run(&benches[i], min_ns);
+    }
+
+    corpus_cleanup();
+    wifi_cleanup(bench_handle, bench_cleaned_up);
+    pthread_join(thread, NULL);
+    return 0;
+}